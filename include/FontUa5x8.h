@@ -0,0 +1,53 @@
+#ifndef FontUa5x8_h
+#define FontUa5x8_h
+
+// Generated by tools/fontgen.py from tools/fonts/ua5x8.bdf, do not edit.
+// 73 glyphs, 54 distinct columns, 6 bit indices:
+// 357 bytes of flash (393 with plain columns)
+
+#include "UiFont.h"
+
+static const UiFontRange FONT_UA5X8_RANGES[] PROGMEM = {
+  { 0x00B0, 1, 0 }, // °
+  { 0x0404, 1, 1 }, // Є
+  { 0x0406, 2, 2 }, // ІЇ
+  { 0x0410, 64, 4 }, // АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯабвгдежзийклмнопрстуфхцчшщъыьэюя
+  { 0x0454, 1, 68 }, // є
+  { 0x0456, 2, 69 }, // ії
+  { 0x0490, 2, 71 }, // Ґґ
+};
+
+static const uint8_t FONT_UA5X8_COLUMNS[] PROGMEM = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x10, 0x11, 0x14, 0x18, 0x19,
+  0x1C, 0x20, 0x21, 0x22, 0x24, 0x27, 0x28, 0x29, 0x30, 0x31, 0x34, 0x36, 0x38, 0x3C, 0x3E, 0x3F,
+  0x40, 0x41, 0x44, 0x45, 0x46, 0x48, 0x49, 0x4A, 0x50, 0x54, 0x60, 0x63, 0x6C, 0x77, 0x78, 0x7C,
+  0x7D, 0x7E, 0x7F, 0xA0, 0xC0, 0xFC,
+};
+
+static const uint8_t FONT_UA5X8_INDICES[] PROGMEM = {
+  0x46, 0x92, 0x18, 0x80, 0x67, 0x9A, 0xE1, 0x04, 0x84, 0x72, 0x08, 0x00, 0xE3, 0x3B, 0x02, 0x71,
+  0x92, 0x24, 0xB1, 0x6C, 0x9A, 0x66, 0x26, 0x9B, 0xA6, 0xB9, 0xC9, 0x41, 0x10, 0x04, 0xAA, 0x27,
+  0x7D, 0xAA, 0x6C, 0x9A, 0x66, 0xD8, 0x22, 0x32, 0xD2, 0x4E, 0xA1, 0x69, 0x6E, 0xF2, 0x82, 0x10,
+  0x72, 0xCC, 0x24, 0x45, 0x2C, 0x23, 0xCD, 0x14, 0x82, 0x5E, 0x10, 0xC8, 0xB2, 0xA0, 0x08, 0xB2,
+  0x8C, 0x20, 0x88, 0xEC, 0x85, 0x61, 0xE8, 0xC9, 0x41, 0x10, 0xC8, 0x72, 0x92, 0x24, 0x86, 0x17,
+  0x86, 0xE1, 0x14, 0x04, 0x72, 0x10, 0x54, 0x65, 0x59, 0x7E, 0xD0, 0x24, 0x4F, 0xD0, 0xDA, 0x20,
+  0xCD, 0xFA, 0x45, 0xD1, 0xA7, 0x1E, 0x08, 0x82, 0xC8, 0x32, 0x28, 0x83, 0xF2, 0x17, 0x7D, 0x91,
+  0x1C, 0xC8, 0x65, 0x89, 0xC9, 0x25, 0x06, 0xC8, 0x72, 0x59, 0x96, 0xD8, 0x14, 0x9A, 0xA6, 0x27,
+  0x23, 0x5E, 0xE8, 0x91, 0xD7, 0x93, 0xC8, 0x51, 0x9A, 0xA6, 0x6E, 0x77, 0x9A, 0x66, 0xF6, 0xA6,
+  0x69, 0x6A, 0xBD, 0x04, 0x41, 0x10, 0x2A, 0x47, 0x75, 0x2A, 0x97, 0xA6, 0xA9, 0xC3, 0x2E, 0xEF,
+  0xC2, 0x5A, 0x62, 0x9A, 0x5A, 0x6F, 0xB4, 0x20, 0xEF, 0x2B, 0x31, 0xC9, 0xFB, 0x2E, 0x96, 0x08,
+  0x80, 0x1C, 0x41, 0xBC, 0x2F, 0xB2, 0x20, 0xEF, 0xBB, 0x2C, 0xCB, 0xCB, 0x89, 0xA2, 0xC8, 0xBD,
+  0x04, 0x41, 0xBC, 0x35, 0x45, 0x51, 0x0E, 0x27, 0x8A, 0x62, 0x44, 0x10, 0x2F, 0x41, 0x40, 0xF3,
+  0x3C, 0xBF, 0x0E, 0x15, 0x53, 0x8E, 0x68, 0x2D, 0x96, 0xF8, 0x82, 0xE0, 0x4B, 0x2B, 0xCB, 0xB2,
+  0xBC, 0x2F, 0xF8, 0x82, 0xEF, 0x0B, 0xBE, 0x60, 0x4D, 0xBC, 0x28, 0x1A, 0xBD, 0x68, 0x04, 0xBC,
+  0x2F, 0x8A, 0x46, 0x80, 0x25, 0xA6, 0x29, 0xF7, 0x2E, 0x9C, 0xC8, 0x95, 0x5A, 0xD3, 0xBC, 0x5C,
+  0x9A, 0x8A, 0x00, 0x20, 0xC2, 0x20, 0x00, 0x8C, 0x6F, 0x08, 0xC4, 0x82, 0x20, 0x0C, 0x2F, 0x41,
+  0x10, 0x06, 0x00,
+};
+
+static const UiFontData FONT_UA5X8 = {
+  FONT_UA5X8_RANGES, 7,
+  FONT_UA5X8_COLUMNS, FONT_UA5X8_INDICES, 6, 73, 357
+};
+
+#endif
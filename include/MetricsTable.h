@@ -0,0 +1,51 @@
+#ifndef MetricsTable_h
+#define MetricsTable_h
+
+/**
+ * Metrics table. The id of a metric is its position in its list, the dump carries the list
+ * sizes and tools/metrics_decode.py takes the names from here, so only append.
+ */
+#define METRICS_COUNTERS \
+  METRIC(M_WAKE_COLD,         "wake.cold") \
+  METRIC(M_WAKE_TIMER,        "wake.timer") \
+  METRIC(M_WAKE_BUTTON,       "wake.button") \
+  METRIC(M_SERVO_OPEN,        "servo.open") \
+  METRIC(M_SERVO_CLOSE,       "servo.close") \
+  METRIC(M_SERVO_STOP,        "servo.stop") \
+  METRIC(M_MOTION_TIMEOUT,    "motion.timeout") \
+  METRIC(M_MOTION_STALL,      "motion.stall") \
+  METRIC(M_DHT_READS,         "dht.reads") \
+  METRIC(M_DHT_FAILS,         "dht.fails") \
+  METRIC(M_CHECKPOINTS,       "metrics.checkpoints") \
+  METRIC(M_POWER_SWITCHES,    "power.switches") \
+  METRIC(M_POWER_DEFERRED,    "power.deferred")
+
+#define METRICS_GAUGES \
+  METRIC(M_BATTERY_MV,        "battery.mv") \
+  METRIC(M_BATTERY_PERCENT,   "battery.percent") \
+  METRIC(M_TEMP_DECI,         "temp.deci_c") \
+  METRIC(M_POWER_PROFILE,     "power.profile") \
+  METRIC(M_RUNTIME_H,         "power.runtime_h")
+
+#define METRICS_HISTOGRAMS \
+  METRIC(M_MOTION_MS,         "motion.ms") \
+  METRIC(M_MOTION_PEAK_MA,    "motion.peak_ma") \
+  METRIC(M_BOOT_US,           "boot.us") \
+  METRIC(M_UI_LATENCY_MS,     "ui.latency_ms")
+
+#define METRIC(id, name) id,
+enum MetricCounterId : uint8_t {
+  METRICS_COUNTERS
+  M_COUNTERS_COUNT
+};
+enum MetricGaugeId : uint8_t {
+  METRICS_GAUGES
+  M_GAUGES_COUNT
+};
+enum MetricHistogramId : uint8_t {
+  METRICS_HISTOGRAMS
+  M_HISTOGRAMS_COUNT
+};
+#undef METRIC
+
+#endif
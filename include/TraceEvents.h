@@ -0,0 +1,45 @@
+#ifndef TraceEvents_h
+#define TraceEvents_h
+
+/**
+ * Trace event table. The id of an event is its position in the list, so only append.
+ * Format strings are printf style and are applied by tools/trace_decode.py on the host,
+ * nothing of them ends up in the firmware.
+ */
+#define TRACE_EVENTS \
+  TRACE_EVENT(TR_BOOT,            "boot: wake reason %u, button %u") \
+  TRACE_EVENT(TR_DROPPED,         "trace: %u events overwritten") \
+  TRACE_EVENT(TR_BATTERY,         "battery: load %.2f V, current %.1f mA, %u %%") \
+  TRACE_EVENT(TR_BATTERY_SHUNT,   "battery: bus %.2f V, shunt %.2f mV, power %.1f mW") \
+  TRACE_EVENT(TR_BATTERY_RANGE,   "battery: min %.1f V, max %.1f V") \
+  TRACE_EVENT(TR_CHECK,           "check: low %.1f, cur %.1f, high %.1f") \
+  TRACE_EVENT(TR_CHECK_STATE,     "check: display %u, opened %u, ready %u") \
+  TRACE_EVENT(TR_OPEN_REQ,        "open: servo op %u, full %u, partial %u") \
+  TRACE_EVENT(TR_OPEN_SKIP,       "open: already opened, nothing to do") \
+  TRACE_EVENT(TR_OPEN,            "open: rotate %d us") \
+  TRACE_EVENT(TR_CLOSE_REQ,       "close: servo op %u, full %u, partial %u") \
+  TRACE_EVENT(TR_CLOSE_SKIP,      "close: already closed, nothing to do") \
+  TRACE_EVENT(TR_CLOSE,           "close: rotate %d us") \
+  TRACE_EVENT(TR_MOTION,          "motion: op %u, high pressed %u, low pressed %u") \
+  TRACE_EVENT(TR_MOTION_DONE,     "motion: op %u done in %u ms") \
+  TRACE_EVENT(TR_MOTION_TIMEOUT,  "motion: op %u timeout after %u ms") \
+  TRACE_EVENT(TR_SERVO_IDLE,      "servo: idle current powered %.1f mA, gated %.1f mA") \
+  TRACE_EVENT(TR_MOTION_STALL,    "motion: op %u stalled at %d mA, detected in %u ms") \
+  TRACE_EVENT(TR_MOTION_CURRENT,  "motion: current sampled at %u Hz, peak %d mA, stall latency %u ms") \
+  TRACE_EVENT(TR_PEER,            "peers: %u heard, leader %u, request %u, radio %u ms") \
+  TRACE_EVENT(TR_WAKE_PIXEL,      "display: first pixel at %u us, fresh frame at %u us, resumed %u") \
+  TRACE_EVENT(TR_BOOT_PHASE,      "boot: critical phase %u at %u us took %u us") \
+  TRACE_EVENT(TR_BOOT_GRAPH,      "boot: %u us, sequential %u us, critical path of %u phases") \
+  TRACE_EVENT(TR_BOOT_OVER,       "boot: %u us over the budget of %u us") \
+  TRACE_EVENT(TR_UI_SLOW,         "ui: input to photon %u ms, over the p99 budget of %u ms") \
+  TRACE_EVENT(TR_POWER_PROFILE,   "power: profile %u -> %u at %.2f V") \
+  TRACE_EVENT(TR_POWER_DEFER,     "power: request %u deferred at %.1f C, %u checks in a row")
+
+#define TRACE_EVENT(id, fmt) id,
+enum TraceEventId : uint8_t {
+  TRACE_EVENTS
+  TR_EVENTS_COUNT
+};
+#undef TRACE_EVENT
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef Bench_h
+#define Bench_h
+
+#include <Arduino.h>
+
+/**
+ * One line benchmark reports on the serial port: "BENCH <name> key=value ...".
+ * Compiled out without BENCH_ENABLE:
+ *   BENCH("main_frame").add("draw_calls", n).add("us", t);
+ */
+
+#ifdef BENCH_ENABLE
+
+class BenchLine {
+public:
+  BenchLine(const char* name) {
+    Serial.print("BENCH ");
+    Serial.print(name);
+  }
+
+  ~BenchLine() {
+    Serial.println();
+  }
+
+  template< typename T >
+  BenchLine& add(const char* key, const T val) {
+    Serial.print(' ');
+    Serial.print(key);
+    Serial.print('=');
+    Serial.print(val);
+    return *this;
+  }
+};
+
+#define BENCH(name) BenchLine(name)
+#define BENCH_CYCLES() ESP.getCycleCount()
+
+#else
+
+class BenchLine {
+public:
+  template< typename T >
+  BenchLine& add(const char*, const T) {
+    return *this;
+  }
+};
+
+#define BENCH(name) BenchLine()
+#define BENCH_CYCLES() 0
+
+#endif
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef BootGraph_h
+#define BootGraph_h
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * Boot as a graph of phases instead of a fixed sequence.
+ *
+ * A phase has a start hook and an optional completion hook (poll). Without poll the phase
+ * is done when start() returns; with poll it stays running and the scheduler starts other
+ * phases whose dependencies are met until poll() reports it done. run() starts ready phases
+ * in the order they were added, so add the long I/O phases first.
+ *
+ * Phases which block inside a driver (delay() in a sensor read) are made asynchronous with
+ * BootTask: it runs the blocking part on its own FreeRTOS task, the boot continues on the
+ * loop task while the driver sleeps.
+ *
+ * After run() every phase has its start / end time and the time it was ready but waited for
+ * the CPU. The critical path goes back from the phase which finished last over the
+ * dependency which finished last: shortening a phase on it shortens the boot, others do not.
+ */
+
+#ifndef BOOT_PHASES_MAX
+#define BOOT_PHASES_MAX 16
+#endif
+
+#define BOOT_AFTER(phase) (1UL << (phase))
+
+struct BootPhase {
+  const char* name;
+  void (*start)();
+  bool (*poll)();   // nullptr: done when start() returns
+  uint32_t deps;    // BOOT_AFTER(a) | BOOT_AFTER(b)
+  uint32_t readyUs; // all dependencies done
+  uint32_t startUs;
+  uint32_t endUs;
+  uint8_t state;
+};
+
+enum BootPhaseState : uint8_t {
+  BOOT_WAITING = 0,
+  BOOT_RUNNING,
+  BOOT_DONE
+};
+
+class BootGraph {
+public:
+  uint32_t startUs = 0;
+  uint32_t endUs = 0;
+
+  /**
+   * Phase index for BOOT_AFTER(), in the order of the calls.
+   */
+  uint8_t add(const char* name, void (*start)(), bool (*poll)() = nullptr, const uint32_t deps = 0) {
+    if (_count == BOOT_PHASES_MAX) {
+      return _count;
+    }
+    _phases[_count] = { name, start, poll, deps, 0, 0, 0, BOOT_WAITING };
+    return _count++;
+  }
+
+  /**
+   * Runs all phases. False if some could not start: a dependency on a missing phase or a cycle.
+   */
+  bool run() {
+    startUs = micros();
+    uint8_t left = _count;
+
+    while (left) {
+      bool isProgress = false;
+
+      for (uint8_t i = 0; i < _count; i++) {
+        BootPhase& p = _phases[i];
+        if (p.state == BOOT_RUNNING && p.poll()) {
+          finish(p);
+          left--;
+          isProgress = true;
+        }
+      }
+
+      for (uint8_t i = 0; i < _count; i++) {
+        BootPhase& p = _phases[i];
+        if (p.state != BOOT_WAITING || !isReady(p)) {
+          continue;
+        }
+
+        p.startUs = micros();
+        p.state = BOOT_RUNNING;
+        p.start();
+        if (!p.poll) {
+          finish(p);
+          left--;
+        }
+        isProgress = true;
+        break; // a finished phase may unblock an earlier one
+      }
+
+      if (!isProgress) {
+        if (!isAnyRunning()) {
+          break;
+        }
+        delay(1); // only async phases are left, let their tasks run
+      }
+    }
+
+    endUs = micros();
+    return !left;
+  }
+
+  uint8_t count() const {
+    return _count;
+  }
+
+  const BootPhase& phase(const uint8_t i) const {
+    return _phases[i];
+  }
+
+  uint32_t totalUs() const {
+    return endUs - startUs;
+  }
+
+  /**
+   * Sum of the phase durations, about what the boot takes without overlapping.
+   */
+  uint32_t sequentialUs() const {
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      sum += _phases[i].endUs - _phases[i].startUs;
+    }
+    return sum;
+  }
+
+  /**
+   * Critical path, first phase first, into path (count() entries). Returns its length.
+   */
+  uint8_t criticalPath(uint8_t* path) const {
+    uint8_t len = 0;
+    int16_t cur = -1;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_phases[i].state == BOOT_DONE && (cur < 0 || _phases[i].endUs - startUs > _phases[cur].endUs - startUs)) {
+        cur = i;
+      }
+    }
+
+    while (cur >= 0 && len < _count) {
+      path[len++] = cur;
+      int16_t prev = -1;
+      for (uint8_t i = 0; i < _count; i++) {
+        if ((_phases[cur].deps & BOOT_AFTER(i)) &&
+            (prev < 0 || _phases[i].endUs - startUs > _phases[prev].endUs - startUs)) {
+          prev = i;
+        }
+      }
+      cur = prev;
+    }
+
+    for (uint8_t i = 0; i < len / 2; i++) {
+      uint8_t t = path[i];
+      path[i] = path[len - 1 - i];
+      path[len - 1 - i] = t;
+    }
+    return len;
+  }
+
+  /**
+   * One line per phase (start, duration, CPU wait after ready, in us from the boot start)
+   * and the critical path.
+   */
+  void printReport(Print& out) const {
+    for (uint8_t i = 0; i < _count; i++) {
+      const BootPhase& p = _phases[i];
+      out.print("boot "); out.print(p.name);
+      if (p.state != BOOT_DONE) {
+        out.println(p.state == BOOT_RUNNING ? ": not finished" : ": not started");
+        continue;
+      }
+      out.print(" @"); out.print(p.startUs - startUs);
+      out.print(" took "); out.print(p.endUs - p.startUs);
+      out.print(" waited "); out.println(p.startUs - p.readyUs);
+    }
+
+    uint8_t path[BOOT_PHASES_MAX];
+    uint8_t len = criticalPath(path);
+    out.print("boot critical:");
+    for (uint8_t i = 0; i < len; i++) {
+      out.print(i ? " > " : " "); out.print(_phases[path[i]].name);
+    }
+    out.print(" total us: "); out.print(totalUs());
+    out.print(" sequential us: "); out.println(sequentialUs());
+  }
+
+private:
+  BootPhase _phases[BOOT_PHASES_MAX];
+  uint8_t _count = 0;
+
+  static_assert(BOOT_PHASES_MAX <= 32, "dependencies are a 32 bit mask");
+
+  bool isReady(BootPhase& p) {
+    uint32_t readyUs = startUs;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (!(p.deps & BOOT_AFTER(i))) {
+        continue;
+      }
+      if (_phases[i].state != BOOT_DONE) {
+        return false;
+      }
+      if (_phases[i].endUs - startUs > readyUs - startUs) {
+        readyUs = _phases[i].endUs;
+      }
+    }
+    // a dependency on a phase which was never added never becomes ready
+    if (p.deps >> _count) {
+      return false;
+    }
+    p.readyUs = readyUs;
+    return true;
+  }
+
+  bool isAnyRunning() const {
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_phases[i].state == BOOT_RUNNING) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void finish(BootPhase& p) {
+    p.endUs = micros();
+    p.state = BOOT_DONE;
+  }
+};
+
+/**
+ * A blocking call on its own FreeRTOS task, for a BootGraph phase: start() from the phase
+ * start hook, done() as its poll hook. The call must not touch state the boot uses meanwhile
+ * (no Serial, no trace). Runs inline if the task cannot be created.
+ */
+class BootTask {
+public:
+  void start(void (*fn)(), const char* name, const uint32_t stackBytes = 2048, const uint8_t priority = 2) {
+    _fn = fn;
+    _done = false;
+    if (xTaskCreate(run, name, stackBytes, this, priority, nullptr) != pdPASS) {
+      _fn();
+      _done = true;
+    }
+  }
+
+  bool done() const {
+    return _done;
+  }
+
+private:
+  void (*_fn)() = nullptr;
+  std::atomic<bool> _done{true};
+
+  static void run(void* arg) {
+    BootTask* self = (BootTask*)arg;
+    self->_fn();
+    self->_done = true;
+    vTaskDelete(nullptr);
+  }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ClimateControl_h
+#define ClimateControl_h
+
+#include <stdint.h>
+#include "SensorFilter.h"
+
+/**
+ * Window decisions of the temperature check, without hardware access, so host tools
+ * (tools/sweep) replay exactly what the firmware decides.
+ */
+
+// outliers -> median -> EMA -> slew limit
+typedef FilterPipeline<OutlierFilter<30>, MedianFilter<3>, EmaFilter<40>, SlewLimiter<5>> TempFilter;
+
+enum ClimateRequest : uint8_t {
+  CLIMATE_KEEP = 0,
+  CLIMATE_OPEN,
+  CLIMATE_CLOSE
+};
+
+/**
+ * What a temperature check asks for. Nothing until the filter has a valid sample
+ * (do not act on the initial 0) and nothing after a manual stop.
+ */
+inline ClimateRequest climateRequest(const bool isReady, const float temp, const float lowTemp, const float highTemp,
+                                     const bool isForceStopped) {
+  if (!isReady || isForceStopped) {
+    return CLIMATE_KEEP;
+  }
+
+  if (temp >= highTemp) {
+    return CLIMATE_OPEN;
+  }
+
+  if (temp < lowTemp) {
+    return CLIMATE_CLOSE;
+  }
+
+  return CLIMATE_KEEP;
+}
+
+/**
+ * An open request moves the servo unless the window is already fully opened.
+ */
+inline bool climateNeedsOpen(const bool isFullOpened, const bool isPartiallyOpened) {
+  return !isFullOpened || isPartiallyOpened;
+}
+
+/**
+ * A close request moves the servo unless the window is already fully closed.
+ */
+inline bool climateNeedsClose(const bool isFullOpened, const bool isPartiallyOpened) {
+  return isFullOpened || isPartiallyOpened;
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef Coroutine_h
+#define Coroutine_h
+
+#include <Arduino.h>
+#include <atomic>
+#include "TimerWheel.h"
+
+/**
+ * Stackless coroutines and a cooperative executor on a TimerWheel.
+ *
+ * A flow which waits in between ("run the servo, wait for the endstops, stop, check the
+ * temperature") is one step function instead of flags checked on every loop pass:
+ *
+ *   bool motionTask(CoTask& t) {
+ *     CO_BEGIN(t);
+ *     startServo();
+ *     CO_AWAIT_EVENT(t, EV_ENDSTOP, MOTION_TIMEOUT);
+ *     stopServo();
+ *     CO_AWAIT_MS(t, 500);
+ *     checkTemperature();
+ *     CO_END(t);
+ *   }
+ *
+ * The await macros store the resume point in the task and return, the executor calls the
+ * step again when the timer ran out or the event came; the switch jumps back behind the
+ * await (protothread style, the toolchain has no C++20 coroutines). Locals do not survive
+ * an await, keep the state of a flow in globals, and an await cannot be inside a switch.
+ *
+ * Events are bits from signal() / signalFromIsr() (GPIO interrupts). A task gets the bits
+ * of its waitMask in t.events, also while it is running (CO_LISTEN), and clears them itself.
+ * run() is one loop pass; isBusy() / nextDeadline() tell the idle code when it may sleep.
+ */
+
+#ifndef CO_TASKS_MAX
+#define CO_TASKS_MAX 8
+#endif
+
+#define CO_OVERRIDE_NONE 0xFF
+
+enum CoState : uint8_t {
+  CO_DONE = 0,
+  CO_READY,    // stepped every run()
+  CO_SLEEPING, // until its timer
+  CO_WAITING   // until an event of waitMask or its timer
+};
+
+struct CoTask {
+  bool (*step)(CoTask& t); // false when the flow ended
+  const char* name;
+  uint16_t line;           // resume point, 0 = start
+  uint8_t state;
+  uint32_t waitMask;
+  uint32_t events;         // waitMask bits received
+  uint32_t awaitMs;        // timer of the current await, 0 = none
+  WheelTimer timer;
+};
+
+#define CO_BEGIN(t) switch ((t).line) { case 0:
+#define CO_END(t) } (t).line = 0; return false
+
+#define CO_AWAIT_STATE(t, newState, ms) \
+  do { (t).state = (newState); (t).awaitMs = (ms); (t).line = __LINE__; return true; case __LINE__:; } while (0)
+
+// next run() pass
+#define CO_YIELD(t) CO_AWAIT_STATE(t, CO_READY, 0)
+// ms from now
+#define CO_AWAIT_MS(t, ms) CO_AWAIT_STATE(t, CO_SLEEPING, ms)
+// an event bit of mask or timeoutMs (0: none); t.events is 0 after a timeout
+#define CO_AWAIT_EVENT(t, mask, timeoutMs) \
+  do { (t).waitMask = (mask); (t).events = 0; CO_AWAIT_STATE(t, CO_WAITING, timeoutMs); } while (0)
+// polled every pass, for conditions without an event
+#define CO_AWAIT_UNTIL(t, cond) while (!(cond)) CO_YIELD(t)
+// collect these event bits into t.events while the task runs
+#define CO_LISTEN(t, mask) ((t).waitMask = (mask))
+#define CO_EXIT(t) do { (t).line = 0; return false; } while (0)
+
+class CoExecutor {
+public:
+  TimerWheel wheel;
+  uint32_t steps = 0;
+
+  void begin(const uint32_t nowMs) {
+    wheel.begin(nowMs);
+  }
+
+  /**
+   * Registers a flow, not started yet. Returns its id for start() / stop().
+   */
+  uint8_t add(bool (*step)(CoTask&), const char* name) {
+    if (_count == CO_TASKS_MAX) {
+      return _count;
+    }
+    CoTask& t = _tasks[_count];
+    t = CoTask();
+    t.step = step;
+    t.name = name;
+    t.timer.fn = wake;
+    t.timer.arg = &t;
+    return _count++;
+  }
+
+  /**
+   * Starts the flow from its beginning at the next run(), a running one restarts.
+   * From inside its own step the restart takes effect after the step returned.
+   */
+  void start(const uint8_t id) {
+    CoTask& t = _tasks[id];
+    wheel.cancel(t.timer);
+    t.line = 0;
+    t.waitMask = 0;
+    t.events = 0;
+    t.state = CO_READY;
+    if (&t == _current) {
+      _currentOverride = CO_READY;
+    }
+  }
+
+  /**
+   * Ends the flow, also from inside its own step.
+   */
+  void stop(const uint8_t id) {
+    CoTask& t = _tasks[id];
+    wheel.cancel(t.timer);
+    t.line = 0;
+    t.state = CO_DONE;
+    if (&t == _current) {
+      _currentOverride = CO_DONE;
+    }
+  }
+
+  bool isRunning(const uint8_t id) const {
+    return _tasks[id].state != CO_DONE;
+  }
+
+  void signal(const uint32_t bits) {
+    _events.fetch_or(bits, std::memory_order_relaxed);
+  }
+
+  void IRAM_ATTR signalFromIsr(const uint32_t bits) {
+    _events.fetch_or(bits, std::memory_order_relaxed);
+  }
+
+  /**
+   * One loop pass: due timers, events, then every ready task once.
+   * Events nobody listens to are dropped.
+   */
+  void run(const uint32_t nowMs) {
+    wheel.advance(nowMs);
+
+    uint32_t events = _events.exchange(0, std::memory_order_relaxed);
+    for (uint8_t i = 0; i < _count && events; i++) {
+      CoTask& t = _tasks[i];
+      uint32_t got = events & t.waitMask;
+      if (t.state == CO_DONE || !got) {
+        continue;
+      }
+      t.events |= got;
+      if (t.state == CO_WAITING) {
+        wheel.cancel(t.timer);
+        t.state = CO_READY;
+      }
+    }
+
+    for (uint8_t i = 0; i < _count; i++) {
+      CoTask& t = _tasks[i];
+      if (t.state != CO_READY) {
+        continue;
+      }
+      steps++;
+      _current = &t;
+      _currentOverride = CO_OVERRIDE_NONE;
+      bool isAlive = t.step(t);
+      _current = nullptr;
+      if (_currentOverride != CO_OVERRIDE_NONE || !isAlive) {
+        // start() / stop() from the step win over where it stopped
+        wheel.cancel(t.timer);
+        t.line = 0;
+        t.state = _currentOverride == CO_READY ? CO_READY : CO_DONE;
+        continue;
+      }
+      if (t.awaitMs) {
+        wheel.after(t.timer, t.awaitMs, nowMs);
+      } else if (t.state == CO_SLEEPING) {
+        t.state = CO_READY; // CO_AWAIT_MS(t, 0)
+      }
+    }
+  }
+
+  /**
+   * A task runs on the next pass, do not sleep.
+   */
+  bool isBusy() const {
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_tasks[i].state == CO_READY) {
+        return true;
+      }
+    }
+    return _events.load(std::memory_order_relaxed) != 0;
+  }
+
+  /**
+   * Earliest timer of the tasks and of the plain wheel timers, false if none.
+   */
+  bool nextDeadline(uint32_t& deadlineMs) {
+    return wheel.nextDeadline(deadlineMs);
+  }
+
+  const CoTask& task(const uint8_t id) const {
+    return _tasks[id];
+  }
+
+private:
+  CoTask _tasks[CO_TASKS_MAX];
+  uint8_t _count = 0;
+  std::atomic<uint32_t> _events{0};
+  CoTask* _current = nullptr;      // stepping now
+  uint8_t _currentOverride = CO_OVERRIDE_NONE;
+
+  static void wake(void* arg) {
+    CoTask* t = (CoTask*)arg;
+    if (t->state == CO_SLEEPING || t->state == CO_WAITING) {
+      t->state = CO_READY;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef CpuGovernor_h
+#define CpuGovernor_h
+
+#include <Arduino.h>
+
+/**
+ * Workload driven CPU clock.
+ *
+ * Hot paths hint what they are about to do and the governor switches the CPU clock
+ * with setCpuFrequencyMhz(). Only clocks >= 80 MHz are used: there APB stays at 80 MHz,
+ * so I2C, LEDC (servo PWM) and UART timings are not touched by a switch.
+ * Time per load is accounted to estimate the energy against a fixed max clock.
+ */
+
+#if CONFIG_IDF_TARGET_ESP32C3 || defined(ESP32C3)
+#define GOV_FREQ_MAX 160
+#define GOV_MA_AT_MAX 28.0 // typical, radio off
+#define GOV_MA_AT_MIN 20.0
+#else
+#define GOV_FREQ_MAX 240
+#define GOV_MA_AT_MAX 50.0
+#define GOV_MA_AT_MIN 30.0
+#endif
+
+#ifndef GOV_FREQ_MIN
+#define GOV_FREQ_MIN 80
+#endif
+
+#if GOV_FREQ_MIN < 80
+#error "below 80 MHz APB follows the CPU clock and breaks I2C / PWM timings"
+#endif
+
+#define GOV_SUPPLY_V 3.3
+
+enum GovernorLoad {
+  GOV_IDLE_UI = 0,     // waiting for input with the display on
+  GOV_SENSOR_WAIT,     // busy waiting on slow sensors (DHT)
+  GOV_RENDER,          // rasterizing and pushing frames
+  GOV_MOTION,          // supervising the servo (endstops polling)
+  GOV_LOADS_COUNT
+};
+
+class CpuGovernor {
+public:
+  /**
+   * Switches to a load for the lifetime of the scope, then back to the previous one.
+   */
+  class Scope {
+  public:
+    Scope(CpuGovernor& gov, const GovernorLoad load): _gov(gov), _prev(gov.load()) {
+      _gov.hint(load);
+    }
+
+    ~Scope() {
+      _gov.hint(_prev);
+    }
+
+  private:
+    CpuGovernor& _gov;
+    GovernorLoad _prev;
+  };
+
+  void begin(const GovernorLoad load = GOV_RENDER) {
+    _load = load;
+    _since = micros();
+    apply(freqOf(load));
+  }
+
+  void hint(const GovernorLoad load) {
+    if (load == _load) {
+      return;
+    }
+
+    account();
+    _load = load;
+    apply(freqOf(load));
+  }
+
+  GovernorLoad load() const {
+    return _load;
+  }
+
+  static uint16_t freqOf(const GovernorLoad load) {
+    return load == GOV_RENDER ? GOV_FREQ_MAX : GOV_FREQ_MIN;
+  }
+
+  uint32_t timeMs(const GovernorLoad load) {
+    account();
+    return _timeUs[load] / 1000;
+  }
+
+  /**
+   * Estimated CPU energy in mJ, as governed and as it would be at a fixed max clock.
+   * Conservative: the time of render bursts is the same in both cases.
+   */
+  float energyMj(const bool fixedClock = false) {
+    account();
+    float mj = 0;
+    for (uint8_t i = 0; i < GOV_LOADS_COUNT; i++) {
+      float ma = fixedClock ? GOV_MA_AT_MAX : currentMa(freqOf((GovernorLoad)i));
+      mj += ma * GOV_SUPPLY_V * _timeUs[i] / 1000000.0;
+    }
+    return mj;
+  }
+
+  void resetStats() {
+    account();
+    memset(_timeUs, 0, sizeof(_timeUs));
+    _switches = 0;
+  }
+
+  void printReport(Print& out) {
+    static const char* NAMES[GOV_LOADS_COUNT] = { "idle ui", "sensor", "render", "motion" };
+
+    for (uint8_t i = 0; i < GOV_LOADS_COUNT; i++) {
+      out.print("gov "); out.print(NAMES[i]); out.print(" @"); out.print(freqOf((GovernorLoad)i));
+      out.print("MHz: "); out.print(timeMs((GovernorLoad)i)); out.println(" ms");
+    }
+    out.print("gov switches: "); out.print(_switches);
+    out.print(" energy mJ: "); out.print(energyMj());
+    out.print(" fixed clock mJ: "); out.println(energyMj(true));
+  }
+
+private:
+  GovernorLoad _load = GOV_RENDER;
+  unsigned long _since = 0;
+  uint64_t _timeUs[GOV_LOADS_COUNT] = {};
+  uint32_t _switches = 0;
+
+  void account() {
+    unsigned long now = micros();
+    _timeUs[_load] += now - _since;
+    _since = now;
+  }
+
+  void apply(const uint16_t mhz) {
+    if (getCpuFrequencyMhz() != mhz) {
+      setCpuFrequencyMhz(mhz);
+      _switches++;
+    }
+  }
+
+  static float currentMa(const uint16_t mhz) {
+    return GOV_MA_AT_MIN + (GOV_MA_AT_MAX - GOV_MA_AT_MIN) * (mhz - GOV_FREQ_MIN) / (GOV_FREQ_MAX - GOV_FREQ_MIN);
+  }
+};
+
+#endif
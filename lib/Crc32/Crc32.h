@@ -0,0 +1,25 @@
+#ifndef Crc32_h
+#define Crc32_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * CRC-32 as zlib.crc32() (so the host tools check it with zlib), with a 16 entry table:
+ * 64 bytes instead of 1 KB, two lookups per byte. Chain calls by passing the last result.
+ */
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  static const uint32_t TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+#endif
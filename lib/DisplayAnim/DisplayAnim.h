@@ -0,0 +1,141 @@
+#ifndef DisplayAnim_h
+#define DisplayAnim_h
+
+#include <Arduino.h>
+
+/**
+ * Animations done by the display controller instead of by sending frames
+ * (setStartLine() / scrollColumns() of the display backends, see DisplayBackend.h).
+ *
+ * PageSlide: a new menu page slides in vertically. The start line (the panel RAM row shown
+ * at the top) moves one 8 row band per step, and each step sends only the band of the new
+ * page which enters the view: a page change costs the same 1 KB as display(), spread over
+ * the steps, and the first band is on the panel after 128 bytes instead of 1024.
+ *
+ * Marquee: a rect (the motion arrow) scrolls one column per step in the panel RAM,
+ * 7 command bytes per step instead of a redrawn frame.
+ *
+ * Both report false from begin() when the panel cannot do it (e-paper, SH1106 content
+ * scroll, 90 degree rotations); the caller then draws the plain way.
+ */
+
+template< typename TDisplay >
+class PageSlide {
+public:
+  uint32_t slides = 0;
+
+  /**
+   * Starts a slide to what was drawn into the display's picture, not flushed yet.
+   * dir > 0: the next page comes in from below, < 0: the previous one from above.
+   * False if the panel has no start line, display() it then.
+   */
+  bool begin(TDisplay& d, const int8_t dir) {
+    finish();
+    uint8_t rotation = d.getRotation();
+    if ((rotation & 1) || d.height() % 8 || !d.setStartLine(0)) {
+      return false;
+    }
+    _d = &d;
+    _bands = d.height() / 8;
+    _step = 0;
+    _isNext = dir > 0;
+    // the start line counts physical rows, rotation 2 turns the panel upside down
+    _isUp = _isNext == (rotation == 0);
+    slides++;
+    return true;
+  }
+
+  /**
+   * Next band. Returns false after the last one, the start line is back at 0 then and the
+   * panel RAM holds the new page in place.
+   */
+  bool step() {
+    if (!_d) {
+      return false;
+    }
+
+    _step++;
+    uint8_t band = _isNext ? _step - 1 : _bands - _step;
+    uint8_t rows = _bands * 8;
+    // the band takes the place of the old rows about to leave the view, the new start
+    // line moves it to the entering edge
+    _d->displayRegion(0, band * 8, _d->width(), 8);
+    _d->setStartLine(_isUp ? (_step * 8) % rows : (rows - _step * 8) % rows);
+    if (_step == _bands) {
+      _d = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Sends the rest at once, before drawing anything else.
+   */
+  void finish() {
+    while (step()) {}
+  }
+
+  bool isActive() const {
+    return _d != nullptr;
+  }
+
+private:
+  TDisplay* _d = nullptr;
+  uint8_t _bands = 0;
+  uint8_t _step = 0;
+  bool _isNext = true;
+  bool _isUp = true;
+};
+
+template< typename TDisplay >
+class Marquee {
+public:
+  uint32_t steps = 0;
+
+  /**
+   * Scrolls the rect (logical coordinates, whole 8 row pages move) one column every stepMs
+   * from tick(). What is drawn there should repeat across the rect. False without a
+   * hardware content scroll.
+   */
+  bool begin(TDisplay& d, const int16_t x, const int16_t y, const int16_t w, const int16_t h,
+             const bool toLeft, const uint16_t stepMs) {
+    if (!d.hasColumnScroll()) {
+      return false;
+    }
+    _d = &d;
+    _x = x; _y = y; _w = w; _h = h;
+    _isLeft = toLeft;
+    _stepMs = stepMs;
+    _lastMs = millis();
+    return true;
+  }
+
+  void tick(const uint32_t nowMs) {
+    if (!_d || nowMs - _lastMs < _stepMs) {
+      return;
+    }
+    _lastMs = nowMs;
+    if (_d->scrollColumns(_x, _y, _w, _h, _isLeft)) {
+      steps++;
+    } else {
+      _d = nullptr;
+    }
+  }
+
+  void end() {
+    _d = nullptr;
+  }
+
+  bool isActive() const {
+    return _d != nullptr;
+  }
+
+private:
+  TDisplay* _d = nullptr;
+  int16_t _x = 0, _y = 0, _w = 0, _h = 0;
+  bool _isLeft = false;
+  uint16_t _stepMs = 0;
+  uint32_t _lastMs = 0;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef DisplayBackend_h
+#define DisplayBackend_h
+
+#include <Arduino.h>
+
+/**
+ * Display backends the menu (OledMenu<N, TDisplay>) and the main screen widgets program against.
+ *
+ * A backend is an Adafruit_GFX (drawing primitives and text; print() takes UTF-8, the
+ * classic font draws ASCII and UiFont the rest, see UiFont.h) plus:
+ *   bool begin(vcs, addr)         panel init; e-paper / headless ignore the OLED arguments
+ *   bool resume(addr, frame, len) the controller stayed powered and configured (deep sleep):
+ *                                 takes the picture saved by saveFrame() back without the init
+ *                                 sequence; false if the panel does not answer, begin() then
+ *   uint16_t saveFrame(buf, cap) const  copies the picture for resume(), 0 if none is needed
+ *   void clearDisplay()           clears the picture, not the panel
+ *   void display()                pushes the whole picture
+ *   void displayRegion(x, y, w, h) pushes at least the rect (logical, rotated coordinates)
+ *   void poll()                   finishes deferred work, call every loop pass (e-paper refresh)
+ *   bool isFlushPending() const   a flush waits for poll(), do not sleep
+ *   void setPower(bool)           panel on / off (sleep), the picture is kept in RAM
+ *   void setContrast(uint8_t)
+ *   bool retainsImage() const     the panel keeps showing the image unpowered (e-paper)
+ *   uint16_t ramBytes() const     RAM used for the picture
+ *   uint16_t litPixels() const    lit (OLED) / inked (e-paper) pixels of the picture, for power estimates
+ *   uint32_t flushedBytes         bytes sent by the last flush
+ *   uint32_t flushes              flushes sent to the panel so far
+ *   uint32_t shownFrames() const  flushes the panel shows; an e-paper refresh counts once it finished
+ *   bool setStartLine(uint8_t)    panel RAM row shown at the top (hardware vertical offset), false if none
+ *   bool hasColumnScroll() const  scrollColumns() is done by the controller
+ *   bool scrollColumns(x, y, w, h, toLeft)  moves the rect (whole 8 row pages) one column inside
+ *                                 the panel RAM, the column pushed out comes back at the other end;
+ *                                 no data is sent; false if the panel cannot
+ *
+ * Implementations: Ssd1306Display, Ssd1306PageDisplay (no framebuffer), Sh1106Display (the
+ * two OLEDs on a framebuffer share OledFramebuffer), EpdDisplay (SSD1681 e-paper) and
+ * HeadlessDisplay (host, for tests).
+ */
+
+/**
+ * Logical rect of a rotated display -> clipped physical rect, false if nothing is left.
+ * Rotation follows Adafruit_SSD1306::drawPixel().
+ */
+inline bool displayRectToPhysical(const uint8_t rotation, const int16_t width, const int16_t height,
+                                  int16_t& x, int16_t& y, int16_t& w, int16_t& h) {
+  int16_t t;
+  switch (rotation & 3) {
+    case 1:
+      t = x;
+      x = width - y - h;
+      y = t;
+      t = w; w = h; h = t;
+      break;
+    case 2:
+      x = width - x - w;
+      y = height - y - h;
+      break;
+    case 3:
+      t = y;
+      y = height - x - w;
+      x = t;
+      t = w; w = h; h = t;
+      break;
+  }
+
+  if (x < 0) { w += x; x = 0; }
+  if (y < 0) { h += y; y = 0; }
+  if (x + w > width) w = width - x;
+  if (y + h > height) h = height - y;
+  return w > 0 && h > 0;
+}
+
+// SSD1306 content scroll (one column per command), not on the oldest controller revisions
+#define SSD1306_CONTENT_SCROLL_RIGHT 0x2C
+#define SSD1306_CONTENT_SCROLL_LEFT 0x2D
+
+/**
+ * Logical column scroll of a rect -> physical rect and direction; false for 90 degree
+ * rotations (it would be a vertical scroll) or if nothing is left.
+ */
+inline bool displayScrollToPhysical(const uint8_t rotation, const int16_t width, const int16_t height,
+                                    int16_t& x, int16_t& y, int16_t& w, int16_t& h, bool& toLeft) {
+  if (rotation & 1) {
+    return false;
+  }
+  if (rotation & 2) {
+    toLeft = !toLeft;
+  }
+  return displayRectToPhysical(rotation, width, height, x, y, w, h);
+}
+
+/**
+ * What a content scroll does to the panel RAM, for the framebuffer copy: the columns of a
+ * physical rect move by one in every page it touches, the one pushed out wraps around.
+ */
+inline void displayRotateColumns(uint8_t* buf, const int16_t width, const int16_t x, const int16_t y,
+                                 const int16_t w, const int16_t h, const bool toLeft) {
+  if (w < 2) {
+    return;
+  }
+  for (uint8_t page = y / 8; page <= (y + h - 1) / 8; page++) {
+    uint8_t* row = buf + page * width + x;
+    if (toLeft) {
+      uint8_t first = row[0];
+      memmove(row, row + 1, w - 1);
+      row[w - 1] = first;
+    } else {
+      uint8_t last = row[w - 1];
+      memmove(row + 1, row, w - 1);
+      row[0] = last;
+    }
+  }
+}
+
+/**
+ * Set bits in a buffer; a lit OLED pixel is a set bit.
+ */
+inline uint16_t displayCountBits(const uint8_t* buf, const size_t len) {
+  uint16_t count = 0;
+  const uint8_t* end = buf + len;
+  while (buf + 4 <= end) {
+    uint32_t word;
+    memcpy(&word, buf, 4);
+    count += __builtin_popcount(word);
+    buf += 4;
+  }
+  while (buf < end) {
+    count += __builtin_popcount(*buf++);
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef EpdDisplay_h
+#define EpdDisplay_h
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h> // WHITE / BLACK / INVERSE
+#include "DisplayBackend.h"
+#include "UiFont.h"
+
+#ifndef EPD_SPI_HZ
+#define EPD_SPI_HZ 4000000
+#endif
+
+#ifndef EPD_FULL_REFRESH_MS
+#define EPD_FULL_REFRESH_MS 2000 // used when there is no BUSY pin
+#endif
+
+#ifndef EPD_PARTIAL_REFRESH_MS
+#define EPD_PARTIAL_REFRESH_MS 500
+#endif
+
+#ifndef EPD_FULL_EVERY
+#define EPD_FULL_EVERY 30 // partial refreshes between full ones, against ghosting
+#endif
+
+#ifndef EPD_BUSY_TIMEOUT_MS
+#define EPD_BUSY_TIMEOUT_MS 5000
+#endif
+
+/**
+ * SSD1681 black / white e-paper (1.54" 200x200 and alike) over SPI.
+ *
+ * The panel keeps its image without power, so it can show the status through deep sleep.
+ * Colors follow the OLED UI: WHITE (lit pixel) is ink, BLACK is paper.
+ *
+ * Refreshes take hundreds of ms, so flushes never wait: display() / displayRegion() start
+ * a refresh, or queue the region while the panel is busy, and poll() starts the queued one.
+ * Partial refreshes are differential, the controller compares new RAM (0x24) with
+ * the previous image (0x26), which is written from a copy of what is shown. That copy
+ * makes drawing during a refresh safe and doubles the RAM: 2 * w * h / 8 bytes.
+ *
+ * The physical width must be a multiple of 8.
+ * Any of the CS / RST / BUSY pins can be -1 (CS tied low, no reset, fixed refresh times).
+ * Without RST the panel is only powered down instead of the deep sleep mode.
+ */
+class EpdDisplay : public UiFontText<Adafruit_GFX> {
+public:
+  uint32_t flushedBytes = 0;
+  uint32_t flushes = 0; // refreshes started
+
+  EpdDisplay(uint16_t w, uint16_t h, SPIClass* spi, int8_t csPin, int8_t dcPin, int8_t rstPin = -1, int8_t busyPin = -1):
+    UiFontText<Adafruit_GFX>(w, h), _spi(spi), _csPin(csPin), _dcPin(dcPin), _rstPin(rstPin), _busyPin(busyPin) {}
+
+  /**
+   * Same signature as the OLED backends, the arguments are not used.
+   * Does not refresh the panel: it keeps the image from before the reset / deep sleep.
+   */
+  bool begin(const uint8_t = 0, const uint8_t = 0) {
+    size_t size = bufferSize();
+    if (!_buffer) {
+      _buffer = (uint8_t*)malloc(size);
+      _shown = (uint8_t*)malloc(size);
+      if (!_buffer || !_shown) {
+        return false;
+      }
+    }
+    memset(_buffer, 0xFF, size);
+    memset(_shown, 0xFF, size);
+
+    if (_csPin >= 0) {
+      pinMode(_csPin, OUTPUT);
+      digitalWrite(_csPin, HIGH);
+    }
+    pinMode(_dcPin, OUTPUT);
+    if (_busyPin >= 0) {
+      pinMode(_busyPin, INPUT);
+    }
+
+    init();
+    return true;
+  }
+
+  /**
+   * begin() does not touch the picture anyway.
+   */
+  bool resume(const uint8_t, const uint8_t*, const uint16_t) {
+    return begin();
+  }
+
+  uint16_t saveFrame(uint8_t*, const uint16_t) const {
+    return 0;
+  }
+
+  bool retainsImage() const {
+    return true;
+  }
+
+  uint16_t ramBytes() const {
+    return 2 * bufferSize();
+  }
+
+  void setContrast(const uint8_t) {}
+
+  /**
+   * Inked pixels; e-paper draws power only while refreshing, this is for comparisons with the OLEDs.
+   */
+  uint16_t litPixels() const {
+    return _buffer ? bufferSize() * 8 - displayCountBits(_buffer, bufferSize()) : 0;
+  }
+
+  /**
+   * Off waits for the running refresh and puts the controller to deep sleep, the image stays.
+   */
+  void setPower(const bool on) {
+    if (on == _isOn) {
+      return;
+    }
+
+    if (on) {
+      init();
+      poll();
+      return;
+    }
+
+    waitBusy();
+    poll(); // the last frame is what stays on the panel
+    waitBusy();
+    if (_rstPin >= 0) {
+      command(0x10, 0x01); // deep sleep mode 1, needs a HW reset to wake up
+    } else {
+      command(0x22, 0x83); // analog and clock off
+      command(0x20);
+      waitBusy();
+    }
+    _isOn = false;
+  }
+
+  void clearDisplay() {
+    memset(_buffer, 0xFF, bufferSize());
+  }
+
+  void display() {
+    _isFullPending = true;
+    displayRegion(0, 0, width(), height());
+  }
+
+  void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h) {
+    flushedBytes = 0;
+    if (!_buffer || !displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h)) {
+      return;
+    }
+
+    // RAM columns are bytes of 8 pixels
+    int16_t x1 = (x + w + 7) & ~7;
+    x &= ~7;
+    w = x1 - x;
+
+    if (_pendingW == 0) {
+      _pendingX = x; _pendingY = y; _pendingW = w; _pendingH = h;
+    } else {
+      int16_t px1 = _pendingX + _pendingW > x + w ? _pendingX + _pendingW : x + w;
+      int16_t py1 = _pendingY + _pendingH > y + h ? _pendingY + _pendingH : y + h;
+      if (x < _pendingX) _pendingX = x;
+      if (y < _pendingY) _pendingY = y;
+      _pendingW = px1 - _pendingX;
+      _pendingH = py1 - _pendingY;
+    }
+
+    poll();
+  }
+
+  /**
+   * Starts the queued refresh once the panel is idle.
+   */
+  void poll() {
+    if (_pendingW == 0 || !_isOn || isBusy()) {
+      return;
+    }
+
+    bool isFull = _isFullPending || _partials >= EPD_FULL_EVERY;
+    if (isFull) {
+      _pendingX = 0; _pendingY = 0; _pendingW = WIDTH; _pendingH = HEIGHT;
+    }
+
+    writeRam(0x26, _shown, _pendingX, _pendingY, _pendingW, _pendingH);
+    writeRam(0x24, _buffer, _pendingX, _pendingY, _pendingW, _pendingH);
+    for (int16_t row = _pendingY; row < _pendingY + _pendingH; row++) {
+      size_t offset = row * (WIDTH / 8) + _pendingX / 8;
+      memcpy(_shown + offset, _buffer + offset, _pendingW / 8);
+    }
+
+    command(0x22, isFull ? 0xF7 : 0xFC); // full waveform / differential partial waveform
+    command(0x20);
+    _refreshStartMs = millis();
+    _isFullRefresh = isFull;
+    _partials = isFull ? 0 : _partials + 1;
+    _isFullPending = false;
+    _pendingW = 0;
+    flushes++;
+  }
+
+  bool isFlushPending() const {
+    return _pendingW != 0;
+  }
+
+  uint32_t shownFrames() const {
+    return isBusy() ? flushes - 1 : flushes;
+  }
+
+  /**
+   * No RAM offset or scrolling on e-paper, every change is a refresh.
+   */
+  bool setStartLine(const uint8_t) {
+    return false;
+  }
+
+  bool hasColumnScroll() const {
+    return false;
+  }
+
+  bool scrollColumns(int16_t, int16_t, int16_t, int16_t, bool) {
+    return false;
+  }
+
+  bool isBusy() const {
+    if (_busyPin >= 0) {
+      return digitalRead(_busyPin) == HIGH;
+    }
+    return flushes && millis() - _refreshStartMs < (_isFullRefresh ? EPD_FULL_REFRESH_MS : EPD_PARTIAL_REFRESH_MS);
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (x < 0 || y < 0 || x >= width() || y >= height()) {
+      return;
+    }
+
+    int16_t w = 1, h = 1;
+    displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h);
+    uint8_t* b = &_buffer[y * (WIDTH / 8) + x / 8];
+    uint8_t mask = 0x80 >> (x & 7);
+    switch (color) {
+      case WHITE: *b &= ~mask; break; // ink
+      case BLACK: *b |= mask; break;  // paper
+      case INVERSE: *b ^= mask; break;
+    }
+  }
+
+private:
+  SPIClass* _spi;
+  int8_t _csPin;
+  int8_t _dcPin;
+  int8_t _rstPin;
+  int8_t _busyPin;
+  uint8_t* _buffer = nullptr;
+  uint8_t* _shown = nullptr;  // what the panel shows, source of the "previous" RAM
+  bool _isOn = false;
+  bool _isFullPending = true; // controller RAM is unknown after init
+  bool _isFullRefresh = false;
+  uint8_t _partials = 0;
+  unsigned long _refreshStartMs = 0;
+  int16_t _pendingX = 0, _pendingY = 0, _pendingW = 0, _pendingH = 0;
+
+  size_t bufferSize() const {
+    return (size_t)WIDTH / 8 * HEIGHT;
+  }
+
+  void init() {
+    if (_rstPin >= 0) {
+      pinMode(_rstPin, OUTPUT);
+      digitalWrite(_rstPin, LOW);
+      delay(10);
+      digitalWrite(_rstPin, HIGH);
+      delay(10);
+    }
+
+    command(0x12); // SW reset
+    delay(10);
+    waitBusy();
+    command(0x01, (HEIGHT - 1) & 0xFF, (HEIGHT - 1) >> 8, 0x00); // driver output control
+    command(0x3C, 0x05); // border waveform
+    command(0x18, 0x80); // internal temperature sensor
+    command(0x11, 0x03); // data entry: x then y increment
+    _isOn = true;
+    _isFullPending = true;
+  }
+
+  void waitBusy() {
+    unsigned long start = millis();
+    while (isBusy() && millis() - start < EPD_BUSY_TIMEOUT_MS) {
+      delay(1);
+    }
+  }
+
+  void writeRam(const uint8_t ram, const uint8_t* src, int16_t x, int16_t y, int16_t w, int16_t h) {
+    int16_t y1 = y + h - 1;
+    command(0x44, x / 8, (x + w - 1) / 8);
+    command(0x45, y & 0xFF, y >> 8, y1 & 0xFF, y1 >> 8);
+    command(0x4E, x / 8);
+    command(0x4F, y & 0xFF, y >> 8);
+
+    beginCommand(ram);
+    for (int16_t row = y; row <= y1; row++) {
+      const uint8_t* line = src + row * (WIDTH / 8) + x / 8;
+      for (int16_t i = 0; i < w / 8; i++) {
+        _spi->transfer(line[i]);
+      }
+      flushedBytes += w / 8;
+    }
+    endCommand();
+  }
+
+  void command(const uint8_t c, const int16_t d0 = -1, const int16_t d1 = -1, const int16_t d2 = -1, const int16_t d3 = -1) {
+    beginCommand(c);
+    const int16_t data[] = { d0, d1, d2, d3 };
+    for (uint8_t i = 0; i < 4 && data[i] >= 0; i++) {
+      _spi->transfer((uint8_t)data[i]);
+    }
+    endCommand();
+  }
+
+  /**
+   * Sends the command byte and leaves the bus selected in data mode.
+   */
+  void beginCommand(const uint8_t c) {
+    _spi->beginTransaction(SPISettings(EPD_SPI_HZ, MSBFIRST, SPI_MODE0));
+    if (_csPin >= 0) digitalWrite(_csPin, LOW);
+    digitalWrite(_dcPin, LOW);
+    _spi->transfer(c);
+    digitalWrite(_dcPin, HIGH);
+  }
+
+  void endCommand() {
+    if (_csPin >= 0) digitalWrite(_csPin, HIGH);
+    _spi->endTransaction();
+  }
+};
+
+#endif
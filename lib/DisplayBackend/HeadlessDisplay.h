@@ -0,0 +1,179 @@
+#ifndef HeadlessDisplay_h
+#define HeadlessDisplay_h
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h> // WHITE / BLACK / INVERSE
+#include "DisplayBackend.h"
+#include "UiFont.h"
+
+/**
+ * Display backend without a panel, for host tests of the menu and the widgets.
+ *
+ * Draws into an SSD1306 layout framebuffer (pages of 8 rows) and records the flushes:
+ * what was pushed is copied into the "panel" buffer, so a test can check both what is
+ * drawn and what would be visible after partial updates.
+ */
+class HeadlessDisplay : public UiFontText<Adafruit_GFX> {
+public:
+  uint32_t flushedBytes = 0;
+  uint32_t flushes = 0;
+  int16_t lastX = 0, lastY = 0, lastW = 0, lastH = 0; // physical rect of the last flush
+  bool isOn = false;
+  uint8_t contrast = 0xCF;
+  uint8_t startLine = 0;  // panel row shown at the top
+  uint32_t scrolls = 0;   // scrollColumns() steps
+
+  HeadlessDisplay(uint8_t w, uint8_t h): UiFontText<Adafruit_GFX>(w, h) {}
+
+  ~HeadlessDisplay() {
+    free(_buffer);
+    free(_panel);
+  }
+
+  bool begin(const uint8_t = 0, const uint8_t = 0) {
+    if (!_buffer) {
+      _buffer = (uint8_t*)calloc(1, ramBytes());
+      _panel = (uint8_t*)calloc(1, ramBytes());
+    }
+    isOn = _buffer && _panel;
+    return isOn;
+  }
+
+  /**
+   * The "panel" kept frame, like an SSD1306 powered through deep sleep.
+   */
+  bool resume(const uint8_t, const uint8_t* frame, const uint16_t len) {
+    if (len != ramBytes() || !begin()) {
+      return false;
+    }
+    memcpy(_buffer, frame, len);
+    memcpy(_panel, frame, len);
+    return true;
+  }
+
+  uint16_t saveFrame(uint8_t* frame, const uint16_t cap) const {
+    if (!_buffer || cap < ramBytes()) {
+      return 0;
+    }
+    memcpy(frame, _buffer, ramBytes());
+    return ramBytes();
+  }
+
+  uint16_t litPixels() const {
+    return _buffer ? displayCountBits(_buffer, ramBytes()) : 0;
+  }
+
+  bool retainsImage() const {
+    return false;
+  }
+
+  uint16_t ramBytes() const {
+    return WIDTH * ((HEIGHT + 7) / 8);
+  }
+
+  void poll() {}
+
+  bool isFlushPending() const {
+    return false;
+  }
+
+  void setPower(const bool on) {
+    isOn = on;
+  }
+
+  void setContrast(const uint8_t value) {
+    contrast = value;
+  }
+
+  void clearDisplay() {
+    memset(_buffer, 0, ramBytes());
+  }
+
+  void display() {
+    displayRegion(0, 0, width(), height());
+  }
+
+  void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h) {
+    flushedBytes = 0;
+    if (!displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h)) {
+      return;
+    }
+
+    for (uint8_t page = y / 8; page <= (y + h - 1) / 8; page++) {
+      memcpy(_panel + page * WIDTH + x, _buffer + page * WIDTH + x, w);
+      flushedBytes += w;
+    }
+    lastX = x; lastY = y; lastW = w; lastH = h;
+    flushes++;
+  }
+
+  uint32_t shownFrames() const {
+    return flushes;
+  }
+
+  bool setStartLine(const uint8_t line) {
+    startLine = line % HEIGHT;
+    return true;
+  }
+
+  bool hasColumnScroll() const {
+    return true;
+  }
+
+  bool scrollColumns(int16_t x, int16_t y, int16_t w, int16_t h, bool toLeft) {
+    if (!_buffer || !displayScrollToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h, toLeft)) {
+      return false;
+    }
+    displayRotateColumns(_buffer, WIDTH, x, y, w, h, toLeft);
+    displayRotateColumns(_panel, WIDTH, x, y, w, h, toLeft);
+    scrolls++;
+    return true;
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (x < 0 || y < 0 || x >= width() || y >= height()) {
+      return;
+    }
+
+    int16_t w = 1, h = 1;
+    displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h);
+    uint8_t* b = &_buffer[(y / 8) * WIDTH + x];
+    uint8_t mask = 1 << (y & 7);
+    switch (color) {
+      case WHITE: *b |= mask; break;
+      case BLACK: *b &= ~mask; break;
+      case INVERSE: *b ^= mask; break;
+    }
+  }
+
+  /**
+   * Pixel in physical coordinates, as drawn / as shown on the panel (after the start line).
+   */
+  bool getPixel(const int16_t x, int16_t y, const bool shown = false) const {
+    const uint8_t* src = _buffer;
+    if (shown) {
+      src = _panel;
+      y = (y + startLine) % HEIGHT;
+    }
+    return src[(y / 8) * WIDTH + x] & (1 << (y & 7));
+  }
+
+  /**
+   * Shown picture as text, '#' for a lit pixel.
+   */
+  void dump(Print& out) const {
+    for (int16_t y = 0; y < HEIGHT; y++) {
+      for (int16_t x = 0; x < WIDTH; x++) {
+        out.write(getPixel(x, y, true) ? '#' : '.');
+      }
+      out.println();
+    }
+  }
+
+private:
+  uint8_t* _buffer = nullptr;
+  uint8_t* _panel = nullptr;
+};
+
+#endif
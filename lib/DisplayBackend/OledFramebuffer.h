@@ -0,0 +1,97 @@
+#ifndef OledFramebuffer_h
+#define OledFramebuffer_h
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include "DisplayBackend.h"
+#include "UiFont.h"
+
+#ifndef SSD1306_REGION_CHUNK
+#define SSD1306_REGION_CHUNK 31 // data bytes per I2C transaction, 1 byte goes to the control byte
+#endif
+
+/**
+ * The part of the backend interface both I2C OLEDs on the Adafruit_SSD1306 framebuffer
+ * share: deep sleep resume, the framebuffer as the picture, power and contrast.
+ * Ssd1306Display and Sh1106Display add display() / displayRegion() and the scrolling
+ * their controller can do.
+ */
+class OledFramebuffer : public UiFontText<Adafruit_SSD1306> {
+public:
+  uint32_t flushedBytes = 0; // framebuffer bytes sent by the last display() / displayRegion()
+  uint32_t flushes = 0;
+
+  OledFramebuffer(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rstPin = -1):
+    UiFontText<Adafruit_SSD1306>(w, h, twi, rstPin) {}
+
+  /**
+   * RAM used for the picture (the framebuffer).
+   */
+  uint16_t ramBytes() const {
+    return WIDTH * ((HEIGHT + 7) / 8);
+  }
+
+  /**
+   * The controller kept its configuration and RAM (powered through deep sleep): frame, which
+   * is what the panel RAM holds, becomes the framebuffer again, no reset and no init sequence.
+   */
+  bool resume(const uint8_t addr, const uint8_t* frame, const uint16_t len) {
+    uint16_t size = ramBytes();
+    if (!wire || len != size || (!buffer && !(buffer = (uint8_t*)malloc(size)))) {
+      return false;
+    }
+
+    i2caddr = addr;
+    vccstate = SSD1306_SWITCHCAPVCC;
+    wire->beginTransmission(addr);
+    if (wire->endTransmission() != 0) {
+      return false;
+    }
+    memcpy(buffer, frame, size);
+    return true;
+  }
+
+  uint16_t saveFrame(uint8_t* frame, const uint16_t cap) const {
+    uint16_t size = ramBytes();
+    if (!buffer || cap < size) {
+      return 0;
+    }
+    memcpy(frame, buffer, size);
+    return size;
+  }
+
+  uint16_t litPixels() const {
+    return buffer ? displayCountBits(buffer, ramBytes()) : 0;
+  }
+
+  bool retainsImage() const {
+    return false;
+  }
+
+  void poll() {}
+
+  bool isFlushPending() const {
+    return false;
+  }
+
+  void setPower(const bool on) {
+    ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+  }
+
+  void setContrast(const uint8_t contrast) {
+    ssd1306_command(SSD1306_SETCONTRAST);
+    ssd1306_command(contrast);
+  }
+
+  uint32_t shownFrames() const {
+    return flushes;
+  }
+
+  bool setStartLine(const uint8_t line) {
+    ssd1306_command(SSD1306_SETSTARTLINE | (line & 0x3F));
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef Sh1106Display_h
+#define Sh1106Display_h
+
+#include "OledFramebuffer.h"
+
+#ifndef SH1106_COLUMN_OFFSET
+#define SH1106_COLUMN_OFFSET 2 // 132 column RAM, 128 visible columns centered on 1.3" modules
+#endif
+
+/**
+ * SH1106 (1.3" 128x64 I2C OLED) on top of the Adafruit_SSD1306 framebuffer and drawing.
+ *
+ * The SSD1306 init sequence is understood by SH1106 except the charge pump, which is
+ * replaced by the SH1106 DC-DC command. SH1106 has page addressing only, so every page
+ * is sent with its own page / column address; displayRegion() sends only the covered columns.
+ */
+class Sh1106Display : public OledFramebuffer {
+public:
+  Sh1106Display(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rstPin = -1):
+    OledFramebuffer(w, h, twi, rstPin) {}
+
+  bool begin(uint8_t vcs = SSD1306_SWITCHCAPVCC, uint8_t addr = 0x3C, bool reset = true, bool periphBegin = true) {
+    if (!Adafruit_SSD1306::begin(vcs, addr, reset, periphBegin)) {
+      return false;
+    }
+
+    static const uint8_t init[] = {
+      0xAD, 0x8B, // DC-DC on
+      0x33        // pump voltage 9 V
+    };
+    wire->setClock(wireClk);
+    ssd1306_commandList(init, sizeof(init));
+    wire->setClock(restoreClk);
+    return true;
+  }
+
+  void display() {
+    displayRegion(0, 0, width(), height());
+  }
+
+  void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h) {
+    flushedBytes = 0;
+    if (!wire || !buffer || !displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h)) {
+      return;
+    }
+
+    uint8_t page0 = y / 8;
+    uint8_t page1 = (y + h - 1) / 8;
+    uint8_t col = x + SH1106_COLUMN_OFFSET;
+
+    wire->setClock(wireClk);
+    for (uint8_t page = page0; page <= page1; page++) {
+      const uint8_t window[] = {
+        (uint8_t)(0xB0 | page),
+        (uint8_t)(0x00 | (col & 0x0F)),
+        (uint8_t)(0x10 | (col >> 4))
+      };
+      ssd1306_commandList(window, sizeof(window));
+
+      const uint8_t* row = buffer + page * WIDTH + x;
+      int16_t left = w;
+      while (left > 0) {
+        uint8_t chunk = left > SSD1306_REGION_CHUNK ? SSD1306_REGION_CHUNK : left;
+        wire->beginTransmission(i2caddr);
+        wire->write((uint8_t)0x40);
+        for (uint8_t i = 0; i < chunk; i++) {
+          wire->write(*row++);
+        }
+        wire->endTransmission();
+        left -= chunk;
+        flushedBytes += chunk;
+      }
+    }
+    wire->setClock(restoreClk);
+    flushes++;
+  }
+
+  /**
+   * The SH1106 has no content scroll.
+   */
+  bool hasColumnScroll() const {
+    return false;
+  }
+
+  bool scrollColumns(int16_t, int16_t, int16_t, int16_t, bool) {
+    return false;
+  }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef Ssd1306Display_h
+#define Ssd1306Display_h
+
+#include "OledFramebuffer.h"
+
+/**
+ * Adafruit_SSD1306 which can push a part of the framebuffer.
+ *
+ * displayRegion() sets the page / column address window to the pages and columns
+ * covering the rect and streams only those bytes; display() always sends all 1 KB.
+ * setStartLine() and scrollColumns() (-D OLED_CONTENT_SCROLL) move the picture inside the
+ * panel RAM without sending it; the framebuffer follows a content scroll.
+ */
+class Ssd1306Display : public OledFramebuffer {
+public:
+  Ssd1306Display(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rstPin = -1):
+    OledFramebuffer(w, h, twi, rstPin) {}
+
+  void display() {
+    Adafruit_SSD1306::display();
+    flushedBytes = ramBytes();
+    flushes++;
+  }
+
+  bool hasColumnScroll() const {
+#ifdef OLED_CONTENT_SCROLL
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * One SSD1306 content scroll step. The controller needs two frame periods (about 20 ms)
+   * to finish it, do not send the next one earlier.
+   */
+  bool scrollColumns(int16_t x, int16_t y, int16_t w, int16_t h, bool toLeft) {
+#ifdef OLED_CONTENT_SCROLL
+    if (!wire || !buffer || !displayScrollToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h, toLeft)) {
+      return false;
+    }
+
+    const uint8_t scroll[] = {
+      (uint8_t)(toLeft ? SSD1306_CONTENT_SCROLL_LEFT : SSD1306_CONTENT_SCROLL_RIGHT),
+      0x00, (uint8_t)(y / 8), 0x01, (uint8_t)((y + h - 1) / 8),
+      (uint8_t)x, (uint8_t)(x + w - 1)
+    };
+    wire->setClock(wireClk);
+    ssd1306_commandList(scroll, sizeof(scroll));
+    wire->setClock(restoreClk);
+    displayRotateColumns(buffer, WIDTH, x, y, w, h, toLeft);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h) {
+    flushedBytes = 0;
+    if (!wire || !buffer) {
+      display();
+      return;
+    }
+
+    if (!displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h)) {
+      return;
+    }
+
+    int16_t x1 = x + w - 1;
+    uint8_t page0 = y / 8;
+    uint8_t page1 = (y + h - 1) / 8;
+
+    wire->setClock(wireClk);
+    const uint8_t window[] = {
+      SSD1306_PAGEADDR, page0, page1,
+      SSD1306_COLUMNADDR, (uint8_t)x, (uint8_t)x1
+    };
+    ssd1306_commandList(window, sizeof(window));
+
+    uint8_t chunk = 0;
+    for (uint8_t page = page0; page <= page1; page++) {
+      const uint8_t* row = buffer + page * WIDTH;
+      for (int16_t col = x; col <= x1; col++) {
+        if (chunk == 0) {
+          wire->beginTransmission(i2caddr);
+          wire->write((uint8_t)0x40);
+        }
+        wire->write(row[col]);
+        flushedBytes++;
+        if (++chunk == SSD1306_REGION_CHUNK) {
+          wire->endTransmission();
+          chunk = 0;
+        }
+      }
+    }
+    if (chunk) {
+      wire->endTransmission();
+    }
+    wire->setClock(restoreClk);
+    flushes++;
+  }
+};
+
+#endif
@@ -0,0 +1,515 @@
+#ifndef Ssd1306PageDisplay_h
+#define Ssd1306PageDisplay_h
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h> // colors and command constants only, its framebuffer is not used
+#include "DisplayBackend.h"
+#include "UiFont.h"
+
+/**
+ * SSD1306 (I2C) without a full framebuffer, like the u8g2 page loop.
+ *
+ * Drawing calls between clearDisplay() and display() are recorded into a display list
+ * (rects, pixels and text runs). display() rasterises the list one 8 row page at a time
+ * into a 128 byte buffer and sends each page; displayRegion() only the pages / columns
+ * covering a rect. Drop-in for Ssd1306Display as far as the menu and the main screen go.
+ *
+ * Drawing over a previous frame (menu items, widgets) is kept bounded: an opaque rect
+ * removes the recorded operations it fully covers, as it would overwrite them in a framebuffer.
+ * If the list still overflows, operations are dropped and counted in droppedOps.
+ *
+ * Trade-off: RAM is PAGED_OLED_OPS * 8 + PAGED_OLED_TEXT + 128 bytes instead of 1024,
+ * CPU is one replay of every operation for each page it touches, per flush
+ * (see the "BENCH main_frame" line, cycles / ram).
+ * Only the built-in 6x8 font and the UiFont glyphs are supported, a glyph takes one byte
+ * of the text buffer like an ASCII char.
+ */
+
+#ifndef PAGED_OLED_OPS
+#define PAGED_OLED_OPS 48
+#endif
+
+#ifndef PAGED_OLED_TEXT
+#define PAGED_OLED_TEXT 128
+#endif
+
+#ifndef SSD1306_REGION_CHUNK
+#define SSD1306_REGION_CHUNK 31 // data bytes per I2C transaction, 1 byte goes to the control byte
+#endif
+
+class Ssd1306PageDisplay : public Adafruit_GFX {
+public:
+  uint32_t flushedBytes = 0; // bytes sent by the last display() / displayRegion()
+  uint32_t flushes = 0;
+  uint16_t droppedOps = 0;   // operations which did not fit since the last clearDisplay()
+
+  Ssd1306PageDisplay(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rstPin = -1,
+                     uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL):
+    Adafruit_GFX(w, h), _wire(twi), _rstPin(rstPin), _wireClk(clkDuring), _restoreClk(clkAfter) {}
+
+  bool begin(uint8_t vcs = SSD1306_SWITCHCAPVCC, uint8_t addr = 0x3C, bool reset = true, bool periphBegin = true) {
+    _addr = addr;
+    if (periphBegin) {
+      _wire->begin();
+    }
+
+    if (reset && _rstPin >= 0) {
+      pinMode(_rstPin, OUTPUT);
+      digitalWrite(_rstPin, HIGH);
+      delay(1);
+      digitalWrite(_rstPin, LOW);
+      delay(10);
+      digitalWrite(_rstPin, HIGH);
+    }
+
+    bool external = vcs == SSD1306_EXTERNALVCC;
+    const uint8_t init[] = {
+      SSD1306_DISPLAYOFF,
+      SSD1306_SETDISPLAYCLOCKDIV, 0x80,
+      SSD1306_SETMULTIPLEX, (uint8_t)(HEIGHT - 1),
+      SSD1306_SETDISPLAYOFFSET, 0x00,
+      SSD1306_SETSTARTLINE | 0x0,
+      SSD1306_CHARGEPUMP, (uint8_t)(external ? 0x10 : 0x14),
+      SSD1306_MEMORYMODE, 0x00, // horizontal addressing, the page / column window wraps
+      SSD1306_SEGREMAP | 0x1,
+      SSD1306_COMSCANDEC,
+      SSD1306_SETCOMPINS, (uint8_t)(HEIGHT == 64 ? 0x12 : 0x02),
+      SSD1306_SETCONTRAST, (uint8_t)(external ? 0x9F : 0xCF),
+      SSD1306_SETPRECHARGE, (uint8_t)(external ? 0x22 : 0xF1),
+      SSD1306_SETVCOMDETECT, 0x40,
+      SSD1306_DISPLAYALLON_RESUME,
+      SSD1306_NORMALDISPLAY,
+      SSD1306_DEACTIVATE_SCROLL,
+      SSD1306_DISPLAYON
+    };
+    commandList(init, sizeof(init));
+    clearDisplay();
+    return true;
+  }
+
+  /**
+   * The controller kept its configuration and RAM (powered through deep sleep), there is
+   * no framebuffer to restore: the next frame is recorded and flushed as usual.
+   */
+  bool resume(const uint8_t addr, const uint8_t*, const uint16_t) {
+    _addr = addr;
+    _wire->beginTransmission(addr);
+    if (_wire->endTransmission() != 0) {
+      return false;
+    }
+    clearDisplay();
+    return true;
+  }
+
+  uint16_t saveFrame(uint8_t*, const uint16_t) const {
+    return 0;
+  }
+
+  void ssd1306_command(const uint8_t c) {
+    commandList(&c, 1);
+  }
+
+  bool retainsImage() const {
+    return false;
+  }
+
+  void poll() {}
+
+  bool isFlushPending() const {
+    return false;
+  }
+
+  void setPower(const bool on) {
+    ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+  }
+
+  void setContrast(const uint8_t contrast) {
+    const uint8_t c[] = { SSD1306_SETCONTRAST, contrast };
+    commandList(c, sizeof(c));
+  }
+
+  void clearDisplay() {
+    _opsCount = 0;
+    _textLen = 0;
+    droppedOps = 0;
+  }
+
+  void display() {
+    displayRegion(0, 0, width(), height());
+  }
+
+  void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h) {
+    flushedBytes = 0;
+    if (!toPhysical(x, y, w, h)) {
+      return;
+    }
+
+    uint8_t page0 = y / 8;
+    uint8_t page1 = (y + h - 1) / 8;
+    const uint8_t window[] = {
+      SSD1306_PAGEADDR, page0, page1,
+      SSD1306_COLUMNADDR, (uint8_t)x, (uint8_t)(x + w - 1)
+    };
+    commandList(window, sizeof(window));
+
+    _wire->setClock(_wireClk);
+    uint8_t chunk = 0;
+    for (uint8_t page = page0; page <= page1; page++) {
+      rasterPage(page);
+      for (int16_t col = x; col < x + w; col++) {
+        if (chunk == 0) {
+          _wire->beginTransmission(_addr);
+          _wire->write((uint8_t)0x40);
+        }
+        _wire->write(_page[col]);
+        flushedBytes++;
+        if (++chunk == SSD1306_REGION_CHUNK) {
+          _wire->endTransmission();
+          chunk = 0;
+        }
+      }
+    }
+    if (chunk) {
+      _wire->endTransmission();
+    }
+    _wire->setClock(_restoreClk);
+    flushes++;
+  }
+
+  uint32_t shownFrames() const {
+    return flushes;
+  }
+
+  bool setStartLine(const uint8_t line) {
+    ssd1306_command(SSD1306_SETSTARTLINE | (line & 0x3F));
+    return true;
+  }
+
+  bool hasColumnScroll() const {
+#ifdef OLED_CONTENT_SCROLL
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * One content scroll step (see Ssd1306Display). The display list does not follow it,
+   * the next flush of the rect shows it unscrolled again.
+   */
+  bool scrollColumns(int16_t x, int16_t y, int16_t w, int16_t h, bool toLeft) {
+#ifdef OLED_CONTENT_SCROLL
+    if (!displayScrollToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h, toLeft)) {
+      return false;
+    }
+
+    const uint8_t scroll[] = {
+      (uint8_t)(toLeft ? SSD1306_CONTENT_SCROLL_LEFT : SSD1306_CONTENT_SCROLL_RIGHT),
+      0x00, (uint8_t)(y / 8), 0x01, (uint8_t)((y + h - 1) / 8),
+      (uint8_t)x, (uint8_t)(x + w - 1)
+    };
+    commandList(scroll, sizeof(scroll));
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * RAM used for the picture (display list + page buffer).
+   */
+  uint16_t ramBytes() const {
+    return sizeof(_ops) + sizeof(_text) + sizeof(_page);
+  }
+
+  /**
+   * Lit pixels on the panel, counted while the pages are streamed (there is no framebuffer
+   * to count), so drawing shows up after the flush.
+   */
+  uint16_t litPixels() const {
+    uint16_t count = 0;
+    for (uint8_t page = 0; page < 8; page++) {
+      count += _pageLit[page];
+    }
+    return count;
+  }
+
+  uint8_t opsCount() const {
+    return _opsCount;
+  }
+
+  // ---- Adafruit_GFX ----
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (_isRaster) {
+      rasterRect(x, y, 1, 1, color);
+    } else {
+      recordRect(OP_RECT, x, y, 1, 1, color);
+    }
+  }
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    if (_isRaster) {
+      rasterRect(x, y, w, h, color);
+    } else {
+      recordRect(OP_RECT, x, y, w, h, color);
+    }
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    fillRect(x, y, w, 1, color);
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    fillRect(x, y, 1, h, color);
+  }
+
+  void fillScreen(uint16_t color) override {
+    clearDisplay();
+    if (color != BLACK) {
+      fillRect(0, 0, width(), height(), color);
+    }
+  }
+
+  /**
+   * Text goes into runs, one operation for consecutive chars of the same style.
+   * Cursor and wrap handling follow Adafruit_GFX::write() for the built-in font.
+   */
+  size_t write(uint8_t c) override {
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+      return 1;
+    }
+
+    if (c == '\r') {
+      return 1;
+    }
+
+    uint32_t cp;
+    if (!_utf8.push(c, cp)) {
+      return 1;
+    }
+    if (cp < 0x80) {
+      c = cp;
+    } else if (!(c = uiFont().codeOf(cp))) {
+      c = UI_FONT_MISSING;
+    }
+
+    if (wrap && cursor_x + textsize_x * 6 > _width) {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+    }
+
+    recordChar(c);
+    cursor_x += textsize_x * 6;
+    return 1;
+  }
+
+  using Print::write;
+
+private:
+  enum : uint8_t { OP_RECT, OP_TEXT };
+
+  struct Op {
+    uint8_t kind;
+    uint8_t color;
+    uint8_t x;
+    uint8_t y;
+    uint8_t w;   // text: size
+    uint8_t h;   // text: length
+    uint8_t ch;  // text: offset in _text
+    uint8_t bg;
+  };
+
+  TwoWire* _wire;
+  int8_t _rstPin;
+  uint32_t _wireClk;
+  uint32_t _restoreClk;
+  uint8_t _addr = 0x3C;
+
+  Op _ops[PAGED_OLED_OPS];
+  uint8_t _opsCount = 0;
+  char _text[PAGED_OLED_TEXT];
+  uint8_t _textLen = 0;
+  uint8_t _page[128];
+  uint16_t _pageLit[8] = {};
+  uint8_t _rasterPage = 0;
+  bool _isRaster = false;
+  Utf8Decoder _utf8;
+
+  void commandList(const uint8_t* c, uint8_t n) {
+    _wire->setClock(_wireClk);
+    _wire->beginTransmission(_addr);
+    _wire->write((uint8_t)0x00);
+    while (n--) {
+      _wire->write(*c++);
+    }
+    _wire->endTransmission();
+    _wire->setClock(_restoreClk);
+  }
+
+  bool toPhysical(int16_t& x, int16_t& y, int16_t& w, int16_t& h) const {
+    return displayRectToPhysical(getRotation(), WIDTH, HEIGHT, x, y, w, h);
+  }
+
+  // ---- recording ----
+
+  static bool clipLogical(int16_t& x, int16_t& y, int16_t& w, int16_t& h, int16_t maxW, int16_t maxH) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > maxW) w = maxW - x;
+    if (y + h > maxH) h = maxH - y;
+    return w > 0 && h > 0;
+  }
+
+  void recordRect(uint8_t kind, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (!clipLogical(x, y, w, h, _width, _height)) {
+      return;
+    }
+
+    if (color != INVERSE) {
+      removeCovered(x, y, w, h);
+    }
+
+    Op* op = append();
+    if (op) {
+      *op = { kind, (uint8_t)color, (uint8_t)x, (uint8_t)y, (uint8_t)w, (uint8_t)h, 0, 0 };
+    }
+  }
+
+  void recordChar(uint8_t c) {
+    uint8_t size = textsize_x;
+    if (cursor_x >= _width || cursor_y >= _height || cursor_x < 0 || cursor_y < 0) {
+      return;
+    }
+
+    Op* last = _opsCount ? &_ops[_opsCount - 1] : nullptr;
+    bool isRunTail = last && last->kind == OP_TEXT && last->ch + last->h == _textLen && last->h < 255
+      && last->y == cursor_y && last->w == size && last->color == (uint8_t)textcolor && last->bg == (uint8_t)textbgcolor
+      && last->x + last->h * 6 * size == cursor_x;
+
+    if (_textLen >= PAGED_OLED_TEXT) {
+      droppedOps++;
+      return;
+    }
+
+    if (isRunTail) {
+      _text[_textLen++] = c;
+      last->h++;
+      return;
+    }
+
+    Op* op = append();
+    if (op) {
+      *op = { OP_TEXT, (uint8_t)textcolor, (uint8_t)cursor_x, (uint8_t)cursor_y, size, 1, _textLen, (uint8_t)textbgcolor };
+      _text[_textLen++] = c;
+    }
+  }
+
+  Op* append() {
+    if (_opsCount >= PAGED_OLED_OPS) {
+      droppedOps++;
+      return nullptr;
+    }
+
+    return &_ops[_opsCount++];
+  }
+
+  /**
+   * Drops operations fully inside an opaque rect drawn on top of them; keeps the text pool packed.
+   */
+  void removeCovered(int16_t x, int16_t y, int16_t w, int16_t h) {
+    uint8_t kept = 0;
+    uint8_t textLen = 0;
+
+    for (uint8_t i = 0; i < _opsCount; i++) {
+      Op op = _ops[i];
+      int16_t ow = op.w;
+      int16_t oh = op.h;
+      if (op.kind == OP_TEXT) {
+        // the spacing column after the last char is drawn only with a background color
+        ow = op.h * 6 * op.w - (op.bg == op.color ? op.w : 0);
+        oh = 8 * op.w;
+      }
+
+      if (op.x >= x && op.y >= y && op.x + ow <= x + w && op.y + oh <= y + h) {
+        continue;
+      }
+
+      if (op.kind == OP_TEXT) {
+        memmove(_text + textLen, _text + op.ch, op.h);
+        op.ch = textLen;
+        textLen += op.h;
+      }
+      _ops[kept++] = op;
+    }
+
+    _opsCount = kept;
+    _textLen = textLen;
+  }
+
+  // ---- rasterising ----
+
+  void rasterPage(uint8_t page) {
+    memset(_page, 0, sizeof(_page));
+    _rasterPage = page;
+    _isRaster = true;
+
+    int16_t cx = cursor_x;
+    int16_t cy = cursor_y;
+
+    for (uint8_t i = 0; i < _opsCount; i++) {
+      const Op& op = _ops[i];
+      if (op.kind == OP_RECT) {
+        rasterRect(op.x, op.y, op.w, op.h, op.color);
+        continue;
+      }
+
+      int16_t x = op.x, y = op.y, w = op.h * 6 * op.w, h = 8 * op.w;
+      if (!toPhysical(x, y, w, h) || y >= (page + 1) * 8 || y + h <= page * 8) {
+        continue;
+      }
+
+      for (uint8_t j = 0; j < op.h; j++) {
+        uint8_t c = _text[op.ch + j];
+        if (c >= UI_FONT_CODE_FIRST) {
+          uiFontDrawGlyph(*this, op.x + j * 6 * op.w, op.y, c, op.color, op.bg, op.w);
+        } else {
+          drawChar(op.x + j * 6 * op.w, op.y, c, op.color, op.bg, op.w);
+        }
+      }
+    }
+
+    cursor_x = cx;
+    cursor_y = cy;
+    _isRaster = false;
+    _pageLit[page & 7] = displayCountBits(_page, WIDTH);
+  }
+
+  void rasterRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (!toPhysical(x, y, w, h)) {
+      return;
+    }
+
+    int16_t top = _rasterPage * 8;
+    int16_t y0 = y < top ? top : y;
+    int16_t y1 = y + h > top + 8 ? top + 8 : y + h;
+    if (y0 >= y1) {
+      return;
+    }
+
+    uint8_t mask = (uint8_t)(0xFF << (y0 - top)) & (uint8_t)(0xFF >> (top + 8 - y1));
+    for (int16_t col = x; col < x + w; col++) {
+      switch (color) {
+        case WHITE: _page[col] |= mask; break;
+        case BLACK: _page[col] &= ~mask; break;
+        case INVERSE: _page[col] ^= mask; break;
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef DisplayPower_h
+#define DisplayPower_h
+
+#include <Arduino.h>
+
+/**
+ * Power policy of the UI display: contrast follows the time since the last interaction,
+ * and the panel current is integrated per session (wake -> switch-off) from the lit pixels.
+ *
+ *   | full contrast | ramp down         | dim stage     | off
+ *   0              hold                timeout - DIM   timeout
+ *
+ * The hold is DISPLAY_HOLD_PERCENT of the time before the dim stage, the dim stage is
+ * DISPLAY_DIM_MS or a quarter of a shorter timeout. Contrast changes smaller than
+ * DISPLAY_CONTRAST_STEP are not sent, so the ramp costs a few I2C writes. setFull() lowers
+ * the full contrast the ramp starts from (a dimmed panel on a low battery).
+ *
+ * Current model (SSD1306 / SH1106): segment current is proportional to the lit pixels and
+ * to the contrast, on top of a fixed part for the controller and the charge pump:
+ *   I = DISPLAY_ON_UA + DISPLAY_FULL_UA * lit / pixels * contrast / 255
+ * The constants are the defaults of a 0.96" 128x64 module, calibrate them with a meter
+ * when absolute numbers matter; comparisons between UI variants hold either way.
+ */
+
+#ifndef DISPLAY_CONTRAST_FULL
+#define DISPLAY_CONTRAST_FULL 0xCF // SSD1306 default with the internal charge pump
+#endif
+
+#ifndef DISPLAY_CONTRAST_DIM
+#define DISPLAY_CONTRAST_DIM 0x01
+#endif
+
+#ifndef DISPLAY_HOLD_PERCENT
+#define DISPLAY_HOLD_PERCENT 50
+#endif
+
+#ifndef DISPLAY_DIM_MS
+#define DISPLAY_DIM_MS 2000
+#endif
+
+#ifndef DISPLAY_CONTRAST_STEP
+#define DISPLAY_CONTRAST_STEP 16
+#endif
+
+#ifndef DISPLAY_ON_UA
+#define DISPLAY_ON_UA 450
+#endif
+
+#ifndef DISPLAY_FULL_UA
+#define DISPLAY_FULL_UA 24000 // all pixels lit at contrast 255
+#endif
+
+class DisplayPowerPolicy {
+public:
+  // current session
+  uint32_t sessionMs = 0;
+  uint64_t chargeUaMs = 0;  // integrated panel current, uA * ms
+  uint64_t litPixelMs = 0;  // lit pixels integrated over time, for the average
+  uint16_t frames = 0;
+  uint16_t contrastWrites = 0;
+
+  void begin(const uint16_t pixels) {
+    _pixels = pixels;
+  }
+
+  /**
+   * Panel switched on: starts a new session at full contrast.
+   */
+  void beginSession(const unsigned long now) {
+    sessionMs = 0;
+    chargeUaMs = 0;
+    litPixelMs = 0;
+    frames = 0;
+    contrastWrites = 0;
+    _accountMs = now;
+    _contrast = _full;
+    interact(now);
+  }
+
+  /**
+   * Panel switched off, closes the session totals.
+   */
+  void endSession(const unsigned long now) {
+    account(now);
+  }
+
+  /**
+   * User input (or a motion in progress): back to full contrast.
+   */
+  void interact(const unsigned long now) {
+    _lastInteractionMs = now;
+  }
+
+  /**
+   * Full contrast from now on, at least DISPLAY_CONTRAST_DIM. Takes effect with the next update().
+   */
+  void setFull(const uint8_t contrast) {
+    _full = contrast > DISPLAY_CONTRAST_DIM ? contrast : DISPLAY_CONTRAST_DIM;
+  }
+
+  /**
+   * A flush changed the picture.
+   */
+  void frame(const uint16_t lit, const unsigned long now) {
+    account(now);
+    _lit = lit;
+    frames++;
+  }
+
+  /**
+   * Contrast for the time since the last interaction, the display switches off at timeoutMs.
+   */
+  uint8_t contrastAt(const unsigned long now, const uint32_t timeoutMs) const {
+    uint32_t elapsed = now - _lastInteractionMs;
+    uint32_t hold, dimStart;
+    stages(timeoutMs, hold, dimStart);
+    if (elapsed < hold) {
+      return _full;
+    }
+    if (elapsed >= dimStart) {
+      return DISPLAY_CONTRAST_DIM;
+    }
+
+    uint32_t span = _full - DISPLAY_CONTRAST_DIM;
+    return _full - (uint64_t)span * (elapsed - hold) / (dimStart - hold);
+  }
+
+  /**
+   * True if the contrast should be sent to the panel, see contrast().
+   */
+  bool update(const unsigned long now, const uint32_t timeoutMs) {
+    uint8_t target = contrastAt(now, timeoutMs);
+    if (target == _contrast) {
+      return false;
+    }
+
+    uint8_t diff = target > _contrast ? target - _contrast : _contrast - target;
+    bool isEnd = target == _full || target == DISPLAY_CONTRAST_DIM;
+    if (diff < DISPLAY_CONTRAST_STEP && !isEnd) {
+      return false;
+    }
+
+    account(now);
+    _contrast = target;
+    contrastWrites++;
+    return true;
+  }
+
+  uint8_t contrast() const {
+    return _contrast;
+  }
+
+  /**
+   * When update() may change the contrast next, for the light sleep deadline.
+   */
+  unsigned long nextChangeMs(const unsigned long now, const uint32_t timeoutMs) const {
+    uint32_t elapsed = now - _lastInteractionMs;
+    uint32_t hold, dimStart;
+    stages(timeoutMs, hold, dimStart);
+    if (elapsed < hold) {
+      return _lastInteractionMs + hold;
+    }
+    uint32_t span = _full - DISPLAY_CONTRAST_DIM;
+    if (elapsed >= dimStart || !span) {
+      return _lastInteractionMs + timeoutMs; // switch-off
+    }
+
+    // one contrast step of the ramp
+    uint32_t stepMs = (uint64_t)(dimStart - hold) * DISPLAY_CONTRAST_STEP / span;
+    return now + (stepMs ? stepMs : 1);
+  }
+
+  /**
+   * Average panel current of the session so far, uA.
+   */
+  uint32_t averageUa() const {
+    return sessionMs ? chargeUaMs / sessionMs : 0;
+  }
+
+  uint16_t averageLit() const {
+    return sessionMs ? litPixelMs / sessionMs : 0;
+  }
+
+private:
+  uint16_t _pixels = 128 * 64;
+  uint16_t _lit = 0;
+  uint8_t _contrast = DISPLAY_CONTRAST_FULL;
+  uint8_t _full = DISPLAY_CONTRAST_FULL;
+  unsigned long _lastInteractionMs = 0;
+  unsigned long _accountMs = 0;
+
+  /**
+   * The dim stage takes at most a quarter of short timeouts.
+   */
+  static void stages(const uint32_t timeoutMs, uint32_t& hold, uint32_t& dimStart) {
+    uint32_t dimMs = timeoutMs / 4 < DISPLAY_DIM_MS ? timeoutMs / 4 : DISPLAY_DIM_MS;
+    dimStart = timeoutMs - dimMs;
+    hold = (uint64_t)dimStart * DISPLAY_HOLD_PERCENT / 100;
+  }
+
+  void account(const unsigned long now) {
+    uint32_t dt = now - _accountMs;
+    _accountMs = now;
+    sessionMs += dt;
+    litPixelMs += (uint64_t)_lit * dt;
+    uint32_t ua = DISPLAY_ON_UA + (uint64_t)DISPLAY_FULL_UA * _lit * _contrast / ((uint32_t)_pixels * 255);
+    chargeUaMs += (uint64_t)ua * dt;
+  }
+};
+
+#endif
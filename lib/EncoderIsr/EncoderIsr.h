@@ -0,0 +1,535 @@
+#ifndef EncoderIsr_h
+#define EncoderIsr_h
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * Encoder and button decoded in GPIO interrupts.
+ *
+ * The interrupts only decode and push timestamped events into a lock-free single producer /
+ * single consumer ring (all three pins are served by the same GPIO interrupt, so the
+ * producer side never runs concurrently with itself). tick() from loop() drains the ring and
+ * calls the attached callback once per event, with the same accessors as EncButton
+ * (action(), dir(), fast()). Turns and clicks keep their order while loop() is stuck in
+ * a delay(), a sensor read or a display push:
+ *  - every queued detent carries its own timestamp and the interval to the previous one;
+ *  - turns take new slots only in the first ENC_ISR_TURN_SLOTS of the ring, then a detent
+ *    is added to the last queued turn (one turn of steps() detents, the sum of both
+ *    directions); the rest of the ring is kept for button edges and the first detent after one;
+ *  - past ENC_ISR_TURN_SLOTS a press and its release become one click slot (debounced by
+ *    the press length in the interrupt), and further clicks are added to it;
+ *  - if even that is full, a click whose press and release were both lost is counted, and
+ *    detents after a lost edge are summed in a pending count until the ring drained; tick()
+ *    delivers the lost clicks after the queued events and then the pending detents as one
+ *    turn. No detent is lost; only detents between two lost clicks move behind the second.
+ *
+ * Quadrature follows EncButton EB_STEP4_LOW: a detent is reported when both pins return
+ * to HIGH, invalid transitions (bounce, missed edge) count as 0. The button interrupt
+ * queues raw level changes, tick() debounces them by their timestamps; a turn queued after
+ * an edge waits for that edge to settle, so a click comes before the turns which followed it.
+ */
+
+#ifndef ENC_ISR_QUEUE
+#define ENC_ISR_QUEUE 32 // power of 2
+#endif
+
+#ifndef ENC_ISR_TURN_SLOTS
+#define ENC_ISR_TURN_SLOTS (ENC_ISR_QUEUE / 2) // queued turns taking a slot of their own
+#endif
+
+#ifndef ENC_ISR_FAST_MS
+#define ENC_ISR_FAST_MS 30 // detents closer than this are fast(), as EB_FAST_T
+#endif
+
+#ifndef ENC_ISR_DEBOUNCE_MS
+#define ENC_ISR_DEBOUNCE_MS 20
+#endif
+
+#ifndef ENC_ISR_HOLD_MS
+#define ENC_ISR_HOLD_MS 600 // a longer press is not a click
+#endif
+
+enum EncoderAction : uint8_t {
+  ENC_NONE = 0,
+  ENC_TURN,
+  ENC_PRESS,
+  ENC_RELEASE,
+  ENC_CLICK
+};
+
+struct EncoderEvent {
+  uint32_t ms;         // millis() of the detent / edge
+  uint16_t intervalMs; // to the previous detent in the same direction, 0 if none; clicks: to the last release
+  int8_t steps;        // turns: signed detents, 1 unless merged; button: 1 pressed, 0 released; clicks: count
+  uint8_t action;      // ENC_TURN / ENC_PRESS / ENC_RELEASE / ENC_CLICK
+};
+
+class EncoderIsr {
+public:
+  uint32_t events = 0;      // delivered to the callback
+  uint32_t overflows = 0;   // detents added to a queued turn
+  uint32_t deferred = 0;    // detents held back after a lost edge, delivered after the lost clicks
+  uint8_t maxQueued = 0;    // ring high water mark
+
+  EncoderIsr(const uint8_t pinA, const uint8_t pinB, const uint8_t pinBtn, const uint8_t mode = INPUT_PULLUP):
+    _pinA(pinA), _pinB(pinB), _pinBtn(pinBtn), _mode(mode) {}
+
+  void begin() {
+    pinMode(_pinA, _mode);
+    pinMode(_pinB, _mode);
+    pinMode(_pinBtn, _mode);
+
+    _state = digitalRead(_pinA) | digitalRead(_pinB) << 1;
+    _btnLevel = isPinPressed();
+    _raw = _pressed = _btnLevel;
+    _rawMs = _pressMs = millis();
+
+    attachInterruptArg(_pinA, isrEncoder, this, CHANGE);
+    attachInterruptArg(_pinB, isrEncoder, this, CHANGE);
+    attachInterruptArg(_pinBtn, isrButton, this, CHANGE);
+  }
+
+  void attach(void (*cb)()) {
+    _cb = cb;
+  }
+
+  /**
+   * Delivers all queued events to the callback. Returns true if there were any.
+   */
+  bool tick() {
+    bool any = false;
+    uint8_t tail = _tail.load(std::memory_order_relaxed);
+    // up to what is queued now: the lost clicks come after it, before anything newer
+    const uint8_t head = _head.load(std::memory_order_acquire);
+    uint8_t queued = head - tail;
+    if (queued > maxQueued) {
+      maxQueued = queued;
+    }
+
+    uint32_t now = millis();
+    while (tail != head) {
+      EncoderEvent ev = _ring[tail & (ENC_ISR_QUEUE - 1)];
+      if (ev.action == ENC_TURN && !settleBefore(ev.ms, tail + 1, head, now)) {
+        break; // the button edge before it is not debounced yet, the turn waits
+      }
+      _tail.store(++tail, std::memory_order_release);
+      handle(ev);
+      any = true;
+    }
+    // a release lost after a queued press, with its own time so it can still be a click
+    if (tail == head && _isReleaseLost) {
+      _isReleaseLost = false;
+      handle({ _lostReleaseMs, 0, 0, ENC_RELEASE });
+    }
+    any |= settle(now);
+
+    // clicks whose edges were both lost, nothing after them was queued
+    uint32_t lostClicks = _lostClicks;
+    while (tail == head && _raw == _pressed && lostClicks != _lostClicksSeen) {
+      _lostClicksSeen = _lostClicksSeen + 1;
+      deliver(ENC_CLICK, 1, now, 0);
+      any = true;
+    }
+    // then the detents which came after the lost edge, the interrupt queues again after them
+    if (tail == head && _raw == _pressed && _lostClicks == _lostClicksSeen) {
+      for (int32_t pending = _pendingSteps - _pendingSeen; pending; pending = _pendingSteps - _pendingSeen) {
+        int8_t steps = pending > 127 ? 127 : (pending < -127 ? -127 : pending);
+        _pendingSeen = _pendingSeen + steps;
+        deliver(ENC_TURN, steps, now, 0);
+        any = true;
+      }
+    }
+
+    // an edge lost in an overflow leaves the raw level behind the pin (a held press comes later)
+    bool pinPressed = isPinPressed();
+    if (pinPressed != _raw && _tail.load() == _head.load() && !_isPressHeld) {
+      _raw = pinPressed;
+      _rawMs = now;
+    }
+    return any;
+  }
+
+  /**
+   * Something is queued or the button level is not settled yet, keep ticking.
+   */
+  bool busy() const {
+    return _tail.load() != _head.load() || _lostClicks != _lostClicksSeen || _pendingSteps != _pendingSeen ||
+           _isReleaseLost || _raw != _pressed || isPinPressed() != _raw;
+  }
+
+  uint8_t action() const {
+    return _action;
+  }
+
+  /**
+   * Turn direction, 1 or -1.
+   */
+  int8_t dir() const {
+    return _steps < 0 ? -1 : 1;
+  }
+
+  /**
+   * Detents of the current turn, more than 1 only after a ring overflow.
+   */
+  uint8_t steps() const {
+    return _steps < 0 ? -_steps : _steps;
+  }
+
+  bool fast() const {
+    return _intervalMs && _intervalMs < ENC_ISR_FAST_MS;
+  }
+
+  /**
+   * Turn speed in detents per second, 0 for the first detent of a turn.
+   */
+  uint16_t speed() const {
+    return _intervalMs ? 1000 / _intervalMs : 0;
+  }
+
+  /**
+   * millis() when the current event happened, not when it was delivered.
+   */
+  uint32_t eventMs() const {
+    return _eventMs;
+  }
+
+  bool pressing() const {
+    return _pressed;
+  }
+
+  /**
+   * Interrupt side, public for replaying edges on the host.
+   */
+  void IRAM_ATTR onEncoder(const uint8_t a, const uint8_t b, const uint32_t ms) {
+    static const int8_t DELTA[16] = { 0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0 };
+
+    uint8_t state = a | b << 1;
+    if (state == _state) {
+      return;
+    }
+    _count += DELTA[state | _state << 2];
+    _state = state;
+    if (state != 0b11) {
+      return;
+    }
+
+    // detent, a missed transition still leaves 2 of 4 counted
+    int8_t dir = _count >= 2 ? 1 : (_count <= -2 ? -1 : 0);
+    _count = 0;
+    if (!dir) {
+      return;
+    }
+
+    uint32_t interval = dir == _lastDir ? ms - _lastDetentMs : 0;
+    _lastDir = dir;
+    _lastDetentMs = ms;
+    pushTurn({ ms, (uint16_t)(interval > UINT16_MAX ? UINT16_MAX : interval), dir, ENC_TURN });
+  }
+
+  void IRAM_ATTR onButton(const bool pressed, const uint32_t ms) {
+    if (pressed == _btnLevel) {
+      return;
+    }
+    _btnLevel = pressed;
+
+    // after a lost edge nothing is queued before tick() took all of it, the lost click goes first
+    if (_isEdgeLost && isLostTaken()) {
+      _isEdgeLost = false;
+    }
+    if (!_isEdgeLost && mergeClick(pressed, ms)) {
+      return;
+    }
+    if (!_isEdgeLost && push({ ms, 0, (int8_t)pressed, (uint8_t)(pressed ? ENC_PRESS : ENC_RELEASE) })) {
+      _isPressLost = false;
+      return;
+    }
+    loseEdge(pressed, ms);
+  }
+
+private:
+  uint8_t _pinA, _pinB, _pinBtn, _mode;
+  void (*_cb)() = nullptr;
+
+  // producer (interrupt) side
+  EncoderEvent _ring[ENC_ISR_QUEUE];
+  std::atomic<uint8_t> _head{0};
+  uint8_t _state = 0b11;
+  int8_t _count = 0;
+  int8_t _lastDir = 0;
+  uint32_t _lastDetentMs = 0;
+  bool _btnLevel = false;
+  volatile bool _isPressHeld = false; // a press to be added to the queued click, or queued before what follows
+  uint32_t _heldPressMs = 0;
+  bool _isPressLost = false;
+  bool _isEdgeLost = false; // an edge did not fit, nothing is queued until tick() took the lost ones
+  volatile int32_t _pendingSteps = 0; // detents after the lost edge, signed
+  uint32_t _lostPressMs = 0;
+  volatile uint32_t _lostClicks = 0;
+  volatile bool _isReleaseLost = false;
+  volatile uint32_t _lostReleaseMs = 0;
+
+  // consumer (loop) side
+  std::atomic<uint8_t> _tail{0};
+  volatile uint32_t _lostClicksSeen = 0;
+  volatile int32_t _pendingSeen = 0;
+  bool _raw = false;      // last queued button level
+  uint32_t _rawMs = 0;
+  bool _pressed = false;  // debounced
+  uint32_t _pressMs = 0;
+  uint8_t _action = ENC_NONE;
+  int8_t _steps = 0;
+  uint16_t _intervalMs = 0;
+  uint32_t _eventMs = 0;
+
+  static_assert((ENC_ISR_QUEUE & (ENC_ISR_QUEUE - 1)) == 0 && ENC_ISR_QUEUE <= 128, "ENC_ISR_QUEUE must be a power of 2 up to 128");
+  static_assert(ENC_ISR_TURN_SLOTS >= 2 && ENC_ISR_TURN_SLOTS < ENC_ISR_QUEUE, "ENC_ISR_TURN_SLOTS must leave slots for the button");
+
+  void IRAM_ATTR loseEdge(const bool pressed, const uint32_t ms) {
+    _isEdgeLost = true;
+    if (pressed) {
+      _isPressLost = true;
+      _lostPressMs = ms;
+    } else if (_isPressLost) {
+      // neither edge is queued, count it if it is a click
+      if (ms - _lostPressMs >= ENC_ISR_DEBOUNCE_MS && ms - _lostPressMs < ENC_ISR_HOLD_MS) {
+        _lostClicks = _lostClicks + 1;
+      }
+      _isPressLost = false;
+    } else {
+      // after a queued press, tick() takes it once the ring is drained
+      _lostReleaseMs = ms;
+      _isReleaseLost = true;
+    }
+  }
+
+  static void IRAM_ATTR isrEncoder(void* arg) {
+    EncoderIsr* self = (EncoderIsr*)arg;
+    self->onEncoder(digitalRead(self->_pinA), digitalRead(self->_pinB), millis());
+  }
+
+  static void IRAM_ATTR isrButton(void* arg) {
+    EncoderIsr* self = (EncoderIsr*)arg;
+    self->onButton(self->isPinPressed(), millis());
+  }
+
+  bool IRAM_ATTR isPinPressed() const {
+    return digitalRead(_pinBtn) == (_mode == INPUT_PULLUP ? LOW : HIGH);
+  }
+
+  uint8_t IRAM_ATTR queued() const {
+    return _head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * The ring drained and tick() delivered the lost clicks and the pending detents.
+   */
+  bool IRAM_ATTR isLostTaken() const {
+    return queued() == 0 && _lostClicks == _lostClicksSeen && _pendingSteps == _pendingSeen && !_isReleaseLost;
+  }
+
+  /**
+   * The newest queued event; only past ENC_ISR_TURN_SLOTS queued, so it is not the one
+   * tick() reads.
+   */
+  EncoderEvent& IRAM_ATTR lastQueued() {
+    return _ring[(uint8_t)(_head.load(std::memory_order_relaxed) - 1) & (ENC_ISR_QUEUE - 1)];
+  }
+
+  static uint32_t IRAM_ATTR releaseMs(const EncoderEvent& ev) {
+    return ev.action == ENC_CLICK ? ev.ms + ev.intervalMs : ev.ms;
+  }
+
+  /**
+   * Past ENC_ISR_TURN_SLOTS queued: a release turns its queued press into a click slot,
+   * the press of the next click is held back and added to that slot on its release.
+   * True if the edge was taken.
+   */
+  bool IRAM_ATTR mergeClick(const bool pressed, const uint32_t ms) {
+    if (pressed) {
+      if (queued() < ENC_ISR_TURN_SLOTS) {
+        return false;
+      }
+      const EncoderEvent& last = lastQueued();
+      if (last.action != ENC_CLICK || last.steps == 127 || ms - releaseMs(last) < ENC_ISR_DEBOUNCE_MS) {
+        return false;
+      }
+      _isPressHeld = true;
+      _heldPressMs = ms;
+      return true;
+    }
+
+    if (_isPressHeld) {
+      uint32_t held = ms - _heldPressMs;
+      if (held < ENC_ISR_DEBOUNCE_MS) {
+        _isPressHeld = false; // a bounce, neither edge counts
+        return true;
+      }
+      if (held < ENC_ISR_HOLD_MS && queued() >= ENC_ISR_TURN_SLOTS && lastQueued().action == ENC_CLICK) {
+        EncoderEvent& last = lastQueued();
+        last.steps++;
+        last.intervalMs = ms - last.ms > UINT16_MAX ? UINT16_MAX : ms - last.ms;
+        _isPressHeld = false;
+        return true;
+      }
+      // a hold, or tick() took the click meanwhile: the press is queued as it came
+      flushHeldPress();
+      return false;
+    }
+
+    if (queued() < ENC_ISR_TURN_SLOTS) {
+      return false;
+    }
+    EncoderEvent& last = lastQueued();
+    uint32_t held = ms - last.ms;
+    if (last.action != ENC_PRESS || held < ENC_ISR_DEBOUNCE_MS || held >= ENC_ISR_HOLD_MS) {
+      return false;
+    }
+    const EncoderEvent& before = _ring[(uint8_t)(_head.load(std::memory_order_relaxed) - 2) & (ENC_ISR_QUEUE - 1)];
+    if ((before.action == ENC_RELEASE || before.action == ENC_CLICK) && last.ms - releaseMs(before) < ENC_ISR_DEBOUNCE_MS) {
+      return false; // the release before bounced, tick() sees one long press
+    }
+    last.action = ENC_CLICK;
+    last.steps = 1;
+    last.intervalMs = held > UINT16_MAX ? UINT16_MAX : held;
+    return true;
+  }
+
+  /**
+   * Queues a held back press before anything newer. False if it was lost.
+   */
+  bool IRAM_ATTR flushHeldPress() {
+    if (!_isPressHeld) {
+      return true;
+    }
+    _isPressHeld = false;
+    if (push({ _heldPressMs, 0, 1, ENC_PRESS })) {
+      return true;
+    }
+    loseEdge(true, _heldPressMs);
+    return false;
+  }
+
+  bool IRAM_ATTR push(const EncoderEvent& ev) {
+    uint8_t head = _head.load(std::memory_order_relaxed);
+    if (queued() >= ENC_ISR_QUEUE) {
+      return false;
+    }
+    _ring[head & (ENC_ISR_QUEUE - 1)] = ev;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  void IRAM_ATTR pushTurn(const EncoderEvent& ev) {
+    if (_isEdgeLost && !isLostTaken()) {
+      pend(ev.steps);
+      return;
+    }
+    _isEdgeLost = false;
+    if (!flushHeldPress()) {
+      pend(ev.steps);
+      return;
+    }
+
+    uint8_t n = queued();
+    if (n < ENC_ISR_TURN_SLOTS) {
+      push(ev);
+      return;
+    }
+
+    EncoderEvent& last = lastQueued();
+    if (last.action == ENC_TURN && last.steps + ev.steps != 0 && last.steps + ev.steps >= -127 && last.steps + ev.steps <= 127) {
+      last.steps += ev.steps;
+      overflows++;
+      return;
+    }
+    // after a button edge (or a full turn) a new slot
+    if (!push(ev)) {
+      _isEdgeLost = true;
+      pend(ev.steps);
+    }
+  }
+
+  void IRAM_ATTR pend(const int8_t steps) {
+    _pendingSteps = _pendingSteps + steps;
+    deferred++;
+  }
+
+  void handle(const EncoderEvent& ev) {
+    if (ev.action == ENC_TURN) {
+      deliver(ENC_TURN, ev.steps, ev.ms, ev.intervalMs);
+      return;
+    }
+
+    // clicks the interrupt merged, already debounced by their press length
+    if (ev.action == ENC_CLICK) {
+      settle(ev.ms);
+      for (int8_t i = 0; i < ev.steps; i++) {
+        deliver(ENC_PRESS, 1, ev.ms, 0);
+        deliver(ENC_RELEASE, 1, ev.ms, 0);
+        deliver(ENC_CLICK, 1, ev.ms, 0);
+      }
+      _raw = _pressed = false;
+      _pressMs = ev.ms;
+      _rawMs = releaseMs(ev);
+      return;
+    }
+
+    // the raw level held until this edge counts if it lasted the debounce time
+    settle(ev.ms);
+    _raw = ev.steps;
+    _rawMs = ev.ms;
+  }
+
+  /**
+   * Settles a pending button edge which came before a turn at ms, so the press / click
+   * is delivered first. The level held until ms, or until the next queued button edge,
+   * or until now if there is none; false if that is still shorter than the debounce time.
+   */
+  bool settleBefore(const uint32_t ms, uint8_t from, const uint8_t head, const uint32_t now) {
+    if (_raw == _pressed || settle(ms)) {
+      return true;
+    }
+    for (; from != head; from++) {
+      const EncoderEvent& ev = _ring[from & (ENC_ISR_QUEUE - 1)];
+      if (ev.action != ENC_TURN) {
+        settle(ev.ms); // a bounce if it came too soon, the level stays
+        return true;
+      }
+    }
+    return settle(now) || now - _rawMs >= ENC_ISR_DEBOUNCE_MS;
+  }
+
+  /**
+   * Takes the raw button level once it is stable for ENC_ISR_DEBOUNCE_MS at time ms.
+   */
+  bool settle(const uint32_t ms) {
+    if (_raw == _pressed || ms - _rawMs < ENC_ISR_DEBOUNCE_MS) {
+      return false;
+    }
+
+    _pressed = _raw;
+    if (_pressed) {
+      _pressMs = _rawMs;
+      deliver(ENC_PRESS, 1, _rawMs, 0);
+    } else {
+      deliver(ENC_RELEASE, 1, _rawMs, 0);
+      if (_rawMs - _pressMs < ENC_ISR_HOLD_MS) {
+        deliver(ENC_CLICK, 1, _rawMs, 0);
+      }
+    }
+    return true;
+  }
+
+  void deliver(const uint8_t action, const int8_t steps, const uint32_t ms, const uint16_t intervalMs) {
+    _action = action;
+    _steps = steps;
+    _eventMs = ms;
+    _intervalMs = intervalMs;
+    events++;
+    if (_cb) _cb();
+    _action = ENC_NONE;
+  }
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef FixedFormat_h
+#define FixedFormat_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Allocation free text formatting into a caller buffer, integer math only
+ * (the ESP32-C3 has no FPU, printf("%f") pulls in soft float and the full printf).
+ *
+ *   char buf[20];
+ *   FixedWriter(buf, sizeof(buf)).text("ВОЛОГІСТЬ: ").fixed(cur_h, 2).ch('%');
+ *
+ * fixed() takes the float apart into mantissa and exponent and rounds the exact value,
+ * so the output is the same as printf("%.Nf") / Print::print(float, N), except exact binary
+ * ties (0.25 -> "0.3" like Print, printf gives "0.2"). "-0.0" is kept for small negatives.
+ * The result is always NUL terminated, too long output is cut.
+ */
+
+#ifndef FIXED_FORMAT_MAX_DECIMALS
+#define FIXED_FORMAT_MAX_DECIMALS 4
+#endif
+
+class FixedWriter {
+public:
+  FixedWriter(char* buf, const size_t cap): _buf(buf), _cap(cap) {
+    if (_cap) {
+      _buf[0] = '\0';
+    }
+  }
+
+  FixedWriter& ch(const char c) {
+    if (_len + 1 < _cap) {
+      _buf[_len++] = c;
+      _buf[_len] = '\0';
+    }
+    return *this;
+  }
+
+  FixedWriter& text(const char* str) {
+    while (*str) {
+      ch(*str++);
+    }
+    return *this;
+  }
+
+  /**
+   * Unsigned integer, zero padded to minDigits.
+   */
+  FixedWriter& uint(uint32_t val, const uint8_t minDigits = 1) {
+    char digits[10];
+    uint8_t n = 0;
+    do {
+      digits[n++] = '0' + val % 10;
+      val /= 10;
+    } while (val);
+
+    for (uint8_t i = n; i < minDigits; i++) {
+      ch('0');
+    }
+    while (n) {
+      ch(digits[--n]);
+    }
+    return *this;
+  }
+
+  FixedWriter& integer(const int32_t val) {
+    if (val < 0) {
+      ch('-');
+      return uint(-(int64_t)val);
+    }
+    return uint(val);
+  }
+
+  /**
+   * Scaled integer: scaled(785, 2) -> "7.85".
+   */
+  FixedWriter& scaled(const int32_t val, uint8_t decimals) {
+    if (decimals > FIXED_FORMAT_MAX_DECIMALS) {
+      decimals = FIXED_FORMAT_MAX_DECIMALS;
+    }
+
+    uint32_t abs = val < 0 ? -(int64_t)val : val;
+    if (val < 0) {
+      ch('-');
+    }
+    return scaledAbs(abs, decimals);
+  }
+
+  /**
+   * Float with a fixed number of decimals, without float math.
+   */
+  FixedWriter& fixed(const float val, uint8_t decimals) {
+    if (decimals > FIXED_FORMAT_MAX_DECIMALS) {
+      decimals = FIXED_FORMAT_MAX_DECIMALS;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    if (bits >> 31) {
+      ch('-');
+    }
+
+    int16_t exp = (bits >> 23) & 0xFF;
+    if (exp == 0xFF) {
+      return text((bits & 0x7FFFFF) ? "nan" : "inf");
+    }
+
+    uint64_t scaled = 0;
+    if (exp) { // denormals are 0
+      // val = mantissa * 2^(exp - 150)
+      scaled = (uint64_t)((bits & 0x7FFFFF) | 0x800000) * POW10[decimals];
+      exp -= 150;
+      if (exp >= 0) {
+        scaled = exp > 24 ? UINT32_MAX : scaled << exp;
+      } else if (exp > -64) {
+        scaled = (scaled + (1ULL << (-exp - 1))) >> -exp;
+      } else {
+        scaled = 0;
+      }
+    }
+
+    return scaledAbs(scaled > UINT32_MAX ? UINT32_MAX : (uint32_t)scaled, decimals);
+  }
+
+  FixedWriter& percent(const float val, const uint8_t decimals = 0) {
+    return fixed(val, decimals).ch('%');
+  }
+
+  FixedWriter& volts(const float val, const uint8_t decimals = 1) {
+    return fixed(val, decimals).ch('V');
+  }
+
+  /**
+   * Duration as mm:ss, minutes are not limited to 2 digits.
+   */
+  FixedWriter& mmss(const uint32_t seconds) {
+    return uint(seconds / 60, 2).ch(':').uint(seconds % 60, 2);
+  }
+
+  const char* c_str() const {
+    return _buf;
+  }
+
+  size_t length() const {
+    return _len;
+  }
+
+private:
+  static constexpr uint32_t POW10[FIXED_FORMAT_MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000 };
+
+  char* _buf;
+  size_t _cap;
+  size_t _len = 0;
+
+  FixedWriter& scaledAbs(const uint32_t abs, const uint8_t decimals) {
+    uint(abs / POW10[decimals]);
+    if (decimals) {
+      ch('.');
+      uint(abs % POW10[decimals], decimals);
+    }
+    return *this;
+  }
+};
+
+#endif
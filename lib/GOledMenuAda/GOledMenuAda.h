@@ -1,6 +1,8 @@
 #ifndef GyverOLEDMenu_h
 #define GyverOLEDMenu_h
 
+#include "FixedFormat.h"
+
 #define GM_N_INT(x) (__extension__({static const int __m_d_i = (x); &__m_d_i;}))
 #define GM_N_U_INT(x) (__extension__({static const unsigned int __m_d_u_i = (x); &__m_d_u_i;}))
 #define GM_N_FLOAT(x) (__extension__({static const float __m_d_f = (x); &__m_d_f;}))
@@ -25,6 +27,9 @@
 
 #define MENU_ITEM_SELECT_W 127
 
+// MENU_SELECT_OUTLINE: the selected row is framed instead of filled,
+// ~1000 lit pixels less on an OLED (panel current scales with lit pixels)
+
 #ifndef MENU_PARAMS_LEFT_OFFSET
 #define MENU_PARAMS_LEFT_OFFSET 92
 #endif
@@ -40,9 +45,15 @@
 #define MENU_FAST_K 4
 #endif
 
+#ifndef MENU_FLOAT_DECIMALS
+#define MENU_FLOAT_DECIMALS 2 // same as Print::print(float)
+#endif
+
 
 typedef void (*cbOnChange)(const int index, const void* val, const byte valType);
 typedef boolean (*cbOnPrintOverride)(const int index, const void* val, const byte valType);
+// flushes a page change instead of display(): dir 1 to the next page, -1 to the previous one
+typedef void (*cbOnPageFlush)(const int8_t dir);
 
 const char* MENU_BOOLEAN_TEXT[]  = { "Off", "On" };
 
@@ -80,11 +91,22 @@ public:
     // }
     // _oled->textMode((isSelect && !isChange) ? BUF_SUBTRACT : BUF_ADD);
     _oled->setTextSize(1);
+#ifdef MENU_SELECT_OUTLINE
+    _oled->fillRect(_x, _y, MENU_ITEM_SELECT_W, _y1 - _y, BLACK);
+    if (isSelect && !isChange) {
+      _oled->drawRoundRect(_x, _y, MENU_ITEM_SELECT_W, _y1 - _y, 2, WHITE);
+    }
+#else
     _oled->fillRect(_x, _y, MENU_ITEM_SELECT_W, _y1 - _y,(isSelect && !isChange) ? WHITE : BLACK);
+#endif
     if (isChange) {
       _oled->drawRoundRect(MENU_PARAMS_LEFT_OFFSET - 4, _y, MENU_ITEM_SELECT_W - MENU_PARAMS_LEFT_OFFSET + 4, _y1 -_y + 1, 2, WHITE);
     }
+#ifdef MENU_SELECT_OUTLINE
+    _oled->setTextColor(WHITE);
+#else
     _oled->setTextColor((isSelect && !isChange) ? INVERSE: WHITE);
+#endif
     //
     _oled->setCursor(_x + MENU_ITEM_PADDING_LEFT, _text_y);
     _oled->print((const __FlashStringHelper*)_str);
@@ -115,10 +137,18 @@ public:
       }
     }
     if (update) {
-      _oled->display();
+      flush();
     }
   }
 
+  /**
+   * Pushes the row of the item (one pixel taller, the frame of a value being changed);
+   * display() is left for page changes, an e-paper makes a full refresh of it.
+   */
+  void flush() {
+    _oled->displayRegion(_x, _y, MENU_ITEM_SELECT_W, _y1 - _y + 1);
+  }
+
   void unselect(const boolean update = false) {
     isSelect = false;
 
@@ -185,7 +215,7 @@ public:
         break;
     }
 
-    _oled->display();
+    flush();
 
     if (cbImmediate) {
       callCb();
@@ -225,7 +255,7 @@ public:
         break;
     }
 
-    _oled->display();
+    flush();
 
     if (cbImmediate) {
       callCb();
@@ -253,10 +283,24 @@ public:
     }
 
     if (!callPrintOverride()) {
-      _oled->print(*(T*)_val);
+      printVal(*(T*)_val);
     }
   }
 
+  template<typename T>
+  void printVal(const T val) {
+    _oled->print(val);
+  }
+
+  void printVal(const float val) {
+    char buf[16];
+    _oled->print(FixedWriter(buf, sizeof(buf)).fixed(val, MENU_FLOAT_DECIMALS).c_str());
+  }
+
+  void printVal(const double val) {
+    printVal((float)val);
+  }
+
   void printBoolean(const byte mode = MENU_IP_PRINT) {
     if (mode != MENU_IP_PRINT) {
       *(boolean*)_val = !*(boolean*)_val;
@@ -293,8 +337,7 @@ public:
   }
 
 private:
-  // TGyverOLED* _oled = nullptr;
-  Adafruit_SSD1306* _oled = nullptr;
+  TGyverOLED* _oled = nullptr;
   int _index = 0;
   const void* _str = nullptr;
   int _x;
@@ -432,6 +475,10 @@ public:
     _onItemPrintOverride = cb;
   }
 
+  void onPageFlush(cbOnPageFlush cb) {
+    _onPageFlush = cb;
+  }
+
   void showMenu(const boolean val, const boolean update = true) {
     if (val == isMenuShowing) {
       return;
@@ -465,6 +512,7 @@ private:
   OledMenuItem<TGyverOLED> oledMenuItems[_MS_SIZE];
   cbOnChange _onItemChange = nullptr;
   cbOnPrintOverride _onItemPrintOverride = nullptr;
+  cbOnPageFlush _onPageFlush = nullptr;
 
   int getSelectedItemIndex() {
     for (int i = 0; i < _MS_SIZE; i++) {
@@ -500,7 +548,7 @@ private:
     initInterator++;
   }
 
-  void renderPage(const byte page, const boolean firstSelect = true) {
+  void renderPage(const byte page, const boolean firstSelect = true, const int8_t dir = 0) {
     if (page < 1) {
       return;
     }
@@ -534,6 +582,10 @@ private:
 
     currentPage = page;
 
+    if (dir && _onPageFlush) {
+      _onPageFlush(dir);
+      return;
+    }
     _oled->display();
   }
 
@@ -555,7 +607,7 @@ private:
     }
 
     if (nextIndexPage != currentPage) {
-      renderPage(nextIndexPage, isFirstSelect);
+      renderPage(nextIndexPage, isFirstSelect, isFirstSelect ? 1 : -1);
       return;
     }
 
@@ -565,6 +617,8 @@ private:
       nextIdx = 0;
     }
 
+    // both rows changed, each is pushed on its own
+    oledMenuItems[selectedIdx].flush();
     oledMenuItems[nextIdx].select(true);
   }
 
@@ -0,0 +1,592 @@
+#ifndef HistoryLog_h
+#define HistoryLog_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "Crc32.h"
+
+/**
+ * Long term history (temperature, humidity, battery, window state, actuations) in an
+ * append-only log on a flash partition of its own, apart from the Preferences NVS.
+ *
+ * Three tiers, each a ring of 4 KB sectors: every sample, hourly and daily rollups
+ * (min / max / avg, kept incrementally as the samples come). With the 1.4 MB partition of
+ * partitions.csv: ~100k samples (10 weeks at 60 s), 5 months of hours, 2 years of days.
+ * The ring erases its oldest sector when the head comes around, so every sector wears
+ * the same.
+ *
+ * Samples and rollups are batched in RTC memory (the State) and written as one 256 byte
+ * flash page when a page is full: a sample costs a flash write every 20 wakes, the other
+ * wakes do not touch the flash. flush() writes partial batches (low battery, export).
+ *
+ * Page: kind:u8, count:u8, 0xFFFF, seq:u32, crc32:u32, records (the first 4 bytes of a
+ * record are its time). The CRC covers kind .. seq and the records. Power loss safety:
+ * the records are programmed before the header, the header makes the page valid; a page
+ * cut short fails its CRC and is skipped, and a page is used once, only an erased one is
+ * written. A cold boot mounts by reading the first valid page of every sector: the one
+ * with the highest seq is the head. A sector cut during its erase has no valid page and
+ * is erased again when the head gets there.
+ *
+ * Range queries go through a sparse time index in RAM, the first time of every sector,
+ * built at the first query after a wake, then read only the pages of the range.
+ *
+ * The flash is a template parameter with:
+ *   uint32_t size()
+ *   bool read(uint32_t addr, void* out, size_t len)
+ *   bool write(uint32_t addr, const void* data, size_t len)  - NOR: only clears bits
+ *   bool erase(uint32_t addr)                                - the 4 KB sector at addr
+ * PartitionFlash on the ESP32, tools/flashsim/SimFlash.h on the host.
+ *
+ * Times are device seconds (time()), kept increasing over power losses: a cold boot
+ * continues after the last logged time.
+ */
+
+#ifndef HISTORY_SECTORS_MAX
+#define HISTORY_SECTORS_MAX 512 // 2 MB partition, the time index takes 4 bytes per sector
+#endif
+
+#define HISTORY_SECTOR_SIZE 4096
+#define HISTORY_PAGE_SIZE 256
+#define HISTORY_PAGES (HISTORY_SECTOR_SIZE / HISTORY_PAGE_SIZE)
+#define HISTORY_PAGE_HEADER 12
+#define HISTORY_PAGE_DATA (HISTORY_PAGE_SIZE - HISTORY_PAGE_HEADER)
+#define HISTORY_STATE_MAGIC 0x48495354
+#define HISTORY_NO_TIME 0xFFFFFFFF
+
+#define HISTORY_RAW 0
+#define HISTORY_HOURLY 1
+#define HISTORY_DAILY 2
+#define HISTORY_TIERS 3
+
+// actuation of a sample, the TM_ACT_* codes of the telemetry
+#define HISTORY_ACT_NONE 0
+#define HISTORY_ACT_OPEN 1
+#define HISTORY_ACT_CLOSE 2
+#define HISTORY_ACT_STOP 3
+#define HISTORY_ACT_MANUAL 4
+
+struct HistorySample {
+  uint32_t time;
+  int16_t temp;  // x10
+  int16_t hum;   // x10
+  uint16_t mv;   // battery
+  uint8_t state; // window: bit 0 fully, bit 1 partially opened
+  uint8_t action;
+};
+
+struct HistoryRollup {
+  uint32_t start; // of the hour / day
+  uint16_t samples;
+  uint16_t actions;
+  int16_t minTemp, maxTemp, avgTemp;
+  int16_t minHum, maxHum, avgHum;
+  uint16_t minMv, avgMv;
+};
+
+struct HistoryAccumulator {
+  uint32_t start;
+  uint16_t samples;
+  uint16_t actions;
+  int32_t sumTemp, sumHum;
+  uint32_t sumMv;
+  int16_t minTemp, maxTemp, minHum, maxHum;
+  uint16_t minMv;
+
+  void add(const HistorySample& s, const uint32_t periodStart) {
+    if (!samples) {
+      *this = {};
+      start = periodStart;
+      minTemp = maxTemp = s.temp;
+      minHum = maxHum = s.hum;
+      minMv = s.mv;
+    }
+    samples++;
+    actions += s.action != HISTORY_ACT_NONE;
+    sumTemp += s.temp;
+    sumHum += s.hum;
+    sumMv += s.mv;
+    if (s.temp < minTemp) minTemp = s.temp;
+    if (s.temp > maxTemp) maxTemp = s.temp;
+    if (s.hum < minHum) minHum = s.hum;
+    if (s.hum > maxHum) maxHum = s.hum;
+    if (s.mv < minMv) minMv = s.mv;
+  }
+
+  HistoryRollup rollup() const {
+    return { start, samples, actions,
+             minTemp, maxTemp, (int16_t)(sumTemp / samples),
+             minHum, maxHum, (int16_t)(sumHum / samples),
+             minMv, (uint16_t)(sumMv / samples) };
+  }
+};
+
+struct HistoryTier {
+  uint16_t first;   // sector in the partition
+  uint16_t sectors;
+  uint16_t head;    // sector written now, 0 .. sectors - 1
+  uint8_t page;     // next page in it, HISTORY_PAGES: full
+  bool isWrapped;   // the sectors after head hold data, the oldest is head + 1
+  uint32_t seq;     // of the next page
+};
+
+struct HistoryStats {
+  uint32_t samples;
+  uint32_t pageWrites;
+  uint32_t erases;
+  uint32_t failed;  // flash operations
+  uint32_t dropped; // records lost to failed writes
+};
+
+template< typename TFlash >
+class HistoryLog {
+public:
+  /**
+   * Everything that has to survive deep sleep, declare it RTC_DATA_ATTR.
+   */
+  struct State {
+    uint32_t magic;
+    uint32_t size;       // of the partition it was mounted on
+    HistoryTier tiers[HISTORY_TIERS];
+    uint32_t timeOffset; // added to the time() seconds
+    uint32_t lastTime;
+    uint8_t batch[HISTORY_TIERS][HISTORY_PAGE_DATA];
+    uint8_t batchCount[HISTORY_TIERS];
+    HistoryAccumulator hour, day;
+    HistoryStats stats;
+  };
+
+  HistoryLog(TFlash& flash, State& state) : _flash(flash), _s(state) {}
+
+  /**
+   * After every boot. A deep sleep wake continues from the State, any other boot reads
+   * the head positions back from the flash; the batches in RTC memory are kept if valid.
+   * False without a usable partition.
+   */
+  bool begin(const uint32_t now, const bool isSleepWake) {
+    uint32_t size = _flash.size();
+    if (size / HISTORY_SECTOR_SIZE < 6) {
+      return false;
+    }
+    bool isStateValid = _s.magic == HISTORY_STATE_MAGIC && _s.size == size;
+    if (isStateValid && isSleepWake) {
+      return true;
+    }
+    if (!isStateValid) {
+      memset(&_s, 0, sizeof(_s));
+    }
+    layout(size);
+    mount(now);
+    _s.magic = HISTORY_STATE_MAGIC;
+    _s.size = size;
+    return true;
+  }
+
+  bool isReady() const {
+    return _s.magic == HISTORY_STATE_MAGIC;
+  }
+
+  /**
+   * Log time of a time() value.
+   */
+  uint32_t timeOf(const uint32_t now) const {
+    uint32_t t = now + _s.timeOffset;
+    return t < _s.lastTime ? _s.lastTime : t;
+  }
+
+  /**
+   * Adds a sample and rolls the hour / day over. False if a flash write failed.
+   */
+  bool append(const uint32_t now, const int16_t temp, const int16_t hum, const uint16_t mv,
+              const uint8_t state, const uint8_t action = HISTORY_ACT_NONE) {
+    if (!isReady()) {
+      return false;
+    }
+    HistorySample s = { timeOf(now), temp, hum, mv, state, action };
+    _s.lastTime = s.time;
+    _s.stats.samples++;
+
+    bool ok = true;
+    uint32_t hour = s.time - s.time % 3600;
+    if (_s.hour.samples && _s.hour.start != hour) {
+      HistoryRollup r = _s.hour.rollup();
+      ok &= add(HISTORY_HOURLY, &r);
+      _s.hour.samples = 0;
+    }
+    _s.hour.add(s, hour);
+
+    uint32_t day = s.time - s.time % 86400;
+    if (_s.day.samples && _s.day.start != day) {
+      HistoryRollup r = _s.day.rollup();
+      ok &= add(HISTORY_DAILY, &r);
+      _s.day.samples = 0;
+    }
+    _s.day.add(s, day);
+
+    return add(HISTORY_RAW, &s) && ok;
+  }
+
+  /**
+   * Writes the partial batches, the open hour and day go on.
+   */
+  bool flush() {
+    bool ok = true;
+    for (uint8_t tier = 0; tier < HISTORY_TIERS && isReady(); tier++) {
+      if (_s.batchCount[tier]) {
+        ok &= writeBatch(tier);
+      }
+    }
+    return ok;
+  }
+
+  /**
+   * Calls fn(const HistorySample&) for the samples with from <= time < to, oldest first,
+   * the unwritten batch included. Returns their number.
+   */
+  template< typename F >
+  uint32_t querySamples(const uint32_t from, const uint32_t to, F fn) {
+    return scan(HISTORY_RAW, from, to, [&](const uint8_t* rec) {
+      HistorySample s;
+      memcpy(&s, rec, sizeof(s));
+      fn(s);
+    });
+  }
+
+  /**
+   * The same for HISTORY_HOURLY / HISTORY_DAILY rollups, by their start.
+   */
+  template< typename F >
+  uint32_t queryRollups(const uint8_t tier, const uint32_t from, const uint32_t to, F fn) {
+    return scan(tier, from, to, [&](const uint8_t* rec) {
+      HistoryRollup r;
+      memcpy(&r, rec, sizeof(r));
+      fn(r);
+    });
+  }
+
+  /**
+   * Export view of a tier (lib/SerialExport): its pages from the oldest sector to the head
+   * as they are in flash. base changes when the oldest sector is recycled.
+   */
+  uint32_t exportOpen(const uint8_t tier, uint32_t& base) {
+    flush();
+    base = exportBase(tier);
+    return usedPages(tier) * HISTORY_PAGE_SIZE;
+  }
+
+  uint16_t exportRead(const uint8_t tier, const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len) {
+    if (!isReady() || base != exportBase(tier)) {
+      return 0;
+    }
+    const HistoryTier& t = _s.tiers[tier];
+    uint16_t done = 0;
+    while (done < len) {
+      uint32_t pos = offset + done;
+      uint32_t page = pos / HISTORY_PAGE_SIZE;
+      uint32_t sector = t.first + (oldest(t) + page / HISTORY_PAGES) % t.sectors;
+      uint16_t n = HISTORY_PAGE_SIZE - pos % HISTORY_PAGE_SIZE;
+      if (n > len - done) {
+        n = len - done;
+      }
+      uint32_t addr = sector * HISTORY_SECTOR_SIZE + page % HISTORY_PAGES * HISTORY_PAGE_SIZE + pos % HISTORY_PAGE_SIZE;
+      if (!_flash.read(addr, out + done, n)) {
+        return 0;
+      }
+      done += n;
+    }
+    return done;
+  }
+
+  const State& state() const {
+    return _s;
+  }
+
+  static uint8_t recordSize(const uint8_t tier) {
+    return tier == HISTORY_RAW ? sizeof(HistorySample) : sizeof(HistoryRollup);
+  }
+
+  static uint8_t perPage(const uint8_t tier) {
+    return HISTORY_PAGE_DATA / recordSize(tier);
+  }
+
+private:
+  TFlash& _flash;
+  State& _s;
+  uint32_t _index[HISTORY_SECTORS_MAX]; // first time of every sector, HISTORY_NO_TIME: none
+  bool _isIndexed = false;
+
+  static_assert(sizeof(HistorySample) == 12 && sizeof(HistoryRollup) == 24, "records are stored as they are");
+
+  /**
+   * Tiers over the sectors: 1/64 days, 1/16 hours, the rest samples.
+   */
+  void layout(const uint32_t size) {
+    uint16_t sectors = size / HISTORY_SECTOR_SIZE;
+    if (sectors > HISTORY_SECTORS_MAX) {
+      sectors = HISTORY_SECTORS_MAX;
+    }
+    uint16_t daily = sectors / 64 > 2 ? sectors / 64 : 2;
+    uint16_t hourly = sectors / 16 > 2 ? sectors / 16 : 2;
+    uint16_t counts[HISTORY_TIERS] = { (uint16_t)(sectors - hourly - daily), hourly, daily };
+    uint16_t first = 0;
+    for (uint8_t tier = 0; tier < HISTORY_TIERS; tier++) {
+      _s.tiers[tier] = { first, counts[tier], 0, 0, false, 1 };
+      first += counts[tier];
+    }
+  }
+
+  uint16_t oldest(const HistoryTier& t) const {
+    return t.isWrapped ? (t.head + 1) % t.sectors : 0;
+  }
+
+  uint32_t usedPages(const uint8_t tier) const {
+    const HistoryTier& t = _s.tiers[tier];
+    return (t.isWrapped ? t.sectors - 1 : t.head) * HISTORY_PAGES + t.page;
+  }
+
+  uint32_t exportBase(const uint8_t tier) const {
+    return _s.tiers[tier].seq - usedPages(tier);
+  }
+
+  bool add(const uint8_t tier, const void* rec) {
+    uint8_t& count = _s.batchCount[tier];
+    if (count == perPage(tier) && !writeBatch(tier)) {
+      _s.stats.dropped++;
+      return false;
+    }
+    memcpy(_s.batch[tier] + count * recordSize(tier), rec, recordSize(tier));
+    count++;
+    return count < perPage(tier) || writeBatch(tier);
+  }
+
+  /**
+   * The batch as the next page. The page is used up also when the write fails, the batch
+   * stays for the next try then.
+   */
+  bool writeBatch(const uint8_t tier) {
+    HistoryTier& t = _s.tiers[tier];
+    if (t.page == HISTORY_PAGES) {
+      t.head = (t.head + 1) % t.sectors;
+      t.page = 0;
+      if (t.head == 0) {
+        t.isWrapped = true;
+      }
+    }
+    uint32_t sector = t.first + t.head;
+    uint8_t count = _s.batchCount[tier];
+    if (t.page == 0) {
+      _s.stats.erases++;
+      if (!_flash.erase(sector * HISTORY_SECTOR_SIZE)) {
+        _s.stats.failed++;
+        t.page = HISTORY_PAGES; // erase the next one on the next try
+        return false;
+      }
+      memcpy(&_index[sector], _s.batch[tier], 4);
+    }
+
+    uint8_t page[HISTORY_PAGE_SIZE];
+    uint16_t len = count * recordSize(tier);
+    page[0] = tier + 1;
+    page[1] = count;
+    page[2] = page[3] = 0xFF;
+    memcpy(page + 4, &t.seq, 4);
+    uint32_t crc = crc32Update(crc32Update(0, page, 8), _s.batch[tier], len);
+    memcpy(page + 8, &crc, 4);
+
+    uint32_t addr = sector * HISTORY_SECTOR_SIZE + t.page * HISTORY_PAGE_SIZE;
+    t.page++;
+    t.seq++;
+    _s.stats.pageWrites++;
+    // the header last, it commits the page
+    if (!_flash.write(addr + HISTORY_PAGE_HEADER, _s.batch[tier], len) || !_flash.write(addr, page, HISTORY_PAGE_HEADER)) {
+      _s.stats.failed++;
+      return false;
+    }
+    _s.batchCount[tier] = 0;
+    return true;
+  }
+
+  /**
+   * Reads and checks a page, false if it is not a valid one of the tier.
+   */
+  bool readPage(const uint8_t tier, const uint32_t sector, const uint8_t page, uint8_t* out) {
+    if (!_flash.read(sector * HISTORY_SECTOR_SIZE + page * HISTORY_PAGE_SIZE, out, HISTORY_PAGE_SIZE)) {
+      _s.stats.failed++;
+      return false;
+    }
+    if (out[0] != tier + 1 || out[1] == 0 || out[1] > perPage(tier)) {
+      return false;
+    }
+    uint32_t crc;
+    memcpy(&crc, out + 8, 4);
+    return crc32Update(crc32Update(0, out, 8), out + HISTORY_PAGE_HEADER, out[1] * recordSize(tier)) == crc;
+  }
+
+  static bool isErased(const uint8_t* page) {
+    for (uint16_t i = 0; i < HISTORY_PAGE_SIZE; i++) {
+      if (page[i] != 0xFF) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Index entry of a sector from its first valid page, returns that page's seq (0: none).
+   */
+  uint32_t indexSector(const uint8_t tier, const uint32_t sector) {
+    uint8_t page[HISTORY_PAGE_SIZE];
+    _index[sector] = HISTORY_NO_TIME;
+    for (uint8_t p = 0; p < HISTORY_PAGES; p++) {
+      if (readPage(tier, sector, p, page)) {
+        uint32_t seq;
+        memcpy(&_index[sector], page + HISTORY_PAGE_HEADER, 4);
+        memcpy(&seq, page + 4, 4);
+        return seq;
+      }
+      if (isErased(page)) {
+        break; // the pages are written in order
+      }
+    }
+    return 0;
+  }
+
+  void mount(const uint32_t now) {
+    uint8_t page[HISTORY_PAGE_SIZE];
+    for (uint8_t tier = 0; tier < HISTORY_TIERS; tier++) {
+      HistoryTier& t = _s.tiers[tier];
+      uint32_t newestSeq = 0;
+      uint32_t lastTime = 0;
+      for (uint16_t s = 0; s < t.sectors; s++) {
+        uint32_t seq = indexSector(tier, t.first + s);
+        if (seq > newestSeq) {
+          newestSeq = seq;
+          t.head = s;
+        }
+      }
+      if (!newestSeq) {
+        continue; // empty, from the start
+      }
+
+      // behind the last page which is not erased, valid or not
+      uint32_t sector = t.first + t.head;
+      t.page = 0;
+      t.seq = newestSeq + 1;
+      for (uint8_t p = 0; p < HISTORY_PAGES; p++) {
+        bool isValid = readPage(tier, sector, p, page);
+        if (!isValid && isErased(page)) {
+          continue;
+        }
+        t.page = p + 1;
+        if (isValid) {
+          uint32_t seq;
+          memcpy(&seq, page + 4, 4);
+          t.seq = seq + 1;
+          memcpy(&lastTime, page + HISTORY_PAGE_HEADER + (page[1] - 1) * recordSize(tier), 4);
+        } else {
+          t.seq++;
+        }
+      }
+      t.isWrapped = false;
+      for (uint16_t s = t.head + 1; s < t.sectors && !t.isWrapped; s++) {
+        t.isWrapped = _index[t.first + s] != HISTORY_NO_TIME;
+      }
+      trimBatch(tier, lastTime);
+      if (tier == HISTORY_RAW && lastTime > _s.lastTime) {
+        _s.lastTime = lastTime;
+      }
+    }
+    _isIndexed = true;
+
+    // time() starts over after a power loss, the log goes on from its last time
+    _s.timeOffset = now + _s.timeOffset < _s.lastTime ? _s.lastTime + 1 - now : _s.timeOffset;
+  }
+
+  /**
+   * Drops the records of a batch kept over a reset which made it to the flash already
+   * (the reset came between the page write and the end of writeBatch()).
+   */
+  void trimBatch(const uint8_t tier, const uint32_t lastTime) {
+    uint8_t size = recordSize(tier);
+    uint8_t* batch = _s.batch[tier];
+    uint8_t count = _s.batchCount[tier];
+    uint8_t skip = 0;
+    uint32_t time;
+    while (skip < count && (memcpy(&time, batch + skip * size, 4), time <= lastTime)) {
+      skip++;
+    }
+    memmove(batch, batch + skip * size, (count - skip) * size);
+    _s.batchCount[tier] = count - skip;
+  }
+
+  template< typename F >
+  uint32_t scan(const uint8_t tier, const uint32_t from, const uint32_t to, F fn) {
+    if (!isReady()) {
+      return 0;
+    }
+    const HistoryTier& t = _s.tiers[tier];
+    if (!_isIndexed) {
+      for (uint8_t i = 0; i < HISTORY_TIERS; i++) {
+        for (uint16_t s = 0; s < _s.tiers[i].sectors; s++) {
+          indexSector(i, _s.tiers[i].first + s);
+        }
+      }
+      _isIndexed = true;
+    }
+
+    // the last sector starting at or before from, it may hold the first records
+    uint16_t used = t.isWrapped ? t.sectors : t.head + 1;
+    uint16_t start = 0;
+    for (uint16_t i = 0; i < used; i++) {
+      uint32_t first = _index[t.first + (oldest(t) + i) % t.sectors];
+      if (first == HISTORY_NO_TIME) {
+        continue;
+      }
+      if (first > from) {
+        break;
+      }
+      start = i;
+    }
+
+    uint32_t n = 0;
+    uint8_t page[HISTORY_PAGE_SIZE];
+    uint8_t size = recordSize(tier);
+    for (uint16_t i = start; i < used; i++) {
+      uint16_t s = (oldest(t) + i) % t.sectors;
+      uint8_t pages = s == t.head ? t.page : HISTORY_PAGES;
+      for (uint8_t p = 0; p < pages; p++) {
+        if (!readPage(tier, t.first + s, p, page)) {
+          continue;
+        }
+        for (uint8_t r = 0; r < page[1]; r++) {
+          const uint8_t* rec = page + HISTORY_PAGE_HEADER + r * size;
+          if (!visit(rec, from, to, fn, n)) {
+            return n;
+          }
+        }
+      }
+    }
+    for (uint8_t r = 0; r < _s.batchCount[tier]; r++) {
+      if (!visit(_s.batch[tier] + r * size, from, to, fn, n)) {
+        break;
+      }
+    }
+    return n;
+  }
+
+  template< typename F >
+  static bool visit(const uint8_t* rec, const uint32_t from, const uint32_t to, F& fn, uint32_t& n) {
+    uint32_t time;
+    memcpy(&time, rec, 4);
+    if (time >= to) {
+      return false;
+    }
+    if (time >= from) {
+      fn(rec);
+      n++;
+    }
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+/**
+ * Fixed-memory metrics: counters, gauges (last / min / max) and histograms with log2
+ * buckets. An update is an index and an add, the histogram bucket is one count-leading-zeros.
+ * The registry has no constructor work, so it can be declared RTC_DATA_ATTR and keeps
+ * counting through deep sleep; a dump() saved to NVS and merge() carry it over resets.
+ *
+ * Dump (also the checkpoint), unsigned LEB128 varints unless noted:
+ *   'M', version, counters, gauges, histograms, buckets (6 bytes)
+ *   counters:   value
+ *   gauges:     flags (bit 0: set), then if set: last, min, max as zigzag varints
+ *   histograms: count, sum, bit mask of the non-empty buckets, their counts
+ * tools/metrics_decode.py reads the "#M<hex>" lines of a serial log.
+ *
+ * Bucket 0 holds 0, bucket k holds [2^(k-1), 2^k), the last one everything above.
+ */
+
+#ifndef METRICS_BUCKETS
+#define METRICS_BUCKETS 24 // up to 2^22, 4.2 s in us
+#endif
+
+#define METRICS_VERSION 1
+
+struct MetricGauge {
+  int32_t last;
+  int32_t min;
+  int32_t max;
+  bool isSet;
+};
+
+struct MetricHistogram {
+  uint32_t count;
+  uint64_t sum;
+  uint16_t buckets[METRICS_BUCKETS]; // saturating
+};
+
+template< uint8_t _COUNTERS, uint8_t _GAUGES, uint8_t _HISTOGRAMS >
+class MetricsRegistry {
+  static_assert(METRICS_BUCKETS <= 32, "bucket mask is 32 bit");
+
+public:
+  uint32_t counters[_COUNTERS] = {};
+  MetricGauge gauges[_GAUGES] = {};
+  MetricHistogram histograms[_HISTOGRAMS] = {};
+  uint16_t updatesSinceCheckpoint = 0;
+
+  void count(const uint8_t id, const uint32_t n = 1) {
+    counters[id] += n;
+    updatesSinceCheckpoint++;
+  }
+
+  void set(const uint8_t id, const int32_t value) {
+    MetricGauge& g = gauges[id];
+    if (!g.isSet || value < g.min) g.min = value;
+    if (!g.isSet || value > g.max) g.max = value;
+    g.last = value;
+    g.isSet = true;
+  }
+
+  void observe(const uint8_t id, const uint32_t value) {
+    MetricHistogram& h = histograms[id];
+    h.count++;
+    h.sum += value;
+    uint16_t& bucket = h.buckets[bucketOf(value)];
+    if (bucket != UINT16_MAX) bucket++;
+    updatesSinceCheckpoint++;
+  }
+
+  static uint8_t bucketOf(const uint32_t value) {
+    uint8_t b = value ? 32 - __builtin_clz(value) : 0;
+    return b < METRICS_BUCKETS ? b : METRICS_BUCKETS - 1;
+  }
+
+  /**
+   * Value at quantile q (0..1) from the buckets, the upper bound of the bucket it falls into.
+   */
+  uint32_t quantile(const uint8_t id, const float q) const {
+    const MetricHistogram& h = histograms[id];
+    uint32_t rank = h.count * q;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < METRICS_BUCKETS; b++) {
+      seen += h.buckets[b];
+      if (seen > rank) {
+        return b == METRICS_BUCKETS - 1 ? UINT32_MAX : (b ? (1UL << b) - 1 : 0);
+      }
+    }
+    return UINT32_MAX;
+  }
+
+  /**
+   * Binary dump, see the header. Returns its length, 0 if cap is too small.
+   */
+  size_t dump(uint8_t* out, const size_t cap) const {
+    Writer w = { out, cap, 0 };
+    const uint8_t header[] = { 'M', METRICS_VERSION, _COUNTERS, _GAUGES, _HISTOGRAMS, METRICS_BUCKETS };
+    for (uint8_t b : header) w.byte(b);
+
+    for (uint8_t i = 0; i < _COUNTERS; i++) {
+      w.varint(counters[i]);
+    }
+    for (uint8_t i = 0; i < _GAUGES; i++) {
+      const MetricGauge& g = gauges[i];
+      w.byte(g.isSet);
+      if (g.isSet) {
+        w.zigzag(g.last);
+        w.zigzag(g.min);
+        w.zigzag(g.max);
+      }
+    }
+    for (uint8_t i = 0; i < _HISTOGRAMS; i++) {
+      const MetricHistogram& h = histograms[i];
+      uint32_t mask = 0;
+      for (uint8_t b = 0; b < METRICS_BUCKETS; b++) {
+        if (h.buckets[b]) mask |= 1UL << b;
+      }
+      w.varint(h.count);
+      w.varint(h.sum);
+      w.varint(mask);
+      for (uint8_t b = 0; b < METRICS_BUCKETS; b++) {
+        if (h.buckets[b]) w.varint(h.buckets[b]);
+      }
+    }
+    return w.len <= cap ? w.len : 0;
+  }
+
+#ifdef ARDUINO
+  /**
+   * The dump as one "#M<hex>" line.
+   */
+  void printDump(Print& out) const {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    uint8_t buf[dumpMax()];
+    size_t len = dump(buf, sizeof(buf));
+    out.print("#M");
+    for (size_t i = 0; i < len; i++) {
+      out.print(HEX_DIGITS[buf[i] >> 4]);
+      out.print(HEX_DIGITS[buf[i] & 0x0F]);
+    }
+    out.println();
+  }
+#endif
+
+  /**
+   * Adds a dump (a checkpoint from before a reset) to the current values. False if it does
+   * not parse or has another layout, nothing is changed then.
+   */
+  bool merge(const uint8_t* in, const size_t len) {
+    const uint8_t header[] = { 'M', METRICS_VERSION, _COUNTERS, _GAUGES, _HISTOGRAMS, METRICS_BUCKETS };
+    if (len < sizeof(header) || memcmp(in, header, sizeof(header)) != 0) {
+      return false;
+    }
+
+    // parse into a copy first, a truncated checkpoint must not leave half merged values
+    MetricsRegistry loaded;
+    Reader r = { in + sizeof(header), in + len };
+    for (uint8_t i = 0; i < _COUNTERS; i++) {
+      loaded.counters[i] = r.varint();
+    }
+    for (uint8_t i = 0; i < _GAUGES; i++) {
+      MetricGauge& g = loaded.gauges[i];
+      g.isSet = r.byte();
+      if (g.isSet) {
+        g.last = r.zigzag();
+        g.min = r.zigzag();
+        g.max = r.zigzag();
+      }
+    }
+    for (uint8_t i = 0; i < _HISTOGRAMS; i++) {
+      MetricHistogram& h = loaded.histograms[i];
+      h.count = r.varint();
+      h.sum = r.varint();
+      uint32_t mask = r.varint();
+      for (uint8_t b = 0; b < METRICS_BUCKETS; b++) {
+        if (mask & (1UL << b)) h.buckets[b] = r.varint();
+      }
+    }
+    if (!r.isOk) {
+      return false;
+    }
+
+    for (uint8_t i = 0; i < _COUNTERS; i++) {
+      counters[i] += loaded.counters[i];
+    }
+    for (uint8_t i = 0; i < _GAUGES; i++) {
+      const MetricGauge& from = loaded.gauges[i];
+      MetricGauge& g = gauges[i];
+      if (!from.isSet) continue;
+      if (!g.isSet) {
+        g = from;
+        continue;
+      }
+      if (from.min < g.min) g.min = from.min;
+      if (from.max > g.max) g.max = from.max;
+    }
+    for (uint8_t i = 0; i < _HISTOGRAMS; i++) {
+      const MetricHistogram& from = loaded.histograms[i];
+      MetricHistogram& h = histograms[i];
+      h.count += from.count;
+      h.sum += from.sum;
+      for (uint8_t b = 0; b < METRICS_BUCKETS; b++) {
+        uint32_t sum = (uint32_t)h.buckets[b] + from.buckets[b];
+        h.buckets[b] = sum < UINT16_MAX ? sum : UINT16_MAX;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Enough updates since the last checkpoint to spend an NVS write on them.
+   */
+  bool needCheckpoint(const uint16_t minUpdates) const {
+    return updatesSinceCheckpoint >= minUpdates;
+  }
+
+  void checkpointed() {
+    updatesSinceCheckpoint = 0;
+  }
+
+  /**
+   * Worst case dump size.
+   */
+  static constexpr size_t dumpMax() {
+    return 6 + _COUNTERS * 5 + _GAUGES * 16 + _HISTOGRAMS * (5 + 10 + 5 + METRICS_BUCKETS * 3);
+  }
+
+private:
+  struct Writer {
+    uint8_t* out;
+    size_t cap;
+    size_t len;
+
+    void byte(const uint8_t b) {
+      if (len < cap) out[len] = b;
+      len++;
+    }
+
+    void varint(uint64_t v) {
+      while (v >= 0x80) {
+        byte((uint8_t)v | 0x80);
+        v >>= 7;
+      }
+      byte(v);
+    }
+
+    void zigzag(const int32_t v) {
+      varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+    }
+  };
+
+  struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool isOk = true;
+
+    uint8_t byte() {
+      if (p >= end) {
+        isOk = false;
+        return 0;
+      }
+      return *p++;
+    }
+
+    uint64_t varint() {
+      uint64_t v = 0;
+      for (uint8_t shift = 0; shift < 64; shift += 7) {
+        uint8_t b = byte();
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+      }
+      return v;
+    }
+
+    int32_t zigzag() {
+      uint32_t v = varint();
+      return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    }
+  };
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef MotionCurrent_h
+#define MotionCurrent_h
+
+#include <Arduino.h>
+#include <Wire.h>
+
+/**
+ * High rate INA219 current sampling while the servo moves.
+ *
+ * begin() switches the INA219 to shunt only, 9 bit (84 us) continuous conversions and
+ * leaves the register pointer on the shunt register, so every sample() is a bare 2 byte read.
+ * Samples go into a fixed ring buffer; a stall is declared when the current stays above
+ * the threshold for the whole window. end() only stops sampling, the caller restores the
+ * normal INA219 configuration (Adafruit_INA219::setCalibration_*).
+ */
+
+#ifndef MOTION_CURRENT_BUF
+#define MOTION_CURRENT_BUF 256
+#endif
+
+#ifndef MOTION_CURRENT_SHUNT_MOHM
+#define MOTION_CURRENT_SHUNT_MOHM 100
+#endif
+
+// 16V bus range, PGA /8 (+-320 mV), bus ADC 9 bit, shunt ADC 9 bit, shunt continuous
+#ifndef MOTION_CURRENT_INA_CONFIG
+#define MOTION_CURRENT_INA_CONFIG 0x1805
+#endif
+
+#define INA219_REG_CONFIG 0x00
+#define INA219_REG_SHUNT 0x01
+
+class MotionCurrentMonitor {
+public:
+  int16_t samples[MOTION_CURRENT_BUF] = {}; // mA, ring
+  uint16_t pos = 0;
+  uint32_t count = 0;
+  int16_t peakMa = 0;
+  uint16_t latencyMs = 0; // first sample over the threshold -> stall declared
+
+  MotionCurrentMonitor(TwoWire* wire, const uint8_t addr): _wire(wire), _addr(addr) {}
+
+  void begin(const int16_t stallMa, const uint16_t stallWindowMs) {
+    _stallMa = stallMa;
+    _stallWindowMs = stallWindowMs;
+    pos = 0;
+    count = 0;
+    peakMa = 0;
+    latencyMs = 0;
+    _stalled = false;
+    _isOver = false;
+
+    _wire->beginTransmission(_addr);
+    _wire->write((uint8_t)INA219_REG_CONFIG);
+    _wire->write((uint8_t)(MOTION_CURRENT_INA_CONFIG >> 8));
+    _wire->write((uint8_t)(MOTION_CURRENT_INA_CONFIG & 0xFF));
+    _wire->endTransmission();
+
+    _wire->beginTransmission(_addr);
+    _wire->write((uint8_t)INA219_REG_SHUNT);
+    _wire->endTransmission();
+
+    _active = true;
+    _startMs = millis();
+  }
+
+  void end() {
+    if (!_active) {
+      return;
+    }
+
+    _active = false;
+    _durationMs = millis() - _startMs;
+  }
+
+  bool isActive() const {
+    return _active;
+  }
+
+  /**
+   * Reads one sample, returns false if the INA219 did not answer.
+   */
+  bool sample() {
+    if (!_active || _wire->requestFrom(_addr, (uint8_t)2) != 2) {
+      return false;
+    }
+
+    uint8_t hi = _wire->read();
+    int16_t raw = (int16_t)(hi << 8 | _wire->read());
+    int16_t ma = (int32_t)raw * 10 / MOTION_CURRENT_SHUNT_MOHM; // 10 uV per LSB
+
+    samples[pos] = ma;
+    pos = (pos + 1) % MOTION_CURRENT_BUF;
+    count++;
+    if (ma > peakMa) peakMa = ma;
+
+    unsigned long now = millis();
+    if (ma < _stallMa) {
+      _isOver = false;
+    } else if (!_isOver) {
+      _isOver = true;
+      _overSinceMs = now;
+    } else if (!_stalled && now - _overSinceMs >= _stallWindowMs) {
+      _stalled = true;
+      latencyMs = now - _overSinceMs;
+    }
+
+    return true;
+  }
+
+  bool hasSample() const {
+    return count > 0;
+  }
+
+  /**
+   * Latest sample of this motion, 0 before the first one (the ring still holds the
+   * previous motion).
+   */
+  int16_t lastMa() const {
+    return count ? samples[(pos + MOTION_CURRENT_BUF - 1) % MOTION_CURRENT_BUF] : 0;
+  }
+
+  bool isStalled() const {
+    return _stalled;
+  }
+
+  uint16_t sampleRateHz() const {
+    unsigned long ms = _active ? millis() - _startMs : _durationMs;
+    return ms ? (uint64_t)count * 1000 / ms : 0;
+  }
+
+private:
+  TwoWire* _wire;
+  uint8_t _addr;
+  int16_t _stallMa = 0;
+  uint16_t _stallWindowMs = 0;
+  bool _active = false;
+  bool _stalled = false;
+  bool _isOver = false;
+  unsigned long _overSinceMs = 0;
+  unsigned long _startMs = 0;
+  unsigned long _durationMs = 0;
+};
+
+#endif
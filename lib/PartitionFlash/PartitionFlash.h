@@ -0,0 +1,44 @@
+#ifndef PartitionFlash_h
+#define PartitionFlash_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_partition.h"
+
+/**
+ * A data partition of partitions.csv as raw NOR flash for HistoryLog: addresses are
+ * offsets in the partition, erase() clears the 4 KB sector at an address. Nothing is
+ * cached, the IDF reads and writes through the flash cache.
+ */
+class PartitionFlash {
+public:
+  /**
+   * Finds the data partition by its label. False if the partition table has none.
+   */
+  bool begin(const char* label) {
+    _part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return _part != nullptr;
+  }
+
+  uint32_t size() const {
+    return _part ? _part->size : 0;
+  }
+
+  bool read(const uint32_t addr, void* out, const size_t len) {
+    return _part && esp_partition_read(_part, addr, out, len) == ESP_OK;
+  }
+
+  bool write(const uint32_t addr, const void* data, const size_t len) {
+    return _part && esp_partition_write(_part, addr, data, len) == ESP_OK;
+  }
+
+  bool erase(const uint32_t addr) {
+    return _part && esp_partition_erase_range(_part, addr - addr % SECTOR_SIZE, SECTOR_SIZE) == ESP_OK;
+  }
+
+private:
+  static const uint32_t SECTOR_SIZE = 4096;
+  const esp_partition_t* _part = nullptr;
+};
+
+#endif
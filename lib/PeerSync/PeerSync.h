@@ -0,0 +1,473 @@
+#ifndef PeerSync_h
+#define PeerSync_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "ClimateControl.h"
+
+/**
+ * Coordination of several window units in one room.
+ *
+ * Units wake in the same slots (a slot is one check period on a shared clock) and on every
+ * wake exchange one batched packet: own filtered reading and window state, plus the
+ * actuation plan when the unit is the leader. The leader is the lowest id heard within
+ * PEER_TTL_SLOTS, so there are no election messages; everybody computes the same result.
+ *
+ * The leader runs climateRequest() on the median of the room readings, so one noisy DHT
+ * does not flip the room, and turns a request into a plan: at most PEER_STAGE_SIZE units
+ * which still need the move, each acting PEER_STAGGER_SLOTS after the previous one.
+ * A new plan waits PEER_SETTLE_SLOTS after the last one finished (the room needs time to
+ * react), a reversal waits PEER_MIN_REVERSE_SLOTS. Without peers a unit decides alone,
+ * exactly as without PeerSync.
+ *
+ * Declare the object RTC_DATA_ATTR, it keeps the peer table, the plan and the clock
+ * offset through deep sleep. The transport is a template parameter with:
+ *   bool begin()
+ *   bool send(const uint8_t* data, size_t len)                  - to all peers (broadcast)
+ *   size_t receive(uint8_t* buf, size_t cap, uint16_t timeoutMs) - one packet, 0 on timeout
+ *   void end()
+ * Times are passed in (ms on the unit clock), so the same code runs in the host simulator
+ * (tools/peersim).
+ *
+ * Packet (little endian):
+ *   'P', version, id:u32, seq:u16, time:u32 (shared clock ms), count:u8
+ *   count x message:
+ *     PEER_MSG_STATE: temp x10:i16, window:u8 (bit 0 opened, bit 1 partially), flags:u8, executed plan:u16
+ *     PEER_MSG_PLAN:  seq:u16, request:u8, start slot:u32, stagger slots:u8, n:u8, n x id:u32
+ */
+
+#ifndef PEER_MAX
+#define PEER_MAX 8
+#endif
+
+#ifndef PEER_TTL_SLOTS
+#define PEER_TTL_SLOTS 5 // a peer not heard for this many slots is gone
+#endif
+
+#ifndef PEER_LISTEN_MS
+#define PEER_LISTEN_MS 60 // radio listen window after the own packet, covers the clock drift
+#endif
+
+#ifndef PEER_STAGE_SIZE
+#define PEER_STAGE_SIZE 1 // units moved by one plan
+#endif
+
+#ifndef PEER_STAGGER_SLOTS
+#define PEER_STAGGER_SLOTS 1
+#endif
+
+#ifndef PEER_SETTLE_SLOTS
+#define PEER_SETTLE_SLOTS 10 // after a plan, before the next one in the same direction
+#endif
+
+#ifndef PEER_MIN_REVERSE_SLOTS
+#define PEER_MIN_REVERSE_SLOTS 30 // between plans of opposite direction
+#endif
+
+#define PEER_MAGIC 'P'
+#define PEER_VERSION 1
+#define PEER_HEADER_SIZE 13
+#define PEER_STATE_SIZE 7
+#define PEER_PLAN_SIZE (10 + 4 * PEER_MAX)
+#define PEER_PACKET_MAX (PEER_HEADER_SIZE + PEER_STATE_SIZE + PEER_PLAN_SIZE)
+
+#define PEER_MSG_STATE 1
+#define PEER_MSG_PLAN 2
+
+#define PEER_FLAG_READY 1
+#define PEER_FLAG_FORCE_STOP 2
+
+#define PEER_WND_OPENED 1
+#define PEER_WND_PARTIAL 2
+
+struct PeerState {
+  uint32_t id;
+  uint32_t lastSlot;
+  int16_t tempX10;
+  uint8_t window;
+  uint8_t flags;
+  uint16_t executedPlan;
+};
+
+struct PeerPlan {
+  uint32_t leader;
+  uint32_t startSlot;
+  uint16_t seq;
+  uint8_t request;  // ClimateRequest
+  uint8_t stagger;
+  uint8_t count;
+  uint32_t ids[PEER_MAX];
+};
+
+struct PeerStats {
+  uint32_t sent;
+  uint32_t received;
+  uint32_t rejected;  // bad or foreign packets
+  uint32_t plans;     // plans made as the leader
+  uint32_t actions;   // plan steps executed by this unit
+  uint16_t lastBytes; // sent + received in the last exchange
+};
+
+class PeerSync {
+public:
+  PeerState self = {};
+  PeerState peers[PEER_MAX - 1] = {};
+  uint8_t peersCount = 0;
+  PeerPlan plan = {};
+  int32_t clockOffsetMs = 0; // shared clock - unit clock
+  uint16_t seq = 0;
+  PeerStats stats = {};
+
+  void begin(const uint32_t id) {
+    if (self.id != id) {
+      self = {};
+      self.id = id;
+      peersCount = 0;
+      plan = {};
+    }
+  }
+
+  /**
+   * Own reading for the next packet; window uses PEER_WND_* bits.
+   */
+  void setLocal(const bool isReady, const float temp, const uint8_t window, const bool isForceStopped) {
+    self.tempX10 = (int16_t)(temp * 10 + (temp < 0 ? -0.5f : 0.5f));
+    self.window = window;
+    self.flags = (isReady ? PEER_FLAG_READY : 0) | (isForceStopped ? PEER_FLAG_FORCE_STOP : 0);
+  }
+
+  uint32_t sharedMs(const uint32_t nowMs) const {
+    return nowMs + clockOffsetMs;
+  }
+
+  uint32_t slot(const uint32_t nowMs, const uint32_t periodMs) const {
+    return sharedMs(nowMs) / periodMs;
+  }
+
+  /**
+   * Time to sleep to wake at the start of the next slot, together with the peers.
+   */
+  uint32_t msToNextSlot(const uint32_t nowMs, const uint32_t periodMs) const {
+    return periodMs - sharedMs(nowMs) % periodMs;
+  }
+
+  /**
+   * One radio session: own packet out, peers' packets in. Returns false if the link failed.
+   */
+  template< typename TTransport >
+  bool exchange(TTransport& transport, const uint32_t nowMs, const uint32_t periodMs) {
+    stats.lastBytes = 0;
+    bool ok = transport.begin() && publish(transport, nowMs);
+    if (ok) {
+      collect(transport, nowMs, periodMs);
+    }
+    transport.end();
+    return ok;
+  }
+
+  template< typename TTransport >
+  bool publish(TTransport& transport, const uint32_t nowMs) {
+    uint8_t packet[PEER_PACKET_MAX];
+    size_t len = encode(packet, sizeof(packet), nowMs);
+    if (!transport.send(packet, len)) {
+      return false;
+    }
+    seq++;
+    stats.sent++;
+    stats.lastBytes += len;
+    return true;
+  }
+
+  /**
+   * Receives until the listen window passes without a packet.
+   */
+  template< typename TTransport >
+  void collect(TTransport& transport, const uint32_t nowMs, const uint32_t periodMs) {
+    uint8_t packet[PEER_PACKET_MAX];
+    for (uint8_t i = 0; i < 2 * PEER_MAX; i++) {
+      size_t len = transport.receive(packet, sizeof(packet), PEER_LISTEN_MS);
+      if (!len) {
+        break;
+      }
+      stats.lastBytes += len;
+      decode(packet, len, nowMs, periodMs);
+    }
+  }
+
+  size_t encode(uint8_t* out, const size_t cap, const uint32_t nowMs) const {
+    bool hasPlan = isLeader() && plan.leader == self.id && plan.count;
+    if (cap < (size_t)(PEER_HEADER_SIZE + PEER_STATE_SIZE + (hasPlan ? 10 + 4 * plan.count : 0))) {
+      return 0;
+    }
+
+    uint8_t* p = out;
+    *p++ = PEER_MAGIC;
+    *p++ = PEER_VERSION;
+    p = putU32(p, self.id);
+    p = putU16(p, seq);
+    p = putU32(p, sharedMs(nowMs));
+    *p++ = hasPlan ? 2 : 1;
+
+    *p++ = PEER_MSG_STATE;
+    p = putU16(p, (uint16_t)self.tempX10);
+    *p++ = self.window;
+    *p++ = self.flags;
+    p = putU16(p, self.executedPlan);
+
+    if (hasPlan) {
+      *p++ = PEER_MSG_PLAN;
+      p = putU16(p, plan.seq);
+      *p++ = plan.request;
+      p = putU32(p, plan.startSlot);
+      *p++ = plan.stagger;
+      *p++ = plan.count;
+      for (uint8_t i = 0; i < plan.count; i++) {
+        p = putU32(p, plan.ids[i]);
+      }
+    }
+    return p - out;
+  }
+
+  bool decode(const uint8_t* data, const size_t len, const uint32_t nowMs, const uint32_t periodMs) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    if (len < PEER_HEADER_SIZE || p[0] != PEER_MAGIC || p[1] != PEER_VERSION) {
+      stats.rejected++;
+      return false;
+    }
+    p += 2;
+    uint32_t id = getU32(p);
+    p += 6; // id, seq is for captures
+    uint32_t time = getU32(p);
+    p += 4;
+    uint8_t count = *p++;
+    if (id == self.id) {
+      return false; // own broadcast
+    }
+
+    // the leader's clock is the shared clock
+    if (id <= leaderId()) {
+      clockOffsetMs = (int32_t)(time - nowMs);
+    }
+
+    uint32_t now = slot(nowMs, periodMs);
+    for (uint8_t m = 0; m < count && p < end; m++) {
+      uint8_t type = *p++;
+      if (type == PEER_MSG_STATE && p + PEER_STATE_SIZE - 1 <= end) {
+        PeerState* peer = findPeer(id, true);
+        if (peer) {
+          peer->tempX10 = (int16_t)getU16(p);
+          peer->window = p[2];
+          peer->flags = p[3];
+          peer->executedPlan = getU16(p + 4);
+          peer->lastSlot = now;
+        }
+        p += PEER_STATE_SIZE - 1;
+      } else if (type == PEER_MSG_PLAN && p + 9 <= end) {
+        uint8_t n = p[8];
+        if (n > PEER_MAX || p + 9 + 4 * n > end) {
+          break;
+        }
+        // the plan of the lowest id in the room wins
+        if (id <= leaderId() && (plan.leader != id || plan.seq != getU16(p))) {
+          plan.leader = id;
+          plan.seq = getU16(p);
+          plan.request = p[2];
+          plan.startSlot = getU32(p + 3);
+          plan.stagger = p[7];
+          plan.count = n;
+          for (uint8_t i = 0; i < n; i++) {
+            plan.ids[i] = getU32(p + 9 + 4 * i);
+          }
+        }
+        p += 9 + 4 * n;
+      } else {
+        break;
+      }
+    }
+
+    stats.received++;
+    return true;
+  }
+
+  /**
+   * Drops peers not heard for PEER_TTL_SLOTS, call once per slot before decide().
+   */
+  void expire(const uint32_t nowMs, const uint32_t periodMs) {
+    uint32_t now = slot(nowMs, periodMs);
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < peersCount; i++) {
+      if (now - peers[i].lastSlot <= PEER_TTL_SLOTS) {
+        peers[kept++] = peers[i];
+      }
+    }
+    peersCount = kept;
+  }
+
+  uint32_t leaderId() const {
+    uint32_t id = self.id;
+    for (uint8_t i = 0; i < peersCount; i++) {
+      if (peers[i].id < id) id = peers[i].id;
+    }
+    return id;
+  }
+
+  bool isLeader() const {
+    return leaderId() == self.id;
+  }
+
+  /**
+   * Median of the ready readings in the room, self included.
+   */
+  bool roomTemp(float& temp) const {
+    int16_t vals[PEER_MAX];
+    uint8_t n = 0;
+    if (self.flags & PEER_FLAG_READY) vals[n++] = self.tempX10;
+    for (uint8_t i = 0; i < peersCount; i++) {
+      if (peers[i].flags & PEER_FLAG_READY) vals[n++] = peers[i].tempX10;
+    }
+    if (!n) {
+      return false;
+    }
+
+    for (uint8_t i = 1; i < n; i++) {
+      for (uint8_t j = i; j > 0 && vals[j - 1] > vals[j]; j--) {
+        int16_t t = vals[j]; vals[j] = vals[j - 1]; vals[j - 1] = t;
+      }
+    }
+    temp = (n & 1 ? vals[n / 2] : (vals[n / 2 - 1] + vals[n / 2]) / 2.0f) / 10.0f;
+    return true;
+  }
+
+  /**
+   * What this unit should do in the current slot.
+   * Alone: the own reading decides. With peers: the leader plans, everybody follows the plan.
+   */
+  ClimateRequest decide(const float lowTemp, const float highTemp, const uint32_t nowMs, const uint32_t periodMs) {
+    bool isReady = self.flags & PEER_FLAG_READY;
+    bool isForceStopped = self.flags & PEER_FLAG_FORCE_STOP;
+    if (!peersCount) {
+      return climateRequest(isReady, self.tempX10 / 10.0f, lowTemp, highTemp, isForceStopped);
+    }
+
+    uint32_t now = slot(nowMs, periodMs);
+    if (isLeader()) {
+      makePlan(lowTemp, highTemp, now);
+    }
+
+    bool isExecuted = plan.leader == _executedLeader && plan.seq == self.executedPlan;
+    if (isForceStopped || plan.leader != leaderId() || isExecuted || plan.request == CLIMATE_KEEP) {
+      return CLIMATE_KEEP;
+    }
+
+    for (uint8_t i = 0; i < plan.count; i++) {
+      if (plan.ids[i] != self.id) continue;
+
+      uint32_t at = plan.startSlot + i * plan.stagger;
+      if (now < at) return CLIMATE_KEEP;
+      self.executedPlan = plan.seq;
+      _executedLeader = plan.leader;
+      if (now > at + PEER_TTL_SLOTS) return CLIMATE_KEEP; // stale, the room moved on
+      stats.actions++;
+      return (ClimateRequest)plan.request;
+    }
+    return CLIMATE_KEEP;
+  }
+
+private:
+  uint32_t _executedLeader = 0;
+
+  PeerState* findPeer(const uint32_t id, const bool add) {
+    for (uint8_t i = 0; i < peersCount; i++) {
+      if (peers[i].id == id) return &peers[i];
+    }
+    if (!add || peersCount == PEER_MAX - 1) {
+      return nullptr;
+    }
+    peers[peersCount] = {};
+    peers[peersCount].id = id;
+    return &peers[peersCount++];
+  }
+
+  static bool needsMove(const PeerState& unit, const uint8_t request) {
+    if (!(unit.flags & PEER_FLAG_READY) || (unit.flags & PEER_FLAG_FORCE_STOP)) {
+      return false;
+    }
+    bool isFull = unit.window & PEER_WND_OPENED;
+    bool isPartial = unit.window & PEER_WND_PARTIAL;
+    return request == CLIMATE_OPEN ? climateNeedsOpen(isFull, isPartial) : climateNeedsClose(isFull, isPartial);
+  }
+
+  void makePlan(const float lowTemp, const float highTemp, const uint32_t now) {
+    float temp;
+    if (!roomTemp(temp)) {
+      return;
+    }
+    ClimateRequest request = climateRequest(true, temp, lowTemp, highTemp, false);
+    if (request == CLIMATE_KEEP) {
+      return;
+    }
+
+    if (plan.leader == self.id && plan.count) {
+      uint32_t done = plan.startSlot + (plan.count - 1) * plan.stagger;
+      uint32_t wait = request == plan.request ? PEER_SETTLE_SLOTS : PEER_MIN_REVERSE_SLOTS;
+      if (now < done + wait) {
+        return;
+      }
+    }
+
+    // units which still need the move, rotated by the plan number to share the wear
+    uint32_t ids[PEER_MAX];
+    uint8_t n = 0;
+    if (needsMove(self, request)) ids[n++] = self.id;
+    for (uint8_t i = 0; i < peersCount; i++) {
+      if (needsMove(peers[i], request)) ids[n++] = peers[i].id;
+    }
+    if (!n) {
+      return;
+    }
+    sortIds(ids, n);
+
+    uint16_t planSeq = plan.leader == self.id ? plan.seq + 1 : 1;
+    plan.leader = self.id;
+    plan.seq = planSeq ? planSeq : 1;
+    plan.request = request;
+    plan.startSlot = now;
+    plan.stagger = PEER_STAGGER_SLOTS;
+    plan.count = n < PEER_STAGE_SIZE ? n : PEER_STAGE_SIZE;
+    for (uint8_t i = 0; i < plan.count; i++) {
+      plan.ids[i] = ids[(plan.seq + i) % n];
+    }
+    stats.plans++;
+  }
+
+  static void sortIds(uint32_t* ids, const uint8_t n) {
+    for (uint8_t i = 1; i < n; i++) {
+      for (uint8_t j = i; j > 0 && ids[j - 1] > ids[j]; j--) {
+        uint32_t t = ids[j]; ids[j] = ids[j - 1]; ids[j - 1] = t;
+      }
+    }
+  }
+
+  static uint8_t* putU16(uint8_t* p, const uint16_t v) {
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+    return p;
+  }
+
+  static uint8_t* putU32(uint8_t* p, const uint32_t v) {
+    p = putU16(p, v & 0xFFFF);
+    return putU16(p, v >> 16);
+  }
+
+  static uint16_t getU16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+  }
+
+  static uint32_t getU32(const uint8_t* p) {
+    return getU16(p) | (uint32_t)getU16(p + 2) << 16;
+  }
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef PowerPolicy_h
+#define PowerPolicy_h
+
+#include <stdint.h>
+#include "DisplayPower.h"
+
+/**
+ * Operating profile from the supply and the charge state.
+ *
+ *   POWER_EXTERNAL  12 V supply: no deep sleep and no light sleep, the unit answers at once
+ *                   and the sensor period runs on the awake loop; animations on
+ *   POWER_BATTERY   the unit as it always was
+ *   POWER_LOW       low battery: longer check period, no animations, a dimmed panel and
+ *                   automatic actuations put off while the temperature is close to the band
+ *
+ * Switching is hysteretic twice over: the thresholds to enter and to leave a profile are
+ * apart (the supply by POWER_SUPPLY_HYST_MV above a full battery, the charge by
+ * POWER_LOW_ENTER_PERCENT / POWER_LOW_EXIT_PERCENT), and a new profile has to be seen
+ * in POWER_CONFIRM_READS battery reads in a row, so a sag under load does not flip it.
+ *
+ * Runtime projection: the battery charge over the average current of a profile's timer
+ * wake cycle, from the measured awake current and awake time of the timer wakes (slow
+ * averages kept through deep sleep) and the deep sleep current:
+ *   I = (Iawake * awake + Isleep * (period * scale - awake)) / (period * scale)
+ * POWER_EXTERNAL has no deep sleep, I = Iawake: how long the battery would last in it.
+ * Button sessions are not included, the projection is the unattended runtime.
+ *
+ * Declare the object RTC_DATA_ATTR, the profile and the averages go on after a wake.
+ */
+
+#ifndef POWER_SUPPLY_HYST_MV
+#define POWER_SUPPLY_HYST_MV 200 // external supply above full battery + this, back below full battery
+#endif
+
+#ifndef POWER_LOW_ENTER_PERCENT
+#define POWER_LOW_ENTER_PERCENT 20
+#endif
+
+#ifndef POWER_LOW_EXIT_PERCENT
+#define POWER_LOW_EXIT_PERCENT 30
+#endif
+
+#ifndef POWER_CONFIRM_READS
+#define POWER_CONFIRM_READS 3
+#endif
+
+#ifndef POWER_LOW_PERIOD_SCALE
+#define POWER_LOW_PERIOD_SCALE 3
+#endif
+
+#ifndef POWER_LOW_CONTRAST
+#define POWER_LOW_CONTRAST 0x30
+#endif
+
+#ifndef POWER_URGENT_DECI
+#define POWER_URGENT_DECI 15 // a low battery actuation goes at once this far outside the band, 0.1 C
+#endif
+
+#ifndef POWER_DEFER_MAX
+#define POWER_DEFER_MAX 5 // checks an actuation is put off at most
+#endif
+
+#ifndef POWER_SLEEP_MA
+#define POWER_SLEEP_MA 0.5 // deep sleep, the INA219 and the regulator included
+#endif
+
+#define POWER_AVG_WEIGHT 8 // samples of the slow averages
+
+enum PowerProfile : uint8_t {
+  POWER_EXTERNAL = 0,
+  POWER_BATTERY,
+  POWER_LOW,
+  POWER_PROFILES_COUNT
+};
+
+struct PowerProfileParams {
+  const char* name;
+  const char* mark;    // main screen indicator, next to the battery
+  uint8_t periodScale; // check period multiplier
+  bool isDeepSleep;    // between the checks, else the loop stays awake
+  bool isAnimated;     // motion arrow and menu page slides
+  uint8_t contrast;    // full panel contrast
+  bool isDeferring;    // automatic actuations wait while not urgent
+};
+
+class PowerPolicy {
+public:
+  PowerProfile profile = POWER_BATTERY;
+  uint16_t switches = 0;
+  uint16_t deferred = 0;     // actuations put off, all together
+  uint8_t deferrals = 0;     // the pending one, checks in a row
+  uint8_t batteryPercent = 100; // last charge read on the battery (the 12 V range tells nothing about it)
+  float awakeMa = 22;        // timer wake average current
+  float awakeMs = 1500;      // timer wake length
+
+  static const PowerProfileParams& paramsOf(const PowerProfile p) {
+    static const PowerProfileParams PARAMS[POWER_PROFILES_COUNT] = {
+      { "external", "~", 1, false, true, DISPLAY_CONTRAST_FULL, false },
+      { "battery", "", 1, true, true, DISPLAY_CONTRAST_FULL, false },
+      { "low", "!", POWER_LOW_PERIOD_SCALE, true, false, POWER_LOW_CONTRAST, true },
+    };
+    return PARAMS[p < POWER_PROFILES_COUNT ? p : POWER_BATTERY];
+  }
+
+  const PowerProfileParams& params() const {
+    return paramsOf(profile);
+  }
+
+  /**
+   * A battery read: supply voltage, charge percent of the range it is in and the voltage
+   * of a full battery. True if the profile changed, previous() is the one before.
+   */
+  bool update(const uint16_t mv, const uint8_t percent, const uint16_t fullMv) {
+    PowerProfile target = targetOf(mv, percent, fullMv);
+    if (target != POWER_EXTERNAL) {
+      batteryPercent = percent;
+    }
+
+    if (target == profile) {
+      _confirmations = 0;
+      return false;
+    }
+    if (target != _pending) {
+      _pending = target;
+      _confirmations = 0;
+    }
+    if (++_confirmations < POWER_CONFIRM_READS) {
+      return false;
+    }
+
+    _previous = profile;
+    profile = target;
+    _confirmations = 0;
+    deferrals = 0;
+    switches++;
+    return true;
+  }
+
+  PowerProfile previous() const {
+    return _previous;
+  }
+
+  /**
+   * An automatic actuation is due, excessDeci outside the band. True if it should wait
+   * for a later check; never more than POWER_DEFER_MAX checks in a row.
+   */
+  bool defer(const int16_t excessDeci) {
+    if (!params().isDeferring || excessDeci >= POWER_URGENT_DECI || deferrals >= POWER_DEFER_MAX) {
+      deferrals = 0;
+      return false;
+    }
+    deferrals++;
+    deferred++;
+    return true;
+  }
+
+  /**
+   * Nothing due at a check: a put off actuation is not wanted any more.
+   */
+  void settle() {
+    deferrals = 0;
+  }
+
+  /**
+   * Current read while awake on a timer wake, mA.
+   */
+  void observeCurrent(const float ma) {
+    if (ma > 0) {
+      awakeMa += (ma - awakeMa) / POWER_AVG_WEIGHT;
+    }
+  }
+
+  /**
+   * A timer wake going to deep sleep after ms.
+   */
+  void observeWake(const uint32_t ms) {
+    awakeMs += ((float)ms - awakeMs) / POWER_AVG_WEIGHT;
+  }
+
+  /**
+   * Average current of a profile's unattended cycle with the check period, mA.
+   */
+  float averageMa(const PowerProfile p, const uint32_t periodS) const {
+    const PowerProfileParams& pp = paramsOf(p);
+    float cycleMs = (float)periodS * pp.periodScale * 1000;
+    if (!pp.isDeepSleep || cycleMs <= awakeMs) {
+      return awakeMa;
+    }
+    return (awakeMa * awakeMs + POWER_SLEEP_MA * (cycleMs - awakeMs)) / cycleMs;
+  }
+
+  /**
+   * Hours left on the battery in a profile, capacityMah for a full one.
+   */
+  float runtimeHours(const PowerProfile p, const uint32_t periodS, const uint16_t capacityMah) const {
+    return (float)capacityMah * batteryPercent / 100 / averageMa(p, periodS);
+  }
+
+private:
+  PowerProfile _pending = POWER_BATTERY;
+  PowerProfile _previous = POWER_BATTERY;
+  uint8_t _confirmations = 0;
+
+  PowerProfile targetOf(const uint16_t mv, const uint8_t percent, const uint16_t fullMv) const {
+    bool isExternal = profile == POWER_EXTERNAL ? mv >= fullMv : mv > fullMv + POWER_SUPPLY_HYST_MV;
+    if (isExternal) {
+      return POWER_EXTERNAL;
+    }
+    // coming off the supply the range changes, the charge decides afresh
+    bool isLow = profile == POWER_LOW ? percent < POWER_LOW_EXIT_PERCENT : percent < POWER_LOW_ENTER_PERCENT;
+    return isLow ? POWER_LOW : POWER_BATTERY;
+  }
+};
+
+#endif
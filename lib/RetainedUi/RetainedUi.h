@@ -0,0 +1,170 @@
+#ifndef RetainedUi_h
+#define RetainedUi_h
+
+#include <Arduino.h>
+
+/**
+ * Retained mode screen: widgets own a rectangle and their last rendered value,
+ * render() repaints only the widgets whose value changed and returns the changed
+ * region, so the caller can flush just that part of the framebuffer.
+ * A widget overlapping a repainted one (later in z-order) is repainted too.
+ */
+
+#ifndef UI_TEXT_MAX
+#define UI_TEXT_MAX 32 // bytes, a Cyrillic letter takes 2 in UTF-8
+#endif
+
+struct UiRect {
+  int16_t x = 0;
+  int16_t y = 0;
+  int16_t w = 0;
+  int16_t h = 0;
+
+  bool isEmpty() const {
+    return w <= 0 || h <= 0;
+  }
+
+  bool intersects(const UiRect& r) const {
+    return !isEmpty() && !r.isEmpty() && x < r.x + r.w && r.x < x + w && y < r.y + r.h && r.y < y + h;
+  }
+
+  void join(const UiRect& r) {
+    if (r.isEmpty()) {
+      return;
+    }
+
+    if (isEmpty()) {
+      *this = r;
+      return;
+    }
+
+    int16_t x1 = x + w > r.x + r.w ? x + w : r.x + r.w;
+    int16_t y1 = y + h > r.y + r.h ? y + h : r.y + r.h;
+    if (r.x < x) x = r.x;
+    if (r.y < y) y = r.y;
+    w = x1 - x;
+    h = y1 - y;
+  }
+};
+
+template< typename TGfx >
+class UiWidget {
+public:
+  UiRect rect;
+  boolean dirty = true;
+
+  virtual ~UiWidget() {}
+
+  /**
+   * Paints the whole rect (background included).
+   */
+  virtual void draw(TGfx& gfx) = 0;
+};
+
+/**
+ * Single line of text in a box fitting maxChars characters of the classic 6x8 font.
+ */
+template< typename TGfx >
+class UiText : public UiWidget<TGfx> {
+public:
+  UiText(const int16_t x, const int16_t y, const uint8_t maxChars, const uint8_t textSize = 1): _size(textSize) {
+    this->rect.x = x;
+    this->rect.y = y;
+    this->rect.w = maxChars * 6 * textSize - textSize; // no spacing column after the last char
+    this->rect.h = 8 * textSize;
+  }
+
+  /**
+   * Returns true if the text changed.
+   */
+  bool set(const char* text) {
+    if (strncmp(text, _text, UI_TEXT_MAX - 1) == 0) {
+      return false;
+    }
+
+    strncpy(_text, text, UI_TEXT_MAX - 1);
+    _text[UI_TEXT_MAX - 1] = '\0';
+    this->dirty = true;
+    return true;
+  }
+
+  const char* text() const {
+    return _text;
+  }
+
+  void draw(TGfx& gfx) override {
+    gfx.fillRect(this->rect.x, this->rect.y, this->rect.w, this->rect.h, BLACK);
+    gfx.setTextSize(_size);
+    gfx.setTextColor(WHITE);
+    gfx.setCursor(this->rect.x, this->rect.y);
+    gfx.print(_text);
+  }
+
+private:
+  uint8_t _size;
+  char _text[UI_TEXT_MAX] = "";
+};
+
+template< uint8_t _SIZE, typename TGfx >
+class UiScreen {
+public:
+  uint16_t drawCalls = 0;     // widgets repainted by the last render()
+  uint32_t pixelsTouched = 0; // pixels of the repainted rects
+
+  void add(UiWidget<TGfx>* widget) {
+    if (_count < _SIZE) {
+      _widgets[_count++] = widget;
+    }
+  }
+
+  /**
+   * Next render() clears the screen and paints every widget (something else drew over them).
+   */
+  void invalidate() {
+    _isFull = true;
+  }
+
+  UiRect render(TGfx& gfx) {
+    UiRect changed;
+    drawCalls = 0;
+    pixelsTouched = 0;
+
+    if (_isFull) {
+      gfx.fillScreen(BLACK);
+      changed = { 0, 0, gfx.width(), gfx.height() };
+      for (uint8_t i = 0; i < _count; i++) {
+        _widgets[i]->dirty = true;
+      }
+      _isFull = false;
+    }
+
+    // repaint whatever overlaps a dirty widget below it
+    for (uint8_t i = 0; i < _count; i++) {
+      for (uint8_t j = 0; j < i && !_widgets[i]->dirty; j++) {
+        if (_widgets[j]->dirty && _widgets[j]->rect.intersects(_widgets[i]->rect)) {
+          _widgets[i]->dirty = true;
+        }
+      }
+    }
+
+    for (uint8_t i = 0; i < _count; i++) {
+      UiWidget<TGfx>* w = _widgets[i];
+      if (!w->dirty) continue;
+
+      w->draw(gfx);
+      w->dirty = false;
+      drawCalls++;
+      pixelsTouched += (uint32_t)w->rect.w * w->rect.h;
+      changed.join(w->rect);
+    }
+
+    return changed;
+  }
+
+private:
+  UiWidget<TGfx>* _widgets[_SIZE];
+  uint8_t _count = 0;
+  boolean _isFull = true;
+};
+
+#endif
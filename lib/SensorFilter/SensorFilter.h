@@ -0,0 +1,212 @@
+#ifndef SensorFilter_h
+#define SensorFilter_h
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * Fixed-memory filter stages for slow sensor streams (DHT11 and friends).
+ *
+ * Every stage keeps its state in plain members with constant initializers, so a
+ * whole pipeline can be declared RTC_DATA_ATTR and keeps its history through deep sleep.
+ * Stage parameters are integers (x10 or percent) because float template arguments
+ * are not allowed in C++17.
+ *
+ * A stage implements:
+ *   bool push(float& val) - filter val in place, false if the sample was swallowed
+ *   void reset()
+ */
+
+#ifndef FILTER_MEDIAN_MAX
+#define FILTER_MEDIAN_MAX 9
+#endif
+
+/**
+ * Rejects a sample which jumps more than _MAX_DELTA_X10 / 10 away from the last accepted one.
+ * After _ACCEPT_AFTER rejections in a row the jump is taken as a real step.
+ */
+template< uint16_t _MAX_DELTA_X10, uint8_t _ACCEPT_AFTER = 3 >
+class OutlierFilter {
+public:
+  float last = 0;
+  uint8_t rejected = 0;
+  bool primed = false;
+
+  bool push(float& val) {
+    if (primed && fabsf(val - last) * 10 > _MAX_DELTA_X10) {
+      if (++rejected < _ACCEPT_AFTER) {
+        return false;
+      }
+    }
+
+    rejected = 0;
+    primed = true;
+    last = val;
+    return true;
+  }
+
+  void reset() {
+    rejected = 0;
+    primed = false;
+  }
+};
+
+/**
+ * Median of the last _N samples (median of what is collected until the window fills up).
+ */
+template< uint8_t _N >
+class MedianFilter {
+  static_assert(_N > 0 && _N <= FILTER_MEDIAN_MAX, "median window is out of range");
+
+public:
+  float buf[_N] = {};
+  uint8_t count = 0;
+  uint8_t pos = 0;
+
+  bool push(float& val) {
+    buf[pos] = val;
+    pos = (pos + 1) % _N;
+    if (count < _N) count++;
+
+    float sorted[_N];
+    for (uint8_t i = 0; i < count; i++) {
+      float v = buf[i];
+      int8_t j = i - 1;
+      while (j >= 0 && sorted[j] > v) {
+        sorted[j + 1] = sorted[j];
+        j--;
+      }
+      sorted[j + 1] = v;
+    }
+
+    val = (count & 1) ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    return true;
+  }
+
+  void reset() {
+    count = 0;
+    pos = 0;
+  }
+};
+
+/**
+ * Exponential moving average, new = old + alpha * (val - old), alpha = _ALPHA_PCT / 100.
+ */
+template< uint8_t _ALPHA_PCT >
+class EmaFilter {
+  static_assert(_ALPHA_PCT > 0 && _ALPHA_PCT <= 100, "alpha must be 1..100 %");
+
+public:
+  float value = 0;
+  bool primed = false;
+
+  bool push(float& val) {
+    if (primed) {
+      value += (val - value) * _ALPHA_PCT / 100;
+    } else {
+      value = val;
+      primed = true;
+    }
+
+    val = value;
+    return true;
+  }
+
+  void reset() {
+    primed = false;
+  }
+};
+
+/**
+ * Limits the change between two outputs to _MAX_STEP_X10 / 10 per sample.
+ */
+template< uint16_t _MAX_STEP_X10 >
+class SlewLimiter {
+public:
+  float last = 0;
+  bool primed = false;
+
+  bool push(float& val) {
+    if (primed) {
+      const float step = (float)_MAX_STEP_X10 / 10;
+      if (val > last + step) val = last + step;
+      else if (val < last - step) val = last - step;
+    }
+
+    primed = true;
+    last = val;
+    return true;
+  }
+
+  void reset() {
+    primed = false;
+  }
+};
+
+// =================================================================================================================================
+
+template< typename... TStages >
+class FilterChain;
+
+template<>
+class FilterChain<> {
+public:
+  bool push(float&) { return true; }
+  void reset() {}
+};
+
+template< typename THead, typename... TTail >
+class FilterChain<THead, TTail...> {
+public:
+  THead head;
+  FilterChain<TTail...> tail;
+
+  bool push(float& val) {
+    return head.push(val) && tail.push(val);
+  }
+
+  void reset() {
+    head.reset();
+    tail.reset();
+  }
+};
+
+/**
+ * Runs raw samples through the stages in order and keeps the last output.
+ * Invalid (NaN) samples and samples dropped by a stage leave `value` untouched.
+ */
+template< typename... TStages >
+class FilterPipeline {
+public:
+  FilterChain<TStages...> chain;
+  float value = 0;
+  bool ready = false;
+  uint16_t missed = 0;   // invalid samples from the sensor
+  uint16_t rejected = 0; // samples swallowed by a stage
+
+  bool push(const float sample) {
+    if (isnan(sample)) {
+      missed++;
+      return false;
+    }
+
+    float val = sample;
+    if (!chain.push(val)) {
+      rejected++;
+      return false;
+    }
+
+    value = val;
+    ready = true;
+    return true;
+  }
+
+  void reset() {
+    chain.reset();
+    ready = false;
+    missed = 0;
+    rejected = 0;
+  }
+};
+
+#endif
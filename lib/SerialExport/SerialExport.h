@@ -0,0 +1,244 @@
+#ifndef SerialExport_h
+#define SerialExport_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "Crc32.h"
+
+/**
+ * Bulk export of the logged data (trace ring, telemetry queue, metrics, ...) over the
+ * serial port (USB CDC on the C3) in CRC framed binary chunks, tools/export_pull.py writes
+ * them to CSV. No hex text: a 240 byte chunk costs 254 bytes on the wire instead of 480+.
+ *
+ * The host sends text lines, the device answers with frames:
+ *   x list                           one 'L' frame describing the streams
+ *   x get <stream> <offset> [window] 'D' frames from offset on, then 'E' at the end
+ *   x ack <offset>                   everything below offset arrived
+ *   x nak <offset>                   resend from offset (a bad CRC, a lost frame; go-back-N)
+ *   x stop
+ * Frame, little endian:
+ *   0xA5 0x5A, type, stream, offset:u32, len:u16, payload, crc32:u32
+ * The CRC (zlib CRC-32) covers type .. payload. 'L' payload: count:u8, then per stream
+ * recordSize:u8, size:u32, base:u32, nameLen:u8, name. 'E' payload: base:u32. '!' payload:
+ * the reason as text, the get ended.
+ *
+ * Flow control: at most window frames are unacknowledged, and poll() writes a frame only
+ * when the port has room for all of it, so it never blocks the loop. Resume: a new get
+ * continues at any offset; base tells whether it is still the same data. A session ends
+ * EXPORT_IDLE_MS after the last host line, a running get too (the host went away).
+ *
+ * A stream reads its storage in place, read() copies a chunk straight into the frame:
+ *   open(base)                        snapshot, returns the size in bytes; base is the
+ *                                     absolute position of offset 0 (what left the ring before)
+ *                                     or a generation of a dump; not called for a list while
+ *                                     a get of the stream runs
+ *   read(base, offset, out, len)      bytes copied, 0 if they are gone (overwritten meanwhile)
+ */
+
+#ifndef EXPORT_CHUNK
+#define EXPORT_CHUNK 240 // payload per frame, a multiple of the record sizes
+#endif
+
+#ifndef EXPORT_WINDOW
+#define EXPORT_WINDOW 8 // default frames in flight
+#endif
+
+#ifndef EXPORT_IDLE_MS
+#define EXPORT_IDLE_MS 5000 // a session ends this long after the last host line
+#endif
+
+#define EXPORT_SYNC0 0xA5
+#define EXPORT_SYNC1 0x5A
+#define EXPORT_HEADER_SIZE 10
+#define EXPORT_FRAME_MAX (EXPORT_HEADER_SIZE + EXPORT_CHUNK + 4)
+#define EXPORT_STREAM_LIST 0xFF
+
+#define EXPORT_LIST 'L'
+#define EXPORT_DATA 'D'
+#define EXPORT_END 'E'
+#define EXPORT_ERROR '!'
+
+struct ExportStream {
+  const char* name;
+  uint8_t recordSize; // fixed record length, 0: a byte stream (a dump)
+  uint32_t (*open)(uint32_t& base);
+  uint16_t (*read)(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len);
+};
+
+template< typename TPort >
+class SerialExport {
+public:
+  uint32_t frames = 0;
+  uint32_t bytes = 0;   // payload sent
+  uint32_t resends = 0; // naks
+
+  SerialExport(TPort& port, const ExportStream* streams, const uint8_t count)
+    : _port(port), _streams(streams), _count(count) {}
+
+  /**
+   * Takes a host line. False if it is not an export command, someone else may have it.
+   */
+  bool command(const char* line, const uint32_t nowMs) {
+    if (line[0] != 'x' || line[1] != ' ') {
+      return false;
+    }
+    _lastMs = nowMs;
+    const char* p = line + 2;
+    char* end;
+
+    if (!strcmp(p, "list")) {
+      sendList();
+    } else if (!strncmp(p, "get ", 4)) {
+      uint32_t id = strtoul(p + 4, &end, 10);
+      uint32_t offset = strtoul(end, &end, 10);
+      uint32_t window = strtoul(end, &end, 10);
+      begin(id, offset, window ? window : EXPORT_WINDOW);
+    } else if (!strncmp(p, "ack ", 4)) {
+      uint32_t offset = strtoul(p + 4, &end, 10);
+      if (_stream && offset > _acked && offset <= _sent) {
+        _acked = offset;
+      }
+      if (_stream && _acked == _size) {
+        _stream = nullptr; // all there
+      }
+    } else if (!strncmp(p, "nak ", 4)) {
+      uint32_t offset = strtoul(p + 4, &end, 10);
+      if (_stream && offset >= _acked && offset <= _sent) {
+        _acked = offset;
+        _sent = offset;
+        _isEndSent = false;
+        resends++;
+      }
+    } else if (!strcmp(p, "stop")) {
+      _stream = nullptr;
+    }
+    return true;
+  }
+
+  /**
+   * Sends the frames the window and the port have room for, ends a get the host stopped
+   * answering. Call it every loop pass.
+   */
+  void poll(const uint32_t nowMs) {
+    if (!_stream) {
+      return;
+    }
+    if (nowMs - _lastMs >= EXPORT_IDLE_MS) {
+      _stream = nullptr; // nobody left to tell
+      return;
+    }
+
+    while (_sent < _size && _sent - _acked < _window * EXPORT_CHUNK) {
+      uint16_t len = _size - _sent < EXPORT_CHUNK ? _size - _sent : EXPORT_CHUNK;
+      if (_port.availableForWrite() < EXPORT_HEADER_SIZE + len + 4) {
+        return;
+      }
+      uint16_t got = _stream->read(_base, _sent, _frame + EXPORT_HEADER_SIZE, len);
+      if (got == 0) {
+        fail("gone");
+        return;
+      }
+      send(EXPORT_DATA, _sent, got);
+      _sent += got;
+      bytes += got;
+    }
+
+    if (_sent == _size && !_isEndSent && _port.availableForWrite() >= EXPORT_HEADER_SIZE + 4 + 4) {
+      memcpy(_frame + EXPORT_HEADER_SIZE, &_base, 4);
+      send(EXPORT_END, _size, 4);
+      _isEndSent = true;
+    }
+  }
+
+  /**
+   * A host is pulling: a line came within EXPORT_IDLE_MS (a running get gets its acks).
+   * Keep the unit awake and the rings unconsumed meanwhile.
+   */
+  bool isActive(const uint32_t nowMs) const {
+    return _lastMs && nowMs - _lastMs < EXPORT_IDLE_MS;
+  }
+
+private:
+  TPort& _port;
+  const ExportStream* _streams;
+  uint8_t _count;
+  const ExportStream* _stream = nullptr; // the running get
+  uint8_t _id = 0;
+  uint32_t _base = 0;
+  uint32_t _size = 0;
+  uint32_t _sent = 0;
+  uint32_t _acked = 0;
+  uint32_t _window = EXPORT_WINDOW;
+  bool _isEndSent = false;
+  uint32_t _lastMs = 0;
+  uint8_t _frame[EXPORT_FRAME_MAX];
+
+  void begin(const uint32_t id, const uint32_t offset, const uint32_t window) {
+    _stream = nullptr;
+    _id = id;
+    if (id >= _count) {
+      fail("stream");
+      return;
+    }
+    _stream = &_streams[id];
+    _size = _stream->open(_base);
+    _sent = _acked = offset < _size ? offset : _size;
+    _window = window;
+    _isEndSent = false;
+  }
+
+  void sendList() {
+    uint8_t* p = _frame + EXPORT_HEADER_SIZE;
+    uint8_t* end = _frame + EXPORT_HEADER_SIZE + EXPORT_CHUNK;
+    *p++ = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      const ExportStream& s = _streams[i];
+      uint8_t nameLen = strlen(s.name);
+      if (p + 10 + nameLen > end) {
+        break;
+      }
+      uint32_t base = _base;
+      uint32_t size = _size;
+      if (_stream != &s) {
+        size = s.open(base); // the running get keeps its snapshot
+      }
+      *p++ = s.recordSize;
+      memcpy(p, &size, 4);
+      memcpy(p + 4, &base, 4);
+      p[8] = nameLen;
+      memcpy(p + 9, s.name, nameLen);
+      p += 9 + nameLen;
+      _frame[EXPORT_HEADER_SIZE]++;
+    }
+    _id = EXPORT_STREAM_LIST;
+    // the reply to a command, waits for the port like a LOG line does
+    send(EXPORT_LIST, 0, p - (_frame + EXPORT_HEADER_SIZE));
+  }
+
+  void fail(const char* reason) {
+    uint16_t len = strlen(reason);
+    memcpy(_frame + EXPORT_HEADER_SIZE, reason, len);
+    send(EXPORT_ERROR, _sent, len);
+    _stream = nullptr;
+  }
+
+  /**
+   * Frames the payload already in _frame and writes it in one go.
+   */
+  void send(const uint8_t type, const uint32_t offset, const uint16_t len) {
+    _frame[0] = EXPORT_SYNC0;
+    _frame[1] = EXPORT_SYNC1;
+    _frame[2] = type;
+    _frame[3] = _id;
+    memcpy(_frame + 4, &offset, 4);
+    memcpy(_frame + 8, &len, 2);
+    uint32_t crc = crc32Update(0, _frame + 2, EXPORT_HEADER_SIZE - 2 + len);
+    memcpy(_frame + EXPORT_HEADER_SIZE + len, &crc, 4);
+    _port.write(_frame, EXPORT_HEADER_SIZE + len + 4);
+    frames++;
+  }
+};
+
+#endif
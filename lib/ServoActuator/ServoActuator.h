@@ -0,0 +1,99 @@
+#ifndef ServoActuator_h
+#define ServoActuator_h
+
+#include <Arduino.h>
+#include "driver/gpio.h"
+
+#ifndef SERVO_SETTLE_MS
+#define SERVO_SETTLE_MS 150 // neutral pulses after power on and before power off
+#endif
+
+#ifndef SERVO_POWER_ON
+#define SERVO_POWER_ON HIGH // level of the power pin which enables the servo rail
+#endif
+
+/**
+ * Continuous rotation servo with a switched power rail.
+ *
+ * Rail and PWM are on only while the servo moves: run() powers up with neutral
+ * pulses, lets the electronics settle and then drives; stop() goes back to neutral
+ * and settles; powerOff() detaches PWM and cuts the rail. Both pins are driven low
+ * when off and can be latched with holdForSleep() so they stay off in deep sleep.
+ */
+template< typename TServo >
+class ServoActuator {
+public:
+  ServoActuator(TServo* servo, const gpio_num_t pwmPin, const gpio_num_t powerPin, const uint16_t stopUs):
+    _servo(servo), _pwmPin(pwmPin), _powerPin(powerPin), _stopUs(stopUs) {}
+
+  /**
+   * Releases the deep sleep latch and makes sure everything is off.
+   */
+  void begin() {
+    gpio_hold_dis(_pwmPin);
+    gpio_hold_dis(_powerPin);
+
+    pinMode(_powerPin, OUTPUT);
+    pinMode(_pwmPin, OUTPUT);
+    digitalWrite(_powerPin, !SERVO_POWER_ON);
+    digitalWrite(_pwmPin, LOW);
+    _powered = false;
+  }
+
+  void run(const uint16_t us) {
+    if (!_powered) {
+      // neutral pulses first, so the servo does not twitch when the rail comes up
+      _servo->attach(_pwmPin);
+      _servo->writeMicroseconds(_stopUs);
+      digitalWrite(_powerPin, SERVO_POWER_ON);
+      _powered = true;
+      delay(SERVO_SETTLE_MS);
+    }
+
+    _servo->writeMicroseconds(us);
+  }
+
+  void stop() {
+    if (!_powered) {
+      return;
+    }
+
+    _servo->writeMicroseconds(_stopUs);
+    delay(SERVO_SETTLE_MS);
+  }
+
+  void powerOff() {
+    if (!_powered) {
+      return;
+    }
+
+    _servo->detach();
+    digitalWrite(_powerPin, !SERVO_POWER_ON);
+    pinMode(_pwmPin, OUTPUT);
+    digitalWrite(_pwmPin, LOW);
+    _powered = false;
+  }
+
+  bool isPowered() const {
+    return _powered;
+  }
+
+  /**
+   * Latches the off state of both pins through deep sleep.
+   */
+  void holdForSleep() {
+    powerOff();
+    gpio_hold_en(_pwmPin);
+    gpio_hold_en(_powerPin);
+    gpio_deep_sleep_hold_en();
+  }
+
+private:
+  TServo* _servo;
+  gpio_num_t _pwmPin;
+  gpio_num_t _powerPin;
+  uint16_t _stopUs;
+  bool _powered = false;
+};
+
+#endif
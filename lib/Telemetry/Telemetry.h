@@ -0,0 +1,250 @@
+#ifndef Telemetry_h
+#define Telemetry_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Batched telemetry uplink.
+ *
+ * Records are queued in RTC memory (declare the queue RTC_DATA_ATTR) and sent as one
+ * delta/varint compressed packet every N wakes, when the queue is full, or as soon as
+ * possible after a fault. The radio is only brought up for that one packet.
+ * After a failed packet nothing is tried, not for a fault and not with a full queue,
+ * until a backoff of wakes has passed: TELEMETRY_RETRY_WAKES, doubled after every
+ * further failure up to TELEMETRY_RETRY_MAX_WAKES, so a missing gateway does not cost
+ * a radio attempt every wake.
+ *
+ * The transport is a template parameter with:
+ *   bool begin()                              - bring the link up
+ *   bool send(const uint8_t* data, size_t len)
+ *   void end()                                - link (radio) off
+ *
+ * Packet (little endian):
+ *   'T', version, deviceId:u32, seq:u16, now:u32, lastRadioOnMs:u16, count:u8
+ *   count x { type << 4 | code, varint dt, zigzag varint da, db, dc }
+ * dt of the first record is (now - time), then (time - previous time).
+ * a/b/c are delta coded against the previous record of the same type.
+ * tools/telemetry_listen.py decodes it.
+ */
+
+#ifndef TELEMETRY_QUEUE_SIZE
+#define TELEMETRY_QUEUE_SIZE 64
+#endif
+
+#ifndef TELEMETRY_FLUSH_WAKES
+#define TELEMETRY_FLUSH_WAKES 90 // 30 min with the default 20 sec check period
+#endif
+
+#ifndef TELEMETRY_RETRY_WAKES
+#define TELEMETRY_RETRY_WAKES 3 // first retry after a failed packet
+#endif
+
+#ifndef TELEMETRY_RETRY_MAX_WAKES
+#define TELEMETRY_RETRY_MAX_WAKES (8 * TELEMETRY_FLUSH_WAKES)
+#endif
+
+#define TELEMETRY_MAGIC 'T'
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER_SIZE 15
+#define TELEMETRY_RECORD_MAX 16 // 1 + 5 (dt) + 3 * 3 (zigzag int16)
+#define TELEMETRY_TYPES 4
+
+enum TelemetryType {
+  TM_SAMPLE = 0,    // code: window state, a: temp x10, b: humidity x10, c: battery mV
+  TM_ACTUATION = 1, // code: TM_ACT_*, a: temp x10
+  TM_FAULT = 2,     // code: TM_FAULT_*, a: fault specific value; flushed asap
+  TM_EVENT = 3,     // free for diagnostics
+};
+
+#define TM_ACT_OPEN 1
+#define TM_ACT_CLOSE 2
+#define TM_ACT_STOP 3
+#define TM_ACT_MANUAL 4
+
+#define TM_FAULT_MOTION_TIMEOUT 1
+#define TM_FAULT_LOW_BATTERY 2
+#define TM_FAULT_SENSOR 3
+#define TM_FAULT_STALL 4
+
+struct TelemetryRecord {
+  uint32_t time;
+  uint8_t type;
+  uint8_t code;
+  int16_t a;
+  int16_t b;
+  int16_t c;
+};
+
+struct TelemetryStats {
+  uint32_t batches;
+  uint32_t records;       // records delivered
+  uint32_t dropped;       // records overwritten while the queue was full
+  uint32_t failed;        // batches which could not be delivered
+  uint32_t radioOnMs;     // total radio on time of all attempts
+  uint16_t lastRadioOnMs;
+  uint16_t lastBatchSize; // bytes
+};
+
+template< uint16_t _SIZE >
+class TelemetryQueue {
+  static_assert(_SIZE > 0 && _SIZE < 256, "queue size must fit the packet count field");
+
+public:
+  TelemetryRecord records[_SIZE] = {};
+  uint16_t head = 0; // oldest record
+  uint16_t count = 0;
+  uint16_t wakes = 0;
+  uint16_t seq = 0;
+  uint16_t retryWakes = 0; // backoff after a failed packet, 0 if the last one went
+  bool urgent = false;
+  TelemetryStats stats = {};
+
+  void push(const uint32_t time, const uint8_t type, const uint8_t code, const int16_t a = 0, const int16_t b = 0, const int16_t c = 0) {
+    uint16_t idx = (head + count) % _SIZE;
+
+    if (count == _SIZE) {
+      head = (head + 1) % _SIZE;
+      stats.dropped++;
+    } else {
+      count++;
+    }
+
+    records[idx] = { time, type, code, a, b, c };
+
+    if (type == TM_FAULT) {
+      urgent = true;
+    }
+  }
+
+  void onWake() {
+    wakes++;
+  }
+
+  bool isFull() const {
+    return count == _SIZE;
+  }
+
+  bool needFlush(const uint16_t everyWakes = TELEMETRY_FLUSH_WAKES) const {
+    if (count == 0 || wakes < retryWakes) {
+      return false;
+    }
+    return retryWakes || urgent || isFull() || wakes >= everyWakes;
+  }
+
+  /**
+   * Radio on time per delivered record, in microseconds.
+   */
+  uint32_t radioUsPerRecord() const {
+    return stats.records ? (uint32_t)((uint64_t)stats.radioOnMs * 1000 / stats.records) : 0;
+  }
+
+  size_t encode(uint8_t* out, const size_t cap, const uint32_t deviceId, const uint32_t now) const {
+    if (cap < TELEMETRY_HEADER_SIZE + (size_t)count * TELEMETRY_RECORD_MAX) {
+      return 0;
+    }
+
+    uint8_t* p = out;
+    *p++ = TELEMETRY_MAGIC;
+    *p++ = TELEMETRY_VERSION;
+    p = putU32(p, deviceId);
+    p = putU16(p, seq);
+    p = putU32(p, now);
+    p = putU16(p, stats.lastRadioOnMs);
+    *p++ = (uint8_t)count;
+
+    int16_t prev[TELEMETRY_TYPES][3] = {};
+    uint32_t prevTime = now;
+
+    for (uint16_t i = 0; i < count; i++) {
+      const TelemetryRecord& r = records[(head + i) % _SIZE];
+      const uint8_t t = r.type & (TELEMETRY_TYPES - 1);
+
+      *p++ = (uint8_t)(t << 4 | (r.code & 0x0F));
+      p = putVarint(p, i == 0 ? now - r.time : r.time - prevTime);
+      p = putVarint(p, zigzag(r.a - prev[t][0]));
+      p = putVarint(p, zigzag(r.b - prev[t][1]));
+      p = putVarint(p, zigzag(r.c - prev[t][2]));
+
+      prev[t][0] = r.a;
+      prev[t][1] = r.b;
+      prev[t][2] = r.c;
+      prevTime = r.time;
+    }
+
+    return p - out;
+  }
+
+#ifdef ARDUINO
+  /**
+   * Sends the whole queue as one packet. On failure records are kept (a full queue
+   * overwrites the oldest) and retried after the backoff, see needFlush().
+   */
+  template< typename TTransport >
+  bool flush(TTransport& transport, const uint32_t deviceId, const uint32_t now) {
+    if (count == 0) {
+      return true;
+    }
+
+    uint8_t packet[TELEMETRY_HEADER_SIZE + _SIZE * TELEMETRY_RECORD_MAX];
+    size_t len = encode(packet, sizeof(packet), deviceId, now);
+
+    unsigned long start = millis();
+    bool ok = transport.begin() && transport.send(packet, len);
+    transport.end();
+    uint32_t radioMs = millis() - start;
+
+    stats.radioOnMs += radioMs;
+    stats.lastRadioOnMs = radioMs > 0xFFFF ? 0xFFFF : radioMs;
+    stats.lastBatchSize = len;
+    wakes = 0;
+
+    if (!ok) {
+      stats.failed++;
+      retryWakes = retryWakes ? retryWakes * 2 : TELEMETRY_RETRY_WAKES;
+      if (retryWakes > TELEMETRY_RETRY_MAX_WAKES) {
+        retryWakes = TELEMETRY_RETRY_MAX_WAKES;
+      }
+      return false;
+    }
+
+    urgent = false;
+    retryWakes = 0;
+
+    stats.batches++;
+    stats.records += count;
+    seq++;
+    head = 0;
+    count = 0;
+    return true;
+  }
+#endif
+
+private:
+  static uint32_t zigzag(const int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+  }
+
+  static uint8_t* putVarint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+      *p++ = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+  }
+
+  static uint8_t* putU16(uint8_t* p, const uint16_t v) {
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+    return p;
+  }
+
+  static uint8_t* putU32(uint8_t* p, const uint32_t v) {
+    p = putU16(p, v & 0xFFFF);
+    return putU16(p, v >> 16);
+  }
+};
+
+#endif
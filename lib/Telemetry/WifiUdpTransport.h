@@ -0,0 +1,103 @@
+#ifndef WifiUdpTransport_h
+#define WifiUdpTransport_h
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#ifndef TELEMETRY_CONNECT_TIMEOUT
+#define TELEMETRY_CONNECT_TIMEOUT 5000 // ms
+#endif
+
+/**
+ * Telemetry / PeerSync transport over WiFi station + UDP.
+ * The radio is on only between begin() and end(). Channel and BSSID of the last
+ * successful connect are remembered in `Link` (keep it in RTC memory) so the next
+ * connect skips the scan, which is most of the radio on time.
+ * With a localPort the transport also receives (host may be a broadcast address).
+ */
+class WifiUdpTransport {
+public:
+  struct Link {
+    uint8_t bssid[6];
+    int32_t channel;
+    bool valid;
+  };
+
+  WifiUdpTransport(const char* ssid, const char* pass, const char* host, const uint16_t port, Link* link = nullptr,
+                   const uint16_t localPort = 0):
+    _ssid(ssid), _pass(pass), _host(host), _port(port), _link(link), _localPort(localPort) {}
+
+  bool begin() {
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+
+    if (_link != nullptr && _link->valid) {
+      WiFi.begin(_ssid, _pass, _link->channel, _link->bssid);
+    } else {
+      WiFi.begin(_ssid, _pass);
+    }
+
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED) {
+      if (millis() - start > TELEMETRY_CONNECT_TIMEOUT) {
+        // AP could move to another channel, do a full scan next time
+        if (_link != nullptr) _link->valid = false;
+        return false;
+      }
+      delay(5);
+    }
+
+    if (_link != nullptr) {
+      memcpy(_link->bssid, WiFi.BSSID(), sizeof(_link->bssid));
+      _link->channel = WiFi.channel();
+      _link->valid = true;
+    }
+
+    if (_localPort) {
+      _udp.begin(_localPort);
+    }
+    return true;
+  }
+
+  bool send(const uint8_t* data, const size_t len) {
+    if (!_udp.beginPacket(_host, _port)) {
+      return false;
+    }
+
+    _udp.write(data, len);
+    return _udp.endPacket();
+  }
+
+  /**
+   * One received packet, 0 when nothing came within timeoutMs.
+   */
+  size_t receive(uint8_t* buf, const size_t cap, const uint16_t timeoutMs) {
+    unsigned long start = millis();
+    do {
+      if (_udp.parsePacket() > 0) {
+        int len = _udp.read(buf, cap);
+        return len > 0 ? len : 0;
+      }
+      delay(1);
+    } while (millis() - start < timeoutMs);
+    return 0;
+  }
+
+  void end() {
+    _udp.stop();
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+  }
+
+private:
+  const char* _ssid;
+  const char* _pass;
+  const char* _host;
+  uint16_t _port;
+  Link* _link;
+  uint16_t _localPort;
+  WiFiUDP _udp;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef TicklessIdle_h
+#define TicklessIdle_h
+
+#include <Arduino.h>
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+
+#ifndef TICKLESS_MAX_PINS
+#define TICKLESS_MAX_PINS 8
+#endif
+
+#ifndef TICKLESS_MIN_SLEEP_MS
+#define TICKLESS_MIN_SLEEP_MS 3 // light sleep enter + exit costs about 1 ms
+#endif
+
+/**
+ * Light sleep between loop() passes while the UI is active.
+ *
+ * Every pass the caller collects deadlines of the active timers with until(),
+ * then sleep() enters light sleep until the nearest one or until any of the
+ * registered pins changes its level (encoder, button, endstops).
+ * RAM, peripherals state and the OLED content are kept; LEDC (servo PWM) stops,
+ * so do not call sleep() during a motion.
+ *
+ * The wake pins are expected to have CHANGE interrupts attached: sleep() turns them off
+ * while the pins are armed as level wakeups (a held level would retrigger the attached
+ * handler until the wakeup is disarmed) and restores any edge interrupts before it returns.
+ *
+ * Light sleep changes the timer and GPIO wakeup sources, re-arm the deep sleep ones before going to deep sleep.
+ */
+class TicklessIdle {
+public:
+  uint32_t sleepMs = 0;  // time spent in light sleep since resetStats()
+  uint32_t sleeps = 0;
+  unsigned long statsStartMs = 0;
+
+  void addWakePin(const gpio_num_t pin) {
+    if (_pinsCount < TICKLESS_MAX_PINS) {
+      _pins[_pinsCount++] = pin;
+    }
+  }
+
+  /**
+   * Starts a new pass, nothing to wait for yet.
+   */
+  void begin() {
+    _hasDeadline = false;
+  }
+
+  /**
+   * Adds a deadline (millis() value) to the current pass.
+   */
+  void until(const unsigned long deadlineMs) {
+    if (!_hasDeadline || (long)(deadlineMs - _deadline) < 0) {
+      _deadline = deadlineMs;
+      _hasDeadline = true;
+    }
+  }
+
+  /**
+   * Sleeps until the nearest deadline or a pin edge. Returns false when the
+   * deadline is too close (or missing) and the pass should just spin.
+   */
+  bool sleep() {
+    if (!_hasDeadline) {
+      return false;
+    }
+
+    unsigned long now = millis();
+    long left = (long)(_deadline - now);
+    if (left < TICKLESS_MIN_SLEEP_MS) {
+      return false;
+    }
+
+    // level wakeup on the opposite of the current level == wakeup on any edge
+    for (uint8_t i = 0; i < _pinsCount; i++) {
+      gpio_intr_disable(_pins[i]);
+      gpio_wakeup_enable(_pins[i], digitalRead(_pins[i]) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    }
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup((uint64_t)left * 1000);
+
+    esp_light_sleep_start();
+
+    // gpio_wakeup_disable() leaves the interrupt type disabled, back to the edges
+    for (uint8_t i = 0; i < _pinsCount; i++) {
+      gpio_wakeup_disable(_pins[i]);
+      gpio_set_intr_type(_pins[i], GPIO_INTR_ANYEDGE);
+      gpio_intr_enable(_pins[i]);
+    }
+
+    sleepMs += millis() - now;
+    sleeps++;
+    return true;
+  }
+
+  void resetStats() {
+    sleepMs = 0;
+    sleeps = 0;
+    statsStartMs = millis();
+  }
+
+  /**
+   * Share of time spent in light sleep since resetStats(), in percent.
+   */
+  byte sleepPercent() const {
+    unsigned long total = millis() - statsStartMs;
+    return total ? (uint64_t)sleepMs * 100 / total : 0;
+  }
+
+private:
+  gpio_num_t _pins[TICKLESS_MAX_PINS];
+  uint8_t _pinsCount = 0;
+  unsigned long _deadline = 0;
+  bool _hasDeadline = false;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef TimerWheel_h
+#define TimerWheel_h
+
+#include <Arduino.h>
+
+/**
+ * Hashed timer wheel for millis() deadlines.
+ *
+ * Timers are intrusive (the caller owns the WheelTimer, nothing is allocated) and hang in
+ * the slot of their deadline tick; a deadline more than one turn ahead stays in its slot
+ * until its turn comes. advance() only looks at the slots of the ticks passed since the
+ * last call, and returns right away while the earliest deadline is still ahead, so a loop
+ * pass without a due timer costs one compare instead of a millis() check per timer.
+ * The earliest deadline is kept for TicklessIdle::until().
+ *
+ * Callbacks run from advance() after the due timers are unlinked, they may schedule or
+ * cancel any timer, also their own. Deadlines are wrap-safe up to 24 days ahead.
+ */
+
+#ifndef TIMER_WHEEL_SLOTS
+#define TIMER_WHEEL_SLOTS 16 // power of 2
+#endif
+
+#ifndef TIMER_WHEEL_TICK_MS
+#define TIMER_WHEEL_TICK_MS 16 // one turn: 256 ms
+#endif
+
+struct WheelTimer {
+  void (*fn)(void* arg);
+  void* arg;
+  uint32_t periodMs;   // 0: one shot, else rescheduled after every run
+  uint32_t deadlineMs;
+  WheelTimer* next;
+  uint8_t slot;
+  bool isArmed;
+};
+
+class TimerWheel {
+public:
+  uint32_t fired = 0;
+
+  void begin(const uint32_t nowMs) {
+    _tick = nowMs / TIMER_WHEEL_TICK_MS;
+  }
+
+  /**
+   * (Re)arms t for deadlineMs (a millis() value).
+   */
+  void schedule(WheelTimer& t, const uint32_t deadlineMs) {
+    if (t.isArmed) {
+      cancel(t);
+    }
+    t.deadlineMs = deadlineMs;
+    t.isArmed = true;
+    // a deadline already passed goes to the current slot, the next advance() finds it there
+    uint32_t tick = deadlineMs / TIMER_WHEEL_TICK_MS;
+    t.slot = ((int32_t)(tick - _tick) < 0 ? _tick : tick) & (TIMER_WHEEL_SLOTS - 1);
+    t.next = _slots[t.slot];
+    _slots[t.slot] = &t;
+    _armed++;
+    if (_armed == 1) {
+      _next = deadlineMs;
+      _isNextStale = false;
+    } else if (!_isNextStale && isBefore(deadlineMs, _next)) {
+      _next = deadlineMs;
+    }
+  }
+
+  void after(WheelTimer& t, const uint32_t delayMs, const uint32_t nowMs) {
+    schedule(t, nowMs + delayMs);
+  }
+
+  void cancel(WheelTimer& t) {
+    if (!t.isArmed) {
+      return;
+    }
+    for (WheelTimer** p = &_slots[t.slot]; *p; p = &(*p)->next) {
+      if (*p == &t) {
+        *p = t.next;
+        break;
+      }
+    }
+    t.isArmed = false;
+    t.next = nullptr;
+    _armed--;
+    if (t.deadlineMs == _next) {
+      _isNextStale = true;
+    }
+  }
+
+  /**
+   * Runs the callbacks of all timers due at nowMs. Returns their number.
+   */
+  uint8_t advance(const uint32_t nowMs) {
+    if (_isNextStale && _armed) {
+      findNext();
+    }
+    if (!_armed || isBefore(nowMs, _next)) {
+      _tick = nowMs / TIMER_WHEEL_TICK_MS;
+      return 0;
+    }
+
+    // unlink everything due first, the callbacks may change the wheel
+    WheelTimer* due = nullptr;
+    uint32_t nowTick = nowMs / TIMER_WHEEL_TICK_MS;
+    uint32_t ticks = nowTick - _tick + 1;
+    if (ticks > TIMER_WHEEL_SLOTS) {
+      ticks = TIMER_WHEEL_SLOTS;
+    }
+    for (uint32_t i = 0; i < ticks; i++) {
+      for (WheelTimer** p = &_slots[(nowTick - i) & (TIMER_WHEEL_SLOTS - 1)]; *p;) {
+        WheelTimer* t = *p;
+        if (isBefore(nowMs, t->deadlineMs)) {
+          p = &t->next;
+          continue;
+        }
+        *p = t->next;
+        t->isArmed = false;
+        t->next = due;
+        due = t;
+        _armed--;
+      }
+    }
+    _tick = nowTick;
+    _isNextStale = true;
+
+    uint8_t count = 0;
+    while (due) {
+      WheelTimer* t = due;
+      due = t->next;
+      t->next = nullptr;
+      if (t->periodMs) {
+        // a late run does not make up for the missed periods
+        uint32_t deadlineMs = t->deadlineMs + t->periodMs;
+        schedule(*t, isBefore(deadlineMs, nowMs) ? nowMs + t->periodMs : deadlineMs);
+      }
+      t->fn(t->arg);
+      count++;
+    }
+    fired += count;
+    return count;
+  }
+
+  /**
+   * Earliest deadline of the armed timers, false if none is armed.
+   */
+  bool nextDeadline(uint32_t& deadlineMs) {
+    if (!_armed) {
+      return false;
+    }
+    if (_isNextStale) {
+      findNext();
+    }
+    deadlineMs = _next;
+    return true;
+  }
+
+  uint8_t armed() const {
+    return _armed;
+  }
+
+private:
+  WheelTimer* _slots[TIMER_WHEEL_SLOTS] = {};
+  uint32_t _tick = 0;   // last advanced tick
+  uint32_t _next = 0;   // earliest deadline, unless stale
+  bool _isNextStale = false;
+  uint8_t _armed = 0;
+
+  static_assert((TIMER_WHEEL_SLOTS & (TIMER_WHEEL_SLOTS - 1)) == 0, "TIMER_WHEEL_SLOTS must be a power of 2");
+
+  static bool isBefore(const uint32_t a, const uint32_t b) {
+    return (int32_t)(a - b) < 0;
+  }
+
+  void findNext() {
+    bool isFound = false;
+    for (uint8_t s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+      for (WheelTimer* t = _slots[s]; t; t = t->next) {
+        if (!isFound || isBefore(t->deadlineMs, _next)) {
+          _next = t->deadlineMs;
+          isFound = true;
+        }
+      }
+    }
+    _isNextStale = false;
+  }
+};
+
+#endif
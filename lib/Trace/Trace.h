@@ -0,0 +1,169 @@
+#ifndef Trace_h
+#define Trace_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+/**
+ * Binary trace events in a lock-free single producer / single consumer ring.
+ *
+ * Record: id:u8, args:u8 (count << 6 | type of arg i << 2 * i), timestamp:u32 (us), up to 3 x 4 byte args.
+ * Writing an event is a few stores; formatting happens on the host (tools/trace_decode.py)
+ * which takes names and format strings from the event table (TRACE_EVENT list).
+ * The ring has no constructor work, so it can be declared RTC_DATA_ATTR and keeps
+ * undrained events through deep sleep.
+ *
+ * A flight recorder: when full, a write overwrites the oldest whole records (counted
+ * in dropped), so without a drain the ring holds the latest events before a fault.
+ * The producer moves the tail then, so the consumer commits a read with a compare and
+ * swap and takes the next record if it was overwritten while being copied.
+ */
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 1024
+#endif
+
+#define TRACE_MAX_ARGS 3
+#define TRACE_HEADER_SIZE 6
+#define TRACE_RECORD_MAX (TRACE_HEADER_SIZE + TRACE_MAX_ARGS * 4)
+
+#define TRACE_ARG_I32 0
+#define TRACE_ARG_U32 1
+#define TRACE_ARG_F32 2
+
+template< uint16_t _SIZE >
+class TraceRing {
+  static_assert(_SIZE >= 64 && (_SIZE & (_SIZE - 1)) == 0, "ring size must be a power of two");
+
+public:
+  std::atomic<uint16_t> head { 0 }; // free running, written by the producer only
+  std::atomic<uint16_t> tail { 0 }; // free running, written by the consumer only
+  uint16_t dropped = 0; // records overwritten before they were read
+  uint8_t buf[_SIZE] = {};
+
+  template< typename... TArgs >
+  bool write(const uint8_t id, const uint32_t timestamp, const TArgs... args) {
+    static_assert(sizeof...(TArgs) <= TRACE_MAX_ARGS, "too many trace arguments");
+
+    uint8_t rec[TRACE_RECORD_MAX];
+    uint8_t len = TRACE_HEADER_SIZE;
+    uint8_t types = sizeof...(TArgs) << 6;
+    [[maybe_unused]] uint8_t i = 0;
+
+    rec[0] = id;
+    memcpy(rec + 2, &timestamp, 4);
+    (packArg(rec, len, types, i++, args), ...);
+    rec[1] = types;
+
+    const uint16_t h = head.load(std::memory_order_relaxed);
+    uint16_t t = tail.load(std::memory_order_acquire);
+
+    // make room from the oldest record on; a failed swap means the consumer took it
+    while ((uint16_t)(_SIZE - (uint16_t)(h - t)) < len) {
+      const uint16_t next = t + recordLength(buf[(uint16_t)(t + 1) & (_SIZE - 1)]);
+      if (tail.compare_exchange_weak(t, next, std::memory_order_acq_rel)) {
+        t = next;
+        dropped++;
+      }
+    }
+
+    for (uint8_t k = 0; k < len; k++) {
+      buf[(uint16_t)(h + k) & (_SIZE - 1)] = rec[k];
+    }
+
+    head.store(h + len, std::memory_order_release);
+    return true;
+  }
+
+  bool isEmpty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Pops one record into out (TRACE_RECORD_MAX bytes), returns its length or 0.
+   */
+  uint8_t read(uint8_t* out) {
+    uint16_t t = tail.load(std::memory_order_acquire);
+
+    while (true) {
+      const uint16_t h = head.load(std::memory_order_acquire);
+      if (h == t) {
+        return 0;
+      }
+
+      const uint8_t len = recordLength(buf[(uint16_t)(t + 1) & (_SIZE - 1)]);
+      for (uint8_t k = 0; k < len; k++) {
+        out[k] = buf[(uint16_t)(t + k) & (_SIZE - 1)];
+      }
+
+      // the producer moved the tail over it meanwhile: overwritten, t is the new tail
+      if (tail.compare_exchange_strong(t, t + len, std::memory_order_acq_rel)) {
+        return len;
+      }
+    }
+  }
+
+  static uint8_t recordLength(const uint8_t types) {
+    return TRACE_HEADER_SIZE + (types >> 6) * 4;
+  }
+
+#ifdef ARDUINO
+  /**
+   * Prints up to maxRecords records as "#T<hex>" lines, so they can share the serial
+   * port with plain text logs. Returns the number of records printed.
+   */
+  uint16_t drain(Print& out, const uint16_t maxRecords = 0xFFFF) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    uint8_t rec[TRACE_RECORD_MAX];
+    char line[2 + TRACE_RECORD_MAX * 2 + 1];
+    uint16_t n = 0;
+
+    while (n < maxRecords) {
+      uint8_t len = read(rec);
+      if (len == 0) break;
+
+      line[0] = '#';
+      line[1] = 'T';
+      for (uint8_t k = 0; k < len; k++) {
+        line[2 + k * 2] = HEX_DIGITS[rec[k] >> 4];
+        line[3 + k * 2] = HEX_DIGITS[rec[k] & 0x0F];
+      }
+      line[2 + len * 2] = '\0';
+      out.println(line);
+      n++;
+    }
+
+    return n;
+  }
+#endif
+
+private:
+  template< typename T >
+  static void packArg(uint8_t* rec, uint8_t& len, uint8_t& types, const uint8_t i, const T val) {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "only numbers can be traced");
+
+    if (std::is_floating_point<T>::value) {
+      float f = (float)val;
+      memcpy(rec + len, &f, 4);
+      types |= TRACE_ARG_F32 << (i * 2);
+    } else if (std::is_signed<T>::value) {
+      int32_t v = (int32_t)val;
+      memcpy(rec + len, &v, 4);
+      types |= TRACE_ARG_I32 << (i * 2);
+    } else {
+      uint32_t v = (uint32_t)val;
+      memcpy(rec + len, &v, 4);
+      types |= TRACE_ARG_U32 << (i * 2);
+    }
+
+    len += 4;
+  }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef UiFont_h
+#define UiFont_h
+
+#include <Arduino.h>
+
+/**
+ * UTF-8 text beyond ASCII (the Ukrainian labels) for the classic 6x8 font of Adafruit_GFX.
+ *
+ * Glyphs come from a table generated by tools/fontgen.py (include/FontUa5x8.h): 5 columns
+ * of 8 pixels like the classic font, so they keep its 6 * size px advance and every layout
+ * stays as it is. ASCII is still drawn by the built-in font. In flash a glyph is 5 indices
+ * into a dictionary of the distinct columns, bit-packed, so glyph n sits at a fixed bit
+ * offset and needs no offset table.
+ *
+ * Decoded glyphs stay in a small direct mapped cache: the page mode display replays the
+ * text of every page it rasterises, and the menu redraws the same labels on every move.
+ *
+ * Backends get UTF-8 printing by deriving from UiFontText<Adafruit_GFX or a subclass>:
+ * print("ВІДКР.") then draws the font glyphs, unknown characters as '?'. Inside a
+ * backend a glyph is a one byte code, UI_FONT_CODE_FIRST + its number in the table.
+ */
+
+#ifndef UI_FONT_CACHE
+#define UI_FONT_CACHE 16 // decoded glyphs kept, power of 2
+#endif
+
+#define UI_FONT_CODE_FIRST 0x80
+#define UI_FONT_MISSING '?'
+
+struct UiFontRange {
+  uint16_t first; // code point
+  uint8_t count;
+  uint8_t glyph;  // glyph number of first
+};
+
+struct UiFontData {
+  const UiFontRange* ranges;
+  uint8_t rangeCount;
+  const uint8_t* columns; // distinct columns
+  const uint8_t* indices; // 5 column indices per glyph, bits each, LSB first
+  uint8_t bits;
+  uint8_t glyphCount;
+  uint16_t bytes;         // flash of the tables
+};
+
+/**
+ * UTF-8 bytes -> code points, one byte at a time (print() writes byte by byte).
+ */
+class Utf8Decoder {
+public:
+  /**
+   * True when cp holds a complete code point. A broken sequence gives U+FFFD.
+   */
+  bool push(const uint8_t b, uint32_t& cp) {
+    if (b < 0x80) {
+      _left = 0;
+      cp = b;
+      return true;
+    }
+
+    if (b < 0xC0) {
+      if (!_left) {
+        cp = 0xFFFD;
+        return true;
+      }
+      _cp = _cp << 6 | (b & 0x3F);
+      if (--_left) {
+        return false;
+      }
+      cp = _cp;
+      return true;
+    }
+
+    if (b >= 0xF8) {
+      _left = 0;
+      cp = 0xFFFD;
+      return true;
+    }
+    _left = b < 0xE0 ? 1 : b < 0xF0 ? 2 : 3;
+    _cp = b & (0x3F >> _left);
+    return false;
+  }
+
+private:
+  uint32_t _cp = 0;
+  uint8_t _left = 0; // continuation bytes to come
+};
+
+class UiFont {
+public:
+  uint32_t hits = 0;
+  uint32_t misses = 0; // glyphs decoded from flash
+
+  void setFont(const UiFontData* font) {
+    _font = font;
+    memset(_cacheCode, 0, sizeof(_cacheCode));
+  }
+
+  const UiFontData* font() const {
+    return _font;
+  }
+
+  /**
+   * Glyph code of a code point, 0 if the font has none.
+   */
+  uint8_t codeOf(const uint32_t cp) const {
+    if (!_font) {
+      return 0;
+    }
+    for (uint8_t i = 0; i < _font->rangeCount; i++) {
+      uint16_t first = pgm_read_word(&_font->ranges[i].first);
+      uint8_t count = pgm_read_byte(&_font->ranges[i].count);
+      if (cp >= first && cp < (uint32_t)first + count) {
+        return UI_FONT_CODE_FIRST + pgm_read_byte(&_font->ranges[i].glyph) + (cp - first);
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * The 5 column bytes of a glyph code (bit 0 is the top row), valid until the next call.
+   */
+  const uint8_t* columns(const uint8_t code) {
+    uint8_t slot = code & (UI_FONT_CACHE - 1);
+    if (_cacheCode[slot] == code) {
+      hits++;
+      return _cache[slot];
+    }
+
+    misses++;
+    _cacheCode[slot] = code;
+    decode(code - UI_FONT_CODE_FIRST, _cache[slot]);
+    return _cache[slot];
+  }
+
+private:
+  const UiFontData* _font = nullptr;
+  uint8_t _cacheCode[UI_FONT_CACHE] = {}; // 0: empty, glyph codes are >= 0x80
+  uint8_t _cache[UI_FONT_CACHE][5];
+
+  static_assert((UI_FONT_CACHE & (UI_FONT_CACHE - 1)) == 0, "UI_FONT_CACHE must be a power of 2");
+
+  void decode(const uint8_t glyph, uint8_t* out) const {
+    if (!_font || glyph >= _font->glyphCount) {
+      memset(out, 0, 5);
+      return;
+    }
+
+    uint8_t bits = _font->bits;
+    uint8_t mask = (1 << bits) - 1;
+    uint16_t bit = glyph * 5 * bits;
+    for (uint8_t c = 0; c < 5; c++, bit += bits) {
+      // an index spans 2 bytes at most, the table ends with a spare byte
+      const uint8_t* p = _font->indices + (bit >> 3);
+      uint16_t word = pgm_read_byte(p) | pgm_read_byte(p + 1) << 8;
+      out[c] = pgm_read_byte(_font->columns + ((word >> (bit & 7)) & mask));
+    }
+  }
+};
+
+/**
+ * The font every backend draws with, set once with setFont().
+ */
+inline UiFont& uiFont() {
+  static UiFont font;
+  return font;
+}
+
+/**
+ * A glyph the way Adafruit_GFX::drawChar() draws the classic font: the spacing column and
+ * the unset pixels only with a background color.
+ */
+template< typename TGfx >
+void uiFontDrawGlyph(TGfx& gfx, const int16_t x, const int16_t y, const uint8_t code,
+                     const uint16_t color, const uint16_t bg, const uint8_t size) {
+  const uint8_t* cols = uiFont().columns(code);
+  for (uint8_t i = 0; i < 6; i++) {
+    uint8_t line = i < 5 ? cols[i] : 0;
+    for (uint8_t j = 0; j < 8; j++, line >>= 1) {
+      if (!(line & 1) && bg == color) {
+        continue;
+      }
+      uint16_t c = line & 1 ? color : bg;
+      if (size == 1) {
+        gfx.drawPixel(x + i, y + j, c);
+      } else {
+        gfx.fillRect(x + i * size, y + j * size, size, size, c);
+      }
+    }
+  }
+}
+
+/**
+ * UTF-8 print() for an Adafruit_GFX backend. Cursor and wrap follow Adafruit_GFX::write().
+ */
+template< typename TBase >
+class UiFontText : public TBase {
+public:
+  using TBase::TBase;
+
+  size_t write(uint8_t c) override {
+    uint32_t cp;
+    if (!_utf8.push(c, cp)) {
+      return 1;
+    }
+    if (cp < 0x80) {
+      return TBase::write((uint8_t)cp);
+    }
+
+    uint8_t code = uiFont().codeOf(cp);
+    if (!code) {
+      return TBase::write(UI_FONT_MISSING);
+    }
+    if (this->wrap && this->cursor_x + this->textsize_x * 6 > this->_width) {
+      this->cursor_x = 0;
+      this->cursor_y += this->textsize_y * 8;
+    }
+    uiFontDrawGlyph(*this, this->cursor_x, this->cursor_y, code, this->textcolor, this->textbgcolor, this->textsize_x);
+    this->cursor_x += this->textsize_x * 6;
+    return 1;
+  }
+
+  using Print::write;
+
+private:
+  Utf8Decoder _utf8;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef UiLatency_h
+#define UiLatency_h
+
+#include <Arduino.h>
+
+/**
+ * Input to photon latency of the UI.
+ *
+ * input() takes the time the input happened (the encoder interrupt timestamp, not the
+ * time the loop got to it) and the display's flush count at that point. poll() after the
+ * input is handled resolves every pending input once the panel shows a frame flushed after
+ * it: latency = now - input time, so it covers the queueing in the encoder ring, a light
+ * sleep, the callback, the menu drawing and the blocking I2C flush (or the e-paper refresh).
+ * An input which left the picture as it was (turning past the last menu item) is counted
+ * in invisible.
+ *
+ * Latencies go into linear buckets of UI_LATENCY_BUCKET_MS, the last one takes the rest,
+ * so percentiles are exact to a bucket up to UI_LATENCY_BUCKETS * UI_LATENCY_BUCKET_MS.
+ */
+
+#ifndef UI_LATENCY_BUCKET_MS
+#define UI_LATENCY_BUCKET_MS 2
+#endif
+
+#ifndef UI_LATENCY_BUCKETS
+#define UI_LATENCY_BUCKETS 64 // up to 128 ms
+#endif
+
+#ifndef UI_LATENCY_PENDING
+#define UI_LATENCY_PENDING 8
+#endif
+
+#ifndef UI_LATENCY_BUDGET_MS
+#define UI_LATENCY_BUDGET_MS 50 // p99 target
+#endif
+
+class UiLatencyTracker {
+public:
+  uint32_t samples = 0;
+  uint32_t invisible = 0; // inputs without a new frame
+  uint32_t dropped = 0;   // more pending inputs than UI_LATENCY_PENDING, not measured
+  uint32_t maxMs = 0;
+  uint64_t sumMs = 0;
+  uint16_t buckets[UI_LATENCY_BUCKETS] = {};
+  void (*onSample)(uint32_t ms) = nullptr; // every measured latency, for long term metrics
+
+  void input(const uint32_t eventMs, const uint32_t flushes) {
+    if (_pendingCount == UI_LATENCY_PENDING) {
+      dropped++;
+      return;
+    }
+    _pending[_pendingCount++] = { eventMs, flushes };
+  }
+
+  /**
+   * Call after the input callbacks ran, with the display's flushes, shownFrames() and
+   * isFlushPending(). An input without a flush after it yet waits while one is queued.
+   * Returns the number of inputs resolved with a latency.
+   */
+  uint8_t poll(const uint32_t flushes, const uint32_t shownFrames, const bool isFlushPending, const uint32_t nowMs) {
+    uint8_t resolved = 0;
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < _pendingCount; i++) {
+      const Pending& p = _pending[i];
+      if ((int32_t)(shownFrames - p.flushes) > 0) {
+        record(nowMs - p.eventMs);
+        resolved++;
+      } else if (flushes != p.flushes || isFlushPending) {
+        _pending[kept++] = p;
+      } else {
+        invisible++;
+      }
+    }
+    _pendingCount = kept;
+    return resolved;
+  }
+
+  void record(const uint32_t ms) {
+    samples++;
+    sumMs += ms;
+    if (ms > maxMs) maxMs = ms;
+    uint16_t b = ms / UI_LATENCY_BUCKET_MS;
+    uint16_t& bucket = buckets[b < UI_LATENCY_BUCKETS ? b : UI_LATENCY_BUCKETS - 1];
+    if (bucket != UINT16_MAX) bucket++;
+    if (onSample) onSample(ms);
+  }
+
+  /**
+   * Latency at quantile q (0..1): the upper bound of its bucket, maxMs for the last bucket.
+   */
+  uint32_t percentileMs(const float q) const {
+    if (!samples) {
+      return 0;
+    }
+    uint32_t rank = samples * q;
+    uint32_t seen = 0;
+    for (uint16_t b = 0; b < UI_LATENCY_BUCKETS - 1; b++) {
+      seen += buckets[b];
+      if (seen > rank) {
+        uint32_t upper = (b + 1) * UI_LATENCY_BUCKET_MS - 1;
+        return upper < maxMs ? upper : maxMs;
+      }
+    }
+    return maxMs;
+  }
+
+  uint32_t meanMs() const {
+    return samples ? sumMs / samples : 0;
+  }
+
+  bool isWithinBudget(const uint32_t budgetMs = UI_LATENCY_BUDGET_MS) const {
+    return percentileMs(0.99) <= budgetMs;
+  }
+
+  void reset() {
+    void (*hook)(uint32_t) = onSample;
+    *this = UiLatencyTracker();
+    onSample = hook;
+  }
+
+  /**
+   * One line: "UI_LATENCY n 120 p50 9 p90 13 p99 21 max 24 mean 10 invisible 3 dropped 0 budget 50 ok"
+   */
+  void printReport(Print& out) const {
+    out.print("UI_LATENCY n "); out.print(samples);
+    out.print(" p50 "); out.print(percentileMs(0.5));
+    out.print(" p90 "); out.print(percentileMs(0.9));
+    out.print(" p99 "); out.print(percentileMs(0.99));
+    out.print(" max "); out.print(maxMs);
+    out.print(" mean "); out.print(meanMs());
+    out.print(" invisible "); out.print(invisible);
+    out.print(" dropped "); out.print(dropped);
+    out.print(" budget "); out.print(UI_LATENCY_BUDGET_MS);
+    out.println(isWithinBudget() ? " ok" : " over");
+  }
+
+private:
+  struct Pending {
+    uint32_t eventMs;
+    uint32_t flushes;
+  };
+
+  Pending _pending[UI_LATENCY_PENDING];
+  uint8_t _pendingCount = 0;
+};
+
+#endif
@@ -1,16 +1,81 @@
 #include <Arduino.h>
-#include <EncButton.h>
 #include <SPI.h>
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
-#include <GyverTimer.h>
 #include <Preferences.h>
 #include <ServoSmooth.h>
 #include "GOledMenuAda.h"
 #include "driver/rtc_io.h"
 #include "DHT.h"
 #include <Adafruit_INA219.h>
+#include "SensorFilter.h"
+#include "ClimateControl.h"
+#include "EncoderIsr.h"
+#include "DisplayPower.h"
+#include "PowerPolicy.h"
+#include "ServoActuator.h"
+#include "MotionCurrent.h"
+#if defined(DISPLAY_EPD)
+#include "EpdDisplay.h"
+#elif defined(DISPLAY_SH1106)
+#include "Sh1106Display.h"
+#elif defined(OLED_PAGE_MODE)
+#include "Ssd1306PageDisplay.h"
+#else
+#include "Ssd1306Display.h"
+#endif
+#include "RetainedUi.h"
+#include "DisplayAnim.h"
+#include "UiFont.h"
+#include "FontUa5x8.h"
+#include "FixedFormat.h"
+#include "Bench.h"
+#include "BootGraph.h"
+#include "Coroutine.h"
+#include "Metrics.h"
+#include "MetricsTable.h"
+#include "UiLatency.h"
+#if defined(ENABLE_LIGHT_SLEEP) && defined(DEBUG_ENABLE) && defined(ESP32C3)
+#undef ENABLE_LIGHT_SLEEP // USB CDC serial does not survive light sleep
+#endif
+#if defined(ENABLE_LIGHT_SLEEP) && defined(UI_LATENCY_REPLAY)
+#undef ENABLE_LIGHT_SLEEP // the serial port is no wake source, replayed input would wait for a pin
+#endif
+#if defined(ENABLE_LIGHT_SLEEP) && defined(SERIAL_EXPORT)
+#undef ENABLE_LIGHT_SLEEP // same for the export commands, and USB CDC on the C3
+#endif
+#ifdef ENABLE_LIGHT_SLEEP
+#include "TicklessIdle.h"
+#endif
+#ifdef DISPLAY_EPD
+#undef DISPLAY_FAST_RESUME // e-paper shows the status through deep sleep anyway
+#endif
+#ifdef ENABLE_CPU_GOVERNOR
+#include "CpuGovernor.h"
+#endif
+#ifdef TRACE_ENABLE
+#include "Trace.h"
+#include "TraceEvents.h"
+#endif
+#ifdef TELEMETRY_ENABLE
+#include <time.h>
+#include "Telemetry.h"
+#include "WifiUdpTransport.h"
+#endif
+#ifdef PEER_SYNC_ENABLE
+#include <sys/time.h>
+#include "PeerSync.h"
+#include "WifiUdpTransport.h"
+#endif
+#ifdef SERIAL_EXPORT
+#include "SerialExport.h"
+#endif
+#ifdef HISTORY_ENABLE
+#include <time.h>
+#include "HistoryLog.h"
+#include "PartitionFlash.h"
+#endif
 
 
 
@@ -22,12 +87,73 @@
 #define LOGN(x)
 #endif
 
+// binary trace events, cheap enough to stay on in production (see tools/trace_decode.py)
+#ifdef TRACE_ENABLE
+#define TRACE(...) traceRing.write(micros(), __VA_ARGS__)
+#else
+#define TRACE(...)
+#endif
+
+// CPU clock for the rest of the current scope
+#ifdef ENABLE_CPU_GOVERNOR
+#define GOVERN(load) CpuGovernor::Scope _govScope(governor, load)
+#else
+#define GOVERN(load)
+#endif
+
+#ifdef TELEMETRY_ENABLE
+#define TELEMETRY(...) telemetry.push(time(nullptr), __VA_ARGS__)
+#else
+#define TELEMETRY(...)
+#endif
+
+// long term log on the history partition (see HistoryLog.h): the current readings and an action
+#ifdef HISTORY_ENABLE
+#define HISTORY(action) history.append(time(nullptr), cur_t * 10, cur_h * 10, batVoltage * 1000, \
+                                       isFullOpened | isPartiallyOpened << 1, action)
+#else
+#define HISTORY(action)
+#endif
+
+#ifndef TELEMETRY_WIFI_SSID
+#define TELEMETRY_WIFI_SSID ""
+#endif
+#ifndef TELEMETRY_WIFI_PASS
+#define TELEMETRY_WIFI_PASS ""
+#endif
+#ifndef TELEMETRY_HOST
+#define TELEMETRY_HOST "192.168.1.2"
+#endif
+#ifndef TELEMETRY_PORT
+#define TELEMETRY_PORT 5140
+#endif
+
+// units in one room share readings and take turns (see PeerSync.h), same WiFi as telemetry
+#ifndef PEER_BROADCAST
+#define PEER_BROADCAST "255.255.255.255"
+#endif
+#ifndef PEER_PORT
+#define PEER_PORT 5141
+#endif
+
 #define MENU_ITEMS 12
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 64 // OLED display height, in pixels
 #define OLED_RESET     -1 // Reset pin # (or -1 if sharing Arduino reset pin)
 #define SCREEN_ADDRESS 0x3C //0x3D ///< See datasheet for Address; 0x3D for 128x64, 0x3C for 128x32
 
+// SSD1681 e-paper on SPI (-D DISPLAY_EPD); the C3 has only these pins left: CS tied low, no RST / BUSY
+#define EPD_WIDTH 200
+#define EPD_HEIGHT 200
+#ifndef EPD_SCK_PIN
+#define EPD_SCK_PIN 6
+#define EPD_MOSI_PIN 0
+#define EPD_DC_PIN 8
+#define EPD_CS_PIN -1
+#define EPD_RST_PIN -1
+#define EPD_BUSY_PIN -1
+#endif
+
 #define ENC_BTN GPIO_NUM_1
 #define ENC_L GPIO_NUM_2
 #define ENC_R GPIO_NUM_3
@@ -38,11 +164,23 @@
 #define HIGHT_ENDSTOP_PIN GPIO_NUM_20
 #define LOW_ENDSTOP_PIN GPIO_NUM_21
 #define SERVO_PIN GPIO_NUM_10
+#define SERVO_POWER_PIN GPIO_NUM_4 // servo rail switch, HIGH = on
 #define uS_TO_S_FACTOR 1000000ULL /* Conversion factor for micro seconds to seconds */
 #define MAX_TEMP 50.0
 #define MIN_TEMP 10.0
-#define KICK_DELAY 1000 // freeze for 1 sec during rotation start
+#define KICK_DELAY 1000 // the servo leaves the endstop for 1 sec before the end position counts
 #define LION_BATTERIES_COUNT 2
+#define BATTERY_CAPACITY_MAH 2500 // of the series pack, for the runtime projection
+#define DHT_MIN_INTERVAL 2000 // DHT11 returns a cached value if read more often
+#define DHT_FAIL_FAULT 5 // failed reads in a row reported as a sensor fault
+#define MOTION_TIMEOUT 60000 // stop the servo if the endstop is not reached in 60 sec
+#define MOTION_ANIM_MS 300 // main screen animation frame during a motion, also rereads the endstops
+#define MOTION_SCROLL_MS 40 // motion arrow scrolled by the panel, one column per step (2 panel frames at least)
+#define MOTION_ARROW_W 72 // "> > > " at text size 2, whole periods of the pattern scroll seamlessly
+#define PAGE_SLIDE_STEP_MS 12 // menu page slide, one 8 row band per step
+#define ACTIVE_CURRENT_MA 22.0 // CPU running, used for the UI session estimate
+#define LIGHT_SLEEP_CURRENT_MA 0.8
+#define METRICS_CHECKPOINT_UPDATES 256 // counter / histogram updates between NVS checkpoints, about 2 per wake
 
 
 #define BUTTON_PIN_BITMASK(GPIO) (1ULL << GPIO)  // 2 ^ GPIO_NUMBER in hex
@@ -53,23 +191,140 @@
 uint64_t bitmask = BUTTON_PIN_BITMASK(WAKEUP_1) /* | BUTTON_PIN_BITMASK(WAKEUP_2) */;
 
 
-Adafruit_SSD1306 oled(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-EncButton eb(ENC_L, ENC_R, ENC_BTN, INPUT_PULLUP);
+// display backend, see DisplayBackend.h
+#if defined(DISPLAY_EPD)
+typedef EpdDisplay UiDisplay; // keeps the status through deep sleep
+UiDisplay oled(EPD_WIDTH, EPD_HEIGHT, &SPI, EPD_CS_PIN, EPD_DC_PIN, EPD_RST_PIN, EPD_BUSY_PIN);
+#else
+#if defined(DISPLAY_SH1106)
+typedef Sh1106Display UiDisplay;
+#elif defined(OLED_PAGE_MODE)
+typedef Ssd1306PageDisplay UiDisplay; // no framebuffer, frames are streamed page by page
+#else
+typedef Ssd1306Display UiDisplay;
+#endif
+UiDisplay oled(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+#endif
+EncoderIsr eb(ENC_L, ENC_R, ENC_BTN, INPUT_PULLUP);
 // Button hightEndstor(HIGHT_ENDSTOP_PIN, INPUT_PULLUP, HIGH);
 // Button lowEndstor(LOW_ENDSTOP_PIN, INPUT_PULLUP, HIGH) ;
-GTimer displayIdleTimer(MS);
-GTimer animTimer(MS);
-GTimer temperatureTimer(MS);
-OledMenu<MENU_ITEMS, Adafruit_SSD1306> menu(&oled);
+CoExecutor coop; // timers and the flows waiting on them, the idle loop sleeps until its next deadline
+WheelTimer displayIdleTimer = {};
+#ifdef BENCH_ENABLE
+uint32_t schedCycles = 0; // coop.run() cost, "loop_sched" bench line
+uint32_t schedPasses = 0;
+#endif
+#ifdef ENABLE_LIGHT_SLEEP
+TicklessIdle idle;
+#endif
+#ifdef ENABLE_CPU_GOVERNOR
+CpuGovernor governor;
+#endif
+OledMenu<MENU_ITEMS, UiDisplay> menu(&oled);
+DisplayPowerPolicy displayPower; // contrast ramp, dim stage and panel current estimate
+UiLatencyTracker uiLatency; // encoder / button event to the flush showing its effect
+PageSlide<UiDisplay> pageSlide; // menu page changes slide in through the panel start line
+Marquee<UiDisplay> motionArrow; // the motion arrow scrolled by the panel, software frames without it
+BootGraph boot;
+BootTask dhtTask; // the DHT read sleeps 20 ms in its start signal, the boot goes on meanwhile
+
+// flows in the order of coop.add()
+enum CoTaskId : uint8_t {
+  TASK_MOTION,
+  TASK_CLIMATE,
+  TASK_SLIDE
+};
+
+// coop.signalFromIsr() bits
+enum CoEventBit : uint32_t {
+  EV_ENDSTOP = 1UL << 0
+};
+
+// boot phases in the order of boot.add(), ids for BOOT_AFTER() and the trace
+enum BootPhaseId : uint8_t {
+  BOOT_WAKE,
+  BOOT_DHT,
+  BOOT_PREFS,
+  BOOT_BUS,
+  BOOT_INPUT,
+  BOOT_DISPLAY,
+  BOOT_BATTERY,
+  BOOT_MENU,
+  BOOT_SERVO,
+  BOOT_SENSOR,
+  BOOT_HISTORY
+};
+
+void drawBattery(int16_t x, int16_t y, byte percent/* , byte scale = 1 */);
+
+/**
+ * Main screen widgets, repainted and flushed only when their value changes
+ */
+class BatteryWidget : public UiWidget<UiDisplay> {
+public:
+  BatteryWidget(const int16_t x, const int16_t y) {
+    rect = { x, y, 14, 8 };
+  }
+
+  void set(const byte percent) {
+    if (percent != _percent) {
+      _percent = percent;
+      dirty = true;
+    }
+  }
+
+  void draw(UiDisplay& gfx) override {
+    gfx.fillRect(rect.x, rect.y, rect.w, rect.h, BLACK);
+    drawBattery(rect.x, rect.y, _percent);
+  }
+
+private:
+  byte _percent = 0;
+};
+
+typedef UiText<UiDisplay> TextWidget;
+TextWidget humWidget(20, 4, 17);
+TextWidget tempWidget(2, 16, 7, 3);
+TextWidget wndStateWidget(4, SCREEN_HEIGHT - 18, 7, 2);
+TextWidget voltageWidget(SCREEN_WIDTH - 16-26, SCREEN_HEIGHT - 23, 5);
+TextWidget powerWidget(SCREEN_WIDTH - 16-26-4, SCREEN_HEIGHT - 12, 1); // power profile mark, overlaps wndStateWidget, keep it after
+BatteryWidget batteryWidget(SCREEN_WIDTH - 16-24, SCREEN_HEIGHT - 12);
+TextWidget batPersWidget(SCREEN_WIDTH - 24, SCREEN_HEIGHT - 12, 4);
+UiScreen<7, UiDisplay> mainScreen;
 ServoSmooth servo;
 Preferences prefs;
 DHT dht(DHT_PIN, DHT11);
 Adafruit_INA219 ina219;
+#ifdef TRACE_ENABLE
+RTC_DATA_ATTR TraceRing<TRACE_BUFFER_SIZE> traceRing;
+#endif
+#ifdef TELEMETRY_ENABLE
+RTC_DATA_ATTR TelemetryQueue<TELEMETRY_QUEUE_SIZE> telemetry;
+RTC_DATA_ATTR WifiUdpTransport::Link wifiLink;
+WifiUdpTransport uplink(TELEMETRY_WIFI_SSID, TELEMETRY_WIFI_PASS, TELEMETRY_HOST, TELEMETRY_PORT, &wifiLink);
+#endif
+#ifdef PEER_SYNC_ENABLE
+RTC_DATA_ATTR PeerSync peer;
+RTC_DATA_ATTR WifiUdpTransport::Link peerWifiLink;
+WifiUdpTransport peerLink(TELEMETRY_WIFI_SSID, TELEMETRY_WIFI_PASS, PEER_BROADCAST, PEER_PORT, &peerWifiLink, PEER_PORT);
+#endif
+#ifdef HISTORY_ENABLE
+RTC_DATA_ATTR HistoryLog<PartitionFlash>::State historyState; // batches and ring heads between the flash writes
+PartitionFlash historyFlash;
+HistoryLog<PartitionFlash> history(historyFlash, historyState);
+#endif
 
 
 float cur_t = 0;
 float cur_h = 0;
 
+// filter state is kept through deep sleep (TempFilter is in ClimateControl.h)
+typedef FilterPipeline<OutlierFilter<150>, MedianFilter<3>, EmaFilter<40>> HumFilter;
+RTC_DATA_ATTR TempFilter tempFilter;
+RTC_DATA_ATTR HumFilter humFilter;
+unsigned long lastSampleMs = 0;
+bool isSampled = false;
+
 byte rotateDirection = 1; // no rotation
 byte animationPos = 0;
 
@@ -78,6 +333,20 @@ byte animationPos = 0;
 #define ROTATE_STOP 1500
 #define ROTATE_DOWNWARD 2500
 
+#define INA219_CONVERSION_MS 2 // wait for a fresh INA219 sample
+#define STALL_CURRENT_MA 900 // jammed window: current stays above this ...
+#define STALL_WINDOW_MS 300  // ... for this long
+#define SOFT_START_LIMIT_MA 600 // the speed ramp is held while the current is above
+#define SOFT_START_STEP_US 100
+#define SOFT_START_STEP_MS 20
+
+ServoActuator<ServoSmooth> actuator(&servo, SERVO_PIN, SERVO_POWER_PIN, ROTATE_STOP);
+MotionCurrentMonitor motionCurrent(&Wire, INA219_ADDRESS);
+uint16_t motionTargetUs = ROTATE_STOP;
+uint16_t motionUs = ROTATE_STOP;
+unsigned long rampStepMs = 0;
+RTC_DATA_ATTR float servoIdleSavingMa = 0; // servo idle current removed by the power gating
+
 struct Settings {
   float lowTemp = 22;
   float highTemp = 25;
@@ -87,9 +356,63 @@ struct Settings {
   bool flip = false;
 } cfg;
 
-RTC_DATA_ATTR uint openCloseCounts=0;
+// operational counters through deep sleep, checkpointed to NVS (see MetricsTable.h, tools/metrics_decode.py)
+RTC_DATA_ATTR MetricsRegistry<M_COUNTERS_COUNT, M_GAUGES_COUNT, M_HISTOGRAMS_COUNT> metrics;
 RTC_DATA_ATTR bool oledEnabled = true;
 RTC_DATA_ATTR bool forceStop = false;
+RTC_DATA_ATTR byte dhtFailStreak = 0;
+RTC_DATA_ATTR bool isLowBatteryReported = false;
+RTC_DATA_ATTR PowerPolicy policy; // operating profile from the supply and the charge, see PowerPolicy.h
+
+#ifdef SERIAL_EXPORT
+// logged data for tools/export_pull.py, read in place by the export (see the open/read functions)
+uint32_t openTraceExport(uint32_t& base);
+uint16_t readTraceExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len);
+uint32_t openTelemetryExport(uint32_t& base);
+uint16_t readTelemetryExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len);
+uint32_t openMetricsExport(uint32_t& base);
+uint16_t readMetricsExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len);
+#ifdef HISTORY_ENABLE
+template< uint8_t tier > uint32_t openHistoryExport(uint32_t& base);
+template< uint8_t tier > uint16_t readHistoryExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len);
+#endif
+
+const ExportStream exportStreams[] = {
+  #ifdef TRACE_ENABLE
+  { "trace", 0, openTraceExport, readTraceExport },
+  #endif
+  #ifdef TELEMETRY_ENABLE
+  { "telemetry", sizeof(TelemetryRecord), openTelemetryExport, readTelemetryExport },
+  #endif
+  { "metrics", 0, openMetricsExport, readMetricsExport },
+  #ifdef HISTORY_ENABLE
+  { "history", 0, openHistoryExport<HISTORY_RAW>, readHistoryExport<HISTORY_RAW> },
+  { "hourly", 0, openHistoryExport<HISTORY_HOURLY>, readHistoryExport<HISTORY_HOURLY> },
+  { "daily", 0, openHistoryExport<HISTORY_DAILY>, readHistoryExport<HISTORY_DAILY> },
+  #endif
+};
+SerialExport<decltype(Serial)> exporter(Serial, exportStreams, sizeof(exportStreams) / sizeof(exportStreams[0]));
+uint8_t metricsExport[decltype(metrics)::dumpMax()]; // the dump of the last open
+uint32_t metricsExportSize = 0;
+uint32_t metricsExportGeneration = 0; // the base of the metrics stream, moves with the dump
+#endif
+
+#ifdef DISPLAY_FAST_RESUME
+/**
+ * The OLED stays powered through deep sleep and keeps its configuration and RAM, so a button
+ * wake only has to switch it on. The RAM holds the main screen drawn at switch-off, the copy
+ * here becomes the framebuffer again to keep partial flushes consistent.
+ */
+struct DisplayResumeCache {
+  uint8_t frame[SCREEN_WIDTH * SCREEN_HEIGHT / 8];
+  uint16_t frameBytes;
+  bool flip;
+  bool isValid; // the panel RAM holds frame
+};
+RTC_DATA_ATTR DisplayResumeCache displayResume;
+#endif
+bool isDisplayResumed = false;
+uint32_t firstPixelUs = 0; // micros() when the panel was switched on in setup()
 
 // RTC_DATA_ATTR bool hightEndstopPressed = false;
 // RTC_DATA_ATTR bool lowEndstopPressed = false;
@@ -103,6 +426,9 @@ bool isPartiallyOpened = false;
  *  2 - closing is in progress
  */
 byte servoOperation = 0;
+unsigned long motionStartMs = 0;
+byte lastEndstops = 0xFF;
+unsigned long animMs = 0;
 bool isSleepWakeup = false;
 bool isButtonWakeup = false;
 
@@ -113,7 +439,12 @@ float batVoltage = 0;
 
 void initMenu();
 void initServo();
+void stopServo();
+void startMotion(const uint16_t targetUs);
+void superviseMotion();
 void initDisplay();
+bool resumeDisplay();
+void saveDisplayFrame();
 void toggleMainScreen(bool show);
 void renderMainScreen();
 void onMenuItemChange(const int index, const void* val, const byte valType);
@@ -128,12 +459,47 @@ void goToSleep();
 void checkTemperature();
 void readTemperature();
 void readBattery();
+void applyPowerProfile();
+void reportPower();
+uint32_t checkPeriodS();
 bool isIdleState();
 void saveSettings();
 void resetSettings();
 void manualRunServo();
 void defineWndOpenState();
-void drawBattery(int16_t x, int16_t y, byte percent/* , byte scale = 1 */);
+void sendTelemetry();
+void drainTrace(const uint16_t maxRecords = 4);
+void benchFormat();
+void armDisplayIdleTimer();
+void updateContrast();
+void idleUntilNextDeadline();
+void configureWakeup();
+void bootWake();
+void bootDht();
+bool isBootDhtDone();
+void bootPrefs();
+void bootBus();
+void bootInput();
+void bootBattery();
+void bootSensor();
+void bootHistory();
+void benchHistory();
+void reportBoot();
+void checkpointMetrics();
+void dumpMetrics();
+bool motionTask(CoTask& t);
+bool climateTask(CoTask& t);
+bool slideTask(CoTask& t);
+void tickMotionArrow();
+void slidePage(const int8_t dir);
+void finishPageSlide();
+void onDisplayIdle(void*);
+void onEndstopEdge();
+void onUiLatency(uint32_t ms);
+void serialInput();
+void replayInput(const char* line, const uint32_t now);
+ClimateRequest peerRequest();
+uint32_t peerNowMs();
 
 float mapfloat(float x, float in_min, float in_max, float out_min, float out_max)
 {
@@ -167,72 +533,123 @@ void define_wakeup_reason(){
       isButtonWakeup = false;
     }
   }
+  metrics.count(!isSleepWakeup ? M_WAKE_COLD : (isButtonWakeup ? M_WAKE_BUTTON : M_WAKE_TIMER));
 }
 
 void initDisplay() {
-  
-  Wire.begin(7,9);      
-  //SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-  if(!oled.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
-    LOGN(F("SSD1306 allocation failed"));
-  }
-  LOGN(F("SSD1306 allocation OK"));
-  // u8g2_for_adafruit_gfx.begin(oled);
-  // u8g2_for_adafruit_gfx.setFont(u8g2_font_4x6_t_cyrillic);  // icon font
-
-  if (!cfg.flip) {
-    oled.setRotation(2); // rotate 180deg
+  if (!resumeDisplay()) {
+    #ifdef DISPLAY_EPD
+    SPI.begin(EPD_SCK_PIN, -1, EPD_MOSI_PIN, EPD_CS_PIN);
+    #endif
+    //SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
+    if(!oled.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
+      LOGN(F("SSD1306 allocation failed"));
+    }
+    LOGN(F("SSD1306 allocation OK"));
+    if (oledEnabled) {
+      displayPower.beginSession(millis());
+      oled.setContrast(displayPower.contrast());
+    }
+    #ifdef DISPLAY_FAST_RESUME
+    displayResume.isValid = false;
+    #endif
   }
-  
-  // do not show Adafruit logo
-  oled.clearDisplay();
-  oled.drawPixel(0, 0, SSD1306_WHITE);
+  oled.setRotation(cfg.flip ? 0 : 2); // rotate 180deg unless flipped
   oled.cp437(true);  
   oled.setTextSize(1);             // Normal 1:1 pixel scale
   oled.setTextColor(SSD1306_WHITE);        // Draw white text  
 
-  #ifdef DEBUG_ENABLE
-  oled.println(openCloseCounts);
-  oled.println(cur_t);
-  oled.print(isFullOpened); oled.print(" | "); oled.println( isPartiallyOpened);
-  #endif
-  oled.display();
+  if (!isDisplayResumed) {
+    // do not show Adafruit logo
+    oled.clearDisplay();
+    oled.drawPixel(0, 0, SSD1306_WHITE);
+    #ifdef DEBUG_ENABLE
+    oled.println(metrics.counters[M_SERVO_OPEN] + metrics.counters[M_SERVO_CLOSE]);
+    oled.println(cur_t);
+    oled.print(isFullOpened); oled.print(" | "); oled.println( isPartiallyOpened);
+    #endif
+    oled.display();
+    #ifdef DISPLAY_FAST_RESUME
+    if (!oledEnabled) {
+      oled.setPower(false); // begin() switched it on, keep it dark on timer wakeups
+    }
+    #endif
+  }
+
+  mainScreen.add(&humWidget);
+  mainScreen.add(&tempWidget);
+  mainScreen.add(&wndStateWidget);
+  mainScreen.add(&voltageWidget);
+  mainScreen.add(&powerWidget);
+  mainScreen.add(&batteryWidget);
+  mainScreen.add(&batPersWidget);
   
   // sleep(100);
   // oled.clearDisplay();
   // oled.display();
 }
 
+/**
+ * Takes the panel over as it was left at the last switch-off, without the init sequence.
+ * Only after a deep sleep, when the panel RAM still holds the cached frame.
+ */
+bool resumeDisplay() {
+  #ifdef DISPLAY_FAST_RESUME
+  if (!isDisplayResumed && isSleepWakeup && displayResume.isValid) {
+    Wire.begin(7,9);
+    isDisplayResumed = oled.resume(SCREEN_ADDRESS, displayResume.frame, displayResume.frameBytes);
+    oled.setRotation(displayResume.flip ? 0 : 2);
+  }
+  #endif
+  return isDisplayResumed;
+}
+
+/**
+ * The picture in the panel RAM at switch-off, for resumeDisplay() after the deep sleep.
+ */
+void saveDisplayFrame() {
+  #ifdef DISPLAY_FAST_RESUME
+  displayResume.frameBytes = oled.saveFrame(displayResume.frame, sizeof(displayResume.frame));
+  displayResume.flip = cfg.flip;
+  displayResume.isValid = true;
+  #endif
+}
+
 void initMenu() {
   // menu init
   menu.onChange(onMenuItemChange, false);
   menu.onPrintOverride(onMenuItemPrintOverride);
+  menu.onPageFlush(slidePage);
   
-  menu.addItem(PSTR("VIDKR."));                                                                             // 0
-  menu.addItem(PSTR("ZAKR."));                                                                              // 1
-  menu.addItem(PSTR("STOP!"));                                                                              // 2
-  menu.addItem(PSTR("TEMPER. VIDKR."), GM_N_FLOAT(0.5), &cfg.highTemp, &cfg.lowTemp, GM_N_FLOAT(MAX_TEMP)); // 3
-  menu.addItem(PSTR("TEMPER. ZAKR."), GM_N_FLOAT(0.5), &cfg.lowTemp, GM_N_FLOAT(MIN_TEMP), &cfg.highTemp);  // 4
-  menu.addItem(PSTR("PERIOD (s)"),  GM_N_U_INT(10), &cfg.checkPeriod, GM_N_U_INT(10), GM_N_U_INT(3600));    // 5
-  menu.addItem(PSTR("Vumk. EKRAN(s)"), GM_N_U_INT(1) , &cfg.displayTimeout, GM_N_U_INT(2), &cfg.checkPeriod);// 6
-  menu.addItem(PSTR("Perev. EKRAN"), &cfg.flip);                                                             // 7
-  menu.addItem(PSTR("TEMP.CORR. (C)"), GM_N_FLOAT(0.5) , &cfg.tempCorrection, GM_N_FLOAT(-10), GM_N_FLOAT(10));// 8
-  menu.addItem(PSTR("RESET"));                                                                              // 9
+  // UTF-8, drawn with the UiFont glyphs; at most 15 letters before the value column
+  menu.addItem(PSTR("ВІДКР."));                                                                             // 0
+  menu.addItem(PSTR("ЗАКР."));                                                                              // 1
+  menu.addItem(PSTR("СТОП!"));                                                                              // 2
+  menu.addItem(PSTR("ТЕМПЕР. ВІДКР."), GM_N_FLOAT(0.5), &cfg.highTemp, &cfg.lowTemp, GM_N_FLOAT(MAX_TEMP)); // 3
+  menu.addItem(PSTR("ТЕМПЕР. ЗАКР."), GM_N_FLOAT(0.5), &cfg.lowTemp, GM_N_FLOAT(MIN_TEMP), &cfg.highTemp);  // 4
+  menu.addItem(PSTR("ПЕРІОД (с)"),  GM_N_U_INT(10), &cfg.checkPeriod, GM_N_U_INT(10), GM_N_U_INT(3600));    // 5
+  menu.addItem(PSTR("Вимк. ЕКРАН(с)"), GM_N_U_INT(1) , &cfg.displayTimeout, GM_N_U_INT(2), &cfg.checkPeriod);// 6
+  menu.addItem(PSTR("Перев. ЕКРАН"), &cfg.flip);                                                             // 7
+  menu.addItem(PSTR("КОРЕКЦ. (°C)"), GM_N_FLOAT(0.5) , &cfg.tempCorrection, GM_N_FLOAT(-10), GM_N_FLOAT(10));// 8
+  menu.addItem(PSTR("СКИНУТИ"));                                                                            // 9
   menu.addItem(PSTR("<- M ->"), GM_N_BYTE(1), &rotateDirection, GM_N_BYTE(0), GM_N_BYTE(2));                // 10 
-  menu.addItem(PSTR("<<< EXIT"));                                                                           // 11
+  menu.addItem(PSTR("<<< ВИХІД"));                                                                          // 11
 
   eb.attach(encoder_cb);
 }
 
 void initServo() {
-  servo.attach(SERVO_PIN);        // подключить
+  // PWM and power are switched on by the actuator only for a motion
+  actuator.begin();
   // servo.setSpeed(40);    // ограничить скорость
   // servo.setAccel(0.1);   	  // установить ускорение (разгон и торможение)
 }
 
 void toggleMainScreen(bool show) {
+  finishPageSlide();
   if (show == true) {
     menu.showMenu(false);
+    mainScreen.invalidate(); // the menu drew over the widgets
     renderMainScreen();
   } else {
     menu.showMenu(true);
@@ -259,11 +676,15 @@ void resetSettings() {
 
 
 void encoder_cb() {
+  GOVERN(GOV_RENDER); // menu redraws follow
+  finishPageSlide();
   switch (eb.action()) {
-    case EB_TURN:
-      LOG(F("TURN:")); LOGN(eb.dir());
+    case ENC_TURN:
+      uiLatency.input(eb.eventMs(), oled.flushes);
+      LOG(F("TURN:")); LOG(eb.dir()); LOG(F(" steps: ")); LOGN(eb.steps());
 
-      if (menu.isMenuShowing) {
+      // more than one step only when the loop was stalled long enough to overflow the queue
+      for (uint8_t i = 0; i < eb.steps() && menu.isMenuShowing; i++) {
         if (eb.dir() == 1 && !cfg.flip) {
           menu.selectPrev(eb.fast());
         } else {
@@ -272,7 +693,8 @@ void encoder_cb() {
       }
       wakeDisplayTrigger();
       break;
-    case EB_CLICK:
+    case ENC_CLICK:
+      uiLatency.input(eb.eventMs(), oled.flushes);
       wakeDisplayTrigger();
       if (menu.isMenuShowing) {
         menu.toggleChangeSelected();
@@ -283,8 +705,24 @@ void encoder_cb() {
       break;
   }
 
-  displayIdleTimer.reset();
-  displayIdleTimer.setTimeout(cfg.displayTimeout * 1000);
+  armDisplayIdleTimer();
+  displayPower.frame(oled.litPixels(), millis()); // the menu flushes by itself
+}
+
+void armDisplayIdleTimer() {
+  coop.wheel.after(displayIdleTimer, cfg.displayTimeout * 1000, millis());
+
+  displayPower.interact(millis());
+  updateContrast();
+}
+
+/**
+ * Contrast after the time since the last interaction: full, ramp down, dim stage before off.
+ */
+void updateContrast() {
+  if (oledEnabled && displayPower.update(millis(), cfg.displayTimeout * 1000)) {
+    oled.setContrast(displayPower.contrast());
+  }
 }
 
 void onMenuItemChange(const int index, const void* val, const byte valType) {
@@ -316,39 +754,11 @@ void onMenuItemChange(const int index, const void* val, const byte valType) {
 }
 
 boolean onMenuItemPrintOverride(const int index, const void* val, const byte valType) {
-  if (index == 5) {
-    unsigned int minutes = cfg.checkPeriod / 60; // [mm]
-    byte seconds = cfg.checkPeriod - (minutes * 60); // [ss]
-    if (minutes < 10) {
-      oled.print(0);
-    }
-    oled.print(minutes);
-    oled.print(":");
-    
-    if (seconds < 10) {
-      oled.print(0);
-    }
-    oled.print(seconds);
-    
-    return true;
-  } else if (index == 6) {
-    unsigned int minutes = cfg.displayTimeout / 60; // [mm]
-    byte seconds = cfg.displayTimeout - (minutes * 60); // [ss]
-    if (minutes < 10) {
-      oled.print(0);
-    }
-    oled.print(minutes);
-    oled.print(":");
-    
-    if (seconds < 10) {
-      oled.print(0);
-    }
-    oled.print(seconds);
-    
+  if (index == 5 || index == 6) {
+    char mmss[12];
+    oled.print(FixedWriter(mmss, sizeof(mmss)).mmss(index == 5 ? cfg.checkPeriod : cfg.displayTimeout).c_str());
     return true;
-  }
-  
-  else if (index == 10) {
+  } else if (index == 10) {
     char label[10] = "";
     if (rotateDirection == 0)  strcat(label,  " UP " );
     else if (rotateDirection == 2) strcat(label,  "DOwN" );
@@ -370,7 +780,7 @@ void drawBattery(int16_t x, int16_t y, byte percent/* ,  byte scale = 1 */) {
 
   oled.fillRect(x + 2, y, 12, 8, WHITE); // стенка
   // oled.drawLine(x + 2, y + 2, x+3, y+6, WHITE);
-  oled.fillRect(x + 3, y+1, map(100 - batPers, 0, 100, 0, 10), 6, BLACK);
+  oled.fillRect(x + 3, y+1, map(100 - percent, 0, 100, 0, 10), 6, BLACK);
 }
 
 
@@ -380,141 +790,219 @@ void renderMainScreen() {
   LOG("exit?: ");LOGN(!oledEnabled || menu.isMenuShowing);
   
   if (!oledEnabled || menu.isMenuShowing) return;
+  GOVERN(GOV_RENDER);
 
-  oled.clearDisplay();   
-  oled.setTextWrap(false);
-  
   readTemperature();
+  defineWndOpenState();
+  readBattery();
 
-  char hum_str[32];
-  snprintf(hum_str, sizeof(hum_str), "VOLOHIST: %.2f%%", cur_h);
-  oled.setTextSize(1);
-  oled.setCursor(20, 4);
-  oled.print(hum_str);
-  
-  
-  char temp_str[32];
-  snprintf(temp_str, sizeof(temp_str), "%.1f%", cur_t);
-  oled.setCursor(2, 16); 
-  oled.setTextSize(3);
-  oled.print(temp_str); oled.print(char(248)); oled.print("C");
+  uint32_t benchStart = BENCH_CYCLES();
+  oled.setTextWrap(false);
 
-  // #ifndef DEBUG_ENABLE
-  
-  oled.setTextSize(2);
-  oled.setCursor(4, SCREEN_HEIGHT - 18);
-  
-  defineWndOpenState();
+  char str[UI_TEXT_MAX];
+  humWidget.set(FixedWriter(str, sizeof(str)).text("ВОЛОГІСТЬ: ").percent(cur_h, 2).c_str());
+  tempWidget.set(FixedWriter(str, sizeof(str)).fixed(cur_t, 1).text("°C").c_str());
 
-  if (servoOperation > 0) {
+  if (servoOperation > 0 && (motionArrow.isActive() || !policy.params().isAnimated)) {
+    wndStateWidget.set(servoOperation == 2 ? "< < < " : "> > > ");
+  } else if (servoOperation > 0) {
+    static const char* const OPEN_FRAMES[] = { "    ", ">   ", "->  ", "--> ", "--->" };
+    static const char* const CLOSE_FRAMES[] = { "    ", "   <", "  <-", " <--", "<---" };
     animationPos += 1;
     if (animationPos >= 5) animationPos = 0;
-    oled.setTextSize(2);
-    switch (animationPos)
-    {
-      case 0: oled.print(servoOperation == 2 ? "    " : "    "); break;
-      case 1: oled.print(servoOperation == 2 ? "   <" : ">   "); break;
-      case 2: oled.print(servoOperation == 2 ? "  <-" : "->  "); break;
-      case 3: oled.print(servoOperation == 2 ? " <--" : "--> "); break;
-      case 4: oled.print(servoOperation == 2 ? "<---" : "--->"); break;
-      default: oled.print(servoOperation == 2 ? animationPos : animationPos); break;
-    }
+    wndStateWidget.set(servoOperation == 2 ? CLOSE_FRAMES[animationPos] : OPEN_FRAMES[animationPos]);
+  } else if (isPartiallyOpened) {
+    wndStateWidget.set("ЧАСТК.");
   } else {
-    if (isPartiallyOpened) {
-      oled.print( "CHASTK.");
-    } else {
-      oled.print(isFullOpened ? "VIDKR." : "ZAKR.");
-    }
-    
-  }  
-
-
-  readBattery();
-  // draw battery
-  oled.setTextSize(1);
+    wndStateWidget.set(isFullOpened ? "ВІДКР." : "ЗАКР.");
+  }
 
-  oled.setCursor(SCREEN_WIDTH - 16-26, SCREEN_HEIGHT - 23); 
-  char voltage_str[32];
-  snprintf(voltage_str, sizeof(voltage_str), "%.1f%V", batVoltage);
-  oled.printf(voltage_str);
+  voltageWidget.set(FixedWriter(str, sizeof(str)).volts(batVoltage).c_str());
+  powerWidget.set(policy.params().mark);
+  batteryWidget.set(batPers);
+  batPersWidget.set(FixedWriter(str, sizeof(str)).uint(batPers).ch('%').c_str());
 
-  if (batPers < 20) {
-    oled.setCursor(SCREEN_WIDTH - 16-26-4, SCREEN_HEIGHT - 12); 
-    oled.print("!");
+  UiRect changed = mainScreen.render(oled);
+  if (changed.isEmpty()) {
+    oled.flushedBytes = 0;
+  } else {
+    oled.displayRegion(changed.x, changed.y, changed.w, changed.h);
+    displayPower.frame(oled.litPixels(), millis());
   }
 
-  drawBattery(SCREEN_WIDTH - 16-24, SCREEN_HEIGHT - 12, batPers ); 
-  oled.setCursor(SCREEN_WIDTH - 24, SCREEN_HEIGHT - 12); // 
-  oled.print(batPers); oled.print("%");
-  
-
-  oled.display();
+  BENCH("main_frame")
+    .add("lit", oled.litPixels())
+    .add("draw_calls", mainScreen.drawCalls)
+    .add("pixels", mainScreen.pixelsTouched)
+    .add("flush_bytes", oled.flushedBytes)
+    .add("ram", oled.ramBytes())
+    .add("cycles", BENCH_CYCLES() - benchStart);
 }
 
 
 void idleDisplayTrigger(){
+  displayPower.endSession(millis());
+  LOG("Display session ms: "); LOG(displayPower.sessionMs); LOG(" avg lit: "); LOG(displayPower.averageLit());
+  LOG(" est. panel uA: "); LOGN(displayPower.averageUa());
+  BENCH("display_session")
+    .add("ms", displayPower.sessionMs)
+    .add("frames", displayPower.frames)
+    .add("avg_lit", displayPower.averageLit())
+    .add("contrast_writes", displayPower.contrastWrites)
+    .add("avg_ua", displayPower.averageUa())
+    .add("charge_uas", (uint32_t)(displayPower.chargeUaMs / 1000));
+  LOG("Input to photon ms p50: "); LOG(uiLatency.percentileMs(0.5)); LOG(" p99: "); LOG(uiLatency.percentileMs(0.99));
+  LOG(" max: "); LOG(uiLatency.maxMs); LOG(" of "); LOGN(uiLatency.samples);
+  BENCH("ui_latency")
+    .add("n", uiLatency.samples)
+    .add("p50_ms", uiLatency.percentileMs(0.5))
+    .add("p99_ms", uiLatency.percentileMs(0.99))
+    .add("max_ms", uiLatency.maxMs)
+    .add("invisible", uiLatency.invisible);
+  BENCH("display_anim")
+    .add("page_slides", pageSlide.slides)
+    .add("arrow_scrolls", motionArrow.steps);
+  #ifdef BENCH_ENABLE
+  BENCH("loop_sched")
+    .add("passes", schedPasses)
+    .add("cycles_per_pass", schedPasses ? schedCycles / schedPasses : 0)
+    .add("task_steps", coop.steps)
+    .add("timers_fired", coop.wheel.fired);
+  #endif
+
+  finishPageSlide();
+  #ifdef DISPLAY_FAST_RESUME
+  oled.setPower(false); // the main screen below goes to the panel RAM unseen
+  #endif
   menu.showMenu(false, true);
-  oled.clearDisplay();
-  oled.display();
+  if (oled.retainsImage()) {
+    // e-paper keeps showing the status through deep sleep at no cost
+    mainScreen.invalidate();
+    renderMainScreen();
+  } else {
+    #ifdef DISPLAY_FAST_RESUME
+    // shown at once by the next button wake, before the sensors are read
+    mainScreen.invalidate();
+    renderMainScreen();
+    saveDisplayFrame();
+    #else
+    oled.clearDisplay();
+    oled.display();
+    mainScreen.invalidate();
+    #endif
+  }
   
-  // oled.setPower(false);
-  oled.ssd1306_command(SSD1306_DISPLAYOFF);
+  oled.setPower(false);
   oledEnabled = false;
+
+  #ifdef ENABLE_LIGHT_SLEEP
+  byte sleepPers = idle.sleepPercent();
+  LOG("UI session light sleep: "); LOG(sleepPers); LOG("% in "); LOG(idle.sleeps); LOG(" sleeps, est. CPU current mA: ");
+  LOGN(ACTIVE_CURRENT_MA * (100 - sleepPers) / 100 + LIGHT_SLEEP_CURRENT_MA * sleepPers / 100);
+  #endif
+  #if defined(ENABLE_CPU_GOVERNOR) && defined(DEBUG_ENABLE)
+  governor.printReport(Serial);
+  #endif
   goToSleep();
 }
 
 void goToSleep() {
-  #ifndef DEBUG_ENABLE
+  #if !defined(DEBUG_ENABLE) && !defined(DISPLAY_FAST_RESUME)
   // double clear 
-  if (!oledEnabled) {
+  if (!oledEnabled && !oled.retainsImage()) {
     oled.clearDisplay();
     oled.display();
   }
   #endif
+  #ifdef TELEMETRY_ENABLE
+  if (telemetry.needFlush()) sendTelemetry();
+  #endif
+  checkpointMetrics();
   #ifdef ENABLE_SLEEP
-  LOG("Going to sleep now. Would wakeup after "); LOG(cfg.checkPeriod); LOGN(" seconds.");
+  if (!policy.params().isDeepSleep) return; // external power, the climate flow keeps the period
+  if (!isButtonWakeup) policy.observeWake(millis());
+  LOG("Going to sleep now. Would wakeup after "); LOG(checkPeriodS()); LOGN(" seconds.");
+  drainTrace(0xFFFF);
+  #ifdef ENABLE_LIGHT_SLEEP
+  configureWakeup(); // light sleep has overridden timer and gpio wakeups
+  #endif
+  actuator.holdForSleep(); // keep the servo rail and PWM pin low while sleeping
   esp_deep_sleep_start();
   #endif
 }
 
 void wakeDisplayTrigger() {
   if (!oledEnabled) {
-    oled.ssd1306_command(SSD1306_DISPLAYON);
+    #ifdef DISPLAY_FAST_RESUME
+    displayResume.isValid = false; // the panel RAM follows the UI from now on
+    #endif
+    displayPower.beginSession(millis());
+    oled.setContrast(displayPower.contrast());
+    oled.setPower(true);
     oledEnabled = true;
+    #ifdef ENABLE_LIGHT_SLEEP
+    idle.resetStats();
+    #endif
+    #ifdef ENABLE_CPU_GOVERNOR
+    governor.resetStats();
+    #endif
   }
 }
 
 bool isIdleState() {
+  #ifdef SERIAL_EXPORT
+  if (exporter.isActive(millis())) return false; // a host is pulling the logs
+  #endif
   return !oledEnabled && !servoOperation;
 }
 
 void readTemperature() {
+  // do not feed the same cached DHT value into the filters twice
+  if (isSampled && millis() - lastSampleMs < DHT_MIN_INTERVAL) return;
+  isSampled = true;
+  lastSampleMs = millis();
 
   // Reading temperature or humidity takes about 250 milliseconds!
   // Sensor readings may also be up to 2 seconds 'old' (its a very slow sensor)
+  GOVERN(GOV_SENSOR_WAIT);
   float h = dht.readHumidity();
   // Read temperature as Celsius (the default)
   float t = dht.readTemperature();
   
 
-  // Check if any reads failed and exit early (to try again).
+  metrics.count(M_DHT_READS);
   if (isnan(h) || isnan(t)) {
     LOGN(F("Failed to read from DHT sensor!"));
-    return;
+    metrics.count(M_DHT_FAILS);
+    if (++dhtFailStreak == DHT_FAIL_FAULT) {
+      TELEMETRY(TM_FAULT, TM_FAULT_SENSOR, dhtFailStreak);
+    }
+  } else {
+    dhtFailStreak = 0;
   }
-   
+  
+  // a failed read is counted here and by the filter, which keeps its last value (no early exit)
+  humFilter.push(h);
+  tempFilter.push(t);
+
   // Compute heat index in Celsius (isFahreheit = false)
   // float hic = dht.computeHeatIndex(t, h, false);
-  cur_h = h;
-  cur_t = t + cfg.tempCorrection;
+  if (humFilter.ready) cur_h = humFilter.value;
+  // correction is applied after filtering, so changing it is not slew limited
+  if (tempFilter.ready) cur_t = tempFilter.value + cfg.tempCorrection;
+  if (tempFilter.ready) metrics.set(M_TEMP_DECI, cur_t * 10);
 
-  LOG(F("Humidity: ")); LOGN(h);
-  LOG(F("Temperature: ")); LOG(t);
+  LOG(F("Humidity: ")); LOG(h); LOG(F(" filtered: ")); LOGN(cur_h);
+  LOG(F("Temperature: ")); LOG(t); LOG(F(" filtered: ")); LOG(cur_t);
+  LOG(F(" missed: ")); LOG(tempFilter.missed); LOG(F(" rejected: ")); LOGN(tempFilter.rejected);
 
   // renderMainScreen();
 }
 
 void readBattery() {
+  // INA219 runs shunt only conversions during a motion, keep the last values
+  if (motionCurrent.isActive()) return;
+
   float shuntvoltage = 0;
   float busvoltage = 0;
   float current_mA = 0;
@@ -532,84 +1020,196 @@ void readBattery() {
   float minV = is12vPow ? 10.8 : (float)3.2 * LION_BATTERIES_COUNT; 
   float maxV = is12vPow ? 12.6 : (float)4.2 * LION_BATTERIES_COUNT;
   
-  LOGN("vMin:"); LOG(minV); LOG(" maxV:"); LOGN(maxV);
+  TRACE(TR_BATTERY_RANGE, minV, maxV);
   batPers = mapfloat(loadvoltage, minV, maxV, 0, 100);
 
   if (batPers > 100 ) batPers = 100;
   if (batPers < 0 ) batPers = 0;
 
   batVoltage = loadvoltage;
+  metrics.set(M_BATTERY_MV, loadvoltage * 1000);
+  metrics.set(M_BATTERY_PERCENT, batPers);
+
+  // the policy takes the charge of the Li-ion pack, also on the way to or from the supply
+  float cellsPercent = mapfloat(loadvoltage, 3.2 * LION_BATTERIES_COUNT, 4.2 * LION_BATTERIES_COUNT, 0, 100);
+  if (!isButtonWakeup) policy.observeCurrent(current_mA);
+  if (policy.update(loadvoltage * 1000, constrain(cellsPercent, 0.0f, 100.0f), 4200 * LION_BATTERIES_COUNT)) {
+    applyPowerProfile();
+  }
+
+  // report low battery once per discharge
+  if (!is12vPow && batPers < 20) {
+    if (!isLowBatteryReported) {
+      TELEMETRY(TM_FAULT, TM_FAULT_LOW_BATTERY, batPers, 0, loadvoltage * 1000);
+      isLowBatteryReported = true;
+      #ifdef HISTORY_ENABLE
+      history.flush(); // the batches in RTC memory go with the battery
+      #endif
+    }
+  } else if (batPers > 25) {
+    isLowBatteryReported = false;
+  }
 
-  LOGN("----");
-  LOG("Bus Voltage:   "); LOG(busvoltage); LOGN(" V");
-  LOG("Shunt Voltage: "); LOG(shuntvoltage); LOGN(" mV");
-  LOG("Load Voltage:  "); LOG(loadvoltage); LOGN(" V");
-  LOG("Current:       "); LOG(current_mA); LOGN(" mA");
-  LOG("Power:         "); LOG(power_mW); LOGN(" mW");
-  LOG("percents :     "); LOG(batPers); LOGN(" %");
-  LOGN("----");
+  TRACE(TR_BATTERY, loadvoltage, current_mA, batPers);
+  TRACE(TR_BATTERY_SHUNT, busvoltage, shuntvoltage, power_mW);
+}
+
+/**
+ * A new power profile: panel contrast, and on external power the loop stays awake with
+ * the climate flow doing the checks. The period, animations, the deferral and the screen
+ * mark follow policy.params() where they are used.
+ */
+void applyPowerProfile() {
+  const PowerProfileParams& p = policy.params();
+  TRACE(TR_POWER_PROFILE, policy.previous(), policy.profile, batVoltage);
+  LOG("Power profile: "); LOGN(p.name);
+  metrics.count(M_POWER_SWITCHES);
+  metrics.set(M_POWER_PROFILE, policy.profile);
+
+  displayPower.setFull(p.contrast); // the loop sends it with the next updateContrast()
+  #ifdef ENABLE_SLEEP
+  if (!p.isDeepSleep) {
+    coop.start(TASK_CLIMATE);
+  }
+  #endif
+}
+
+/**
+ * Check period of the profile, seconds.
+ */
+uint32_t checkPeriodS() {
+  return cfg.checkPeriod * policy.params().periodScale;
+}
+
+/**
+ * Projected unattended runtime per profile on the charge left.
+ */
+void reportPower() {
+  float hours[POWER_PROFILES_COUNT];
+  for (uint8_t i = 0; i < POWER_PROFILES_COUNT; i++) {
+    hours[i] = policy.runtimeHours((PowerProfile)i, cfg.checkPeriod, BATTERY_CAPACITY_MAH);
+  }
+  metrics.set(M_POWER_PROFILE, policy.profile);
+  metrics.set(M_RUNTIME_H, hours[policy.profile]);
+  LOG("Power profile: "); LOG(policy.params().name); LOG(" runtime h external: "); LOG(hours[POWER_EXTERNAL]);
+  LOG(" battery: "); LOG(hours[POWER_BATTERY]); LOG(" low: "); LOGN(hours[POWER_LOW]);
+  BENCH("power")
+    .add("profile", policy.params().name)
+    .add("awake_ma", policy.awakeMa)
+    .add("awake_ms", policy.awakeMs)
+    .add("external_h", hours[POWER_EXTERNAL])
+    .add("battery_h", hours[POWER_BATTERY])
+    .add("low_h", hours[POWER_LOW])
+    .add("switches", policy.switches)
+    .add("deferred", policy.deferred);
 }
 
 void checkTemperature() {
 
-  LOG("display on: "); LOG(oledEnabled);LOG(" opened: "); LOGN(isFullOpened);
-  LOG("LOW: "); LOG(cfg.lowTemp); LOG(" CUR: "); LOG(cur_t); LOG(" HI: "); LOGN(cfg.highTemp);
+  TRACE(TR_CHECK_STATE, oledEnabled, isFullOpened, tempFilter.ready);
+  TRACE(TR_CHECK, cfg.lowTemp, cur_t, cfg.highTemp);
   
-  if (cur_t >= cfg.highTemp && !forceStop) {
-    openValve();
-  } else if (cur_t < cfg.lowTemp && !forceStop) {
-    closeValve();
+  #ifdef PEER_SYNC_ENABLE
+  ClimateRequest request = peerRequest();
+  #else
+  ClimateRequest request = climateRequest(tempFilter.ready, cur_t, cfg.lowTemp, cfg.highTemp, forceStop);
+  #endif
+
+  // on a low battery a motion waits for a few checks while the temperature is close to the band
+  bool isDue = servoOperation == 0 &&
+    ((request == CLIMATE_OPEN && climateNeedsOpen(isFullOpened, isPartiallyOpened)) ||
+     (request == CLIMATE_CLOSE && climateNeedsClose(isFullOpened, isPartiallyOpened)));
+  if (!isDue) {
+    policy.settle();
+  } else if (policy.defer((request == CLIMATE_OPEN ? cur_t - cfg.highTemp : cfg.lowTemp - cur_t) * 10)) {
+    TRACE(TR_POWER_DEFER, request, cur_t, policy.deferrals);
+    metrics.count(M_POWER_DEFERRED);
+    request = CLIMATE_KEEP;
+  }
+
+  switch (request) {
+    case CLIMATE_OPEN: openValve(); break;
+    case CLIMATE_CLOSE: closeValve(); break;
+    default: break;
   }
 
   if (isIdleState()) goToSleep();
 }
 
+#ifdef PEER_SYNC_ENABLE
+/**
+ * Shares the reading with the other units in the room and returns what this one should do.
+ */
+ClimateRequest peerRequest() {
+  uint32_t periodMs = cfg.checkPeriod * 1000;
+  peer.setLocal(tempFilter.ready, cur_t, isFullOpened | isPartiallyOpened << 1, forceStop);
+
+  unsigned long start = millis();
+  peer.exchange(peerLink, peerNowMs(), periodMs);
+  uint32_t radioMs = millis() - start;
+
+  peer.expire(peerNowMs(), periodMs);
+  ClimateRequest request = peer.decide(cfg.lowTemp, cfg.highTemp, peerNowMs(), periodMs);
+  TRACE(TR_PEER, peer.peersCount, peer.isLeader(), request, radioMs);
+  return request;
+}
+
+/**
+ * Unit clock for the slots, the RTC keeps it through deep sleep (millis() restarts).
+ */
+uint32_t peerNowMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+#endif
+
 void openValve() {
-  LOG("onOpen: servOp: "); LOG(servoOperation); LOG(" isFullOpened: "); LOG(isFullOpened); LOG(" isPartOpened: "); LOGN(isPartiallyOpened);
+  TRACE(TR_OPEN_REQ, servoOperation, isFullOpened, isPartiallyOpened);
   if (servoOperation > 0) return; // action is already in progress;
-  if (isFullOpened) {
-    if (!isPartiallyOpened) {      
-      LOGN(">>>> Value is opened already. Noting to do.");
-      return;
-    } // else need to open fully
+  if (!climateNeedsOpen(isFullOpened, isPartiallyOpened)) {
+    TRACE(TR_OPEN_SKIP);
+    return;
   }
 
-  LOG("!!!! Open valve with "); LOGN(ROTATE_UPWARD);
+  TRACE(TR_OPEN, ROTATE_UPWARD);
 
   servoOperation = 1;
-  servo.writeMicroseconds(ROTATE_UPWARD);
+  motionStartMs = millis();
+  TELEMETRY(TM_ACTUATION, TM_ACT_OPEN, cur_t * 10);
+  HISTORY(HISTORY_ACT_OPEN);
   forceStop = false;
-  delay(KICK_DELAY); // wait few secconds to release endststop switch
-  #ifdef DEBUG_ENABLE
-  openCloseCounts++;
-  #endif
+  startMotion(ROTATE_UPWARD);
+  metrics.count(M_SERVO_OPEN);
 }
 
 void closeValve() {
-  LOG("onClose: servOp: "); LOG(servoOperation); LOG(" isFullOpened: "); LOG(isFullOpened); LOG(" isPartOpened: "); LOGN(isPartiallyOpened);
+  TRACE(TR_CLOSE_REQ, servoOperation, isFullOpened, isPartiallyOpened);
   if (servoOperation > 0) return; // action is already in progress;
-  if (!isFullOpened) {
-    if (!isPartiallyOpened) {
-      LOGN("<<<< Value is closed already. Noting to do.");
-      return;
-    } // else need to close fully
+  if (!climateNeedsClose(isFullOpened, isPartiallyOpened)) {
+    TRACE(TR_CLOSE_SKIP);
+    return;
   }
-  LOG("!!!! Close valve with "); LOGN(ROTATE_DOWNWARD);
+  TRACE(TR_CLOSE, ROTATE_DOWNWARD);
   servoOperation = 2;
-  servo.writeMicroseconds(ROTATE_DOWNWARD);
+  motionStartMs = millis();
+  TELEMETRY(TM_ACTUATION, TM_ACT_CLOSE, cur_t * 10);
+  HISTORY(HISTORY_ACT_CLOSE);
   forceStop = false;
-  delay(KICK_DELAY); // wait few secconds to release endststop switch
-  #ifdef DEBUG_ENABLE
-  openCloseCounts++;
-  #endif
+  startMotion(ROTATE_DOWNWARD);
+  metrics.count(M_SERVO_CLOSE);
   
 }
 
 void stopValveAction() {
+  TELEMETRY(TM_ACTUATION, TM_ACT_STOP, cur_t * 10);
+  HISTORY(HISTORY_ACT_STOP);
+  metrics.count(M_SERVO_STOP);
   forceStop = true;
-  servo.writeMicroseconds(ROTATE_STOP);
+  coop.stop(TASK_MOTION);
+  motionArrow.end();
+  stopServo();
   servoOperation = 0;
-  animTimer.reset();
   toggleMainScreen(true);  
   defineWndOpenState();
 }
@@ -630,73 +1230,645 @@ void defineWndOpenState() {
   // }
 }
 
+/**
+ * Brings the servo to neutral and cuts its rail. The INA219 current right before and
+ * after the cut is the idle current saved by the gating.
+ */
+void stopServo() {
+  if (motionCurrent.isActive()) {
+    motionCurrent.end();
+    ina219.setCalibration_32V_2A(); // back to the normal INA219 setup
+
+    TRACE(TR_MOTION_CURRENT, motionCurrent.sampleRateHz(), motionCurrent.peakMa, motionCurrent.latencyMs);
+    LOG("Motion current: "); LOG(motionCurrent.sampleRateHz()); LOG(" Hz, peak mA: "); LOG(motionCurrent.peakMa);
+    LOG(" stall latency ms: "); LOGN(motionCurrent.latencyMs);
+  }
+
+  if (!actuator.isPowered()) return;
+
+  actuator.stop();
+  float poweredMa = ina219.getCurrent_mA();
+  actuator.powerOff();
+  delay(INA219_CONVERSION_MS);
+  float gatedMa = ina219.getCurrent_mA();
+
+  servoIdleSavingMa = poweredMa - gatedMa;
+  TRACE(TR_SERVO_IDLE, poweredMa, gatedMa);
+  LOG("Servo idle current mA: powered "); LOG(poweredMa); LOG(" gated "); LOGN(gatedMa);
+}
+
+/**
+ * Starts the servo with a current limited speed ramp and samples the current fast
+ * for stall detection until stopServo(); motionTask() drives the rest of the motion.
+ */
+void startMotion(const uint16_t targetUs) {
+  motionCurrent.begin(STALL_CURRENT_MA, STALL_WINDOW_MS);
+  motionTargetUs = targetUs;
+  motionUs = ROTATE_STOP;
+  rampStepMs = 0;
+  actuator.run(motionUs);
+  coop.start(TASK_MOTION);
+}
+
+void superviseMotion() {
+  motionCurrent.sample();
+
+  if (motionUs == motionTargetUs || millis() - rampStepMs < SOFT_START_STEP_MS) return;
+  // hold the ramp while the motor pulls more than the limit (no sample of this motion yet: no hold)
+  if (motionCurrent.hasSample() && motionCurrent.lastMa() > SOFT_START_LIMIT_MA) return;
+
+  rampStepMs = millis();
+  if (motionTargetUs > motionUs) {
+    motionUs = motionTargetUs - motionUs > SOFT_START_STEP_US ? motionUs + SOFT_START_STEP_US : motionTargetUs;
+  } else {
+    motionUs = motionUs - motionTargetUs > SOFT_START_STEP_US ? motionUs - SOFT_START_STEP_US : motionTargetUs;
+  }
+  actuator.run(motionUs);
+}
+
+/**
+ * One valve motion after startMotion(): the kick off the endstop, the run to the other end
+ * under current supervision, then the new window state and a temperature check.
+ * The ramp and the stall detection sample on every pass, the end position is read after
+ * an endstop edge (and with every animation frame, in case an edge got lost).
+ * With a content scroll on the panel the arrow moves by scroll commands between the frames.
+ */
+bool motionTask(CoTask& t) {
+  CO_BEGIN(t);
+  CO_LISTEN(t, EV_ENDSTOP);
+  if (policy.params().isAnimated && motionArrow.begin(oled, wndStateWidget.rect.x, wndStateWidget.rect.y, MOTION_ARROW_W,
+                        wndStateWidget.rect.h, servoOperation == 2, MOTION_SCROLL_MS)) {
+    renderMainScreen(); // the pattern the panel scrolls
+  }
+
+  // leave the endstop while ramping up, its contacts do not tell the end position yet
+  while (millis() - motionStartMs < KICK_DELAY && !motionCurrent.isStalled()) {
+    superviseMotion();
+    tickMotionArrow();
+    CO_YIELD(t);
+  }
+  t.events = EV_ENDSTOP;
+  animMs = millis();
+
+  while (true) {
+    armDisplayIdleTimer();
+
+    if (millis() - motionStartMs > MOTION_TIMEOUT) {
+      TRACE(TR_MOTION_TIMEOUT, servoOperation, millis() - motionStartMs);
+      metrics.count(M_MOTION_TIMEOUT);
+      TELEMETRY(TM_FAULT, TM_FAULT_MOTION_TIMEOUT, servoOperation);
+      stopValveAction();
+      CO_EXIT(t);
+    }
+
+    superviseMotion();
+    if (motionCurrent.isStalled()) {
+      TRACE(TR_MOTION_STALL, servoOperation, motionCurrent.lastMa(), motionCurrent.latencyMs);
+      metrics.count(M_MOTION_STALL);
+      TELEMETRY(TM_FAULT, TM_FAULT_STALL, servoOperation, motionCurrent.peakMa);
+      stopValveAction();
+      CO_EXIT(t);
+    }
+
+    tickMotionArrow();
+    if (millis() - animMs >= MOTION_ANIM_MS) {
+      animMs = millis();
+      renderMainScreen();
+      t.events |= EV_ENDSTOP;
+    }
+
+    if (t.events & EV_ENDSTOP) {
+      t.events = 0;
+      bool lowEndstopPressed = digitalRead(LOW_ENDSTOP_PIN);
+      bool hightEndstopPressed = digitalRead(HIGHT_ENDSTOP_PIN);
+
+      // trace endstop changes only
+      byte endstops = hightEndstopPressed | lowEndstopPressed << 1;
+      if (endstops != lastEndstops) {
+        TRACE(TR_MOTION, servoOperation, hightEndstopPressed, lowEndstopPressed);
+        lastEndstops = endstops;
+      }
+
+      if (
+        (servoOperation == 1 && !hightEndstopPressed && !lowEndstopPressed) || // for opening trigger stop when both endstops is released
+        (servoOperation == 2 && hightEndstopPressed && lowEndstopPressed) // for closing trigger stop when both endstops is pressed
+      ) {
+        break;
+      }
+    }
+
+    CO_YIELD(t);
+  }
+
+  motionArrow.end();
+  stopServo();
+  TRACE(TR_MOTION_DONE, servoOperation, millis() - motionStartMs);
+  metrics.observe(M_MOTION_MS, millis() - motionStartMs);
+  metrics.observe(M_MOTION_PEAK_MA, motionCurrent.peakMa > 0 ? motionCurrent.peakMa : 0);
+  servoOperation = 0;
+  renderMainScreen();
+  defineWndOpenState();
+  checkTemperature(); // may start the next motion, coop.start() restarts this flow then
+  CO_END(t);
+}
+
+/**
+ * Sensor period without deep sleep (no ENABLE_SLEEP, or on external power): what a timer
+ * wake does.
+ */
+bool climateTask(CoTask& t) {
+  CO_BEGIN(t);
+  while (true) {
+    CO_AWAIT_MS(t, checkPeriodS() * 1000);
+    readBattery();
+    readTemperature();
+    if (tempFilter.ready) {
+      HISTORY(HISTORY_ACT_NONE);
+    }
+    checkTemperature();
+  }
+  CO_END(t);
+}
+
+/**
+ * Scroll steps only while the main screen is on the panel, not over the menu.
+ */
+void tickMotionArrow() {
+  if (oledEnabled && !menu.isMenuShowing) {
+    motionArrow.tick(millis());
+  }
+}
+
+/**
+ * Menu page change: the new page slides in band by band, the first band goes out right away.
+ * Panels without a start line (e-paper) get the whole page.
+ */
+void slidePage(const int8_t dir) {
+  if (!policy.params().isAnimated || !pageSlide.begin(oled, dir)) {
+    oled.display();
+    return;
+  }
+  pageSlide.step();
+  coop.start(TASK_SLIDE);
+}
+
+bool slideTask(CoTask& t) {
+  CO_BEGIN(t);
+  while (pageSlide.isActive()) {
+    CO_AWAIT_MS(t, PAGE_SLIDE_STEP_MS);
+    pageSlide.step();
+  }
+  CO_END(t);
+}
+
+/**
+ * The rest of a running slide at once, before anything else is drawn.
+ */
+void finishPageSlide() {
+  if (pageSlide.isActive()) {
+    pageSlide.finish();
+    coop.stop(TASK_SLIDE);
+  }
+}
+
+void onDisplayIdle(void*) {
+  #ifdef SERIAL_EXPORT
+  if (exporter.isActive(millis())) {
+    // no deep sleep under a running export, look again later
+    coop.wheel.after(displayIdleTimer, EXPORT_IDLE_MS, millis());
+    return;
+  }
+  #endif
+  idleDisplayTrigger();
+}
+
+void IRAM_ATTR onEndstopEdge() {
+  coop.signalFromIsr(EV_ENDSTOP);
+}
+
 void manualRunServo() {
   LOG("Manual rotate: "); LOGN(rotateDirection);
+  TELEMETRY(TM_ACTUATION, TM_ACT_MANUAL, cur_t * 10, rotateDirection);
+  HISTORY(HISTORY_ACT_MANUAL);
   switch (rotateDirection)
   {
   case 0:
     // max forward rotate (open valve)
-    servo.writeMicroseconds(ROTATE_UPWARD);
+    actuator.run(ROTATE_UPWARD);
     break;
   case 1: 
     // no rotation
-    servo.writeMicroseconds(ROTATE_STOP);
+    stopServo();
     break;
   case 2: 
     // max backward rotatie (close valve)
-    servo.writeMicroseconds(ROTATE_DOWNWARD);
+    actuator.run(ROTATE_DOWNWARD);
     break;
   }
   // servo.setCurrentDeg(rotateDirection);
 }
 
-void setup() {
+void sendTelemetry() {
+  #ifdef TELEMETRY_ENABLE
+  bool ok = telemetry.flush(uplink, (uint32_t)ESP.getEfuseMac(), time(nullptr));
+
+  LOG("Telemetry batch "); LOG(ok ? "sent" : "failed"); LOG(" bytes: "); LOG(telemetry.stats.lastBatchSize);
+  LOG(" radio on ms: "); LOG(telemetry.stats.lastRadioOnMs);
+  LOG(" radio us per sample: "); LOG(telemetry.radioUsPerRecord());
+  LOG(" retry after wakes: "); LOGN(telemetry.retryWakes);
+  #endif
+}
+
+/**
+ * Prints pending trace events; from loop() only a few per pass to keep it responsive.
+ * Without DEBUG_ENABLE events stay in the RTC ring, which keeps the latest ones as a
+ * flight recorder for the serial export.
+ */
+void drainTrace(const uint16_t maxRecords) {
+  #if defined(TRACE_ENABLE) && defined(DEBUG_ENABLE)
+  #ifdef SERIAL_EXPORT
+  if (exporter.isActive(millis())) return; // the export reads the ring in place
+  #endif
+  if (traceRing.dropped > 0) {
+    uint16_t dropped = traceRing.dropped;
+    traceRing.dropped = 0;
+    TRACE(TR_DROPPED, dropped);
+  }
+  traceRing.drain(Serial, maxRecords);
+  #endif
+}
+
+/**
+ * Saves the metrics to NVS every METRICS_CHECKPOINT_UPDATES updates, a reset loses less.
+ */
+void checkpointMetrics() {
+  if (!metrics.needCheckpoint(METRICS_CHECKPOINT_UPDATES)) return;
+
+  metrics.count(M_CHECKPOINTS);
+  uint8_t buf[metrics.dumpMax()];
+  size_t len = metrics.dump(buf, sizeof(buf));
+  if (len && prefs.putBytes("m", buf, len) == len) {
+    metrics.checkpointed();
+  }
+  dumpMetrics();
+}
+
+/**
+ * "#M<hex>" line for tools/metrics_decode.py.
+ */
+void dumpMetrics() {
   #ifdef DEBUG_ENABLE
+  metrics.printDump(Serial);
+  #endif
+}
+
+#ifdef SERIAL_EXPORT
+/**
+ * Trace ring bytes from the tail on, whole records. Not consumed, drainTrace() waits
+ * while the export runs; base is the tail, a drain or an overwrite of the oldest
+ * records in between makes it another stream.
+ */
+uint32_t openTraceExport(uint32_t& base) {
+  #ifdef TRACE_ENABLE
+  uint16_t tail = traceRing.tail.load(std::memory_order_relaxed);
+  base = tail;
+  return (uint16_t)(traceRing.head.load(std::memory_order_acquire) - tail);
+  #else
+  base = 0;
+  return 0;
+  #endif
+}
+
+uint16_t readTraceExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len) {
+  #ifdef TRACE_ENABLE
+  if ((uint16_t)base != traceRing.tail.load(std::memory_order_acquire)) return 0;
+  for (uint16_t k = 0; k < len; k++) {
+    out[k] = traceRing.buf[(uint16_t)(base + offset + k) & (TRACE_BUFFER_SIZE - 1)];
+  }
+  // a write makes room before it overwrites, an unchanged tail means the copy is whole
+  return (uint16_t)base == traceRing.tail.load(std::memory_order_acquire) ? len : 0;
+  #else
+  return 0;
+  #endif
+}
+
+/**
+ * Queued telemetry records, oldest first, as the raw structs. base counts the records
+ * which left the queue (sent or overwritten), so it is the number of the oldest one.
+ */
+uint32_t openTelemetryExport(uint32_t& base) {
+  #ifdef TELEMETRY_ENABLE
+  base = telemetry.stats.records + telemetry.stats.dropped;
+  return telemetry.count * sizeof(TelemetryRecord);
+  #else
+  base = 0;
+  return 0;
+  #endif
+}
+
+uint16_t readTelemetryExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len) {
+  #ifdef TELEMETRY_ENABLE
+  const uint32_t first = telemetry.stats.records + telemetry.stats.dropped;
+  const uint32_t from = base + offset / sizeof(TelemetryRecord) - first;
+  const uint32_t to = base + (offset + len - 1) / sizeof(TelemetryRecord) - first;
+  if (base + offset / sizeof(TelemetryRecord) < first || to >= telemetry.count) return 0; // sent or overwritten meanwhile
+
+  for (uint16_t k = 0; k < len; k++) {
+    uint32_t i = from + (offset % sizeof(TelemetryRecord) + k) / sizeof(TelemetryRecord);
+    const uint8_t* rec = (const uint8_t*)&telemetry.records[(telemetry.head + i) % TELEMETRY_QUEUE_SIZE];
+    out[k] = rec[(offset + k) % sizeof(TelemetryRecord)];
+  }
+  return len;
+  #else
+  return 0;
+  #endif
+}
+
+/**
+ * The metrics dump (as printDump() and the NVS checkpoint), encoded at open. base is a
+ * generation counted up whenever the dump differs from the last one, so the host sees
+ * a changed dump and a get of an older one reads nothing.
+ */
+uint32_t openMetricsExport(uint32_t& base) {
+  uint8_t dump[sizeof(metricsExport)];
+  size_t size = metrics.dump(dump, sizeof(dump));
+  if (size != metricsExportSize || memcmp(dump, metricsExport, size)) {
+    memcpy(metricsExport, dump, size);
+    metricsExportSize = size;
+    metricsExportGeneration++;
+  }
+  base = metricsExportGeneration;
+  return size;
+}
+
+uint16_t readMetricsExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len) {
+  if (base != metricsExportGeneration) {
+    return 0;
+  }
+  memcpy(out, metricsExport + offset, len);
+  return len;
+}
+
+#ifdef HISTORY_ENABLE
+/**
+ * A history tier as its 256 byte flash pages, oldest first (the partial batch is written
+ * at open). base moves when the ring recycles its oldest sector.
+ */
+template< uint8_t tier >
+uint32_t openHistoryExport(uint32_t& base) {
+  return history.exportOpen(tier, base);
+}
+
+template< uint8_t tier >
+uint16_t readHistoryExport(const uint32_t base, const uint32_t offset, uint8_t* out, const uint16_t len) {
+  return history.exportRead(tier, base, offset, out, len);
+}
+#endif
+#endif
+
+/**
+ * Every measured input to photon latency: the long term histogram survives deep sleep,
+ * single inputs slower than the p99 budget go to the trace.
+ */
+void onUiLatency(uint32_t ms) {
+  metrics.observe(M_UI_LATENCY_MS, ms);
+  if (ms > UI_LATENCY_BUDGET_MS) {
+    TRACE(TR_UI_SLOW, ms, UI_LATENCY_BUDGET_MS);
+  }
+}
+
+/**
+ * Host lines from the serial port: export commands ("x ...", see SerialExport.h) and the
+ * scripted input of UI_LATENCY_REPLAY.
+ */
+void serialInput() {
+  #if defined(UI_LATENCY_REPLAY) || defined(SERIAL_EXPORT)
+  static char line[32];
+  static uint8_t len = 0;
+
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (len < sizeof(line) - 1) line[len++] = c;
+      continue;
+    }
+    line[len] = '\0';
+    len = 0;
+
+    uint32_t now = millis();
+    #ifdef SERIAL_EXPORT
+    if (exporter.command(line, now)) continue;
+    #endif
+    replayInput(line, now);
+  }
+  #endif
+}
+
+/**
+ * Scripted input from the serial port (tools/ui_replay.py), one command per line:
+ *   inc / dec   one encoder detent of dir() 1 / -1, fed through the quadrature decoder as pin edges
+ *   click       press and release, the release now so the click is seen after the debounce
+ *   report      prints the UiLatencyTracker report line
+ *   reset       clears the latencies
+ * The edges are timestamped on arrival, the serial transport is not part of the latency.
+ * They enter the encoder ring from the loop task, so leave the real encoder alone meanwhile.
+ */
+void replayInput(const char* line, const uint32_t now) {
+  #ifdef UI_LATENCY_REPLAY
+  if (!strcmp(line, "inc") || !strcmp(line, "dec")) {
+    // A | B << 1 from the detent at 0b11, four counted transitions
+    static const uint8_t TURN_INC[] = { 0b01, 0b00, 0b10, 0b11 };
+    static const uint8_t TURN_DEC[] = { 0b10, 0b00, 0b01, 0b11 };
+    const uint8_t* states = line[0] == 'i' ? TURN_INC : TURN_DEC;
+    for (uint8_t i = 0; i < 4; i++) {
+      eb.onEncoder(states[i] & 1, states[i] >> 1, now);
+    }
+  } else if (!strcmp(line, "click")) {
+    eb.onButton(true, now - ENC_ISR_DEBOUNCE_MS * 3);
+    eb.onButton(false, now);
+  } else if (!strcmp(line, "report")) {
+    uiLatency.printReport(Serial);
+  } else if (!strcmp(line, "reset")) {
+    uiLatency.reset();
+    Serial.println("UI_LATENCY reset");
+  }
+  #endif
+}
+
+/**
+ * Cycles per main screen string, printf against FixedWriter.
+ */
+void benchFormat() {
+  #ifdef BENCH_ENABLE
+  const uint8_t runs = 32;
+  char str[UI_TEXT_MAX];
+  float val = 23.45;
+
+  uint32_t start = BENCH_CYCLES();
+  for (uint8_t i = 0; i < runs; i++) {
+    snprintf(str, sizeof(str), "ВОЛОГІСТЬ: %.2f%%", val + i);
+  }
+  uint32_t printfCycles = (BENCH_CYCLES() - start) / runs;
+
+  start = BENCH_CYCLES();
+  for (uint8_t i = 0; i < runs; i++) {
+    FixedWriter(str, sizeof(str)).text("ВОЛОГІСТЬ: ").percent(val + i, 2);
+  }
+  uint32_t fixedCycles = (BENCH_CYCLES() - start) / runs;
+
+  BENCH("format").add("printf_cycles", printfCycles).add("fixed_cycles", fixedCycles);
+
+  // one label of the same length in ASCII and in UiFont glyphs, drawn where the menu draws
+  const char* ascii = "TEMPER. VIDKR.";
+  const char* utf8 = "ТЕМПЕР. ВІДКР.";
+  oled.setTextSize(1);
+  oled.setTextColor(WHITE);
+  start = BENCH_CYCLES();
+  for (uint8_t i = 0; i < runs; i++) {
+    oled.setCursor(2, 2);
+    oled.print(ascii);
+  }
+  uint32_t asciiCycles = (BENCH_CYCLES() - start) / runs;
+
+  uiFont().setFont(uiFont().font()); // empty cache
+  start = BENCH_CYCLES();
+  oled.setCursor(2, 2);
+  oled.print(utf8);
+  uint32_t coldCycles = BENCH_CYCLES() - start;
+
+  start = BENCH_CYCLES();
+  for (uint8_t i = 0; i < runs; i++) {
+    oled.setCursor(2, 2);
+    oled.print(utf8);
+  }
+  uint32_t warmCycles = (BENCH_CYCLES() - start) / runs;
+  mainScreen.invalidate(); // drew over the widgets
+  renderMainScreen();
+
+  BENCH("font")
+    .add("flash", FONT_UA5X8.bytes)
+    .add("glyphs", FONT_UA5X8.glyphCount)
+    .add("ascii_cycles", asciiCycles)
+    .add("cold_cycles", coldCycles)
+    .add("cached_cycles", warmCycles)
+    .add("cache_misses", uiFont().misses);
+  #endif
+}
+
+/**
+ * A one day range query of the history through the sector index, and the flash wear so far.
+ */
+void benchHistory() {
+  #if defined(BENCH_ENABLE) && defined(HISTORY_ENABLE)
+  if (!history.isReady()) return;
+  uint32_t to = history.timeOf(time(nullptr));
+  uint32_t start = BENCH_CYCLES();
+  uint32_t samples = history.querySamples(to > 86400 ? to - 86400 : 0, to, [](const HistorySample&) {});
+  uint32_t queryCycles = BENCH_CYCLES() - start;
+
+  const HistoryStats& stats = history.state().stats;
+  BENCH("history")
+    .add("day_samples", samples)
+    .add("query_cycles", queryCycles)
+    .add("page_writes", stats.pageWrites)
+    .add("erases", stats.erases)
+    .add("failed", stats.failed)
+    .add("dropped", stats.dropped);
+  #endif
+}
+
+void setup() {
+  #ifdef ENABLE_CPU_GOVERNOR
+  governor.begin(GOV_RENDER); // boot at full speed to keep the wake short
+  #endif
+  #if defined(DEBUG_ENABLE) || defined(BENCH_ENABLE) || defined(UI_LATENCY_REPLAY) || defined(SERIAL_EXPORT)
+  #ifdef SERIAL_EXPORT
+  Serial.setTxBufferSize(EXPORT_WINDOW * EXPORT_FRAME_MAX); // a window of frames without waiting for the host
+  #endif
   Serial.begin(115200);
   // pinMode(LED_PIN, OUTPUT); 
   // delay(5000);
   #endif
 
-  prefs.begin("0");
-  prefs.getBytes("0", &cfg, sizeof(cfg));
-  
-  pinMode(HIGHT_ENDSTOP_PIN, INPUT_PULLUP);
-  pinMode(LOW_ENDSTOP_PIN, INPUT_PULLUP);
-  // hightEndstor.setDebTimeout(255);
-  // lowEndstor.setDebTimeout(255);
-
-  // attachInterrupt(HIGHT_ENDSTOP_PIN, on_hight_endstop_change, CHANGE);
-  // attachInterrupt(LOW_ENDSTOP_PIN, on_low_endstop_change, CHANGE);
-  // hightEndstor.attach(on_hight_endstop_change);
-  // lowEndstor.attach(on_low_endstop_change);
-  
-  define_wakeup_reason();
-  LOG("Is awaked from sleep?: ");LOGN(isSleepWakeup);
-  LOG("Is awaked by Btn?: "); LOGN(isButtonWakeup);
+  uiFont().setFont(&FONT_UA5X8); // the labels are UTF-8 Ukrainian
+  uiLatency.onSample = onUiLatency;
+  coop.begin(millis());
+  coop.add(motionTask, "motion");
+  coop.add(climateTask, "climate");
+  coop.add(slideTask, "slide");
+  displayIdleTimer.fn = onDisplayIdle;
+
+  // independent phases overlap: the panel and the INA219 are set up while the DHT sleeps
+  boot.add("wake", bootWake);
+  boot.add("dht", bootDht, isBootDhtDone);
+  boot.add("prefs", bootPrefs, nullptr, BOOT_AFTER(BOOT_WAKE));
+  boot.add("bus", bootBus);
+  boot.add("input", bootInput);
+  boot.add("display", initDisplay, nullptr, BOOT_AFTER(BOOT_WAKE) | BOOT_AFTER(BOOT_PREFS) | BOOT_AFTER(BOOT_BUS));
+  boot.add("battery", bootBattery, nullptr, BOOT_AFTER(BOOT_BUS));
+  boot.add("menu", initMenu);
+  boot.add("servo", initServo);
+  boot.add("sensor", bootSensor, nullptr, BOOT_AFTER(BOOT_DHT) | BOOT_AFTER(BOOT_PREFS) | BOOT_AFTER(BOOT_INPUT));
+  #ifdef HISTORY_ENABLE
+  boot.add("history", bootHistory, nullptr, BOOT_AFTER(BOOT_WAKE));
+  #endif
+  if (!boot.run()) {
+    LOGN("Boot graph: some phases did not run");
+  }
+  reportBoot();
 
-  
-  dht.begin();
+  benchFormat();
+  benchHistory();
+  reportPower();
+  #ifdef PEER_SYNC_ENABLE
+  peer.begin((uint32_t)ESP.getEfuseMac());
+  #endif
 
-  readTemperature();
-  defineWndOpenState();
+  #ifdef TELEMETRY_ENABLE
+  telemetry.onWake();
+  if (tempFilter.ready) {
+    TELEMETRY(TM_SAMPLE, isFullOpened | isPartiallyOpened << 1, cur_t * 10, cur_h * 10, batVoltage * 1000);
+  }
+  #endif
+  #ifdef HISTORY_ENABLE
+  if (tempFilter.ready) {
+    HISTORY(HISTORY_ACT_NONE);
+  }
+  #endif
 
-  initDisplay();
-  initMenu();
-  initServo();
 
-  if ( !ina219.begin()) {
-    LOGN("Failed to find INA219 chip");
+  #ifdef ENABLE_SLEEP
+  if (!policy.params().isDeepSleep) {
+    coop.start(TASK_CLIMATE); // external power, no deep sleep
   }
+  #else
+  coop.start(TASK_CLIMATE);
+  #endif
 
-
-  #ifndef ENABLE_SLEEP
-  temperatureTimer.setInterval(cfg.checkPeriod * 1000);
+  #ifdef ENABLE_LIGHT_SLEEP
+  idle.addWakePin(ENC_L);
+  idle.addWakePin(ENC_R);
+  idle.addWakePin(ENC_BTN);
+  idle.addWakePin(HIGHT_ENDSTOP_PIN);
+  idle.addWakePin(LOW_ENDSTOP_PIN);
+  idle.resetStats();
   #endif
 
   if (isButtonWakeup || !isSleepWakeup) {
     wakeDisplayTrigger();
     toggleMainScreen(true);
-    displayIdleTimer.setTimeout(cfg.displayTimeout * 1000); 
+    armDisplayIdleTimer();
+
+    // since the app start, the ROM / bootloader time before it is not included
+    uint32_t freshUs = micros();
+    if (!firstPixelUs) firstPixelUs = freshUs; // cold init: the first frame is the fresh one
+    TRACE(TR_WAKE_PIXEL, firstPixelUs, freshUs, isDisplayResumed);
+    LOG("Wake to first pixel us: "); LOG(firstPixelUs); LOG(" fresh frame us: "); LOG(freshUs);
+    LOG(" resumed: "); LOGN(isDisplayResumed);
+    BENCH("wake_pixel")
+      .add("first_us", firstPixelUs)
+      .add("fresh_us", freshUs)
+      .add("resumed", isDisplayResumed);
   }  
   
   // defineWndOpenState();
@@ -704,6 +1876,126 @@ void setup() {
   renderMainScreen();
 
 
+  configureWakeup();
+
+  eb.tick();
+  checkTemperature();
+
+}
+
+void bootWake() {
+  define_wakeup_reason();
+  displayPower.begin(oled.width() * oled.height());
+  displayPower.setFull(policy.params().contrast);
+  if (isButtonWakeup && resumeDisplay()) {
+    // the last main screen is up before the settings, the sensor read and the init below
+    wakeDisplayTrigger();
+    firstPixelUs = micros();
+  }
+  TRACE(TR_BOOT, esp_sleep_get_wakeup_cause(), isButtonWakeup);
+  LOG("Is awaked from sleep?: ");LOGN(isSleepWakeup);
+  LOG("Is awaked by Btn?: "); LOGN(isButtonWakeup);
+}
+
+/**
+ * Raw DHT read on the boot task, readTemperature() then gets the cached result.
+ */
+void sampleDht() {
+  dht.begin();
+  dht.read();
+}
+
+void bootDht() {
+  dhtTask.start(sampleDht, "dht");
+}
+
+bool isBootDhtDone() {
+  return dhtTask.done();
+}
+
+void bootPrefs() {
+  prefs.begin("0");
+  prefs.getBytes("0", &cfg, sizeof(cfg));
+
+  // RTC memory starts empty after a reset, continue from the last checkpoint
+  if (!isSleepWakeup) {
+    uint8_t buf[metrics.dumpMax()];
+    size_t len = prefs.getBytes("m", buf, sizeof(buf));
+    if (len && !metrics.merge(buf, len)) {
+      LOGN("Metrics checkpoint has another layout, starting over");
+    }
+    dumpMetrics();
+  }
+}
+
+void bootBus() {
+  Wire.begin(7,9);
+}
+
+void bootInput() {
+  pinMode(HIGHT_ENDSTOP_PIN, INPUT_PULLUP);
+  pinMode(LOW_ENDSTOP_PIN, INPUT_PULLUP);
+  // hightEndstor.setDebTimeout(255);
+  // lowEndstor.setDebTimeout(255);
+  eb.begin(); // decoded in interrupts from now on, also during the rest of the boot
+
+  attachInterrupt(HIGHT_ENDSTOP_PIN, onEndstopEdge, CHANGE);
+  attachInterrupt(LOW_ENDSTOP_PIN, onEndstopEdge, CHANGE);
+  // hightEndstor.attach(on_hight_endstop_change);
+  // lowEndstor.attach(on_low_endstop_change);
+}
+
+void bootBattery() {
+  if ( !ina219.begin()) {
+    LOGN("Failed to find INA219 chip");
+  }
+  readBattery();
+}
+
+void bootSensor() {
+  readTemperature();
+  defineWndOpenState();
+}
+
+/**
+ * Mounts the history partition; a cold boot finds the ring heads by reading a page per sector.
+ */
+void bootHistory() {
+  #ifdef HISTORY_ENABLE
+  if (!historyFlash.begin("history") || !history.begin(time(nullptr), isSleepWakeup)) {
+    LOGN("No history partition, check partitions.csv");
+  }
+  #endif
+}
+
+/**
+ * Critical path of this boot into the trace, the whole graph to the log.
+ */
+void reportBoot() {
+  uint8_t path[BOOT_PHASES_MAX];
+  uint8_t len = boot.criticalPath(path);
+  for (uint8_t i = 0; i < len; i++) {
+    const BootPhase& p = boot.phase(path[i]);
+    TRACE(TR_BOOT_PHASE, path[i], p.startUs - boot.startUs, p.endUs - p.startUs);
+  }
+  TRACE(TR_BOOT_GRAPH, boot.totalUs(), boot.sequentialUs(), len);
+  metrics.observe(M_BOOT_US, boot.totalUs());
+  #ifdef BOOT_BUDGET_US
+  if (boot.totalUs() > BOOT_BUDGET_US) {
+    TRACE(TR_BOOT_OVER, boot.totalUs(), BOOT_BUDGET_US);
+    LOG("Boot over budget us: "); LOGN(boot.totalUs());
+  }
+  #endif
+  #ifdef DEBUG_ENABLE
+  boot.printReport(Serial);
+  #endif
+  BENCH("boot")
+    .add("us", boot.totalUs())
+    .add("sequential_us", boot.sequentialUs())
+    .add("critical_phases", len);
+}
+
+void configureWakeup() {
   #ifdef ENABLE_SLEEP
   // esp_sleep_enable_ext1_wakeup(BUTTON_PIN_BITMASK(ENC_BTN), ESP_EXT1_WAKEUP_ANY_HIGH);
     #ifdef ESP32C3
@@ -728,59 +2020,77 @@ void setup() {
     gpio_set_direction(WAKEUP_1, GPIO_MODE_INPUT);
     
     #else // esp32-dev
+    #ifdef ENABLE_LIGHT_SLEEP
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO); // light sleep only source
+    #endif
     esp_sleep_enable_ext0_wakeup(ENC_BTN, 0);  //1 = High, 0 = Low
     rtc_gpio_pullup_en(ENC_BTN);
     rtc_gpio_pulldown_dis(ENC_BTN);
     #endif
-    esp_sleep_enable_timer_wakeup(cfg.checkPeriod * uS_TO_S_FACTOR);
+    #ifdef PEER_SYNC_ENABLE
+    // wake at the slot start together with the other units
+    // a longer period of the profile is whole slots, the wake stays on a slot start
+    esp_sleep_enable_timer_wakeup(peer.msToNextSlot(peerNowMs(), checkPeriodS() * 1000) * 1000ULL);
+    #else
+    esp_sleep_enable_timer_wakeup(checkPeriodS() * uS_TO_S_FACTOR);
+    #endif
   #endif
+}
 
-  eb.tick();
-  checkTemperature();
-
+/**
+ * Light sleep until the nearest timer deadline or an encoder / endstop edge.
+ */
+void idleUntilNextDeadline() {
+  #ifdef ENABLE_LIGHT_SLEEP
+  // servo PWM stops in light sleep, also for a manual run outside a motion (and animTimer
+  // only runs during a motion); queued encoder events and a bouncing button need loop() passes
+  if (servoOperation > 0 || actuator.isPowered() || eb.busy() || oled.isFlushPending() || coop.isBusy()) return;
+  if (!policy.params().isDeepSleep) return; // external power, no wake latency
+
+  idle.begin();
+  if (oledEnabled) {
+    idle.until(displayPower.nextChangeMs(millis(), cfg.displayTimeout * 1000));
+  }
+  uint32_t deadlineMs;
+  if (coop.nextDeadline(deadlineMs)) {
+    idle.until(deadlineMs); // display timeout, sensor period, flows waiting on a timer
+  }
+  idle.sleep(); // the pins are back on their edge interrupts when it returns
+  #endif
 }
 
 void loop() {
   // LOGN("Loop tick");
+  #ifdef ENABLE_CPU_GOVERNOR
+  governor.hint(servoOperation > 0 ? GOV_MOTION : GOV_IDLE_UI);
+  #endif
+  #if defined(UI_LATENCY_REPLAY) || defined(SERIAL_EXPORT)
+  serialInput();
+  #endif
+  #ifdef SERIAL_EXPORT
+  exporter.poll(millis());
+  #endif
   eb.tick();
+  oled.poll();
+  uiLatency.poll(oled.flushes, oled.shownFrames(), oled.isFlushPending(), millis());
   // servo.tick();
   // hightEndstor.tick();
   // lowEndstor.tick();
-  // animTimer.tick();
-  if (displayIdleTimer.isReady()) idleDisplayTrigger();
-  
-  #ifndef ENABLE_SLEEP
-  if (temperatureTimer.isReady()) readTemperature();
+  updateContrast();
+  #ifdef BENCH_ENABLE
+  uint32_t schedStart = BENCH_CYCLES();
+  coop.run(millis());
+  schedCycles += BENCH_CYCLES() - schedStart;
+  schedPasses++;
+  #else
+  coop.run(millis()); // display timeout, valve motion, sensor period
   #endif
+  drainTrace();
 
-  if (servoOperation > 0 && !forceStop) {
-    displayIdleTimer.reset();
-    bool lowEndstopPressed = digitalRead(LOW_ENDSTOP_PIN);
-    bool hightEndstopPressed = digitalRead(HIGHT_ENDSTOP_PIN);
-    
-    LOG("rotation is in progress... operation: "); LOG(servoOperation == 1 ? "Opening ": "Closing "); 
-    LOG(" hight pressed: "); LOG(hightEndstopPressed); LOG(" low pressed: "); LOG(lowEndstopPressed); 
-    LOG(" full condition: "); LOGN(servoOperation == 1 && !hightEndstopPressed && !lowEndstopPressed);
-    if (!animTimer.isEnabled()) {
-      animTimer.setInterval(300);
-    }
+  #ifdef TELEMETRY_ENABLE
+  // faults are sent right away (unless backing off after a failure), but never in the middle of a motion
+  if (telemetry.urgent && servoOperation == 0 && telemetry.needFlush()) sendTelemetry();
+  #endif
 
-    if (animTimer.isReady()) 
-      renderMainScreen();
-    
-    if (
-      (servoOperation == 1 && !hightEndstopPressed && !lowEndstopPressed) || // for opening trigger stop when both endstops is released
-      (servoOperation == 2 && hightEndstopPressed && lowEndstopPressed) // for closing trigger stop when both endstops is pressed
-    ) {
-      servo.writeMicroseconds(ROTATE_STOP);
-      servoOperation = 0;
-      animTimer.reset();
-      renderMainScreen();
-      defineWndOpenState();
-      checkTemperature();
-      // or 
-      // displayIdleTimer.reset();
-      // displayIdleTimer.setTimeout(cfg.displayTimeout * 1000);
-    }
-  }
+  idleUntilNextDeadline();
 }
\ No newline at end of file
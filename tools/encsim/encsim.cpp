@@ -0,0 +1,272 @@
+/*
+ * Host replay of fast encoder and button input through EncoderIsr (lib/EncoderIsr)
+ * while loop() is stalled: the edges go into onEncoder() / onButton() as the GPIO
+ * interrupt would call them, tick() runs only every --tick-ms (0: not until the whole
+ * script was played, the loop stuck in a long display push or sensor read).
+ *
+ * The delivered turns and clicks are checked against the script: the same number of
+ * clicks, and between two clicks the same net detents (turns may be merged, but none may
+ * be missing or move across a click).
+ *
+ * A script is a list of u<n> (n detents up), d<n> (down) and c<n> (n clicks), played
+ * with --detent-ms between detents and --click-ms press / gap per click. Without
+ * --script the built in scenarios run, then --runs random scripts and tick periods.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -Itools/encsim/shim -Ilib/EncoderIsr tools/encsim/encsim.cpp -o encsim
+ *
+ * Usage:
+ *   encsim [--script "u100 c5 d30"] [--tick-ms 0] [--detent-ms 2] [--click-ms 60]
+ *          [--runs 2000] [--seed 1] [--verbose 1]
+ *
+ * Exits with 1 if a check failed.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "EncoderIsr.h"
+
+#define PIN_A 1
+#define PIN_B 2
+#define PIN_BTN 3
+
+struct Options {
+  const char* script = nullptr;
+  uint32_t tickMs = 0;
+  uint32_t detentMs = 2;
+  uint32_t clickMs = 60;
+  uint32_t runs = 2000;
+  uint32_t seed = 1;
+  bool isVerbose = false;
+};
+
+struct Step {
+  char kind; // 'u', 'd', 'c'
+  uint32_t count;
+};
+
+struct Result {
+  std::vector<int32_t> segments; // net detents between clicks, clicks + 1 of them
+  uint32_t clicks = 0;
+  uint32_t merged = 0;
+  uint32_t deferred = 0;
+  uint8_t maxQueued = 0;
+};
+
+static EncoderIsr* encoder = nullptr;
+static Result* delivered = nullptr;
+
+static void onEncoderEvent() {
+  switch (encoder->action()) {
+    case ENC_TURN:
+      delivered->segments.back() += encoder->dir() * encoder->steps();
+      break;
+    case ENC_CLICK:
+      delivered->clicks++;
+      delivered->segments.push_back(0);
+      break;
+  }
+}
+
+static bool parseScript(const char* text, std::vector<Step>& steps) {
+  steps.clear();
+  const char* p = text;
+  while (*p) {
+    if (*p == ' ' || *p == ',') {
+      p++;
+      continue;
+    }
+    char kind = *p++;
+    char* end;
+    uint32_t count = strtoul(p, &end, 10);
+    if ((kind != 'u' && kind != 'd' && kind != 'c') || end == p || !count) {
+      return false;
+    }
+    steps.push_back({ kind, count });
+    p = end;
+  }
+  return !steps.empty();
+}
+
+static std::string scriptText(const std::vector<Step>& steps) {
+  std::string text;
+  for (const Step& s : steps) {
+    if (!text.empty()) text += ' ';
+    text += s.kind + std::to_string(s.count);
+  }
+  return text;
+}
+
+/**
+ * Net detents between clicks of a script.
+ */
+static std::vector<int32_t> expectedSegments(const std::vector<Step>& steps) {
+  std::vector<int32_t> segments(1, 0);
+  for (const Step& s : steps) {
+    if (s.kind == 'c') {
+      segments.resize(segments.size() + s.count, 0);
+    } else {
+      segments.back() += s.kind == 'u' ? (int32_t)s.count : -(int32_t)s.count;
+    }
+  }
+  return segments;
+}
+
+static void advance(EncoderIsr& eb, const Options& o, const uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    simMs++;
+    if (o.tickMs && simMs % o.tickMs == 0) {
+      eb.tick();
+    }
+  }
+}
+
+static void edge(EncoderIsr& eb, const uint8_t state) {
+  simPins[PIN_A] = state & 1;
+  simPins[PIN_B] = state >> 1;
+  eb.onEncoder(state & 1, state >> 1, simMs);
+}
+
+static void button(EncoderIsr& eb, const bool pressed) {
+  simPins[PIN_BTN] = pressed ? LOW : HIGH;
+  eb.onButton(pressed, simMs);
+}
+
+static Result play(const std::vector<Step>& steps, const Options& o) {
+  static const uint8_t UP[4] = { 0b01, 0b00, 0b10, 0b11 };
+  static const uint8_t DOWN[4] = { 0b10, 0b00, 0b01, 0b11 };
+
+  simMs = 1000;
+  simPins[PIN_A] = simPins[PIN_B] = simPins[PIN_BTN] = HIGH;
+  EncoderIsr eb(PIN_A, PIN_B, PIN_BTN, INPUT_PULLUP);
+  Result result;
+  result.segments.push_back(0);
+  encoder = &eb;
+  delivered = &result;
+  eb.begin();
+  eb.attach(onEncoderEvent);
+
+  for (const Step& s : steps) {
+    for (uint32_t n = 0; n < s.count; n++) {
+      if (s.kind == 'c') {
+        button(eb, true);
+        advance(eb, o, o.clickMs);
+        button(eb, false);
+        advance(eb, o, o.clickMs);
+        continue;
+      }
+      const uint8_t* states = s.kind == 'u' ? UP : DOWN;
+      for (uint8_t k = 0; k < 4; k++) {
+        edge(eb, states[k]);
+        if (k == 1) advance(eb, o, o.detentMs / 2);
+      }
+      advance(eb, o, o.detentMs - o.detentMs / 2);
+    }
+  }
+
+  // the loop comes back
+  for (uint32_t i = 0; i < 1000 && (eb.busy() || i < ENC_ISR_DEBOUNCE_MS * 2); i++) {
+    eb.tick();
+    simMs++;
+  }
+
+  result.merged = eb.overflows;
+  result.deferred = eb.deferred;
+  result.maxQueued = eb.maxQueued;
+  encoder = nullptr;
+  delivered = nullptr;
+  return result;
+}
+
+static bool check(const std::vector<Step>& steps, const Result& r, const Options& o, const bool isVerbose) {
+  std::vector<int32_t> want = expectedSegments(steps);
+  bool ok = r.segments == want;
+
+  if (!ok || isVerbose) {
+    printf("%s \"%s\" tick %u ms: clicks %u (script %zu), segments", ok ? "ok  " : "FAIL", scriptText(steps).c_str(),
+           o.tickMs, r.clicks, want.size() - 1);
+    for (size_t i = 0; i < r.segments.size(); i++) {
+      printf(" %d", r.segments[i]);
+    }
+    printf(" (script");
+    for (int32_t w : want) {
+      printf(" %d", w);
+    }
+    printf("), merged %u, deferred %u, max queued %u\n", r.merged, r.deferred, r.maxQueued);
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* val = argv[i + 1];
+    if (!strcmp(arg, "--script")) o.script = val;
+    else if (!strcmp(arg, "--tick-ms")) o.tickMs = atoi(val);
+    else if (!strcmp(arg, "--detent-ms")) o.detentMs = atoi(val);
+    else if (!strcmp(arg, "--click-ms")) o.clickMs = atoi(val);
+    else if (!strcmp(arg, "--runs")) o.runs = atoi(val);
+    else if (!strcmp(arg, "--seed")) o.seed = strtoul(val, nullptr, 10);
+    else if (!strcmp(arg, "--verbose")) o.isVerbose = atoi(val);
+    else {
+      fprintf(stderr, "unknown option %s, see the header of tools/encsim/encsim.cpp\n", arg);
+      return 2;
+    }
+  }
+  if (o.detentMs < 1 || o.clickMs < ENC_ISR_DEBOUNCE_MS || o.clickMs >= ENC_ISR_HOLD_MS) {
+    fprintf(stderr, "detent-ms > 0, click-ms between the debounce and the hold time\n");
+    return 2;
+  }
+
+  std::vector<Step> steps;
+  uint32_t errors = 0;
+  if (o.script) {
+    if (!parseScript(o.script, steps)) {
+      fprintf(stderr, "bad script: %s\n", o.script);
+      return 2;
+    }
+    errors += !check(steps, play(steps, o), o, true);
+    return errors ? 1 : 0;
+  }
+
+  // stalled loop: the review case, turns around clicks, more clicks than the ring holds
+  static const char* SCENARIOS[] = {
+    "u100 c5 d30",
+    "u3 c1 u3 c1 d3 c1 d3",
+    "u200 d40 c2 u1 c1 d200",
+    "c20 u10",
+    "u300 c20 d30",
+  };
+  for (const char* script : SCENARIOS) {
+    parseScript(script, steps);
+    errors += !check(steps, play(steps, o), o, true);
+  }
+
+  std::mt19937 rng(o.seed);
+  uint32_t unmerged = 0, merged = 0, deferred = 0;
+  for (uint32_t run = 0; run < o.runs; run++) {
+    steps.clear();
+    uint32_t n = 1 + rng() % 12;
+    for (uint32_t i = 0; i < n; i++) {
+      char kind = "udc"[rng() % 3];
+      steps.push_back({ kind, (uint32_t)(kind == 'c' ? 1 + rng() % 8 : 1 + rng() % 120) });
+    }
+    Options ro = o;
+    ro.tickMs = rng() % 3 ? 0 : 1 + rng() % 300;
+    Result r = play(steps, ro);
+    errors += !check(steps, r, ro, o.isVerbose);
+    unmerged += !r.merged && !r.deferred;
+    merged += r.merged;
+    deferred += r.deferred;
+  }
+  printf("%u random scripts: %u without a merged detent, %u detents merged, %u deferred\n", o.runs, unmerged, merged,
+         deferred);
+
+  printf("%s: %u errors\n", errors ? "FAIL" : "ok", errors);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,35 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+/**
+ * Host stand-in for the parts of Arduino.h EncoderIsr uses, only for tools/encsim:
+ * the pins read simPins[], millis() is simMs, interrupts are not attached (the
+ * simulation calls onEncoder() / onButton() itself).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IRAM_ATTR
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define LOW 0
+#define HIGH 1
+#define CHANGE 3
+
+inline uint8_t simPins[64] = {};
+inline uint32_t simMs = 0;
+
+inline void pinMode(uint8_t, uint8_t) {}
+
+inline int digitalRead(const uint8_t pin) {
+  return simPins[pin];
+}
+
+inline unsigned long millis() {
+  return simMs;
+}
+
+inline void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+
+#endif
@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+"""
+Pulls the logged data from firmware built with -D SERIAL_EXPORT (lib/SerialExport)
+and writes one CSV per stream.
+
+The streams come as CRC framed binary chunks; a frame with a bad CRC or a lost one
+is asked for again (nak), a timeout too. The raw bytes go to <out>/<stream>-<base>.bin
+first, --resume continues such a file from its size while the unit still reports the
+same base (the stream did not move on meanwhile), then the CSV is written from it:
+    trace.csv       time_us, event, text (names from include/TraceEvents.h)
+    telemetry.csv   time, type, code, a, b, c (the queued records)
+    metrics.csv     kind, name, value, min, max, count, mean (include/MetricsTable.h)
+    history.csv     time, temp, hum, mv, state, action (lib/HistoryLog, -D HISTORY_ENABLE)
+    hourly.csv      start, samples, actions, min / max / avg of temp, hum, mv min / avg
+    daily.csv       the same per day
+Other streams are kept as .bin only.
+
+Start it while the unit is awake (a button wake); the export keeps it awake as long
+as the host talks to it.
+
+Usage:
+    tools/export_pull.py /dev/ttyACM0 --list
+    tools/export_pull.py /dev/ttyACM0 -o export
+    tools/export_pull.py /dev/ttyACM0 -o export --stream telemetry --resume
+"""
+import argparse
+import csv
+import glob
+import os
+import struct
+import sys
+import time
+import zlib
+
+import metrics_decode
+import trace_decode
+
+SYNC = b'\xa5\x5a'
+HEADER = struct.Struct('<BBIH')  # type, stream, offset, len
+TELEMETRY_RECORD = struct.Struct('<IBBhhh')
+TELEMETRY_TYPES = ['sample', 'actuation', 'fault', 'event']
+HISTORY_PAGE = 256
+HISTORY_PAGE_HEADER = struct.Struct('<BBHII')  # kind, count, 0xFFFF, seq, crc
+HISTORY_SAMPLE = struct.Struct('<IhhHBB')
+HISTORY_ROLLUP = struct.Struct('<IHHhhhhhhHH')
+HISTORY_ACTIONS = ['', 'open', 'close', 'stop', 'manual']
+MAX_RETRIES = 10
+
+
+class BadFrame(Exception):
+    pass
+
+
+class Link:
+    def __init__(self, port, timeout):
+        self.port = port
+        self.timeout = timeout
+        self.buf = bytearray()
+
+    def send(self, line):
+        self.port.write((line + '\n').encode())
+
+    def fill(self, n, deadline):
+        while len(self.buf) < n:
+            if time.monotonic() > deadline:
+                return False
+            self.buf += self.port.read(max(n - len(self.buf), self.port.in_waiting or 1))
+        return True
+
+    def frame(self):
+        """(type, stream, offset, payload), None after the timeout. Text in between (LOG lines) is skipped."""
+        deadline = time.monotonic() + self.timeout
+        while True:
+            if not self.fill(2, deadline):
+                return None
+            pos = self.buf.find(SYNC)
+            if pos < 0:
+                del self.buf[:-1]
+                continue
+            del self.buf[:pos]
+            if not self.fill(2 + HEADER.size, deadline):
+                return None
+            kind, stream, offset, length = HEADER.unpack_from(self.buf, 2)
+            if length > 4096:
+                del self.buf[:2]  # a sync pattern inside text, look further
+                continue
+            end = 2 + HEADER.size + length
+            if not self.fill(end + 4, deadline):
+                return None
+            body = bytes(self.buf[2:end])
+            crc = struct.unpack_from('<I', self.buf, end)[0]
+            if zlib.crc32(body) != crc:
+                del self.buf[:2]
+                raise BadFrame()
+            del self.buf[:end + 4]
+            return chr(kind), stream, offset, body[HEADER.size:]
+
+
+def list_streams(link):
+    """[(id, name, record size, size, base)]"""
+    for _ in range(MAX_RETRIES):
+        link.send('x list')
+        try:
+            frame = link.frame()
+        except BadFrame:
+            continue
+        if frame is None or frame[0] != 'L':
+            continue
+        data = frame[3]
+        out, pos = [], 1
+        for i in range(data[0]):
+            record, size, base, name_len = struct.unpack_from('<BIIB', data, pos)
+            name = data[pos + 10:pos + 10 + name_len].decode()
+            out.append((i, name, record, size, base))
+            pos += 10 + name_len
+        return out
+    sys.exit('no answer to "x list", is the unit awake and built with SERIAL_EXPORT?')
+
+
+def pull(link, sid, size, offset, window, out):
+    """Appends stream bytes [offset, size) to out. Returns the number of naks."""
+    naks = retries = 0
+    since_ack = 0
+    link.send(f'x get {sid} {offset} {window}')
+    while True:
+        try:
+            frame = link.frame()
+        except BadFrame:
+            frame = None
+        if frame is None:
+            retries += 1
+            if retries > MAX_RETRIES:
+                raise RuntimeError(f'stream {sid} stalled at {offset} of {size}')
+            naks += 1
+            link.send(f'x nak {offset}')
+            continue
+
+        kind, stream, frame_offset, payload = frame
+        if stream != sid:
+            continue
+        if kind == '!':
+            raise RuntimeError(f'stream {sid} failed at {frame_offset}: {payload.decode(errors="replace")}')
+        if frame_offset != offset:
+            continue  # behind a lost frame, until the resend comes
+        if kind == 'E':
+            link.send(f'x ack {offset}')
+            return naks
+        if kind == 'D':
+            out.write(payload)
+            offset += len(payload)
+            retries = 0
+            since_ack += 1
+            if since_ack >= max(1, window // 2):
+                link.send(f'x ack {offset}')
+                since_ack = 0
+
+
+def trace_rows(data, args):
+    events = trace_decode.load_events(args.events)
+    pos = 0
+    while pos + 6 <= len(data):
+        length = 6 + (data[pos + 1] >> 6) * 4
+        ts, text = trace_decode.decode_record(data[pos:pos + length], events)
+        name, _, rest = text.partition(': ')
+        yield ts, name, rest
+        pos += length
+
+
+def telemetry_rows(data, args):
+    for rec in TELEMETRY_RECORD.iter_unpack(data[:len(data) - len(data) % TELEMETRY_RECORD.size]):
+        t, kind, code, a, b, c = rec
+        yield t, TELEMETRY_TYPES[kind] if kind < len(TELEMETRY_TYPES) else kind, code, a, b, c
+
+
+def metrics_rows(data, args):
+    t_counters, t_gauges, t_hists = metrics_decode.load_table(args.table)
+    counters, gauges, hists = metrics_decode.decode(data)
+    for i, v in enumerate(counters):
+        yield 'counter', metrics_decode.name_of(t_counters, i), v, '', '', '', ''
+    for i, g in enumerate(gauges):
+        yield ('gauge', metrics_decode.name_of(t_gauges, i)) + (g if g else ('', '', '')) + ('', '')
+    for i, (count, total, buckets) in enumerate(hists):
+        mean = f'{total / count:.1f}' if count else ''
+        yield 'histogram', metrics_decode.name_of(t_hists, i), '', '', '', count, mean
+
+
+def history_pages(data, kind, record):
+    """Records of the valid pages of a HistoryLog tier, in write order (seq)."""
+    pages = []
+    for pos in range(0, len(data) - HISTORY_PAGE + 1, HISTORY_PAGE):
+        page = data[pos:pos + HISTORY_PAGE]
+        k, count, _, seq, crc = HISTORY_PAGE_HEADER.unpack_from(page)
+        end = HISTORY_PAGE_HEADER.size + count * record.size
+        if k != kind or not count or end > HISTORY_PAGE:
+            continue  # erased, another tier or cut short by a power loss
+        if zlib.crc32(page[HISTORY_PAGE_HEADER.size:end], zlib.crc32(page[:8])) != crc:
+            continue
+        pages.append((seq, page[HISTORY_PAGE_HEADER.size:end]))
+    for seq, body in sorted(pages):
+        yield from record.iter_unpack(body)
+
+
+def history_rows(data, args):
+    for t, temp, hum, mv, state, action in history_pages(data, 1, HISTORY_SAMPLE):
+        yield t, temp / 10, hum / 10, mv, state, HISTORY_ACTIONS[action] if action < len(HISTORY_ACTIONS) else action
+
+
+def rollup_rows(kind):
+    def rows(data, args):
+        for r in history_pages(data, kind, HISTORY_ROLLUP):
+            start, samples, actions = r[:3]
+            yield (start, samples, actions) + tuple(v / 10 for v in r[3:9]) + r[9:]
+    return rows
+
+
+ROLLUP_HEADER = ['start', 'samples', 'actions', 'min_temp', 'max_temp', 'avg_temp',
+                 'min_hum', 'max_hum', 'avg_hum', 'min_mv', 'avg_mv']
+
+# stream name -> (CSV header, rows from the raw bytes)
+WRITERS = {
+    'trace': (['time_us', 'event', 'text'], trace_rows),
+    'telemetry': (['time', 'type', 'code', 'a', 'b', 'c'], telemetry_rows),
+    'metrics': (['kind', 'name', 'value', 'min', 'max', 'count', 'mean'], metrics_rows),
+    'history': (['time', 'temp', 'hum', 'mv', 'state', 'action'], history_rows),
+    'hourly': (ROLLUP_HEADER, rollup_rows(2)),
+    'daily': (ROLLUP_HEADER, rollup_rows(3)),
+}
+
+
+def write_csv(name, data, path, args):
+    header, rows = WRITERS[name]
+    with open(path, 'w', newline='') as f:
+        w = csv.writer(f)
+        w.writerow(header)
+        n = 0
+        for row in rows(data, args):
+            w.writerow(row)
+            n += 1
+    return n
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('port', help='serial port of the unit')
+    ap.add_argument('--baud', type=int, default=115200, help='ignored by USB CDC')
+    ap.add_argument('-o', '--out', default='export', help='output directory')
+    ap.add_argument('--stream', action='append', help='stream to pull (repeatable), all by default')
+    ap.add_argument('--list', action='store_true', help='only list the streams')
+    ap.add_argument('--resume', action='store_true', help='continue a partial .bin of the same base')
+    ap.add_argument('--window', type=int, default=8, help='frames in flight')
+    ap.add_argument('--timeout', type=float, default=1.0, help='seconds without a frame before a nak')
+    ap.add_argument('--events', default=trace_decode.EVENTS_H, help='trace event table header')
+    ap.add_argument('--table', default=metrics_decode.TABLE_H, help='metrics table header')
+    args = ap.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit('needs pyserial: pip install pyserial')
+
+    with serial.Serial(args.port, args.baud, timeout=0.05) as port:
+        port.reset_input_buffer()
+        link = Link(port, args.timeout)
+        streams = list_streams(link)
+        if args.list:
+            for sid, name, record, size, base in streams:
+                print(f'{sid}: {name:12} {size} bytes, base {base}' + (f', {record} byte records' if record else ''))
+            return
+
+        os.makedirs(args.out, exist_ok=True)
+        for sid, name, record, size, base in streams:
+            if args.stream and name not in args.stream:
+                continue
+            raw = os.path.join(args.out, f'{name}-{base}.bin')
+            # a dump changes as a whole, only ring and log streams continue
+            offset = os.path.getsize(raw) if args.resume and record and os.path.exists(raw) else 0
+            offset = min(offset - offset % record if record else offset, size)
+            for old in glob.glob(os.path.join(args.out, f'{name}-*.bin')):
+                if old != raw or not offset:
+                    os.remove(old)
+
+            start = time.monotonic()
+            with open(raw, 'r+b' if offset else 'wb') as f:
+                f.truncate(offset)
+                f.seek(offset)
+                naks = pull(link, sid, size, offset, args.window, f)
+            secs = time.monotonic() - start
+            with open(raw, 'rb') as f:
+                data = f.read()
+            rate = (size - offset) / secs / 1024 if secs > 0 else 0
+            text = f'{name}: {size - offset} bytes in {secs:.2f} s ({rate:.1f} KB/s, {naks} naks)'
+            if name in WRITERS:
+                path = os.path.join(args.out, name + '.csv')
+                text += f', {write_csv(name, data, path, args)} rows to {path}'
+            print(text)
+        link.send('x stop')
+
+
+if __name__ == '__main__':
+    main()
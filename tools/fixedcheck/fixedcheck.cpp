@@ -0,0 +1,178 @@
+/*
+ * printf parity check for FixedWriter (lib/FixedFormat) over the value ranges of the
+ * UI strings: temperature fixed(t, 1) in -40..85 C, humidity percent(h, 2) in 0..100 %,
+ * battery volts(v) in 0..20 V, uint() of the charge and mmss() of the settings.
+ *
+ * Every fixed() output is compared with snprintf("%.Nf"). Random floats of each range
+ * and the floats around every rounding boundary (the nearest ones and a few ulps apart)
+ * are checked. The only allowed difference is the documented one: an exact binary tie
+ * (0.25 at 1 decimal) rounds away from zero like Print::print, printf rounds it to even;
+ * the output must then be printf's digits rounded half up.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -Ilib/FixedFormat tools/fixedcheck/fixedcheck.cpp -o fixedcheck
+ *
+ * Usage:
+ *   fixedcheck [--samples 1000000] [--seed 1]
+ *
+ * Exits with 1 if a check failed.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "FixedFormat.h"
+
+struct Range {
+  const char* name;
+  float from;
+  float to;
+  uint8_t decimals;
+};
+
+static const Range RANGES[] = {
+  { "temperature", -40, 85, 1 },
+  { "humidity", 0, 100, 2 },
+  { "volts", 0, 20, 1 },
+  { "decimals", 0, 100, FIXED_FORMAT_MAX_DECIMALS },
+};
+
+struct Check {
+  uint64_t values = 0;
+  uint64_t ties = 0;
+  uint32_t errors = 0;
+};
+
+static void fail(Check& c, const char* what, const char* got, const char* want) {
+  if (c.errors++ < 10) {
+    printf("FAIL %s: \"%s\", expected \"%s\"\n", what, got, want);
+  }
+}
+
+/**
+ * An exact binary tie: val * 10^decimals ends in exactly .5 (exact in double for
+ * a float and up to 4 decimals).
+ */
+static bool isTie(const float val, const uint8_t decimals) {
+  double x = fabs((double)val) * pow(10.0, decimals);
+  return x - floor(x) == 0.5;
+}
+
+static void checkFixed(Check& c, const float val, const uint8_t decimals) {
+  char got[24];
+  char want[48];
+  FixedWriter(got, sizeof(got)).fixed(val, decimals);
+  c.values++;
+
+  if (!isTie(val, decimals)) {
+    snprintf(want, sizeof(want), "%.*f", decimals, val);
+  } else {
+    // half up in magnitude, the sign kept
+    c.ties++;
+    double up = floor(fabs((double)val) * pow(10.0, decimals) + 0.5) / pow(10.0, decimals);
+    snprintf(want, sizeof(want), "%s%.*f", std::signbit(val) ? "-" : "", decimals, up);
+  }
+
+  if (strcmp(got, want)) {
+    char what[64];
+    snprintf(what, sizeof(what), "fixed(%.9g, %u)", val, decimals);
+    fail(c, what, got, want);
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t samples = 1000000;
+  uint32_t seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* val = argv[i + 1];
+    if (!strcmp(arg, "--samples")) samples = strtoul(val, nullptr, 10);
+    else if (!strcmp(arg, "--seed")) seed = strtoul(val, nullptr, 10);
+    else {
+      fprintf(stderr, "unknown option %s, see the header of tools/fixedcheck/fixedcheck.cpp\n", arg);
+      return 2;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  Check check;
+
+  for (const Range& r : RANGES) {
+    Check before = check;
+    std::uniform_real_distribution<float> dist(r.from, r.to);
+    for (uint32_t i = 0; i < samples; i++) {
+      checkFixed(check, dist(rng), r.decimals);
+    }
+
+    // around every boundary between two outputs: x.x5 at 1 decimal
+    double step = pow(10.0, -r.decimals);
+    for (double b = r.from + step / 2; b < r.to; b += step) {
+      float near = (float)b;
+      checkFixed(check, near, r.decimals);
+      float up = near, down = near;
+      for (int k = 0; k < 3; k++) {
+        up = nextafterf(up, INFINITY);
+        down = nextafterf(down, -INFINITY);
+        checkFixed(check, up, r.decimals);
+        checkFixed(check, down, r.decimals);
+      }
+    }
+    printf("%-12s %.0f..%.0f, %u decimals: %llu values, %llu exact ties\n", r.name, r.from, r.to, r.decimals,
+           (unsigned long long)(check.values - before.values), (unsigned long long)(check.ties - before.ties));
+  }
+
+  // the documented cases
+  struct Case {
+    float val;
+    uint8_t decimals;
+    const char* want;
+  };
+  static const Case CASES[] = {
+    { 0.25f, 1, "0.3" },     // printf "0.2"
+    { 0.75f, 1, "0.8" },     // printf "0.8"
+    { 2.5f, 0, "3" },        // printf "2"
+    { 21.125f, 2, "21.13" }, // printf "21.12"
+    { -0.25f, 1, "-0.3" },
+    { -0.01f, 1, "-0.0" },   // small negatives keep the sign, like printf
+    { 0.35f, 1, "0.3" },     // 0.3499999940, no tie
+    { 99.995f, 2, "100.00" },
+    { NAN, 1, "nan" },
+    { INFINITY, 1, "inf" },
+  };
+  for (const Case& t : CASES) {
+    char got[24];
+    FixedWriter(got, sizeof(got)).fixed(t.val, t.decimals);
+    if (strcmp(got, t.want)) {
+      fail(check, "documented case", got, t.want);
+    }
+  }
+
+  // the integer writers of the screens and the settings
+  char got[24];
+  char want[24];
+  for (uint32_t v = 0; v <= 100; v++) {
+    FixedWriter(got, sizeof(got)).uint(v).ch('%');
+    snprintf(want, sizeof(want), "%u%%", v);
+    if (strcmp(got, want)) fail(check, "uint", got, want);
+  }
+  for (uint32_t s = 0; s <= 24 * 3600; s++) {
+    FixedWriter(got, sizeof(got)).mmss(s);
+    snprintf(want, sizeof(want), "%02u:%02u", s / 60, s % 60);
+    if (strcmp(got, want)) fail(check, "mmss", got, want);
+  }
+  for (int32_t v = -100000; v <= 100000; v += 7) {
+    FixedWriter(got, sizeof(got)).scaled(v, 2);
+    snprintf(want, sizeof(want), "%s%d.%02d", v < 0 ? "-" : "", abs(v) / 100, abs(v) % 100);
+    if (strcmp(got, want)) fail(check, "scaled", got, want);
+  }
+
+  // cut, always terminated
+  char small[6];
+  FixedWriter(small, sizeof(small)).text("ВОЛОГІСТЬ: ").percent(55.5f, 2);
+  if (strlen(small) != sizeof(small) - 1) fail(check, "cut", small, "5 bytes");
+
+  printf("%s: %u errors\n", check.errors ? "FAIL" : "ok", check.errors);
+  return check.errors ? 1 : 0;
+}
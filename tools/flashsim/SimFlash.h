@@ -0,0 +1,102 @@
+#ifndef SimFlash_h
+#define SimFlash_h
+
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+/**
+ * NOR flash for HistoryLog on the host: a write only clears bits, an erase sets a 4 KB
+ * sector to 0xFF. Counts programmed bytes and erases per sector.
+ *
+ * cutAfter(n) simulates a power loss n programmed bytes / erases from now: the write in
+ * progress programs a random part of its rest (the last byte with only some of its bits),
+ * an erase leaves the sector half erased, and every call fails until powerOn().
+ */
+class SimFlash {
+public:
+  uint64_t programmed = 0;
+  uint64_t reads = 0;
+  std::vector<uint32_t> erases;
+
+  SimFlash(const uint32_t size, const uint32_t seed) : _mem(size, 0xFF), _rng(seed) {
+    erases.assign(size / 4096, 0);
+  }
+
+  uint32_t size() const {
+    return _mem.size();
+  }
+
+  bool read(const uint32_t addr, void* out, const size_t len) {
+    if (_isDead || addr + len > _mem.size()) {
+      return false;
+    }
+    memcpy(out, &_mem[addr], len);
+    reads++;
+    return true;
+  }
+
+  bool write(const uint32_t addr, const void* data, const size_t len) {
+    if (_isDead || addr + len > _mem.size()) {
+      return false;
+    }
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+      if (_left && !--_left) {
+        // cut: a random part of the rest, then one byte with some of its bits
+        size_t stop = i + _rng() % (len - i);
+        programmed += stop + 1;
+        for (; i < stop; i++) {
+          _mem[addr + i] &= p[i];
+        }
+        _mem[addr + i] &= p[i] | (uint8_t)_rng();
+        _isDead = true;
+        return false;
+      }
+      _mem[addr + i] &= p[i];
+    }
+    programmed += len;
+    return true;
+  }
+
+  bool erase(const uint32_t addr) {
+    if (_isDead || addr % 4096 || addr >= _mem.size()) {
+      return false;
+    }
+    erases[addr / 4096]++;
+    if (_left && !--_left) {
+      // cut: the first part erased, the rest has random bits set
+      uint32_t stop = _rng() % 4096;
+      memset(&_mem[addr], 0xFF, stop);
+      for (uint32_t i = stop; i < 4096; i++) {
+        _mem[addr + i] |= (uint8_t)_rng();
+      }
+      _isDead = true;
+      return false;
+    }
+    memset(&_mem[addr], 0xFF, 4096);
+    return true;
+  }
+
+  void cutAfter(const uint32_t ops) {
+    _left = ops;
+  }
+
+  bool isDead() const {
+    return _isDead;
+  }
+
+  void powerOn() {
+    _isDead = false;
+    _left = 0;
+  }
+
+private:
+  std::vector<uint8_t> _mem;
+  std::mt19937 _rng;
+  uint32_t _left = 0; // ops to the cut, 0: none
+  bool _isDead = false;
+};
+
+#endif
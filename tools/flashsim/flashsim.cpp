@@ -0,0 +1,236 @@
+/*
+ * Flash simulator for HistoryLog (lib/HistoryLog): logs --days of samples every
+ * --period seconds into a simulated NOR partition (SimFlash) with --cuts power losses
+ * at random points, in the middle of page writes and sector erases too. A wake is a new
+ * HistoryLog on the same State, as after deep sleep; a power loss also loses the State
+ * (RTC memory) and restarts time(), every other one is a reset which keeps it.
+ *
+ * After every power loss the log is mounted again and checked:
+ *   - no record which was not written, no duplicate, times increasing
+ *   - every sample of a page written completely before the loss is there, except what
+ *     the ring recycled
+ *   - hourly rollups in order
+ * At the end: write amplification (flash bytes programmed per logged byte), erases
+ * per sector (wear levelling) and the flash reads of a one day range query against a
+ * full scan.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -Ilib/Crc32 -Ilib/HistoryLog -Itools/flashsim tools/flashsim/flashsim.cpp -o flashsim
+ *
+ * Usage:
+ *   flashsim [--days 120] [--period 60] [--cuts 200] [--size 1441792] [--seed 1]
+ *
+ * Exits with 1 if a check failed.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "HistoryLog.h"
+#include "SimFlash.h"
+
+typedef HistoryLog<SimFlash> Log;
+
+struct Options {
+  uint32_t days = 120;
+  uint32_t periodS = 60;
+  uint32_t cuts = 200;
+  uint32_t size = 0x160000; // the history partition of partitions.csv
+  uint32_t seed = 1;
+};
+
+struct Check {
+  uint32_t mounts = 0;
+  uint32_t errors = 0;
+  uint32_t lost = 0;          // samples of the RTC batch lost with the power
+  std::vector<bool> isLost;   // by sample id
+
+  /**
+   * Samples in (from, to] which should be there.
+   */
+  bool isMissing(const int64_t from, const int64_t to) const {
+    for (int64_t id = from + 1; id <= to; id++) {
+      if (!isLost[id]) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// the sample number is stored in temp / hum, mv is a check value of it
+static uint16_t checkOf(const uint32_t id) {
+  return (id * 2654435761u) >> 16;
+}
+
+static uint32_t idOf(const uint8_t* rec) {
+  HistorySample s;
+  memcpy(&s, rec, sizeof(s));
+  return (uint16_t)s.temp | (uint32_t)(uint16_t)s.hum << 16;
+}
+
+static void fail(Check& c, const char* what, const uint32_t a, const uint32_t b) {
+  if (c.errors++ < 10) {
+    printf("FAIL after mount %u: %s (%u, %u)\n", c.mounts, what, a, b);
+  }
+}
+
+/**
+ * Mounted log against what was appended: ids [0, appended), durable up to durable.
+ */
+static void verify(Log& log, Check& c, const uint32_t appended, const int64_t durable) {
+  int64_t prevId = -1;
+  uint32_t prevTime = 0;
+  uint32_t first = 0;
+  log.querySamples(0, HISTORY_NO_TIME, [&](const HistorySample& s) {
+    uint32_t id = idOf((const uint8_t*)&s);
+    if (id >= appended || s.mv != checkOf(id)) {
+      fail(c, "record which was not written", id, s.mv);
+      return;
+    }
+    if ((int64_t)id <= prevId) {
+      fail(c, "sample out of order or twice", id, (uint32_t)prevId);
+    } else if (prevId >= 0 && c.isMissing(prevId, (int64_t)id - 1 < durable ? (int64_t)id - 1 : durable)) {
+      fail(c, "durable samples missing", (uint32_t)prevId + 1, id);
+    }
+    if (s.time < prevTime) {
+      fail(c, "time goes back", s.time, prevTime);
+    }
+    if (prevId < 0) {
+      first = id;
+    }
+    prevId = id;
+    prevTime = s.time;
+  });
+  if (durable >= 0 && (int64_t)first <= durable && c.isMissing(prevId, durable)) {
+    fail(c, "durable samples missing at the end", (uint32_t)prevId, (uint32_t)durable);
+  }
+
+  uint32_t prevStart = 0;
+  log.queryRollups(HISTORY_HOURLY, 0, HISTORY_NO_TIME, [&](const HistoryRollup& r) {
+    if (r.start < prevStart || r.start % 3600 || !r.samples) {
+      fail(c, "hourly rollup", r.start, prevStart);
+    }
+    prevStart = r.start;
+  });
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* val = argv[i + 1];
+    if (!strcmp(arg, "--days")) o.days = atoi(val);
+    else if (!strcmp(arg, "--period")) o.periodS = atoi(val);
+    else if (!strcmp(arg, "--cuts")) o.cuts = atoi(val);
+    else if (!strcmp(arg, "--size")) o.size = strtoul(val, nullptr, 0);
+    else if (!strcmp(arg, "--seed")) o.seed = strtoul(val, nullptr, 10);
+    else {
+      fprintf(stderr, "unknown option %s, see the header of tools/flashsim/flashsim.cpp\n", arg);
+      return 2;
+    }
+  }
+  if (o.days < 1 || o.periodS < 1 || o.size < 6 * HISTORY_SECTOR_SIZE) {
+    fprintf(stderr, "days and period > 0, size at least 6 sectors\n");
+    return 2;
+  }
+
+  std::mt19937 rng(o.seed);
+  SimFlash flash(o.size, o.seed);
+  Log::State state = {};
+  Check check;
+
+  uint32_t wakes = o.days * 86400 / o.periodS;
+  uint32_t cutEvery = o.cuts ? wakes / o.cuts : 0;
+  uint32_t clock = 0;   // time() of the device
+  int64_t durable = -1; // last sample id in a completely written page
+  uint32_t appended = 0;
+  bool isSleepWake = false;
+
+  for (uint32_t w = 0; w < wakes; w++) {
+    Log log(flash, state);
+    if (!log.begin(clock, isSleepWake)) {
+      fprintf(stderr, "no usable partition\n");
+      return 2;
+    }
+    if (!isSleepWake) {
+      check.mounts++;
+      verify(log, check, appended, durable);
+    }
+    isSleepWake = true;
+
+    if (cutEvery && w % cutEvery == cutEvery / 2) {
+      flash.cutAfter(1 + rng() % 600); // within the next page writes or erase
+    }
+
+    uint32_t id = appended++;
+    check.isLost.push_back(false);
+    float day = (float)(clock % 86400) / 86400;
+    bool ok = log.append(clock, (int16_t)(uint16_t)id, (int16_t)(uint16_t)(id >> 16), checkOf(id), day > 0.5f,
+                         w % 97 == 0 ? HISTORY_ACT_OPEN : HISTORY_ACT_NONE);
+    uint8_t count = log.state().batchCount[HISTORY_RAW];
+    if (ok && count == 0) {
+      durable = id;
+    }
+    if (!ok && (!count || idOf(log.state().batch[HISTORY_RAW] + (count - 1) * sizeof(HistorySample)) != id)) {
+      check.isLost[id] = true; // the batch could not be written, the sample was dropped
+    }
+    clock += o.periodS;
+
+    if (flash.isDead()) {
+      // power loss: half of them also lose the RTC memory and the clock
+      flash.powerOn();
+      isSleepWake = false;
+      if (rng() % 2) {
+        for (uint32_t i = durable + 1; i < appended; i++) {
+          check.lost += !check.isLost[i];
+          check.isLost[i] = true; // the RTC batch, may have made it to the flash
+        }
+        state = {};
+        clock = rng() % 1000;
+      }
+    }
+  }
+
+  flash.powerOn(); // a cut armed at the end which did not come
+  Log log(flash, state);
+  log.begin(clock, false);
+  check.mounts++;
+  verify(log, check, appended, durable);
+  log.flush();
+
+  // the stats of the State start over with the RTC memory, count on the flash
+  const HistoryTier& raw = log.state().tiers[HISTORY_RAW];
+  uint32_t minErases = UINT32_MAX, maxErases = 0, erases = 0;
+  for (uint16_t i = 0; i < flash.erases.size(); i++) {
+    erases += flash.erases[i];
+    if (i < raw.first || i >= raw.first + raw.sectors) continue;
+    if (flash.erases[i] < minErases) minErases = flash.erases[i];
+    if (flash.erases[i] > maxErases) maxErases = flash.erases[i];
+  }
+
+  // a one day range query with the index, a full scan of the tier for comparison
+  uint32_t to = log.timeOf(clock);
+  uint64_t reads = flash.reads;
+  uint32_t inDay = log.querySamples(to - 86400, to, [](const HistorySample&) {});
+  uint64_t rangeReads = flash.reads - reads;
+  reads = flash.reads;
+  uint32_t all = log.querySamples(0, HISTORY_NO_TIME, [](const HistorySample&) {});
+  uint64_t scanReads = flash.reads - reads;
+  uint32_t hours = log.queryRollups(HISTORY_HOURLY, 0, HISTORY_NO_TIME, [](const HistoryRollup&) {});
+  uint32_t days = log.queryRollups(HISTORY_DAILY, 0, HISTORY_NO_TIME, [](const HistoryRollup&) {});
+
+  printf("%u days, period %u s, %u KB partition: %u samples, %llu KB programmed, %u erases\n", o.days,
+         o.periodS, o.size / 1024, appended, (unsigned long long)flash.programmed / 1024, erases);
+  printf("power losses %u (mounts %u), samples lost with the RTC batch %u\n", o.cuts, check.mounts, check.lost);
+  printf("write amplification %.3f (programmed bytes per sample byte, rollups included)\n",
+         (double)flash.programmed / ((double)appended * sizeof(HistorySample)));
+  printf("erases per sector of the sample ring: %u .. %u\n", minErases, maxErases);
+  printf("kept: %u samples, %u hours, %u days\n", all, hours, days);
+  printf("one day query: %u samples, %llu page reads (full scan %llu)\n", inDay, (unsigned long long)rangeReads,
+         (unsigned long long)scanReads);
+  printf("%s: %u errors\n", check.errors ? "FAIL" : "ok", check.errors);
+  return check.errors ? 1 : 0;
+}
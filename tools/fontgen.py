@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""
+Converts a BDF font into a compressed glyph table for lib/UiFont/UiFont.h.
+
+Glyphs are drawn in the cell of the Adafruit_GFX classic font (5 columns plus a
+spacing column, 8 rows), so they mix with its ASCII and keep the 6 * size px
+advance the menu and the widgets lay out with. ASCII is left to the built-in font.
+
+Compression: every glyph is 5 columns of 8 pixels (one byte each, like the
+classic font). The distinct columns go into a dictionary and each glyph is 5
+dictionary indices, bit-packed with the fewest bits that fit. Glyph n starts at
+bit n * 5 * bits, so any glyph is decoded without an offset table. Code points
+map to glyph numbers through runs of consecutive code points.
+
+Usage:
+    tools/fontgen.py tools/fonts/ua5x8.bdf -o include/FontUa5x8.h
+    tools/fontgen.py my.bdf -o include/FontMy.h --name FONT_MY --only 0x400-0x4ff,0xb0
+"""
+import argparse
+import os
+import re
+import sys
+
+CELL_W = 5
+CELL_H = 8
+CELL_ASCENT = 7  # rows above the baseline, as in the classic font
+MAX_GLYPHS = 128  # glyph codes 0x80..0xff
+
+
+def parse_bdf(path):
+    """{code point: [column bytes]} of the glyphs fitting the cell."""
+    glyphs = {}
+    ascent = CELL_ASCENT
+    with open(path) as f:
+        lines = iter(f.read().splitlines())
+    for line in lines:
+        words = line.split()
+        if not words:
+            continue
+        if words[0] == 'FONT_ASCENT':
+            ascent = int(words[1])
+        if words[0] != 'STARTCHAR':
+            continue
+        name, cp, bbx, rows = words[1] if len(words) > 1 else '?', None, None, []
+        for line in lines:
+            words = line.split() or ['']
+            if words[0] == 'ENCODING':
+                cp = int(words[1])
+            elif words[0] == 'BBX':
+                bbx = tuple(map(int, words[1:5]))
+            elif words[0] == 'BITMAP':
+                for line in lines:
+                    if line.strip() == 'ENDCHAR':
+                        break
+                    rows.append(int(line, 16))
+                break
+        if cp is None or cp < 0 or bbx is None:
+            continue
+        w, h, xoff, yoff = bbx
+        if ascent != CELL_ASCENT:
+            yoff += CELL_ASCENT - ascent
+        top = CELL_ASCENT - yoff - h
+        if xoff < 0 or xoff + w > CELL_W or top < 0 or top + h > CELL_H:
+            print(f'skipped {name} U+{cp:04X}: {w}x{h} does not fit the {CELL_W}x{CELL_H} cell', file=sys.stderr)
+            continue
+        row_bits = (w + 7) // 8 * 8
+        cols = [0] * CELL_W
+        for r, bits in enumerate(rows[:h]):
+            for c in range(w):
+                if bits & (1 << (row_bits - 1 - c)):
+                    cols[xoff + c] |= 1 << (top + r)
+        glyphs[cp] = cols
+    return glyphs
+
+
+def parse_only(text):
+    ranges = []
+    for part in text.split(','):
+        lo, _, hi = part.partition('-')
+        ranges.append((int(lo, 0), int(hi or lo, 0)))
+    return ranges
+
+
+def runs(cps):
+    """Runs of consecutive code points: (first, count, first glyph)."""
+    out = []
+    for i, cp in enumerate(cps):
+        if out and out[-1][0] + out[-1][1] == cp:
+            out[-1][1] += 1
+        else:
+            out.append([cp, 1, i])
+    return out
+
+
+def pack(values, bits):
+    out = bytearray()
+    acc = n = 0
+    for v in values:
+        acc |= v << n
+        n += bits
+        while n >= 8:
+            out.append(acc & 0xFF)
+            acc >>= 8
+            n -= 8
+    if n:
+        out.append(acc)
+    return out
+
+
+def hex_rows(data, indent='  ', per_row=16):
+    return '\n'.join(indent + ', '.join(f'0x{b:02X}' for b in data[i:i + per_row]) + ','
+                     for i in range(0, len(data), per_row))
+
+
+def generate(glyphs, name, guard, source):
+    cps = sorted(glyphs)
+    columns = sorted({c for cp in cps for c in glyphs[cp]})
+    bits = max(1, (len(columns) - 1).bit_length())
+    index = {c: i for i, c in enumerate(columns)}
+    packed = pack([index[c] for cp in cps for c in glyphs[cp]], bits) + b'\0'  # the decoder reads 2 bytes
+    spans = runs(cps)
+    total = len(packed) + len(columns) + len(spans) * 4
+    raw = len(cps) * CELL_W + len(spans) * 4
+
+    out = [f'#ifndef {guard}', f'#define {guard}', '',
+           f'// Generated by tools/fontgen.py from {source}, do not edit.',
+           f'// {len(cps)} glyphs, {len(columns)} distinct columns, {bits} bit indices:',
+           f'// {total} bytes of flash ({raw} with plain columns)', '',
+           '#include "UiFont.h"', '',
+           f'static const UiFontRange {name}_RANGES[] PROGMEM = {{']
+    for first, count, glyph in spans:
+        chars = ''.join(chr(cp) for cp in range(first, first + count))
+        out.append(f'  {{ 0x{first:04X}, {count}, {glyph} }}, // {chars}')
+    out += ['};', '',
+            f'static const uint8_t {name}_COLUMNS[] PROGMEM = {{', hex_rows(columns), '};', '',
+            f'static const uint8_t {name}_INDICES[] PROGMEM = {{', hex_rows(packed), '};', '',
+            f'static const UiFontData {name} = {{',
+            f'  {name}_RANGES, {len(spans)},',
+            f'  {name}_COLUMNS, {name}_INDICES, {bits}, {len(cps)}, {total}',
+            '};', '', '#endif', '']
+    return '\n'.join(out), total, raw
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('bdf', help='BDF font')
+    ap.add_argument('-o', '--out', required=True, help='header to write')
+    ap.add_argument('--name', help='table name, FONT_<header name> by default')
+    ap.add_argument('--only', help='code point ranges to take, e.g. 0x400-0x4ff,0xb0')
+    args = ap.parse_args()
+
+    glyphs = parse_bdf(args.bdf)
+    only = parse_only(args.only) if args.only else None
+    glyphs = {cp: cols for cp, cols in glyphs.items()
+              if not 0x20 <= cp < 0x7F and (only is None or any(lo <= cp <= hi for lo, hi in only))}
+    if not glyphs:
+        sys.exit('no glyphs left')
+    if len(glyphs) > MAX_GLYPHS:
+        sys.exit(f'{len(glyphs)} glyphs, at most {MAX_GLYPHS} fit the glyph codes, use --only')
+
+    stem = os.path.splitext(os.path.basename(args.out))[0]
+    name = args.name or 'FONT_' + re.sub(r'^Font', '', stem).upper()
+    text, total, raw = generate(glyphs, name, stem + '_h', args.bdf)
+    with open(args.out, 'w') as f:
+        f.write(text)
+    print(f'{args.out}: {len(glyphs)} glyphs, {total} bytes ({raw} with plain columns)')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Reader for the metrics dumps (lib/Metrics/Metrics.h).
+
+Reads a serial monitor log, decodes every "#M<hex>" line with the names from
+include/MetricsTable.h and prints the last dump (or all with --all): counters,
+gauges with min / max and histograms with count, mean and bucket quantiles.
+
+Usage:
+    pio device monitor | tools/metrics_decode.py
+    tools/metrics_decode.py monitor.log --all
+    tools/metrics_decode.py --hex 4d01...
+"""
+import argparse
+import os
+import re
+import sys
+
+TABLE_H = os.path.join(os.path.dirname(__file__), '..', 'include', 'MetricsTable.h')
+LIST_RE = re.compile(r'#define\s+(METRICS_\w+)((?:.*\\\n)*.*)')
+METRIC_RE = re.compile(r'METRIC\(\s*(\w+)\s*,\s*"([^"]*)"\s*\)')
+
+
+def load_table(path):
+    with open(path) as f:
+        text = f.read()
+    lists = {}
+    for name, body in LIST_RE.findall(text):
+        lists[name] = METRIC_RE.findall(body)
+    return lists.get('METRICS_COUNTERS', []), lists.get('METRICS_GAUGES', []), lists.get('METRICS_HISTOGRAMS', [])
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self):
+        v = shift = 0
+        while True:
+            b = self.byte()
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return v
+
+    def zigzag(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+
+def decode(data):
+    if len(data) < 6 or data[0] != ord('M'):
+        raise ValueError('not a metrics dump')
+    version, n_counters, n_gauges, n_hist, n_buckets = data[1:6]
+    if version != 1:
+        raise ValueError(f'unknown version {version}')
+
+    r = Reader(data)
+    r.pos = 6
+    counters = [r.varint() for _ in range(n_counters)]
+    gauges = []
+    for _ in range(n_gauges):
+        gauges.append((r.zigzag(), r.zigzag(), r.zigzag()) if r.byte() else None)
+    hists = []
+    for _ in range(n_hist):
+        count, total, mask = r.varint(), r.varint(), r.varint()
+        buckets = [r.varint() if mask & (1 << b) else 0 for b in range(n_buckets)]
+        hists.append((count, total, buckets))
+    return counters, gauges, hists
+
+
+def bucket_upper(b, n_buckets):
+    if b == n_buckets - 1:
+        return 'inf'  # the last bucket takes everything above
+    return 0 if b == 0 else (1 << b) - 1
+
+
+def quantile(buckets, q):
+    rank = int(sum(buckets) * q)
+    seen = 0
+    for b, n in enumerate(buckets):
+        seen += n
+        if seen > rank:
+            return bucket_upper(b, len(buckets))
+    return 0
+
+
+def name_of(table, i):
+    return table[i][1] if i < len(table) else f'#{i}'
+
+
+def report(dump, table):
+    counters, gauges, hists = dump
+    t_counters, t_gauges, t_hists = table
+    for i, v in enumerate(counters):
+        print(f'{name_of(t_counters, i):24} {v}')
+    for i, g in enumerate(gauges):
+        if g is None:
+            print(f'{name_of(t_gauges, i):24} -')
+        else:
+            print(f'{name_of(t_gauges, i):24} {g[0]} (min {g[1]}, max {g[2]})')
+    for i, (count, total, buckets) in enumerate(hists):
+        name = name_of(t_hists, i)
+        if not count:
+            print(f'{name:24} no samples')
+            continue
+        print(f'{name:24} n {count}, mean {total / count:.1f}, '
+              f'p50 <={quantile(buckets, 0.5)}, p90 <={quantile(buckets, 0.9)}, p99 <={quantile(buckets, 0.99)}')
+        for b, n in enumerate(buckets):
+            if n:
+                lo = 0 if b == 0 else 1 << (b - 1)
+                print(f'{"":26}[{lo}, {bucket_upper(b, len(buckets))}] {n}')
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('log', nargs='?', help='monitor log, stdin by default')
+    ap.add_argument('--table', default=TABLE_H, help='metrics table header')
+    ap.add_argument('--all', action='store_true', help='print every dump, not only the last')
+    ap.add_argument('--hex', help='decode this dump instead of a log')
+    args = ap.parse_args()
+
+    table = load_table(args.table)
+    if args.hex:
+        report(decode(bytes.fromhex(args.hex)), table)
+        return
+
+    src = open(args.log, errors='replace') if args.log else sys.stdin
+    last = None
+    for line in src:
+        pos = line.find('#M')
+        if pos < 0:
+            continue
+        try:
+            dump = decode(bytes.fromhex(line[pos + 2:].strip()))
+        except (ValueError, IndexError):
+            continue
+        if args.all:
+            report(dump, table)
+            print()
+        last = dump
+
+    if last is None:
+        sys.exit('no metrics dump found')
+    if not args.all:
+        report(last, table)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,98 @@
+#ifndef UdpLoopbackTransport_h
+#define UdpLoopbackTransport_h
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <random>
+
+/**
+ * PeerSync transport for the host: node i of a fleet of n binds 127.0.0.1:basePort + i,
+ * send() is a "broadcast" to the ports of all other nodes. lossPercent drops sent packets
+ * per receiver to simulate a lossy radio.
+ */
+class UdpLoopbackTransport {
+public:
+  uint32_t sent = 0;
+  uint32_t lost = 0;
+
+  UdpLoopbackTransport(const uint16_t basePort, const uint8_t index, const uint8_t fleet, const uint8_t lossPercent = 0,
+                       const uint32_t seed = 1):
+    _basePort(basePort), _index(index), _fleet(fleet), _lossPercent(lossPercent), _rng(seed) {}
+
+  ~UdpLoopbackTransport() {
+    if (_fd >= 0) close(_fd);
+  }
+
+  /**
+   * Binds on the first call, the socket stays open for the whole simulation.
+   */
+  bool begin() {
+    if (_fd >= 0) {
+      return true;
+    }
+
+    _fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_fd < 0) {
+      return false;
+    }
+    sockaddr_in addr = address(_basePort + _index);
+    if (bind(_fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+      close(_fd);
+      _fd = -1;
+      return false;
+    }
+    return true;
+  }
+
+  bool send(const uint8_t* data, const size_t len) {
+    if (_fd < 0 || !len) {
+      return false;
+    }
+    for (uint8_t i = 0; i < _fleet; i++) {
+      if (i == _index) continue;
+      if (_lossPercent && _rng() % 100 < _lossPercent) {
+        lost++;
+        continue;
+      }
+      sockaddr_in addr = address(_basePort + i);
+      sendto(_fd, data, len, 0, (sockaddr*)&addr, sizeof(addr));
+    }
+    sent++;
+    return true;
+  }
+
+  size_t receive(uint8_t* buf, const size_t cap, const uint16_t timeoutMs) {
+    if (_fd < 0) {
+      return 0;
+    }
+    pollfd pfd = { _fd, POLLIN, 0 };
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+      return 0;
+    }
+    ssize_t len = recv(_fd, buf, cap, 0);
+    return len > 0 ? len : 0;
+  }
+
+  void end() {}
+
+private:
+  uint16_t _basePort;
+  uint8_t _index;
+  uint8_t _fleet;
+  uint8_t _lossPercent;
+  std::mt19937 _rng;
+  int _fd = -1;
+
+  static sockaddr_in address(const uint16_t port) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+  }
+};
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Fleet simulator for PeerSync: several units in one room, each with its own noisy,
+ * biased DHT and the firmware filter, exchanging real PeerSync packets over UDP on
+ * 127.0.0.1 (UdpLoopbackTransport). Runs the same room with independent units for
+ * comparison and prints servo actuations, fights (opposite moves within --fight-min
+ * minutes) and comfort violation.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -Ilib/SensorFilter -Ilib/ClimateControl -Ilib/PeerSync -Itools/peersim \
+ *       tools/peersim/peersim.cpp -o peersim
+ *
+ * Usage:
+ *   peersim [--nodes 3] [--days 2] [--period 60] [--loss 0] [--seed 1] [--port 47000]
+ *           [--low 22] [--high 25] [--bias 0.8] [--noise 0.4] [--skew 20000] [--fight-min 30]
+ *
+ * Every slot all units send first and then receive, so the listen window is not waited
+ * for (PEER_LISTEN_MS 0). Unit clocks start up to --skew ms apart and are pulled to
+ * the leader's clock by the protocol.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define PEER_LISTEN_MS 0
+#include "ClimateControl.h"
+#include "PeerSync.h"
+#include "UdpLoopbackTransport.h"
+
+struct Options {
+  int nodes = 3;
+  int days = 2;
+  uint32_t periodS = 60;
+  int loss = 0;
+  uint32_t seed = 1;
+  uint16_t port = 47000;
+  float low = 22;
+  float high = 25;
+  float bias = 0.8;     // sd of the fixed per sensor error
+  float noise = 0.4;    // sd of the per reading error
+  uint32_t skewMs = 20000;
+  int fightMin = 30;
+  float openEffect = 3; // room cooling with all windows opened
+  float tau = 900;
+  float comfortLow = 21;
+  float comfortHigh = 26;
+};
+
+struct Unit {
+  TempFilter filter;
+  PeerSync peer;
+  std::unique_ptr<UdpLoopbackTransport> link;
+  float bias = 0;
+  int32_t clockMs = 0; // unit clock - simulation clock
+  bool isOpened = false;
+  uint32_t actuations = 0;
+  uint32_t lastMoveS = 0;
+  int8_t lastMove = 0;
+};
+
+struct Outcome {
+  uint32_t actuations = 0;
+  uint32_t fights = 0;
+  double violation = 0; // C * min
+  uint64_t bytes = 0;
+  uint32_t wakes = 0;
+  uint32_t plans = 0;
+};
+
+static float roomBase(const uint32_t t, std::mt19937& rng, float& drift) {
+  std::normal_distribution<float> walk(0, 0.03f);
+  drift = drift * 0.998f + walk(rng);
+  return 23.5f + 3.0f * sinf(2 * (float)M_PI * ((t % 86400) - 32400) / 86400.0f) + drift;
+}
+
+static Outcome run(const Options& o, const bool isCoordinated) {
+  std::mt19937 rng(o.seed);
+  std::normal_distribution<float> biasDist(0, o.bias);
+  std::normal_distribution<float> noiseDist(0, o.noise);
+  std::uniform_int_distribution<int32_t> skewDist(0, o.skewMs);
+
+  std::vector<Unit> units(o.nodes);
+  for (int i = 0; i < o.nodes; i++) {
+    Unit& u = units[i];
+    u.bias = biasDist(rng);
+    u.clockMs = skewDist(rng);
+    u.peer.begin(0x1000 + i * 7);
+    u.link.reset(new UdpLoopbackTransport(o.port, i, o.nodes, o.loss, o.seed + i));
+  }
+
+  Outcome out;
+  float drift = 0;
+  float offset = 0; // room - base, from the opened windows
+  uint32_t periodMs = o.periodS * 1000;
+  uint32_t end = o.days * 86400;
+
+  for (uint32_t t = 0; t < end; t += o.periodS) {
+    float room = roomBase(t, rng, drift) + offset;
+
+    for (Unit& u : units) {
+      float reading = roundf((room + u.bias + noiseDist(rng)) * 10) / 10;
+      u.filter.push(reading);
+      out.wakes++;
+    }
+
+    std::vector<ClimateRequest> requests(o.nodes, CLIMATE_KEEP);
+    if (isCoordinated) {
+      for (Unit& u : units) {
+        u.peer.setLocal(u.filter.ready, u.filter.value, u.isOpened ? PEER_WND_OPENED : 0, false);
+        u.peer.stats.lastBytes = 0;
+        u.link->begin();
+        u.peer.publish(*u.link, t * 1000 + u.clockMs);
+      }
+      for (int i = 0; i < o.nodes; i++) {
+        Unit& u = units[i];
+        uint32_t now = t * 1000 + u.clockMs;
+        u.peer.collect(*u.link, now, periodMs);
+        u.link->end();
+        u.peer.expire(now, periodMs);
+        requests[i] = u.peer.decide(o.low, o.high, now, periodMs);
+        out.bytes += u.peer.stats.lastBytes;
+      }
+    } else {
+      for (int i = 0; i < o.nodes; i++) {
+        requests[i] = climateRequest(units[i].filter.ready, units[i].filter.value, o.low, o.high, false);
+      }
+    }
+
+    uint8_t opened = 0;
+    for (int i = 0; i < o.nodes; i++) {
+      Unit& u = units[i];
+      int8_t move = 0;
+      if (requests[i] == CLIMATE_OPEN && climateNeedsOpen(u.isOpened, false)) move = 1;
+      if (requests[i] == CLIMATE_CLOSE && climateNeedsClose(u.isOpened, false)) move = -1;
+      if (move) {
+        u.isOpened = move > 0;
+        u.actuations++;
+        out.actuations++;
+        u.lastMove = move;
+        u.lastMoveS = t;
+      }
+      opened += u.isOpened;
+    }
+
+    // a fight: units moving in opposite directions within fightMin
+    for (int i = 0; i < o.nodes; i++) {
+      for (int j = i + 1; j < o.nodes; j++) {
+        const Unit& a = units[i];
+        const Unit& b = units[j];
+        if (a.lastMove && b.lastMove && a.lastMove != b.lastMove && (a.lastMoveS == t || b.lastMoveS == t) &&
+            (a.lastMoveS > b.lastMoveS ? a.lastMoveS - b.lastMoveS : b.lastMoveS - a.lastMoveS) < (uint32_t)o.fightMin * 60) {
+          out.fights++;
+        }
+      }
+    }
+
+    float target = -o.openEffect * opened / o.nodes;
+    offset = target + (offset - target) * expf(-(float)o.periodS / o.tau);
+    float dev = room < o.comfortLow ? o.comfortLow - room : (room > o.comfortHigh ? room - o.comfortHigh : 0);
+    out.violation += dev * o.periodS / 60.0;
+  }
+
+  for (Unit& u : units) {
+    out.plans += u.peer.stats.plans;
+  }
+  return out;
+}
+
+static void print(const char* name, const Outcome& r, const Options& o) {
+  double days = o.days;
+  printf("%-12s actuations/day %7.1f  fights/day %6.1f  violation C*min/day %7.1f", name, r.actuations / days,
+         r.fights / days, r.violation / days);
+  if (r.bytes) {
+    printf("  plans %u  radio bytes/wake %.1f", r.plans, (double)r.bytes / r.wakes);
+  }
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* val = argv[i + 1];
+    if (!strcmp(arg, "--nodes")) o.nodes = atoi(val);
+    else if (!strcmp(arg, "--days")) o.days = atoi(val);
+    else if (!strcmp(arg, "--period")) o.periodS = atoi(val);
+    else if (!strcmp(arg, "--loss")) o.loss = atoi(val);
+    else if (!strcmp(arg, "--seed")) o.seed = strtoul(val, nullptr, 10);
+    else if (!strcmp(arg, "--port")) o.port = atoi(val);
+    else if (!strcmp(arg, "--low")) o.low = atof(val);
+    else if (!strcmp(arg, "--high")) o.high = atof(val);
+    else if (!strcmp(arg, "--bias")) o.bias = atof(val);
+    else if (!strcmp(arg, "--noise")) o.noise = atof(val);
+    else if (!strcmp(arg, "--skew")) o.skewMs = atoi(val);
+    else if (!strcmp(arg, "--fight-min")) o.fightMin = atoi(val);
+    else {
+      fprintf(stderr, "unknown option %s, see the header of tools/peersim/peersim.cpp\n", arg);
+      return 2;
+    }
+  }
+  if (o.nodes < 1 || o.nodes > PEER_MAX || o.days < 1 || o.periodS < 1) {
+    fprintf(stderr, "nodes 1..%d, days and period > 0\n", PEER_MAX);
+    return 2;
+  }
+
+  printf("%d units, %d days, period %u s, loss %d %%\n", o.nodes, o.days, o.periodS, o.loss);
+  print("independent", run(o, false), o);
+  print("peersync", run(o, true), o);
+  return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * Host microbenchmark of the loop scheduler: TimerWheel::advance() (lib/TimerWheel) once
+ * per loop pass against the three GTimer isReady() checks it replaced (display timeout,
+ * motion animation, sensor period; the check is a copy of GyverTimer 3.2 isReady(),
+ * a millis() read per timer and pass).
+ *
+ * Both run the same schedule over --seconds of simulated time with --passes loop passes
+ * per millisecond and count the same callbacks. millis() is either a plain counter
+ * (--clock counter: the bookkeeping alone) or a clock_gettime() read behind it
+ * (--clock real: like arduino-esp32, where millis() is esp_timer_get_time() / 1000,
+ * a system timer read). The host numbers are only a ratio; on the target "loop_sched"
+ * of the BENCH build gives the cycles.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -Itools/encsim/shim -Ilib/TimerWheel tools/schedbench/schedbench.cpp -o schedbench
+ *
+ * Usage:
+ *   schedbench [--seconds 600] [--passes 20] [--clock both|counter|real]
+ *
+ * Exits with 1 if the two schedulers fired a different number of callbacks.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include "TimerWheel.h"
+
+#define DISPLAY_TIMEOUT_MS 30000
+#define ANIM_PERIOD_MS 300
+#define SENSOR_PERIOD_MS 20000
+
+static uint32_t simNow = 0;
+static bool isRealClock = false;
+static volatile uint32_t sink = 0;
+
+/**
+ * millis() of the benchmark: the simulated time, plus a clock read for --clock real.
+ */
+__attribute__((noinline)) static uint32_t benchMillis() {
+  if (isRealClock) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    sink = sink + (uint32_t)ts.tv_nsec;
+  }
+  return simNow;
+}
+
+// GyverTimer 3.2 GTimer in MS mode, isReady() as in the library
+class GTimerCopy {
+public:
+  void setInterval(const uint32_t ms) {
+    _interval = ms;
+    _mode = true;
+    _state = true;
+    _timer = benchMillis();
+  }
+
+  void setTimeout(const uint32_t ms) {
+    _interval = ms;
+    _mode = false;
+    _state = true;
+    _timer = benchMillis();
+  }
+
+  bool isReady() {
+    if (!_state) return false;
+    uint32_t thisTime = benchMillis();
+    if (thisTime - _timer >= _interval) {
+      if (_mode) {
+        do {
+          _timer += _interval;
+          if (_timer < _interval) break;
+        } while (_timer < thisTime - _interval);
+      } else {
+        _state = false;
+      }
+      return true;
+    }
+    return false;
+  }
+
+private:
+  uint32_t _timer = 0;
+  uint32_t _interval = 0;
+  bool _mode = false;
+  bool _state = false;
+};
+
+struct Counts {
+  uint32_t display = 0;
+  uint32_t anim = 0;
+  uint32_t sensor = 0;
+
+  uint32_t total() const {
+    return display + anim + sensor;
+  }
+};
+
+static double nsPerPass(std::chrono::steady_clock::time_point start, const uint64_t passes) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / passes;
+}
+
+static double runGTimer(const uint32_t seconds, const uint32_t passes, Counts& c) {
+  GTimerCopy displayIdle, anim, sensor;
+  simNow = 0;
+  displayIdle.setTimeout(DISPLAY_TIMEOUT_MS);
+  anim.setInterval(ANIM_PERIOD_MS);
+  sensor.setInterval(SENSOR_PERIOD_MS);
+
+  auto start = std::chrono::steady_clock::now();
+  for (simNow = 0; simNow < seconds * 1000; simNow++) {
+    for (uint32_t p = 0; p < passes; p++) {
+      if (displayIdle.isReady()) {
+        c.display++;
+        displayIdle.setTimeout(DISPLAY_TIMEOUT_MS); // the next input
+      }
+      if (anim.isReady()) c.anim++;
+      if (sensor.isReady()) c.sensor++;
+    }
+  }
+  return nsPerPass(start, (uint64_t)seconds * 1000 * passes);
+}
+
+static TimerWheel* benchWheel = nullptr;
+static WheelTimer displayIdleTimer = {};
+
+static void onDisplay(void* arg) {
+  ((Counts*)arg)->display++;
+  benchWheel->after(displayIdleTimer, DISPLAY_TIMEOUT_MS, simNow);
+}
+
+static void onAnim(void* arg) {
+  ((Counts*)arg)->anim++;
+}
+
+static void onSensor(void* arg) {
+  ((Counts*)arg)->sensor++;
+}
+
+static double runWheel(const uint32_t seconds, const uint32_t passes, Counts& c) {
+  TimerWheel wheel;
+  WheelTimer anim = {}, sensor = {};
+  benchWheel = &wheel;
+  simNow = 0;
+  wheel.begin(benchMillis());
+  displayIdleTimer = { onDisplay, &c, 0, 0, nullptr, 0, false };
+  anim = { onAnim, &c, ANIM_PERIOD_MS, 0, nullptr, 0, false };
+  sensor = { onSensor, &c, SENSOR_PERIOD_MS, 0, nullptr, 0, false };
+  wheel.after(displayIdleTimer, DISPLAY_TIMEOUT_MS, benchMillis());
+  wheel.after(anim, ANIM_PERIOD_MS, benchMillis());
+  wheel.after(sensor, SENSOR_PERIOD_MS, benchMillis());
+
+  auto start = std::chrono::steady_clock::now();
+  for (simNow = 0; simNow < seconds * 1000; simNow++) {
+    for (uint32_t p = 0; p < passes; p++) {
+      wheel.advance(benchMillis());
+    }
+  }
+  return nsPerPass(start, (uint64_t)seconds * 1000 * passes);
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = 600;
+  uint32_t passes = 20;
+  const char* clock = "both";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* arg = argv[i];
+    const char* val = argv[i + 1];
+    if (!strcmp(arg, "--seconds")) seconds = atoi(val);
+    else if (!strcmp(arg, "--passes")) passes = atoi(val);
+    else if (!strcmp(arg, "--clock")) clock = val;
+    else {
+      fprintf(stderr, "unknown option %s, see the header of tools/schedbench/schedbench.cpp\n", arg);
+      return 2;
+    }
+  }
+  if (seconds < 1 || passes < 1) {
+    fprintf(stderr, "seconds and passes > 0\n");
+    return 2;
+  }
+
+  uint32_t errors = 0;
+  for (int real = 0; real < 2; real++) {
+    if (strcmp(clock, "both") && strcmp(clock, real ? "real" : "counter")) continue;
+    isRealClock = real;
+
+    Counts gtimer, wheel;
+    double gtimerNs = runGTimer(seconds, passes, gtimer);
+    double wheelNs = runWheel(seconds, passes, wheel);
+    printf("%-7s clock: GTimer x3 %6.2f ns/pass, TimerWheel %6.2f ns/pass (%.1fx), callbacks %u / %u\n",
+           real ? "real" : "counter", gtimerNs, wheelNs, gtimerNs / wheelNs, gtimer.total(), wheel.total());
+    if (gtimer.total() != wheel.total()) {
+      printf("FAIL: display %u / %u, anim %u / %u, sensor %u / %u\n", gtimer.display, wheel.display, gtimer.anim,
+             wheel.anim, gtimer.sensor, wheel.sensor);
+      errors++;
+    }
+  }
+  return errors ? 1 : 0;
+}
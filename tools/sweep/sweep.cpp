@@ -0,0 +1,524 @@
+/*
+ * Parameter sweep over recorded temperature traces.
+ *
+ * Replays every trace for every combination of highTemp, gap (lowTemp = highTemp - gap),
+ * checkPeriod and tempCorrection with the firmware decision logic (lib/ClimateControl)
+ * and the same temperature filter pipeline, spread over all cores. Prints the Pareto
+ * front of comfort violation against servo actuations and wakes per day.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -pthread -Ilib/SensorFilter -Ilib/ClimateControl tools/sweep/sweep.cpp -o sweep
+ *
+ * Usage:
+ *   sweep [options] trace.csv...
+ *   sweep --synthetic 365 --high 22:27:0.5 --period 60,300,600 --csv all.csv
+ *
+ * Traces:
+ *   "time_s,temp_c" lines, or the telemetry_listen.py output (device,seq,time,type,code,a,b,c),
+ *   where the closed window samples (type=sample, code=0) are taken, temp = a / 10.
+ *   A trace is the room temperature with the window closed. Lines which do not parse
+ *   (headers, comments) are skipped, gaps longer than --max-gap split the trace.
+ *
+ * Room model:
+ *   while opened the room drifts exponentially (--tau) towards trace - --open-effect,
+ *   after closing it drifts back. The sensor reads room + --sensor-bias + gaussian --noise
+ *   in --dht-step steps, --fail-rate of the reads fail (NaN), the firmware sees the filtered
+ *   reading + tempCorrection. Servo motion is instant. The noise is the same for every
+ *   combination (seeded per trace).
+ *
+ * Grid options take "from:to:step" or a comma list:
+ *   --high 22:27:0.5  --gap 0.5:4:0.5  --period 20,60,120,300,600  --corr -3:0:0.5
+ *
+ * Other options:
+ *   --comfort-low 21 --comfort-high 26   comfort band of the real room temperature
+ *   --open-effect 4 --tau 900            room response to the opened window (C, s)
+ *   --sensor-bias 1.5 --dht-step 0.1     sensor error and resolution
+ *   --noise 0 --fail-rate 0              DHT read noise (C, sd) and failed reads (0..1)
+ *   --compare-filter                     also replay the unfiltered reading (the firmware
+ *                                        before the filter pipeline: a failed read keeps the
+ *                                        last value) and print its actuations per day next
+ *                                        to the filtered ones
+ *   --max-gap 900                        trace gap (s) which starts a new trace
+ *   --synthetic DAYS --seed 1            add a generated trace instead of / with files
+ *   --threads N                          default: all cores
+ *   --csv FILE                           all results
+ *   --top N                              Pareto rows to print, default 30
+ *
+ * Combinations with exactly the same outcome (e.g. highTemp + 0.5 with tempCorrection + 0.5)
+ * are listed once, "same" counts the others; --csv has all of them.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ClimateControl.h"
+
+struct Sample {
+  double time;
+  float temp;
+};
+
+typedef std::vector<Sample> Trace;
+
+struct Params {
+  float highTemp;
+  float lowTemp;
+  uint32_t checkPeriod;
+  float tempCorrection;
+};
+
+struct Result {
+  Params params;
+  double violation = 0; // degree-minutes outside of the comfort band per day
+  double outside = 0;   // minutes outside of the comfort band per day
+  double actuations = 0;
+  double wakes = 0;
+  double rawActuations = 0; // --compare-filter: the unfiltered reading
+  double rawViolation = 0;
+  bool isPareto = false;
+  uint32_t equivalents = 0; // Pareto combinations with the same outcome, not listed separately
+};
+
+struct Model {
+  float comfortLow = 21;
+  float comfortHigh = 26;
+  float openEffect = 4;
+  float tau = 900;
+  float sensorBias = 1.5;
+  float dhtStep = 0.1;
+  float maxGap = 900;
+  float noise = 0;
+  float failRate = 0;
+};
+
+static const double SUBSTEP_S = 60; // comfort integration step
+
+static bool parseGrid(const char* spec, std::vector<double>& out) {
+  out.clear();
+  double from, to, step;
+  if (strchr(spec, ':')) {
+    if (sscanf(spec, "%lf:%lf:%lf", &from, &to, &step) != 3 || step <= 0 || to < from) {
+      return false;
+    }
+    for (int i = 0; from + i * step <= to + step * 1e-6; i++) {
+      out.push_back(from + i * step);
+    }
+    return true;
+  }
+
+  const char* p = spec;
+  while (*p) {
+    char* end;
+    double val = strtod(p, &end);
+    if (end == p) {
+      return false;
+    }
+    out.push_back(val);
+    p = *end == ',' ? end + 1 : end;
+  }
+  return !out.empty();
+}
+
+static void addTrace(std::vector<Trace>& traces, Trace& trace) {
+  if (trace.size() >= 2) {
+    traces.push_back(trace);
+  }
+  trace.clear();
+}
+
+static bool loadTraces(const char* path, const Model& model, std::vector<Trace>& traces) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return false;
+  }
+
+  Trace trace;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    Sample s;
+    double time, temp;
+    char device[32], type[16];
+    unsigned seq, code;
+    int a;
+    if (sscanf(line, "%31[^,],%u,%lf,%15[^,],%u,%d", device, &seq, &time, type, &code, &a) == 6) {
+      if (strcmp(type, "sample") || code != 0) {
+        continue;
+      }
+      s = { time, a / 10.0f };
+    } else if (sscanf(line, "%lf,%lf", &time, &temp) == 2) {
+      s = { time, (float)temp };
+    } else {
+      continue;
+    }
+
+    if (!trace.empty() && (s.time <= trace.back().time || s.time - trace.back().time > model.maxGap)) {
+      addTrace(traces, trace);
+    }
+    trace.push_back(s);
+  }
+  addTrace(traces, trace);
+  fclose(f);
+  return true;
+}
+
+/**
+ * Daily sine with a slow random walk on top, one sample per minute.
+ */
+static Trace syntheticTrace(const int days, const uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> walk(0, 0.05f);
+  std::normal_distribution<float> dayShift(0, 1.5f);
+
+  Trace trace;
+  float drift = 0;
+  float dayBase = 23;
+  for (int minute = 0; minute < days * 1440; minute++) {
+    if (minute % 1440 == 0) {
+      dayBase = 23 + dayShift(rng);
+    }
+    drift = drift * 0.995f + walk(rng);
+    double time = minute * 60.0;
+    float daily = 2.5f * sinf(2 * (float)M_PI * (minute % 1440 - 540) / 1440.0f);
+    trace.push_back({ time, dayBase + daily + drift });
+  }
+  return trace;
+}
+
+static float traceAt(const Trace& trace, size_t& cursor, const double time) {
+  while (cursor + 2 < trace.size() && trace[cursor + 1].time <= time) {
+    cursor++;
+  }
+  const Sample& a = trace[cursor];
+  const Sample& b = trace[cursor + 1];
+  double k = (time - a.time) / (b.time - a.time);
+  k = k < 0 ? 0 : (k > 1 ? 1 : k);
+  return a.temp + (b.temp - a.temp) * (float)k;
+}
+
+static void simulate(const std::vector<Trace>& traces, const Model& model, Result& result, const bool isFiltered = true) {
+  const Params& p = result.params;
+  double days = 0;
+  double violation = 0, outside = 0;
+  uint32_t actuations = 0, wakes = 0;
+
+  uint32_t substeps = (uint32_t)ceil(p.checkPeriod / SUBSTEP_S);
+  double dt = (double)p.checkPeriod / substeps;
+  float decay = expf(-(float)dt / model.tau);
+
+  for (size_t n = 0; n < traces.size(); n++) {
+    const Trace& trace = traces[n];
+    std::mt19937 rng(n + 1);
+    std::normal_distribution<float> noise(0, model.noise > 0 ? model.noise : 1);
+    std::uniform_real_distribution<float> fail(0, 1);
+    TempFilter filter;
+    float last = 0; // the unfiltered path
+    bool isLastValid = false;
+    bool isFullOpened = false;
+    float offset = 0; // room - trace
+    size_t cursor = 0;
+    double end = trace.back().time;
+    days += (end - trace.front().time) / 86400;
+
+    for (double time = trace.front().time; time < end; time += p.checkPeriod) {
+      float room = traceAt(trace, cursor, time) + offset;
+      float sensed = room + model.sensorBias + (model.noise > 0 ? noise(rng) : 0);
+      float reading = roundf(sensed / model.dhtStep) * model.dhtStep;
+      if (model.failRate > 0 && fail(rng) < model.failRate) {
+        reading = NAN;
+      }
+      wakes++;
+
+      bool isReady;
+      float cur_t;
+      if (isFiltered) {
+        filter.push(reading);
+        isReady = filter.ready;
+        cur_t = filter.value + p.tempCorrection;
+      } else {
+        if (!std::isnan(reading)) {
+          last = reading;
+          isLastValid = true;
+        }
+        isReady = isLastValid;
+        cur_t = last + p.tempCorrection;
+      }
+      switch (climateRequest(isReady, cur_t, p.lowTemp, p.highTemp, false)) {
+        case CLIMATE_OPEN:
+          if (climateNeedsOpen(isFullOpened, false)) {
+            isFullOpened = true;
+            actuations++;
+          }
+          break;
+        case CLIMATE_CLOSE:
+          if (climateNeedsClose(isFullOpened, false)) {
+            isFullOpened = false;
+            actuations++;
+          }
+          break;
+        default:
+          break;
+      }
+
+      float target = isFullOpened ? -model.openEffect : 0;
+      size_t stepCursor = cursor;
+      for (uint32_t i = 0; i < substeps; i++) {
+        offset = target + (offset - target) * decay;
+        double t = time + (i + 1) * dt;
+        if (t > end) {
+          break;
+        }
+        room = traceAt(trace, stepCursor, t) + offset;
+        float dev = room < model.comfortLow ? model.comfortLow - room : (room > model.comfortHigh ? room - model.comfortHigh : 0);
+        if (dev > 0) {
+          violation += dev * dt / 60;
+          outside += dt / 60;
+        }
+      }
+    }
+  }
+
+  if (days > 0 && !isFiltered) {
+    result.rawActuations = actuations / days;
+    result.rawViolation = violation / days;
+  } else if (days > 0) {
+    result.violation = violation / days;
+    result.outside = outside / days;
+    result.actuations = actuations / days;
+    result.wakes = wakes / days;
+  }
+}
+
+static bool dominates(const Result& a, const Result& b) {
+  return a.violation <= b.violation && a.actuations <= b.actuations && a.wakes <= b.wakes &&
+         (a.violation < b.violation || a.actuations < b.actuations || a.wakes < b.wakes);
+}
+
+static bool isSameOutcome(const Result& a, const Result& b) {
+  return a.violation == b.violation && a.actuations == b.actuations && a.wakes == b.wakes;
+}
+
+/**
+ * Marks the non dominated results, returns them without the equivalent duplicates,
+ * ordered by violation.
+ */
+static std::vector<Result*> markPareto(std::vector<Result>& results) {
+  std::vector<Result*> order;
+  for (Result& r : results) {
+    order.push_back(&r);
+  }
+  std::sort(order.begin(), order.end(), [](const Result* a, const Result* b) {
+    if (a->violation != b->violation) return a->violation < b->violation;
+    if (a->actuations != b->actuations) return a->actuations < b->actuations;
+    return a->wakes < b->wakes;
+  });
+
+  // in this order a result can only be dominated by an earlier one
+  std::vector<Result*> front;
+  for (Result* r : order) {
+    bool isDominated = false;
+    for (Result* f : front) {
+      if (isSameOutcome(*f, *r)) {
+        r->isPareto = true;
+        f->equivalents++;
+        isDominated = true;
+        break;
+      }
+      if (dominates(*f, *r)) {
+        isDominated = true;
+        break;
+      }
+    }
+    if (!isDominated) {
+      r->isPareto = true;
+      front.push_back(r);
+    }
+  }
+  return front;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: sweep [--high a:b:s] [--gap a:b:s] [--period list] [--corr a:b:s] [--synthetic DAYS]\n"
+                  "             [--threads N] [--csv FILE] [--top N] [--compare-filter] [model options] trace.csv...\n"
+                  "see the header of tools/sweep/sweep.cpp\n");
+}
+
+int main(int argc, char** argv) {
+  Model model;
+  std::vector<double> highs, gaps, periods, corrs;
+  parseGrid("22:27:0.5", highs);
+  parseGrid("0.5:4:0.5", gaps);
+  parseGrid("20,60,120,300,600", periods);
+  parseGrid("-3:0:0.5", corrs);
+
+  int syntheticDays = 0;
+  uint32_t seed = 1;
+  unsigned threads = std::thread::hardware_concurrency();
+  const char* csvPath = nullptr;
+  size_t top = 30;
+  bool isComparing = false;
+  std::vector<const char*> paths;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool hasVal = true;
+    bool ok = true;
+    if (!strcmp(arg, "--high")) ok = val && parseGrid(val, highs);
+    else if (!strcmp(arg, "--gap")) ok = val && parseGrid(val, gaps);
+    else if (!strcmp(arg, "--period")) ok = val && parseGrid(val, periods);
+    else if (!strcmp(arg, "--corr")) ok = val && parseGrid(val, corrs);
+    else if (!strcmp(arg, "--comfort-low")) ok = val && (model.comfortLow = atof(val), true);
+    else if (!strcmp(arg, "--comfort-high")) ok = val && (model.comfortHigh = atof(val), true);
+    else if (!strcmp(arg, "--open-effect")) ok = val && (model.openEffect = atof(val), true);
+    else if (!strcmp(arg, "--tau")) ok = val && (model.tau = atof(val)) > 0;
+    else if (!strcmp(arg, "--sensor-bias")) ok = val && (model.sensorBias = atof(val), true);
+    else if (!strcmp(arg, "--dht-step")) ok = val && (model.dhtStep = atof(val)) > 0;
+    else if (!strcmp(arg, "--max-gap")) ok = val && (model.maxGap = atof(val)) > 0;
+    else if (!strcmp(arg, "--noise")) ok = val && (model.noise = atof(val)) >= 0;
+    else if (!strcmp(arg, "--fail-rate")) ok = val && (model.failRate = atof(val)) >= 0 && model.failRate < 1;
+    else if (!strcmp(arg, "--compare-filter")) {
+      isComparing = true;
+      hasVal = false;
+    }
+    else if (!strcmp(arg, "--synthetic")) ok = val && (syntheticDays = atoi(val)) > 0;
+    else if (!strcmp(arg, "--seed")) ok = val && (seed = strtoul(val, nullptr, 10), true);
+    else if (!strcmp(arg, "--threads")) ok = val && (threads = atoi(val)) > 0;
+    else if (!strcmp(arg, "--csv")) ok = (csvPath = val) != nullptr;
+    else if (!strcmp(arg, "--top")) ok = val && (top = atoi(val), true);
+    else if (arg[0] == '-' && arg[1]) ok = false;
+    else {
+      paths.push_back(arg);
+      hasVal = false;
+    }
+
+    if (!ok) {
+      fprintf(stderr, "bad option: %s %s\n", arg, val ? val : "");
+      usage();
+      return 2;
+    }
+    if (hasVal) {
+      i++;
+    }
+  }
+
+  std::vector<Trace> traces;
+  for (const char* path : paths) {
+    if (!loadTraces(path, model, traces)) {
+      return 1;
+    }
+  }
+  if (syntheticDays) {
+    traces.push_back(syntheticTrace(syntheticDays, seed));
+  }
+  if (traces.empty()) {
+    usage();
+    return 2;
+  }
+
+  std::vector<Result> results;
+  for (double high : highs) {
+    for (double gap : gaps) {
+      for (double period : periods) {
+        for (double corr : corrs) {
+          if (period < 1) {
+            continue;
+          }
+          Result r;
+          r.params = { (float)high, (float)(high - gap), (uint32_t)period, (float)corr };
+          results.push_back(r);
+        }
+      }
+    }
+  }
+
+  double traceDays = 0;
+  for (const Trace& trace : traces) {
+    traceDays += (trace.back().time - trace.front().time) / 86400;
+  }
+  threads = threads ? threads : 1;
+  fprintf(stderr, "%zu traces, %.1f days, %zu combinations, %u threads\n",
+          traces.size(), traceDays, results.size(), threads);
+
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back([&]() {
+      for (size_t i = next++; i < results.size(); i = next++) {
+        simulate(traces, model, results[i]);
+        if (isComparing) {
+          simulate(traces, model, results[i], false);
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%.2f s, %.0f trace-days/s\n", seconds, traceDays * results.size() / seconds);
+
+  std::vector<Result*> front = markPareto(results);
+
+  if (csvPath) {
+    FILE* f = fopen(csvPath, "w");
+    if (!f) {
+      fprintf(stderr, "%s: %s\n", csvPath, strerror(errno));
+      return 1;
+    }
+    fprintf(f, "high_temp,low_temp,check_period,temp_correction,violation_cmin_day,outside_min_day,actuations_day,wakes_day,pareto%s\n",
+            isComparing ? ",raw_actuations_day,raw_violation_cmin_day" : "");
+    for (const Result& r : results) {
+      fprintf(f, "%.2f,%.2f,%u,%.2f,%.2f,%.1f,%.2f,%.1f,%d", r.params.highTemp, r.params.lowTemp, r.params.checkPeriod,
+              r.params.tempCorrection, r.violation, r.outside, r.actuations, r.wakes, r.isPareto);
+      if (isComparing) {
+        fprintf(f, ",%.2f,%.2f", r.rawActuations, r.rawViolation);
+      }
+      fprintf(f, "\n");
+    }
+    fclose(f);
+  }
+
+  printf("Pareto front: %zu outcomes of %zu combinations (violation C*min/day, minutes outside/day, actuations/day, wakes/day)\n",
+         front.size(), results.size());
+  printf("%6s %6s %6s %6s | %10s %8s %8s %8s %5s%s\n", "high", "low", "period", "corr", "violation", "outside", "servo", "wakes", "same",
+         isComparing ? " | raw servo" : "");
+  for (size_t i = 0; i < front.size() && i < top; i++) {
+    const Result& r = *front[i];
+    printf("%6.1f %6.1f %6u %6.1f | %10.1f %8.1f %8.2f %8.0f %5u", r.params.highTemp, r.params.lowTemp, r.params.checkPeriod,
+           r.params.tempCorrection, r.violation, r.outside, r.actuations, r.wakes, r.equivalents);
+    if (isComparing) {
+      printf(" | %9.2f", r.rawActuations);
+    }
+    printf("\n");
+  }
+  if (front.size() > top) {
+    printf("... %zu more, see --csv\n", front.size() - top);
+  }
+
+  if (isComparing) {
+    double filtered = 0, raw = 0, filteredViolation = 0, rawViolation = 0;
+    size_t fewer = 0;
+    for (const Result& r : results) {
+      filtered += r.actuations;
+      raw += r.rawActuations;
+      filteredViolation += r.violation;
+      rawViolation += r.rawViolation;
+      fewer += r.actuations < r.rawActuations;
+    }
+    size_t n = results.size();
+    printf("filter: %.2f actuations/day against %.2f unfiltered (%.0f%% fewer), fewer in %zu of %zu combinations; "
+           "violation %.1f against %.1f C*min/day\n", filtered / n, raw / n, raw > 0 ? 100 * (1 - filtered / raw) : 0.0,
+           fewer, n, filteredViolation / n, rawViolation / n);
+  }
+  return 0;
+}
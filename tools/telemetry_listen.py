@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+UDP listener for the batched telemetry uplink (lib/Telemetry/Telemetry.h).
+
+Stand-in for the real collector: prints every record as a CSV line
+    device,seq,time,type,code,a,b,c
+plus a per-batch summary on stderr (size, records, radio on time per sample).
+
+Usage: telemetry_listen.py [--port 5140] [--bind 0.0.0.0]
+"""
+import argparse
+import socket
+import struct
+import sys
+
+MAGIC = ord('T')
+VERSION = 1
+TYPES = ['sample', 'actuation', 'fault', 'event']
+
+
+def varint(buf, pos):
+    result = shift = 0
+    while True:
+        b = buf[pos]
+        pos += 1
+        result |= (b & 0x7F) << shift
+        if b < 0x80:
+            return result, pos
+        shift += 7
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def decode(packet):
+    if len(packet) < 15 or packet[0] != MAGIC or packet[1] != VERSION:
+        raise ValueError('not a telemetry packet')
+
+    device, seq, now, radio_ms, count = struct.unpack_from('<IHIHB', packet, 2)
+    pos = 15
+    prev = [[0, 0, 0] for _ in TYPES]
+    time = now
+    records = []
+
+    for i in range(count):
+        tc = packet[pos]
+        pos += 1
+        t, code = tc >> 4, tc & 0x0F
+        dt, pos = varint(packet, pos)
+        time = now - dt if i == 0 else time + dt
+        for k in range(3):
+            d, pos = varint(packet, pos)
+            prev[t][k] += unzigzag(d)
+        records.append((time, TYPES[t], code, *prev[t]))
+
+    return {'device': device, 'seq': seq, 'now': now, 'radio_ms': radio_ms, 'records': records}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--port', type=int, default=5140)
+    ap.add_argument('--bind', default='0.0.0.0')
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    print('device,seq,time,type,code,a,b,c', flush=True)
+
+    while True:
+        packet, addr = sock.recvfrom(4096)
+        try:
+            batch = decode(packet)
+        except (ValueError, IndexError, struct.error) as e:
+            print(f'{addr[0]}: bad packet ({e})', file=sys.stderr)
+            continue
+
+        for r in batch['records']:
+            print(f"{batch['device']:08x},{batch['seq']}," + ','.join(str(v) for v in r), flush=True)
+
+        n = len(batch['records'])
+        # radio time of this batch is reported in the next one
+        print(f"{addr[0]}: device {batch['device']:08x} seq {batch['seq']} "
+              f"{len(packet)} bytes, {n} records, previous batch radio on {batch['radio_ms']} ms",
+              file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
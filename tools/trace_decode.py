@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+Decoder for the binary trace events (lib/Trace/Trace.h).
+
+Reads a serial monitor log, turns every "#T<hex>" line into readable text using
+the event table in include/TraceEvents.h and passes all other lines through.
+
+Usage:
+    pio device monitor | tools/trace_decode.py
+    tools/trace_decode.py monitor.log
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+EVENTS_H = os.path.join(os.path.dirname(__file__), '..', 'include', 'TraceEvents.h')
+EVENT_RE = re.compile(r'TRACE_EVENT\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+ARG_FORMATS = {0: '<i', 1: '<I', 2: '<f'}
+
+
+def load_events(path):
+    with open(path) as f:
+        return EVENT_RE.findall(f.read())
+
+
+def decode_record(data, events):
+    event_id, types, timestamp = data[0], data[1], struct.unpack_from('<I', data, 2)[0]
+    argc = types >> 6
+    args = []
+    for i in range(argc):
+        fmt = ARG_FORMATS.get((types >> (2 * i)) & 3, '<I')
+        args.append(struct.unpack_from(fmt, data, 6 + 4 * i)[0])
+
+    if event_id >= len(events):
+        return timestamp, f'unknown event {event_id} {args}'
+
+    name, fmt = events[event_id]
+    try:
+        text = fmt % tuple(args)
+    except (TypeError, ValueError):
+        text = f'{fmt} {args}'
+    return timestamp, f'{name}: {text}'
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('log', nargs='?', help='monitor log, stdin by default')
+    ap.add_argument('--events', default=EVENTS_H, help='event table header')
+    args = ap.parse_args()
+
+    events = load_events(args.events)
+    src = open(args.log, errors='replace') if args.log else sys.stdin
+    prev_ts = None
+
+    for line in src:
+        pos = line.find('#T')
+        if pos < 0:
+            sys.stdout.write(line)
+            continue
+
+        try:
+            data = bytes.fromhex(line[pos + 2:].strip())
+            ts, text = decode_record(data, events)
+        except (ValueError, IndexError, struct.error):
+            sys.stdout.write(line)
+            continue
+
+        if text.startswith('TR_BOOT'):
+            prev_ts = None
+        delta = '' if prev_ts is None else f' (+{(ts - prev_ts) & 0xFFFFFFFF} us)'
+        prev_ts = ts
+        print(f'[{ts / 1e6:10.6f}]{delta} {text}', flush=True)
+
+
+if __name__ == '__main__':
+    main()
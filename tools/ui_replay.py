@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Scripted menu input for the input to photon latency (lib/UiLatency/UiLatency.h).
+
+Sends a replay script to firmware built with -D UI_LATENCY_REPLAY, reads the
+"UI_LATENCY ..." report and fails (exit 1) if the p99 latency is over the budget,
+so a display or menu change can be checked against the same input every time.
+
+Script, one command per line, '#' starts a comment:
+    inc / dec [N]     N encoder detents (default 1)
+    click [N]         N button clicks
+    wait MS           pause on the host side
+    every MS          pause after every following input (default 150)
+The default script opens the menu, walks it down and up at a normal and a fast
+pace, edits a value and leaves. The edges are timestamped when they arrive, so
+the serial link is not part of the measured latency.
+
+Start it while the display is on (after a reset or a button wake); with deep
+sleep enabled the unit sleeps after the display timeout of a pause.
+
+Usage:
+    tools/ui_replay.py /dev/ttyUSB0
+    tools/ui_replay.py /dev/ttyACM0 --script menu_walk.txt --budget 40
+"""
+import argparse
+import re
+import sys
+import time
+
+DEFAULT_SCRIPT = """
+click           # main screen -> menu
+inc 11          # walk down and back at a relaxed pace
+dec 11
+every 20        # fast spin, detents closer than ENC_ISR_FAST_MS
+inc 11
+dec 11
+every 300
+click           # edit the selected value
+inc 3
+dec 3
+click
+"""
+
+REPORT_RE = re.compile(r'UI_LATENCY n (\d+) p50 (\d+) p90 (\d+) p99 (\d+) max (\d+) mean (\d+) '
+                       r'invisible (\d+) dropped (\d+)')
+
+
+def parse_script(text):
+    """(command, pause_s) pairs; a wait is a command-less pause."""
+    steps = []
+    every = 0.15
+    for n, line in enumerate(text.splitlines(), 1):
+        words = line.split('#')[0].split()
+        if not words:
+            continue
+        cmd, arg = words[0], int(words[1]) if len(words) > 1 else 1
+        if cmd in ('inc', 'dec', 'click'):
+            steps += [(cmd, every)] * arg
+        elif cmd == 'wait':
+            steps.append((None, arg / 1000))
+        elif cmd == 'every':
+            every = arg / 1000
+        else:
+            raise ValueError(f'line {n}: unknown command {cmd}')
+    return steps
+
+
+def read_report(port, timeout):
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        line = port.readline().decode(errors='replace').strip()
+        m = REPORT_RE.search(line)
+        if m:
+            return line, dict(zip(('n', 'p50', 'p90', 'p99', 'max', 'mean', 'invisible', 'dropped'),
+                                  map(int, m.groups())))
+    return None, None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('port', help='serial port of the unit')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--script', help='replay script, the built-in menu walk by default')
+    ap.add_argument('--budget', type=int, default=50, help='p99 budget in ms (UI_LATENCY_BUDGET_MS)')
+    ap.add_argument('--repeat', type=int, default=1, help='run the script this many times')
+    args = ap.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit('needs pyserial: pip install pyserial')
+
+    steps = parse_script(open(args.script).read() if args.script else DEFAULT_SCRIPT)
+    with serial.Serial(args.port, args.baud, timeout=0.5) as port:
+        port.reset_input_buffer()
+        port.write(b'reset\n')
+        for _ in range(args.repeat):
+            for cmd, pause in steps:
+                if cmd:
+                    port.write(cmd.encode() + b'\n')
+                time.sleep(pause)
+        time.sleep(0.5)  # the last click is delivered after the debounce, its flush after that
+        port.reset_input_buffer()
+        port.write(b'report\n')
+        line, report = read_report(port, 3)
+
+    if report is None:
+        sys.exit('no UI_LATENCY report, is the firmware built with -D UI_LATENCY_REPLAY?')
+    print(line)
+    inputs = sum(1 for cmd, _ in steps if cmd) * args.repeat
+    print(f'{inputs} inputs sent, {report["n"]} measured, {report["invisible"]} without a new frame, '
+          f'{report["dropped"]} dropped')
+    if report['p99'] > args.budget:
+        print(f'p99 {report["p99"]} ms is over the budget of {args.budget} ms')
+        sys.exit(1)
+    print(f'p99 {report["p99"]} ms within the budget of {args.budget} ms')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,138 @@
+#ifndef Adafruit_GFX_h
+#define Adafruit_GFX_h
+
+#include "Arduino.h"
+
+/**
+ * Host stand-in for Adafruit_GFX, only for tools/uicheck: rotation, fillRect() /
+ * fillScreen() / drawRoundRect() over drawPixel(), and text with the cursor, wrap and drawChar() rules of
+ * the library. The classic font is not copied: an ASCII character is a made up 5x7
+ * pattern of its code (a space is empty), enough to check where text lands.
+ */
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h): WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t i = x; i < x + w; i++) {
+      for (int16_t j = y; j < y + h; j++) {
+        drawPixel(i, j, color);
+      }
+    }
+  }
+
+  /**
+   * The outline with the corners cut diagonally, not the library's quarter circles.
+   */
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+    for (int16_t i = x + r; i < x + w - r; i++) {
+      drawPixel(i, y, color);
+      drawPixel(i, y + h - 1, color);
+    }
+    for (int16_t j = y + r; j < y + h - r; j++) {
+      drawPixel(x, j, color);
+      drawPixel(x + w - 1, j, color);
+    }
+    for (int16_t k = 1; k < r; k++) {
+      drawPixel(x + k, y + r - k, color);
+      drawPixel(x + w - 1 - k, y + r - k, color);
+      drawPixel(x + k, y + h - 1 - r + k, color);
+      drawPixel(x + w - 1 - k, y + h - 1 - r + k, color);
+    }
+  }
+
+  virtual void fillScreen(uint16_t color) {
+    fillRect(0, 0, _width, _height, color);
+  }
+
+  virtual void setRotation(uint8_t r) {
+    rotation = r & 3;
+    _width = rotation & 1 ? HEIGHT : WIDTH;
+    _height = rotation & 1 ? WIDTH : HEIGHT;
+  }
+
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size) {
+    for (int8_t i = 0; i < 6; i++) {
+      uint8_t line = i < 5 ? glyphColumn(c, i) : 0;
+      for (int8_t j = 0; j < 8; j++, line >>= 1) {
+        if (!(line & 1) && bg == color) {
+          continue;
+        }
+        uint16_t col = line & 1 ? color : bg;
+        if (size == 1) {
+          drawPixel(x + i, y + j, col);
+        } else {
+          fillRect(x + i * size, y + j * size, size, size, col);
+        }
+      }
+    }
+  }
+
+  static uint8_t glyphColumn(const unsigned char c, const uint8_t i) {
+    return c == ' ' ? 0 : (((c * 0x9D) ^ (i * 0x35)) & 0x7F) | 0x01;
+  }
+
+  virtual size_t write(uint8_t c) {
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+    } else if (c != '\r') {
+      if (wrap && cursor_x + textsize_x * 6 > _width) {
+        cursor_x = 0;
+        cursor_y += textsize_y * 8;
+      }
+      drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x);
+      cursor_x += textsize_x * 6;
+    }
+    return 1;
+  }
+
+  using Print::write;
+
+  void setCursor(int16_t x, int16_t y) {
+    cursor_x = x;
+    cursor_y = y;
+  }
+
+  void setTextColor(uint16_t c) {
+    textcolor = textbgcolor = c;
+  }
+
+  void setTextColor(uint16_t c, uint16_t bg) {
+    textcolor = c;
+    textbgcolor = bg;
+  }
+
+  void setTextSize(uint8_t s) {
+    textsize_x = textsize_y = s ? s : 1;
+  }
+
+  void setTextWrap(bool w) {
+    wrap = w;
+  }
+
+  int16_t width() const {
+    return _width;
+  }
+
+  int16_t height() const {
+    return _height;
+  }
+
+  uint8_t getRotation() const {
+    return rotation;
+  }
+
+protected:
+  const int16_t WIDTH, HEIGHT;
+  int16_t _width, _height;
+  int16_t cursor_x = 0, cursor_y = 0;
+  uint16_t textcolor = 0xFFFF, textbgcolor = 0xFFFF;
+  uint8_t textsize_x = 1, textsize_y = 1;
+  uint8_t rotation = 0;
+  bool wrap = true;
+};
+
+#endif
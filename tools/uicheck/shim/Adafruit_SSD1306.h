@@ -0,0 +1,14 @@
+#ifndef Adafruit_SSD1306_h
+#define Adafruit_SSD1306_h
+
+// host stand-in: the colors only, see tools/uicheck
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+#define INVERSE SSD1306_INVERSE
+
+#endif
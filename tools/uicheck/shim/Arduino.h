@@ -0,0 +1,81 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+/**
+ * Host stand-in for the parts of Arduino.h the display libraries and the menu use: Print,
+ * PROGMEM access and the integer types. Only for tools/uicheck.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+
+  size_t write(const char* str) {
+    return write((const uint8_t*)str, strlen(str));
+  }
+
+  virtual size_t write(const uint8_t* buf, size_t len) {
+    size_t n = 0;
+    while (len--) {
+      n += write(*buf++);
+    }
+    return n;
+  }
+
+  size_t print(const char* str) {
+    return write(str);
+  }
+
+  size_t print(const __FlashStringHelper* str) {
+    return write((const char*)str);
+  }
+
+  size_t print(const long val) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%ld", val);
+    return write(buf);
+  }
+
+  size_t print(const unsigned long val) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%lu", val);
+    return write(buf);
+  }
+
+  size_t print(const int val) {
+    return print((long)val);
+  }
+
+  size_t print(const unsigned int val) {
+    return print((unsigned long)val);
+  }
+
+  size_t print(const uint8_t val) {
+    return print((unsigned long)val);
+  }
+
+  size_t println(const char* str = "") {
+    return write(str) + write('\n');
+  }
+};
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * Host check of the retained main screen (lib/RetainedUi) on HeadlessDisplay
+ * (lib/DisplayBackend): the widgets of the main screen at their firmware places render
+ * into the framebuffer and only the changed region is pushed with displayRegion(), as
+ * updateMainScreen() does. After every flush the panel buffer must equal the drawn
+ * picture, and before it the stale pixels must lie inside the region render() returned.
+ *
+ * Checked: the first full render, a single changed widget (region, flushed bytes), an
+ * unchanged value (nothing drawn), a widget repainted because it overlaps a changed one
+ * below it, a flush of too small a rect leaving stale pixels, rotation 2 (physical flush
+ * rect), the UTF-8 label glyphs against the font table, and the menu (lib/GOledMenuAda):
+ * a selection or value change pushes only the item rows, a page change the whole screen.
+ *
+ * Arduino.h / Adafruit_GFX.h / Adafruit_SSD1306.h come from tools/uicheck/shim; the
+ * ASCII glyphs there are made up patterns, the Ukrainian ones are the real font.
+ *
+ * Build (from the repo root):
+ *   g++ -O2 -std=c++17 -Itools/uicheck/shim -Ilib/DisplayBackend -Ilib/RetainedUi -Ilib/UiFont -Iinclude \
+ *       -Ilib/GOledMenuAda -Ilib/FixedFormat tools/uicheck/uicheck.cpp -o uicheck
+ *
+ * Usage:
+ *   uicheck [--dump]     --dump prints the panel after every step
+ *
+ * Exits with 1 if a check failed.
+ */
+#include <cstdio>
+#include <cstring>
+
+#include "HeadlessDisplay.h"
+#include "RetainedUi.h"
+#include "FontUa5x8.h"
+#include "GOledMenuAda.h"
+
+#define SCREEN_WIDTH 128
+#define SCREEN_HEIGHT 64
+
+typedef UiText<HeadlessDisplay> TextWidget;
+
+class StdoutPrint : public Print {
+public:
+  size_t write(uint8_t c) override {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+  }
+  using Print::write;
+};
+
+struct Check {
+  uint32_t errors = 0;
+  bool isDumping = false;
+};
+
+static void expect(Check& c, const bool ok, const char* what, const long got = 0, const long want = 0) {
+  if (!ok && c.errors++ < 20) {
+    printf("FAIL %s (%ld, expected %ld)\n", what, got, want);
+  }
+}
+
+/**
+ * Pixels where the panel differs from the picture, and how many of them lie outside
+ * the physical rect.
+ */
+static uint32_t stalePixels(const HeadlessDisplay& d, uint32_t& outside, const int16_t x = 0, const int16_t y = 0,
+                            const int16_t w = 0, const int16_t h = 0) {
+  uint32_t stale = 0;
+  outside = 0;
+  for (int16_t py = 0; py < SCREEN_HEIGHT; py++) {
+    for (int16_t px = 0; px < SCREEN_WIDTH; px++) {
+      if (d.getPixel(px, py) != d.getPixel(px, py, true)) {
+        stale++;
+        outside += px < x || px >= x + w || py < y || py >= y + h;
+      }
+    }
+  }
+  return stale;
+}
+
+static uint32_t stalePixels(const HeadlessDisplay& d) {
+  uint32_t outside;
+  return stalePixels(d, outside);
+}
+
+static uint32_t pagesOf(const int16_t y, const int16_t h) {
+  return (y + h - 1) / 8 - y / 8 + 1;
+}
+
+static void dump(Check& c, const HeadlessDisplay& d, const char* step) {
+  if (!c.isDumping) {
+    return;
+  }
+  StdoutPrint out;
+  printf("-- %s\n", step);
+  d.dump(out);
+}
+
+/**
+ * One render() + displayRegion() of the changed region; the stale pixels before the
+ * flush must be inside it (physical = logical at rotation 0).
+ */
+template< uint8_t _N >
+static UiRect renderAndFlush(Check& c, HeadlessDisplay& d, UiScreen<_N, HeadlessDisplay>& screen, const char* step) {
+  UiRect r = screen.render(d);
+  if (d.getRotation() == 0) {
+    uint32_t outside;
+    stalePixels(d, outside, r.x, r.y, r.w, r.h);
+    expect(c, outside == 0, "stale pixels outside the changed region", outside, 0);
+  }
+  if (!r.isEmpty()) {
+    d.displayRegion(r.x, r.y, r.w, r.h);
+  }
+  expect(c, stalePixels(d) == 0, "panel differs from the picture after the flush", stalePixels(d), 0);
+  dump(c, d, step);
+  return r;
+}
+
+static void checkMainScreen(Check& c) {
+  HeadlessDisplay d(SCREEN_WIDTH, SCREEN_HEIGHT);
+  expect(c, d.begin(), "begin");
+
+  TextWidget humWidget(20, 4, 17);
+  TextWidget tempWidget(2, 16, 7, 3);
+  TextWidget wndStateWidget(4, SCREEN_HEIGHT - 18, 7, 2);
+  TextWidget voltageWidget(SCREEN_WIDTH - 16-26, SCREEN_HEIGHT - 23, 5);
+  TextWidget powerWidget(SCREEN_WIDTH - 16-26-4, SCREEN_HEIGHT - 12, 1); // overlaps wndStateWidget
+  TextWidget batPersWidget(SCREEN_WIDTH - 24, SCREEN_HEIGHT - 12, 4);
+  UiScreen<6, HeadlessDisplay> screen;
+  screen.add(&humWidget);
+  screen.add(&tempWidget);
+  screen.add(&wndStateWidget);
+  screen.add(&voltageWidget);
+  screen.add(&powerWidget);
+  screen.add(&batPersWidget);
+
+  humWidget.set("ВОЛОГІСТЬ: 45.20%");
+  tempWidget.set("21.5°C");
+  wndStateWidget.set("ЗАКР.");
+  voltageWidget.set("7.9V");
+  powerWidget.set("");
+  batPersWidget.set("83%");
+
+  // first render: everything
+  UiRect r = renderAndFlush(c, d, screen, "first render");
+  expect(c, r.w == SCREEN_WIDTH && r.h == SCREEN_HEIGHT, "first render is the whole screen", r.w * r.h,
+         SCREEN_WIDTH * SCREEN_HEIGHT);
+  expect(c, screen.drawCalls == 6, "first render draws every widget", screen.drawCalls, 6);
+  expect(c, d.flushedBytes == d.ramBytes(), "first flush bytes", d.flushedBytes, d.ramBytes());
+  expect(c, d.litPixels() > 0, "something is drawn");
+
+  // one value: that widget, its rect, its pages
+  expect(c, humWidget.set("ВОЛОГІСТЬ: 45.30%"), "changed text");
+  r = renderAndFlush(c, d, screen, "humidity");
+  expect(c, screen.drawCalls == 1, "one widget repainted", screen.drawCalls, 1);
+  expect(c, r.x == humWidget.rect.x && r.y == humWidget.rect.y && r.w == humWidget.rect.w && r.h == humWidget.rect.h,
+         "region is the widget rect");
+  expect(c, d.flushedBytes == r.w * pagesOf(r.y, r.h), "flushed bytes", d.flushedBytes, r.w * pagesOf(r.y, r.h));
+
+  // the same value again: nothing
+  uint32_t flushes = d.flushes;
+  expect(c, !humWidget.set("ВОЛОГІСТЬ: 45.30%"), "same text is no change");
+  r = renderAndFlush(c, d, screen, "no change");
+  expect(c, r.isEmpty() && screen.drawCalls == 0 && d.flushes == flushes, "nothing drawn or flushed", screen.drawCalls, 0);
+
+  // the window state repaints the power mark drawn over it
+  powerWidget.set("!");
+  renderAndFlush(c, d, screen, "power mark");
+  wndStateWidget.set("ВІДКР.");
+  r = renderAndFlush(c, d, screen, "window state");
+  expect(c, screen.drawCalls == 2, "overlapping widget repainted", screen.drawCalls, 2);
+  uint32_t lit = 0;
+  for (int16_t y = powerWidget.rect.y; y < powerWidget.rect.y + powerWidget.rect.h; y++) {
+    for (int16_t x = powerWidget.rect.x; x < powerWidget.rect.x + powerWidget.rect.w; x++) {
+      lit += d.getPixel(x, y, true);
+    }
+  }
+  expect(c, lit > 0, "power mark still shown over the window state");
+
+  // a flush smaller than the region leaves the rest stale
+  tempWidget.set("22.0°C");
+  r = screen.render(d);
+  d.displayRegion(r.x, r.y, r.w / 2, r.h);
+  expect(c, stalePixels(d) > 0, "half a flush leaves stale pixels");
+  d.displayRegion(r.x, r.y, r.w, r.h);
+  expect(c, stalePixels(d) == 0, "the whole region clears them", stalePixels(d), 0);
+  dump(c, d, "temperature");
+}
+
+static void checkRotation(Check& c) {
+  HeadlessDisplay d(SCREEN_WIDTH, SCREEN_HEIGHT);
+  d.begin();
+  d.setRotation(2);
+
+  TextWidget a(0, 0, 10);
+  TextWidget b(10, 40, 5, 2);
+  UiScreen<2, HeadlessDisplay> screen;
+  screen.add(&a);
+  screen.add(&b);
+  a.set("МЕНЮ");
+  b.set("21.5");
+  renderAndFlush(c, d, screen, "rotation 2");
+
+  b.set("21.6");
+  UiRect r = renderAndFlush(c, d, screen, "rotation 2, changed");
+  expect(c, d.lastX == SCREEN_WIDTH - r.x - r.w, "physical x of the flush", d.lastX, SCREEN_WIDTH - r.x - r.w);
+  expect(c, d.lastY == SCREEN_HEIGHT - r.y - r.h, "physical y of the flush", d.lastY, SCREEN_HEIGHT - r.y - r.h);
+
+  // the drawn pixels are mirrored: the top left logical pixel is the bottom right one
+  d.fillScreen(BLACK);
+  d.drawPixel(0, 0, WHITE);
+  d.display();
+  expect(c, d.getPixel(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1, true), "rotated pixel");
+}
+
+static void checkGlyphs(Check& c) {
+  HeadlessDisplay d(SCREEN_WIDTH, SCREEN_HEIGHT);
+  d.begin();
+
+  static const char* LABELS[] = { "ВОЛОГІСТЬ", "ВІДКР.", "ЗАКР.", "°C", "Ґєї" };
+  for (const char* label : LABELS) {
+    d.clearDisplay();
+    d.setTextSize(1);
+    d.setTextColor(WHITE);
+    d.setCursor(0, 0);
+    d.print(label);
+    d.display();
+
+    Utf8Decoder utf8;
+    int16_t x = 0;
+    for (const char* p = label; *p; p++) {
+      uint32_t cp;
+      if (!utf8.push(*p, cp)) continue;
+      if (cp >= 0x80) {
+        uint8_t code = uiFont().codeOf(cp);
+        expect(c, code != 0, "glyph in the font", cp, 0);
+        const uint8_t* cols = uiFont().columns(code);
+        for (uint8_t i = 0; i < 5; i++) {
+          for (uint8_t j = 0; j < 8; j++) {
+            bool want = cols[i] >> j & 1;
+            if (d.getPixel(x + i, j, true) != want) {
+              expect(c, false, "glyph pixel on the panel", x + i, j);
+            }
+          }
+        }
+      }
+      x += 6;
+    }
+  }
+  dump(c, d, "glyphs");
+}
+
+/**
+ * Menu flushes: after every step the panel equals the picture, a step on one page pushes
+ * at most the two item rows it changed (with the value frame one pixel below).
+ */
+static void checkMenu(Check& c) {
+  HeadlessDisplay d(SCREEN_WIDTH, SCREEN_HEIGHT);
+  d.begin();
+
+  static int period = 60;
+  static float temp = 21.5f;
+  static boolean isFlip = false;
+  OledMenu<8, HeadlessDisplay> menu(&d);
+  menu.addItem(PSTR("ВІДКР."));
+  menu.addItem(PSTR("ПЕРІОД (с)"), GM_N_INT(10), &period, GM_N_INT(10), GM_N_INT(3600));
+  menu.addItem(PSTR("ТЕМПЕР."), GM_N_FLOAT(0.5), &temp, GM_N_FLOAT(5), GM_N_FLOAT(35));
+  menu.addItem(PSTR("Перев. ЕКРАН"), &isFlip);
+  menu.addItem(PSTR("4"));
+  menu.addItem(PSTR("5"));
+  menu.addItem(PSTR("6"));
+  menu.addItem(PSTR("<<< ВИХІД"));
+
+  menu.showMenu(true);
+  expect(c, d.flushedBytes == d.ramBytes(), "menu opens with a full flush", d.flushedBytes, d.ramBytes());
+  expect(c, stalePixels(d) == 0, "menu shown", stalePixels(d), 0);
+  dump(c, d, "menu");
+
+  // a row is 10 px from a multiple of 10, 11 with the frame: at most 3 pages, two rows 6
+  const uint32_t rowsMax = 2 * 3 * SCREEN_WIDTH;
+  struct Step {
+    const char* name;
+    void (*run)(OledMenu<8, HeadlessDisplay>&);
+  };
+  static const Step STEPS[] = {
+    { "select next", [](OledMenu<8, HeadlessDisplay>& m) { m.selectNext(); } },
+    { "change period", [](OledMenu<8, HeadlessDisplay>& m) { m.toggleChangeSelected(); } },
+    { "period up", [](OledMenu<8, HeadlessDisplay>& m) { m.selectNext(); } },
+    { "period down fast", [](OledMenu<8, HeadlessDisplay>& m) { m.selectPrev(true); } },
+    { "period done", [](OledMenu<8, HeadlessDisplay>& m) { m.toggleChangeSelected(); } },
+    { "select temperature", [](OledMenu<8, HeadlessDisplay>& m) { m.selectNext(); } },
+    { "change temperature", [](OledMenu<8, HeadlessDisplay>& m) { m.toggleChangeSelected(); } },
+    { "temperature up", [](OledMenu<8, HeadlessDisplay>& m) { m.selectNext(); } },
+    { "temperature done", [](OledMenu<8, HeadlessDisplay>& m) { m.toggleChangeSelected(); } },
+    { "select flip", [](OledMenu<8, HeadlessDisplay>& m) { m.selectNext(); } },
+    { "flip", [](OledMenu<8, HeadlessDisplay>& m) { m.toggleChangeSelected(); m.selectNext(); } },
+    { "flip done", [](OledMenu<8, HeadlessDisplay>& m) { m.toggleChangeSelected(); } },
+    { "select previous", [](OledMenu<8, HeadlessDisplay>& m) { m.selectPrev(); } },
+  };
+  for (const Step& s : STEPS) {
+    uint32_t flushes = d.flushes;
+    s.run(menu);
+    // flushedBytes is the last flush, a selection step makes two of the same size
+    uint32_t bytes = d.flushedBytes * (d.flushes - flushes);
+    expect(c, d.flushes > flushes, s.name, d.flushes - flushes, 1);
+    expect(c, bytes <= rowsMax, s.name, bytes, rowsMax);
+    expect(c, stalePixels(d) == 0, s.name, stalePixels(d), 0);
+    dump(c, d, s.name);
+  }
+  expect(c, period == 60 + 10 - 10 * MENU_FAST_K, "period", period, 60 + 10 - 10 * MENU_FAST_K);
+  expect(c, temp == 22.0f, "temperature", temp * 10, 220);
+  expect(c, isFlip, "flip");
+
+  // to the next page: the whole screen (no page slide callback here)
+  for (int i = 0; i < 4; i++) {
+    menu.selectNext();
+  }
+  expect(c, d.flushedBytes == d.ramBytes(), "page change is a full flush", d.flushedBytes, d.ramBytes());
+  expect(c, stalePixels(d) == 0, "second page", stalePixels(d), 0);
+  dump(c, d, "second page");
+}
+
+int main(int argc, char** argv) {
+  Check check;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--dump")) check.isDumping = true;
+    else {
+      fprintf(stderr, "unknown option %s, see the header of tools/uicheck/uicheck.cpp\n", argv[i]);
+      return 2;
+    }
+  }
+
+  uiFont().setFont(&FONT_UA5X8);
+  checkMainScreen(check);
+  checkRotation(check);
+  checkGlyphs(check);
+  checkMenu(check);
+
+  printf("%s: %u errors\n", check.errors ? "FAIL" : "ok", check.errors);
+  return check.errors ? 1 : 0;
+}